@@ -0,0 +1,205 @@
+#include "CameraCaptureRegistry.h"
+#include "MLCaptureStats.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+
+const TArray<AActor*> UCameraCaptureRegistry::EmptyCameras;
+const TArray<USceneCaptureComponent2D*> UCameraCaptureRegistry::EmptyCaptures;
+
+void UCameraCaptureRegistry::Initialize(FSubsystemCollectionBase& Collection)
+{
+    Super::Initialize(Collection);
+
+    UWorld* World = GetWorld();
+    ActorSpawnedHandle = World->AddOnActorSpawnedHandler(FOnActorSpawned::FDelegate::CreateUObject(this, &UCameraCaptureRegistry::HandleActorSpawned));
+    ActorDestroyedHandle = World->AddOnActorDestroyedHandler(FOnActorDestroyed::FDelegate::CreateUObject(this, &UCameraCaptureRegistry::HandleActorDestroyed));
+}
+
+void UCameraCaptureRegistry::Deinitialize()
+{
+    if (UWorld* World = GetWorld())
+    {
+        World->RemoveOnActorSpawnedHandler(ActorSpawnedHandle);
+        World->RemoveOnActorDestroyedHandler(ActorDestroyedHandle);
+    }
+    CameraSets.Empty();
+    CameraIds.Empty();
+    PendingSpawners.Empty();
+
+    Super::Deinitialize();
+}
+
+void UCameraCaptureRegistry::WatchClass(TSubclassOf<AActor> CameraClass)
+{
+    if (!CameraClass || CameraSets.Contains(CameraClass))
+        return;
+
+    FMLRegisteredCameraSet& CameraSet = CameraSets.Add(CameraClass);
+    CameraSet.CapturesByType.SetNum(static_cast<int32>(EMLBufferType::Count));
+
+    // One-time scan for instances placed in the level or spawned before anyone watched this class
+    for (TActorIterator<AActor> It(GetWorld(), CameraClass); It; ++It)
+    {
+        AActor* Camera = *It;
+        if (IsValid(Camera) && !CameraSet.Members.Contains(Camera))
+        {
+            CameraSet.Cameras.Add(Camera);
+            CameraSet.Members.Add(Camera, CameraSet.NextSlot++);
+        }
+    }
+
+    UE_LOG(LogMLCapture, Log, TEXT("Camera registry watching %s: %d existing instances"), *CameraClass->GetName(), CameraSet.Cameras.Num());
+}
+
+void UCameraCaptureRegistry::RegisterCamera(AActor* Camera, int32 CameraId)
+{
+    if (!IsValid(Camera))
+        return;
+
+    // The spawn event may already have registered the camera; the ID still applies
+    if (CameraId != INDEX_NONE)
+    {
+        CameraIds.Add(Camera, CameraId);
+    }
+
+    for (TPair<UClass*, FMLRegisteredCameraSet>& Pair : CameraSets)
+    {
+        FMLRegisteredCameraSet& CameraSet = Pair.Value;
+        if (!Camera->IsA(Pair.Key) || CameraSet.Members.Contains(Camera))
+            continue;
+
+        CameraSet.Cameras.Add(Camera);
+        CameraSet.Members.Add(Camera, CameraSet.NextSlot++);
+        CameraSet.bCapturesDirty = true;
+        CamerasChanged.Broadcast(Pair.Key, Camera, true);
+    }
+}
+
+void UCameraCaptureRegistry::UnregisterCamera(AActor* Camera)
+{
+    if (!Camera)
+        return;
+
+    CameraIds.Remove(Camera);
+    for (TPair<UClass*, FMLRegisteredCameraSet>& Pair : CameraSets)
+    {
+        FMLRegisteredCameraSet& CameraSet = Pair.Value;
+        if (CameraSet.Members.Remove(Camera) == 0)
+            continue;
+
+        // Remaining cameras keep their slots, so indices already bound elsewhere stay valid
+        CameraSet.Cameras.Remove(Camera);
+        CameraSet.bCapturesDirty = true;
+        CamerasChanged.Broadcast(Pair.Key, Camera, false);
+    }
+}
+
+void UCameraCaptureRegistry::MarkCapturesDirty()
+{
+    for (TPair<UClass*, FMLRegisteredCameraSet>& Pair : CameraSets)
+    {
+        Pair.Value.bCapturesDirty = true;
+    }
+}
+
+void UCameraCaptureRegistry::BeginSpawnBatch(const UObject* Spawner)
+{
+    PendingSpawners.Add(Spawner);
+}
+
+void UCameraCaptureRegistry::EndSpawnBatch(const UObject* Spawner)
+{
+    if (PendingSpawners.Remove(Spawner) > 0 && PendingSpawners.Num() == 0)
+    {
+        SpawnsComplete.Broadcast();
+    }
+}
+
+void UCameraCaptureRegistry::HandleActorSpawned(AActor* Actor)
+{
+    RegisterCamera(Actor);
+}
+
+void UCameraCaptureRegistry::HandleActorDestroyed(AActor* Actor)
+{
+    UnregisterCamera(Actor);
+}
+
+FMLRegisteredCameraSet* UCameraCaptureRegistry::FindSet(TSubclassOf<AActor> CameraClass)
+{
+    if (!CameraClass)
+        return nullptr;
+
+    WatchClass(CameraClass);
+    return CameraSets.Find(CameraClass);
+}
+
+void UCameraCaptureRegistry::RefreshCaptures(FMLRegisteredCameraSet& CameraSet)
+{
+    for (FMLCaptureList& List : CameraSet.CapturesByType)
+    {
+        List.Captures.Reset();
+    }
+    CameraSet.AllCaptures.Reset();
+
+    TInlineComponentArray<USceneCaptureComponent2D*> SceneCaptures;
+    for (AActor* Camera : CameraSet.Cameras)
+    {
+        if (!IsValid(Camera))
+            continue;
+
+        Camera->GetComponents(SceneCaptures);
+        for (USceneCaptureComponent2D* SceneCapture : SceneCaptures)
+        {
+            if (IsValid(SceneCapture))
+            {
+                CameraSet.CapturesByType[static_cast<int32>(MLCapture::ClassifyCapture(SceneCapture))].Captures.Add(SceneCapture);
+                CameraSet.AllCaptures.Add(SceneCapture);
+            }
+        }
+    }
+
+    CameraSet.bCapturesDirty = false;
+}
+
+const TArray<AActor*>& UCameraCaptureRegistry::GetCameras(TSubclassOf<AActor> CameraClass)
+{
+    FMLRegisteredCameraSet* CameraSet = FindSet(CameraClass);
+    return CameraSet ? CameraSet->Cameras : EmptyCameras;
+}
+
+int32 UCameraCaptureRegistry::GetCameraIndex(TSubclassOf<AActor> CameraClass, const AActor* Camera)
+{
+    if (const int32* CameraId = CameraIds.Find(Camera))
+        return *CameraId;
+
+    FMLRegisteredCameraSet* CameraSet = FindSet(CameraClass);
+    const int32* Slot = CameraSet ? CameraSet->Members.Find(Camera) : nullptr;
+    return Slot ? *Slot : INDEX_NONE;
+}
+
+const TArray<USceneCaptureComponent2D*>& UCameraCaptureRegistry::GetCaptures(TSubclassOf<AActor> CameraClass, EMLBufferType BufferType)
+{
+    FMLRegisteredCameraSet* CameraSet = FindSet(CameraClass);
+    if (!CameraSet)
+        return EmptyCaptures;
+
+    if (CameraSet->bCapturesDirty)
+    {
+        RefreshCaptures(*CameraSet);
+    }
+    return CameraSet->CapturesByType[static_cast<int32>(BufferType)].Captures;
+}
+
+const TArray<USceneCaptureComponent2D*>& UCameraCaptureRegistry::GetAllCaptures(TSubclassOf<AActor> CameraClass)
+{
+    FMLRegisteredCameraSet* CameraSet = FindSet(CameraClass);
+    if (!CameraSet)
+        return EmptyCaptures;
+
+    if (CameraSet->bCapturesDirty)
+    {
+        RefreshCaptures(*CameraSet);
+    }
+    return CameraSet->AllCaptures;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "MLCaptureTypes.h"
+#include "CameraCaptureRegistry.generated.h"
+
+USTRUCT()
+struct FMLCaptureList
+{
+    GENERATED_BODY()
+
+    UPROPERTY()
+    TArray<USceneCaptureComponent2D*> Captures;
+};
+
+// Cameras of one watched class plus their capture components split by buffer type
+USTRUCT()
+struct FMLRegisteredCameraSet
+{
+    GENERATED_BODY()
+
+    // Registration order
+    UPROPERTY()
+    TArray<AActor*> Cameras;
+
+    // Indexed by EMLBufferType
+    UPROPERTY()
+    TArray<FMLCaptureList> CapturesByType;
+
+    // Concatenation of CapturesByType
+    UPROPERTY()
+    TArray<USceneCaptureComponent2D*> AllCaptures;
+
+    // Registration slot of each camera; this is the camera index used throughout the capture pipeline unless a
+    // spawner gave an ID. Slots are never reused, so removing a camera does not renumber the others.
+    TMap<const AActor*, int32> Members;
+    int32 NextSlot = 0;
+    bool bCapturesDirty = true;
+};
+
+DECLARE_MULTICAST_DELEGATE_ThreeParams(FOnRegisteredCamerasChanged, UClass* /*CameraClass*/, AActor* /*Camera*/, bool /*bAdded*/);
+DECLARE_MULTICAST_DELEGATE(FOnCameraSpawnsComplete);
+
+// Persistent list of camera actors per watched class, kept current by ACameraSpawnerManager and the world's
+// actor spawned/destroyed events so per-frame code never has to walk the world.
+UCLASS()
+class CAMERATESTER_API UCameraCaptureRegistry : public UWorldSubsystem
+{
+    GENERATED_BODY()
+
+public:
+    virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+    virtual void Deinitialize() override;
+
+    // Start tracking a class; the first call does a single scan of the world for existing instances
+    void WatchClass(TSubclassOf<AActor> CameraClass);
+
+    // Explicit registration, used by spawners so cameras are known before the spawn event fans out.
+    // CameraId replaces the registration order as the camera's index (sharded spawners pass the global layout index).
+    void RegisterCamera(AActor* Camera, int32 CameraId = INDEX_NONE);
+    void UnregisterCamera(AActor* Camera);
+
+    // Capture components changed on some camera (e.g. one was added or retargeted)
+    void MarkCapturesDirty();
+
+    // Spawners bracket their work so listeners can tell a partially spawned rig from a finished one
+    void BeginSpawnBatch(const UObject* Spawner);
+    void EndSpawnBatch(const UObject* Spawner);
+    bool IsSpawnInProgress() const { return PendingSpawners.Num() > 0; }
+
+    const TArray<AActor*>& GetCameras(TSubclassOf<AActor> CameraClass);
+
+    // The camera's pipeline index: its registered ID, else its registration slot; INDEX_NONE if unknown
+    int32 GetCameraIndex(TSubclassOf<AActor> CameraClass, const AActor* Camera);
+
+    // Flat capture list for one buffer type; no allocation, rebuilt only after registry changes
+    const TArray<USceneCaptureComponent2D*>& GetCaptures(TSubclassOf<AActor> CameraClass, EMLBufferType BufferType);
+
+    // Every capture of every buffer type for the class, in camera order
+    const TArray<USceneCaptureComponent2D*>& GetAllCaptures(TSubclassOf<AActor> CameraClass);
+
+    FOnRegisteredCamerasChanged& OnCamerasChanged() { return CamerasChanged; }
+
+    // Fired when the last open spawn batch ends
+    FOnCameraSpawnsComplete& OnSpawnsComplete() { return SpawnsComplete; }
+
+private:
+    void HandleActorSpawned(AActor* Actor);
+    void HandleActorDestroyed(AActor* Actor);
+    void RefreshCaptures(FMLRegisteredCameraSet& CameraSet);
+    FMLRegisteredCameraSet* FindSet(TSubclassOf<AActor> CameraClass);
+
+    UPROPERTY()
+    TMap<UClass*, FMLRegisteredCameraSet> CameraSets;
+
+    TMap<const AActor*, int32> CameraIds;
+
+    FDelegateHandle ActorSpawnedHandle;
+    FDelegateHandle ActorDestroyedHandle;
+    FOnRegisteredCamerasChanged CamerasChanged;
+    FOnCameraSpawnsComplete SpawnsComplete;
+    TSet<const UObject*> PendingSpawners;
+
+    static const TArray<AActor*> EmptyCameras;
+    static const TArray<USceneCaptureComponent2D*> EmptyCaptures;
+};
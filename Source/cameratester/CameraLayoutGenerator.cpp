@@ -0,0 +1,78 @@
+#include "CameraLayoutGenerator.h"
+#include "Math/RandomStream.h"
+
+namespace
+{
+    FRotator LookAt(const FVector& From, const FVector& Target)
+    {
+        const FVector Direction = Target - From;
+        return Direction.IsNearlyZero() ? FRotator::ZeroRotator : Direction.Rotation();
+    }
+}
+
+void CameraLayout::Generate(const FCameraLayoutSettings& Settings, const FVector& Origin, int32 Count, TArray<FTransform>& OutTransforms)
+{
+    OutTransforms.Reset(FMath::Max(Count, 0));
+    if (Count <= 0)
+        return;
+
+    switch (Settings.LayoutType)
+    {
+    case ECameraLayoutType::Linear:
+        for (int32 i = 0; i < Count; ++i)
+        {
+            OutTransforms.Emplace(FRotator::ZeroRotator, Origin + Settings.LinearOffset * i);
+        }
+        break;
+
+    case ECameraLayoutType::Grid:
+    {
+        const int32 Columns = Settings.GridColumns > 0 ? Settings.GridColumns : FMath::CeilToInt(FMath::Sqrt(static_cast<float>(Count)));
+        for (int32 i = 0; i < Count; ++i)
+        {
+            const FVector Offset((i % Columns) * Settings.GridSpacing.X, (i / Columns) * Settings.GridSpacing.Y, 0.0);
+            OutTransforms.Emplace(FRotator::ZeroRotator, Origin + Offset);
+        }
+        break;
+    }
+
+    case ECameraLayoutType::Ring:
+        for (int32 i = 0; i < Count; ++i)
+        {
+            const double Angle = UE_DOUBLE_TWO_PI * i / Count;
+            const FVector Location = Origin + FVector(FMath::Cos(Angle), FMath::Sin(Angle), 0.0) * Settings.Radius;
+            OutTransforms.Emplace(Settings.bFaceCenter ? LookAt(Location, Origin) : FRotator::ZeroRotator, Location);
+        }
+        break;
+
+    case ECameraLayoutType::Sphere:
+    {
+        const double GoldenAngle = UE_DOUBLE_PI * (3.0 - FMath::Sqrt(5.0));
+        for (int32 i = 0; i < Count; ++i)
+        {
+            const double Z = 1.0 - 2.0 * (i + 0.5) / Count;
+            const double RingRadius = FMath::Sqrt(FMath::Max(0.0, 1.0 - Z * Z));
+            const double Phi = GoldenAngle * i;
+            const FVector Location = Origin + FVector(FMath::Cos(Phi) * RingRadius, FMath::Sin(Phi) * RingRadius, Z) * Settings.Radius;
+            OutTransforms.Emplace(Settings.bFaceCenter ? LookAt(Location, Origin) : FRotator::ZeroRotator, Location);
+        }
+        break;
+    }
+
+    case ECameraLayoutType::RandomInVolume:
+    {
+        FRandomStream Stream(Settings.Seed);
+        for (int32 i = 0; i < Count; ++i)
+        {
+            const FVector Offset(
+                Stream.FRandRange(-Settings.VolumeExtent.X, Settings.VolumeExtent.X),
+                Stream.FRandRange(-Settings.VolumeExtent.Y, Settings.VolumeExtent.Y),
+                Stream.FRandRange(-Settings.VolumeExtent.Z, Settings.VolumeExtent.Z));
+            const FVector Location = Origin + Offset;
+            const FRotator Rotation = Settings.bFaceCenter ? LookAt(Location, Origin) : FRotator(0.0, Stream.FRandRange(0.0, 360.0), 0.0);
+            OutTransforms.Emplace(Rotation, Location);
+        }
+        break;
+    }
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CameraLayoutGenerator.generated.h"
+
+UENUM(BlueprintType)
+enum class ECameraLayoutType : uint8
+{
+    // First camera at the origin, then LinearOffset * i
+    Linear,
+    Grid,
+    Ring,
+    // Evenly distributed over a sphere (Fibonacci lattice)
+    Sphere,
+    RandomInVolume
+};
+
+USTRUCT(BlueprintType)
+struct CAMERATESTER_API FCameraLayoutSettings
+{
+    GENERATED_BODY()
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Layout")
+    ECameraLayoutType LayoutType = ECameraLayoutType::Linear;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Layout")
+    int32 Seed = 1337;
+
+    // Not exposed: ACameraSpawnerManager fills it from its SpawnOffset
+    FVector LinearOffset = FVector(400, 0, 0);
+
+    // 0 = square-ish grid
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Layout", meta = (ClampMin = "0", EditCondition = "LayoutType == ECameraLayoutType::Grid"))
+    int32 GridColumns = 0;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Layout", meta = (EditCondition = "LayoutType == ECameraLayoutType::Grid"))
+    FVector2D GridSpacing = FVector2D(400, 400);
+
+    // Ring and sphere radius
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Layout", meta = (ClampMin = "0"))
+    float Radius = 1000.0f;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Layout", meta = (EditCondition = "LayoutType == ECameraLayoutType::RandomInVolume"))
+    FVector VolumeExtent = FVector(2000, 2000, 500);
+
+    // Point cameras at the layout origin (ring, sphere, random)
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Layout")
+    bool bFaceCenter = true;
+};
+
+namespace CameraLayout
+{
+    // World-space spawn transforms for Count cameras around Origin. Deterministic for a given Settings.Seed.
+    CAMERATESTER_API void Generate(const FCameraLayoutSettings& Settings, const FVector& Origin, int32 Count, TArray<FTransform>& OutTransforms);
+}
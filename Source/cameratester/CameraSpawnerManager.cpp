@@ -1,10 +1,14 @@
 #include "CameraSpawnerManager.h"
+#include "MLCaptureStats.h"
 #include "Engine/World.h"
 #include "Engine/Engine.h"
+#include "CameraCaptureRegistry.h"
+#include "CameraTrajectorySubsystem.h"
 
 ACameraSpawnerManager::ACameraSpawnerManager()
 {
-    PrimaryActorTick.bCanEverTick = false;
+    PrimaryActorTick.bCanEverTick = true;
+    PrimaryActorTick.bStartWithTickEnabled = false;
     
     // Initialize default values
     SpawnCount = 5;
@@ -19,93 +23,213 @@ void ACameraSpawnerManager::BeginPlay()
     SpawnMultipleCameras();
 }
 
+void ACameraSpawnerManager::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+    // Never leave the registry waiting on a batch that will not finish
+    if (bSpawnInProgress)
+    {
+        if (UCameraCaptureRegistry* Registry = GetWorld()->GetSubsystem<UCameraCaptureRegistry>())
+        {
+            Registry->EndSpawnBatch(this);
+        }
+        bSpawnInProgress = false;
+    }
+
+    Super::EndPlay(EndPlayReason);
+}
+
+void ACameraSpawnerManager::Tick(float DeltaSeconds)
+{
+    Super::Tick(DeltaSeconds);
+
+    if (bSpawnInProgress)
+    {
+        SpawnPendingCameras(SpawnBudgetMs / 1000.0);
+    }
+}
+
 void ACameraSpawnerManager::SpawnMultipleCameras()
 {
-    UE_LOG(LogTemp, Warning, TEXT("=== CameraSpawnerManager: Starting spawn process ==="));
+    UE_LOG(LogMLCapture, Log, TEXT("=== CameraSpawnerManager: Starting spawn process ==="));
     
     if (!CameraSpawnerClass)
     {
-        UE_LOG(LogTemp, Error, TEXT("CameraSpawnerClass is NULL! Please assign BP_CameraSpawner in the Details Panel."));
+        UE_LOG(LogMLCapture, Error, TEXT("CameraSpawnerClass is NULL! Please assign BP_CameraSpawner in the Details Panel."));
         return;
     }
 
     UWorld* World = GetWorld();
     if (!World) 
     {
-        UE_LOG(LogTemp, Error, TEXT("World is NULL!"));
+        UE_LOG(LogMLCapture, Error, TEXT("World is NULL!"));
         return;
     }
 
     // Clear any existing spawned cameras array
     SpawnedCameras.Empty();
+    SpawnedCameras.Reserve(SpawnCount);
+    SpawnedLayoutIndices.Reset();
 
-    FVector FirstCameraLocation;
-    bool bFirstCameraSpawned = false;
+    // First camera spawns at the CameraSpawnerManager's location. Every shard generates the full layout, so the
+    // transform of layout index i is the same in every process, then keeps only its own indices.
+    // SpawnOffset is the only editable linear spacing
+    FCameraLayoutSettings LayoutSettings = Layout;
+    LayoutSettings.LinearOffset = SpawnOffset;
+    CameraLayout::Generate(LayoutSettings, GetActorLocation(), SpawnCount, PendingSpawnTransforms);
 
-    UE_LOG(LogTemp, Warning, TEXT("Spawning %d cameras with offset %s"), SpawnCount, *SpawnOffset.ToString());
+    ActiveShard = ResolveShard();
 
-    for (int32 i = 0; i < SpawnCount; i++)
+    PendingSpawnIndices.Reset(PendingSpawnTransforms.Num());
+    int32 NumOwned = 0;
+    for (int32 LayoutIndex = 0; LayoutIndex < PendingSpawnTransforms.Num(); ++LayoutIndex)
     {
-        FVector SpawnLocation;
-        FRotator SpawnRotation = FRotator::ZeroRotator;
-
-        if (i == 0)
+        if (ActiveShard.Owns(LayoutIndex, PendingSpawnTransforms.Num()))
+        {
+            PendingSpawnTransforms[NumOwned++] = PendingSpawnTransforms[LayoutIndex];
+            PendingSpawnIndices.Add(LayoutIndex);
+        }
+    }
+    PendingSpawnTransforms.SetNum(NumOwned);
+    NextSpawnIndex = 0;
+    if (!bSpawnInProgress)
+    {
+        if (UCameraCaptureRegistry* Registry = World->GetSubsystem<UCameraCaptureRegistry>())
         {
-            // First camera spawns at the CameraSpawnerManager's location
-            SpawnLocation = GetActorLocation();
-            FirstCameraLocation = SpawnLocation;
-            UE_LOG(LogTemp, Log, TEXT("First camera will spawn at manager location: %s"), *SpawnLocation.ToString());
+            Registry->BeginSpawnBatch(this);
         }
-        else
+    }
+    bSpawnInProgress = true;
+
+    UE_LOG(LogMLCapture, Log, TEXT("Spawning %d cameras (layout %s, seed %d%s)%s"), PendingSpawnTransforms.Num(),
+        *UEnum::GetValueAsString(Layout.LayoutType), Layout.Seed,
+        ActiveShard.IsSharded() ? *FString::Printf(TEXT(", %s of %d"), *ActiveShard.ToString(), SpawnCount) : TEXT(""),
+        bTimeSlicedSpawning ? *FString::Printf(TEXT(" over frames, %.1f ms budget"), SpawnBudgetMs) : TEXT(""));
+
+    if (bTimeSlicedSpawning)
+    {
+        // Spawn the first slice now, the rest from Tick
+        SpawnPendingCameras(SpawnBudgetMs / 1000.0);
+        if (bSpawnInProgress)
         {
-            // Subsequent cameras offset from the first camera's position
-            SpawnLocation = FirstCameraLocation + (SpawnOffset * i);
-            UE_LOG(LogTemp, Log, TEXT("Camera %d will spawn at: %s (offset: %s)"), 
-                i + 1, *SpawnLocation.ToString(), *(SpawnOffset * i).ToString());
+            SetActorTickEnabled(true);
         }
+    }
+    else
+    {
+        SpawnPendingCameras(TNumericLimits<double>::Max());
+    }
+}
+
+FMLShardAssignment ACameraSpawnerManager::ResolveShard() const
+{
+    const FMLShardAssignment Resolved = UCaptureShardSubsystem::Resolve(this, Shard);
+    if (!Resolved.IsValid())
+    {
+        UE_LOG(LogMLCapture, Error, TEXT("Invalid %s; capturing the whole layout"), *Resolved.ToString());
+        return FMLShardAssignment();
+    }
+    return Resolved;
+}
+
+void ACameraSpawnerManager::SpawnPendingCameras(double BudgetSeconds)
+{
+    const double StartTime = FPlatformTime::Seconds();
 
-        // Set up spawn parameters with unique name
+    // Budget is checked after each spawn, so every call makes progress
+    while (NextSpawnIndex < PendingSpawnTransforms.Num())
+    {
+        SpawnCameraAt(PendingSpawnIndices[NextSpawnIndex], PendingSpawnTransforms[NextSpawnIndex]);
+        ++NextSpawnIndex;
+
+        if (FPlatformTime::Seconds() - StartTime >= BudgetSeconds)
+            break;
+    }
+
+    if (NextSpawnIndex >= PendingSpawnTransforms.Num())
+    {
+        FinishSpawnProcess();
+    }
+}
+
+AActor* ACameraSpawnerManager::SpawnCameraAt(int32 Index, const FTransform& SpawnTransform)
+{
+    UWorld* World = GetWorld();
+    AActor* SpawnedActor = nullptr;
+
+    if (bUseDeferredConstruction)
+    {
+        SpawnedActor = World->SpawnActorDeferred<AActor>(CameraSpawnerClass, SpawnTransform, this, nullptr,
+            ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+        if (SpawnedActor)
+        {
+            SpawnedActor->FinishSpawning(SpawnTransform);
+        }
+    }
+    else
+    {
+        // Set up spawn parameters with unique name (BP_CameraSpawner_<Index+1>) without string formatting
         FActorSpawnParameters SpawnParams;
-        FString UniqueName = FString::Printf(TEXT("BP_CameraSpawner_%d"), i + 1);
-        SpawnParams.Name = FName(*UniqueName);
+        SpawnParams.Name = FName(TEXT("BP_CameraSpawner"), NAME_EXTERNAL_TO_INTERNAL(Index + 1));
         SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
 
-        // Spawn the actor
-        AActor* SpawnedActor = World->SpawnActor<AActor>(
-            CameraSpawnerClass, 
-            SpawnLocation, 
-            SpawnRotation, 
-            SpawnParams
-        );
+        SpawnedActor = World->SpawnActor<AActor>(CameraSpawnerClass, SpawnTransform, SpawnParams);
+    }
 
-        if (SpawnedActor)
+    if (SpawnedActor)
+    {
+        // Add to our array for tracking
+        SpawnedCameras.Add(SpawnedActor);
+        SpawnedLayoutIndices.Add(Index);
+        if (UCameraCaptureRegistry* Registry = World->GetSubsystem<UCameraCaptureRegistry>())
         {
-            // Add to our array for tracking
-            SpawnedCameras.Add(SpawnedActor);
-            
-            UE_LOG(LogTemp, Log, TEXT("✓ SUCCESS: Spawned %s at location %s"), 
-                *SpawnedActor->GetName(), *SpawnLocation.ToString());
-            
-            // Optional: Set actor label in editor for better visibility
-            #if WITH_EDITOR
-                SpawnedActor->SetActorLabel(UniqueName);
-            #endif
-
-            if (i == 0)
-            {
-                bFirstCameraSpawned = true;
-                UE_LOG(LogTemp, Warning, TEXT("First camera spawned successfully - using as reference point"));
-            }
+            // Sharded cameras keep their layout index so every process's captures share one index space
+            Registry->RegisterCamera(SpawnedActor, ActiveShard.IsSharded() ? Index : INDEX_NONE);
         }
-        else
+
+        UE_LOG(LogMLCapture, Verbose, TEXT("✓ SUCCESS: Spawned %s at location %s"), 
+            *SpawnedActor->GetName(), *SpawnTransform.GetLocation().ToString());
+        
+        // Optional: Set actor label in editor for better visibility
+        #if WITH_EDITOR
+            SpawnedActor->SetActorLabel(SpawnedActor->GetName());
+        #endif
+    }
+    else
+    {
+        UE_LOG(LogMLCapture, Error, TEXT("✗ FAILED: Could not spawn camera %d at location %s"), 
+            Index + 1, *SpawnTransform.GetLocation().ToString());
+    }
+
+    return SpawnedActor;
+}
+
+void ACameraSpawnerManager::FinishSpawnProcess()
+{
+    const int32 NumToSpawn = PendingSpawnTransforms.Num();
+    bSpawnInProgress = false;
+    PendingSpawnTransforms.Empty();
+    PendingSpawnIndices.Empty();
+    NextSpawnIndex = 0;
+    SetActorTickEnabled(false);
+
+    UE_LOG(LogMLCapture, Log, TEXT("=== Spawn process complete: %d/%d cameras spawned ==="), 
+        SpawnedCameras.Num(), NumToSpawn);
+
+    if (Trajectory.Type != EMLTrajectoryType::None)
+    {
+        if (UCameraTrajectorySubsystem* Trajectories = GetWorld()->GetSubsystem<UCameraTrajectorySubsystem>())
         {
-            UE_LOG(LogTemp, Error, TEXT("✗ FAILED: Could not spawn camera %d at location %s"), 
-                i + 1, *SpawnLocation.ToString());
+            // Layout indices keep spline spacing, walk seeds and pose tracks identical however the layout is sharded
+            Trajectories->AssignTrajectory(SpawnedCameras, Trajectory, SpawnedLayoutIndices, SpawnCount);
         }
     }
 
-    UE_LOG(LogTemp, Warning, TEXT("=== Spawn process complete: %d/%d cameras spawned ==="), 
-        SpawnedCameras.Num(), SpawnCount);
+    OnAllCamerasSpawned.Broadcast(SpawnedCameras.Num());
+
+    if (UCameraCaptureRegistry* Registry = GetWorld()->GetSubsystem<UCameraCaptureRegistry>())
+    {
+        Registry->EndSpawnBatch(this);
+    }
 }
 
 AActor* ACameraSpawnerManager::GetSpawnedCamera(int32 Index)
@@ -115,7 +239,7 @@ AActor* ACameraSpawnerManager::GetSpawnedCamera(int32 Index)
         return SpawnedCameras[Index];
     }
     
-    UE_LOG(LogTemp, Warning, TEXT("Invalid camera index: %d (valid range: 0-%d)"), 
+    UE_LOG(LogMLCapture, Warning, TEXT("Invalid camera index: %d (valid range: 0-%d)"), 
         Index, SpawnedCameras.Num() - 1);
     return nullptr;
 }
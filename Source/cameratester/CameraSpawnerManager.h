@@ -3,18 +3,28 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
 #include "Engine/Blueprint.h"
+#include "CameraLayoutGenerator.h"
+#include "CameraTrajectorySubsystem.h"
+#include "CaptureSharding.h"
 #include "CameraSpawnerManager.generated.h"
 
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnAllCamerasSpawned, int32, NumSpawned);
+
 UCLASS(BlueprintType, Blueprintable)
 class CAMERATESTER_API ACameraSpawnerManager : public AActor
 {
 	GENERATED_BODY()
 
+	friend class UCaptureBenchmarkSubsystem;
+
 public:    
 	ACameraSpawnerManager();
 
+	virtual void Tick(float DeltaSeconds) override;
+
 protected:
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 	// Blueprint class reference to your BP_CameraSpawner
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Spawning")
@@ -24,14 +34,47 @@ protected:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Spawning")
 	int32 SpawnCount = 5;
 
-	// Offset between spawned instances (from first spawned camera)
+	// Offset between spawned instances (from first spawned camera), used by the Linear layout
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Spawning")
 	FVector SpawnOffset = FVector(400, 0, 0);
 
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Spawning")
+	FCameraLayoutSettings Layout;
+
+	// Spread spawning over several frames so large rigs don't hitch
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Spawning|Performance")
+	bool bTimeSlicedSpawning = true;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Spawning|Performance", meta = (ClampMin = "0.1", EditCondition = "bTimeSlicedSpawning"))
+	float SpawnBudgetMs = 4.0f;
+
+	// Spawn with SpawnActorDeferred/FinishSpawning (skips unique name registration)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Spawning|Performance")
+	bool bUseDeferredConstruction = false;
+
+	// Spawn only this shard's part of the layout. Cameras keep their layout index as actor name and capture camera
+	// index. A process assignment from UCaptureShardSubsystem (-MLCoordinator= or -MLShard=) takes precedence.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Spawning|Sharding")
+	FMLShardAssignment Shard;
+
+	// Motion handed to UCameraTrajectorySubsystem once every camera exists
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Spawning|Trajectory")
+	FMLTrajectorySettings Trajectory;
+
 	// Array to store references to spawned cameras
 	UPROPERTY(BlueprintReadOnly, Category = "Spawning")
 	TArray<AActor*> SpawnedCameras;
 
+	// Layout index of each entry of SpawnedCameras
+	TArray<int32> SpawnedLayoutIndices;
+
+	// Layout transforms still waiting to be spawned, and their layout indices
+	TArray<FTransform> PendingSpawnTransforms;
+	TArray<int32> PendingSpawnIndices;
+	FMLShardAssignment ActiveShard;
+	int32 NextSpawnIndex = 0;
+	bool bSpawnInProgress = false;
+
 public:
 	// Function to spawn multiple camera spawners
 	UFUNCTION(BlueprintCallable, Category = "Spawning")
@@ -44,4 +87,21 @@ public:
 	// Get all spawned cameras
 	UFUNCTION(BlueprintCallable, Category = "Spawning")
 	TArray<AActor*> GetAllSpawnedCameras();
+
+	UFUNCTION(BlueprintCallable, Category = "Spawning")
+	bool AreCamerasReady() const { return !bSpawnInProgress && SpawnedCameras.Num() > 0; }
+
+	TSubclassOf<AActor> GetCameraClass() const { return CameraSpawnerClass; }
+
+	// Shard this spawner captures: the process assignment when there is one, else Shard; unsharded if invalid
+	FMLShardAssignment ResolveShard() const;
+
+	// Fired once every camera of the current spawn request exists, just before the camera registry's OnSpawnsComplete
+	UPROPERTY(BlueprintAssignable, Category = "Spawning")
+	FOnAllCamerasSpawned OnAllCamerasSpawned;
+
+private:
+	AActor* SpawnCameraAt(int32 Index, const FTransform& SpawnTransform);
+	void SpawnPendingCameras(double BudgetSeconds);
+	void FinishSpawnProcess();
 };
@@ -0,0 +1,739 @@
+#include "CameraTrajectorySubsystem.h"
+#include "MLCaptureStats.h"
+#include "Algo/Sort.h"
+#include "Algo/BinarySearch.h"
+#include "Async/ParallelFor.h"
+#include "Components/SceneComponent.h"
+#include "Components/SplineComponent.h"
+#include "GameFramework/Actor.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+    // Slots per ParallelFor task; small enough to balance, large enough that task overhead stays negligible
+    constexpr int32 ChunkSize = 256;
+
+    // Spline tables sample about every half metre, capped so huge splines stay cheap to build
+    constexpr float SplineSampleSpacing = 50.0f;
+    constexpr int32 MaxSplineSamples = 8192;
+
+    template <typename FunctionType>
+    void ForEachChunk(int32 Num, FunctionType&& Function)
+    {
+        const int32 NumChunks = FMath::DivideAndRoundUp(Num, ChunkSize);
+        ParallelFor(NumChunks, [&](int32 Chunk)
+        {
+            const int32 Begin = Chunk * ChunkSize;
+            Function(Begin, FMath::Min(Num, Begin + ChunkSize));
+        }, NumChunks > 1 ? EParallelForFlags::None : EParallelForFlags::ForceSingleThread);
+    }
+
+    template <typename BlockType>
+    void RemoveBlockEntry(BlockType& Block, int32 Index, TArray<int32>& SlotBlockIndex)
+    {
+        Block.RemoveAtSwap(Index);
+        // The former last entry now sits at Index
+        if (Index < Block.Num())
+        {
+            SlotBlockIndex[Block.Slot[Index]] = Index;
+        }
+    }
+
+    template <typename T>
+    void CompactArray(TArray<T>& Array, const TArray<int32>& Remap, int32 NewNum)
+    {
+        for (int32 Old = 0; Old < Remap.Num(); ++Old)
+        {
+            if (Remap[Old] != INDEX_NONE && Remap[Old] != Old)
+            {
+                Array[Remap[Old]] = MoveTemp(Array[Old]);
+            }
+        }
+        Array.SetNum(NewNum);
+    }
+
+    float WrapDistance(float Distance, float Length)
+    {
+        return Length > 0.0f ? Distance - Length * FMath::FloorToFloat(Distance / Length) : 0.0f;
+    }
+
+    FQuat FacingQuat(const FVector& Direction)
+    {
+        return Direction.IsNearlyZero() ? FQuat::Identity : Direction.ToOrientationQuat();
+    }
+}
+
+void UCameraTrajectorySubsystem::FOrbitBlock::RemoveAtSwap(int32 Index)
+{
+    Slot.RemoveAtSwap(Index);
+    CenterX.RemoveAtSwap(Index);
+    CenterY.RemoveAtSwap(Index);
+    CenterZ.RemoveAtSwap(Index);
+    Radius.RemoveAtSwap(Index);
+    Angle.RemoveAtSwap(Index);
+    AngularSpeed.RemoveAtSwap(Index);
+    SinHalfPitch.RemoveAtSwap(Index);
+    CosHalfPitch.RemoveAtSwap(Index);
+}
+
+void UCameraTrajectorySubsystem::FSplineBlock::RemoveAtSwap(int32 Index)
+{
+    Slot.RemoveAtSwap(Index);
+    Table.RemoveAtSwap(Index);
+    Distance.RemoveAtSwap(Index);
+    Speed.RemoveAtSwap(Index);
+    bLoop.RemoveAtSwap(Index);
+}
+
+void UCameraTrajectorySubsystem::FWalkBlock::RemoveAtSwap(int32 Index)
+{
+    Slot.RemoveAtSwap(Index);
+    HomeX.RemoveAtSwap(Index);
+    HomeY.RemoveAtSwap(Index);
+    HomeZ.RemoveAtSwap(Index);
+    VelX.RemoveAtSwap(Index);
+    VelY.RemoveAtSwap(Index);
+    VelZ.RemoveAtSwap(Index);
+    ExtentX.RemoveAtSwap(Index);
+    ExtentY.RemoveAtSwap(Index);
+    ExtentZ.RemoveAtSwap(Index);
+    MaxSpeed.RemoveAtSwap(Index);
+    Acceleration.RemoveAtSwap(Index);
+    Random.RemoveAtSwap(Index);
+}
+
+void UCameraTrajectorySubsystem::FPoseListBlock::RemoveAtSwap(int32 Index)
+{
+    Slot.RemoveAtSwap(Index);
+    Track.RemoveAtSwap(Index);
+    Time.RemoveAtSwap(Index);
+}
+
+void UCameraTrajectorySubsystem::Deinitialize()
+{
+    Reset();
+    Super::Deinitialize();
+}
+
+TStatId UCameraTrajectorySubsystem::GetStatId() const
+{
+    RETURN_QUICK_DECLARE_CYCLE_STAT(UCameraTrajectorySubsystem, STATGROUP_Tickables);
+}
+
+void UCameraTrajectorySubsystem::Tick(float DeltaTime)
+{
+    Super::Tick(DeltaTime);
+
+    // No-op when a render target manager already advanced us this frame
+    Advance(DeltaTime, INDEX_NONE);
+}
+
+int32 UCameraTrajectorySubsystem::AssignTrajectory(const TArray<AActor*>& InCameras, const FMLTrajectorySettings& Settings,
+    TConstArrayView<int32> LayoutIndices, int32 LayoutCount)
+{
+    const bool bUseLayoutIndices = LayoutIndices.Num() == InCameras.Num() && LayoutCount > 0;
+
+    if (Settings.Type == EMLTrajectoryType::None)
+    {
+        for (AActor* Camera : InCameras)
+        {
+            RemoveCamera(Camera);
+        }
+        return 0;
+    }
+
+    int32 SplineTable = INDEX_NONE;
+    TArray<int32> Tracks;
+    if (Settings.Type == EMLTrajectoryType::Spline)
+    {
+        SplineTable = AddSplineTable(Settings.SplineActor);
+        if (SplineTable == INDEX_NONE)
+            return 0;
+    }
+    else if (Settings.Type == EMLTrajectoryType::PoseList)
+    {
+        if (!LoadPoseFile(Settings.PoseFile, Tracks))
+            return 0;
+    }
+
+    int32 Assigned = 0;
+    for (int32 CameraIndex = 0; CameraIndex < InCameras.Num(); ++CameraIndex)
+    {
+        AActor* Camera = InCameras[CameraIndex];
+        const int32 LayoutIndex = bUseLayoutIndices ? LayoutIndices[CameraIndex] : CameraIndex;
+        const int32 NumLayout = bUseLayoutIndices ? LayoutCount : InCameras.Num();
+        USceneComponent* Root = IsValid(Camera) ? Camera->GetRootComponent() : nullptr;
+        if (!Root)
+            continue;
+
+        // Teleporting a static root is refused, and stationary ones would keep stale lighting
+        Root->SetMobility(EComponentMobility::Movable);
+
+        const int32 Slot = FindOrAddSlot(Camera);
+        RemoveFromBlocks(Slot);
+
+        const FVector Location = Root->GetComponentLocation();
+        const FQuat Rotation = Root->GetComponentQuat();
+        PosX[Slot] = Location.X;
+        PosY[Slot] = Location.Y;
+        PosZ[Slot] = Location.Z;
+        RotX[Slot] = static_cast<float>(Rotation.X);
+        RotY[Slot] = static_cast<float>(Rotation.Y);
+        RotZ[Slot] = static_cast<float>(Rotation.Z);
+        RotW[Slot] = static_cast<float>(Rotation.W);
+        bSlotLookAt[Slot] = Settings.bLookAtTarget;
+        SlotLookAtTarget[Slot] = Settings.LookAtTarget;
+
+        switch (Settings.Type)
+        {
+        case EMLTrajectoryType::Orbit:
+        {
+            const FVector Offset = Location - Settings.OrbitCenter;
+            const float Radius = Settings.OrbitRadius > 0.0f ? Settings.OrbitRadius : static_cast<float>(Offset.Size2D());
+            const float HalfPitch = 0.5f * FMath::Atan2(static_cast<float>(-Offset.Z), FMath::Max(Radius, 1.0f));
+
+            SlotBlockIndex[Slot] = Orbits.Num();
+            Orbits.Slot.Add(Slot);
+            Orbits.CenterX.Add(Settings.OrbitCenter.X);
+            Orbits.CenterY.Add(Settings.OrbitCenter.Y);
+            // Each camera keeps its height
+            Orbits.CenterZ.Add(Location.Z);
+            Orbits.Radius.Add(Radius);
+            Orbits.Angle.Add(FMath::Atan2(static_cast<float>(Offset.Y), static_cast<float>(Offset.X)));
+            Orbits.AngularSpeed.Add(FMath::DegreesToRadians(Settings.OrbitAngularSpeed));
+            Orbits.SinHalfPitch.Add(FMath::Sin(HalfPitch));
+            Orbits.CosHalfPitch.Add(FMath::Cos(HalfPitch));
+            break;
+        }
+
+        case EMLTrajectoryType::Spline:
+        {
+            const FSplineTable& Table = SplineTables[SplineTable];
+            SlotBlockIndex[Slot] = Splines.Num();
+            Splines.Slot.Add(Slot);
+            Splines.Table.Add(SplineTable);
+            Splines.Distance.Add(Settings.bSpreadAlongSpline ? Table.Length * LayoutIndex / NumLayout : 0.0f);
+            Splines.Speed.Add(Settings.Speed);
+            Splines.bLoop.Add(Settings.bLoop || Table.bClosed);
+            break;
+        }
+
+        case EMLTrajectoryType::RandomWalk:
+            SlotBlockIndex[Slot] = Walks.Num();
+            Walks.Slot.Add(Slot);
+            Walks.HomeX.Add(Location.X);
+            Walks.HomeY.Add(Location.Y);
+            Walks.HomeZ.Add(Location.Z);
+            Walks.VelX.Add(0.0f);
+            Walks.VelY.Add(0.0f);
+            Walks.VelZ.Add(0.0f);
+            Walks.ExtentX.Add(static_cast<float>(Settings.WalkExtent.X));
+            Walks.ExtentY.Add(static_cast<float>(Settings.WalkExtent.Y));
+            Walks.ExtentZ.Add(static_cast<float>(Settings.WalkExtent.Z));
+            Walks.MaxSpeed.Add(Settings.Speed);
+            Walks.Acceleration.Add(Settings.WalkAcceleration);
+            // One stream per camera keeps runs reproducible however the chunks are scheduled
+            Walks.Random.Emplace(static_cast<int32>(HashCombine(GetTypeHash(Settings.Seed), GetTypeHash(LayoutIndex))));
+            break;
+
+        case EMLTrajectoryType::PoseList:
+            SlotBlockIndex[Slot] = PoseLists.Num();
+            PoseLists.Slot.Add(Slot);
+            PoseLists.Track.Add(Tracks[LayoutIndex % Tracks.Num()]);
+            PoseLists.Time.Add(0.0f);
+            break;
+
+        default:
+            break;
+        }
+
+        SlotType[Slot] = Settings.Type;
+        ++Assigned;
+    }
+
+    UE_LOG(LogMLCapture, Log, TEXT("Trajectory: %s assigned to %d cameras (%d moving in total)"),
+        *UEnum::GetValueAsString(Settings.Type), Assigned, NumCameras());
+    return Assigned;
+}
+
+int32 UCameraTrajectorySubsystem::FindOrAddSlot(AActor* Camera)
+{
+    if (const int32* Existing = SlotByCamera.Find(Camera))
+        return *Existing;
+
+    const int32 Slot = Cameras.Add(Camera->GetRootComponent());
+    SlotType.Add(EMLTrajectoryType::None);
+    SlotBlockIndex.Add(INDEX_NONE);
+    PosX.AddZeroed();
+    PosY.AddZeroed();
+    PosZ.AddZeroed();
+    RotX.AddZeroed();
+    RotY.AddZeroed();
+    RotZ.AddZeroed();
+    RotW.Add(1.0f);
+    PoseFrameIndex.Add(INDEX_NONE);
+    bSlotLookAt.AddZeroed();
+    SlotLookAtTarget.AddZeroed();
+    SlotByCamera.Add(Camera, Slot);
+    return Slot;
+}
+
+void UCameraTrajectorySubsystem::RemoveFromBlocks(int32 SlotIndex)
+{
+    const int32 BlockIndex = SlotBlockIndex[SlotIndex];
+    switch (SlotType[SlotIndex])
+    {
+    case EMLTrajectoryType::Orbit:
+        RemoveBlockEntry(Orbits, BlockIndex, SlotBlockIndex);
+        break;
+    case EMLTrajectoryType::Spline:
+        RemoveBlockEntry(Splines, BlockIndex, SlotBlockIndex);
+        break;
+    case EMLTrajectoryType::RandomWalk:
+        RemoveBlockEntry(Walks, BlockIndex, SlotBlockIndex);
+        break;
+    case EMLTrajectoryType::PoseList:
+        RemoveBlockEntry(PoseLists, BlockIndex, SlotBlockIndex);
+        break;
+    default:
+        break;
+    }
+    SlotType[SlotIndex] = EMLTrajectoryType::None;
+    SlotBlockIndex[SlotIndex] = INDEX_NONE;
+}
+
+void UCameraTrajectorySubsystem::RemoveCamera(AActor* Camera)
+{
+    const int32* Slot = SlotByCamera.Find(Camera);
+    if (!Slot)
+        return;
+
+    RemoveFromBlocks(*Slot);
+    Cameras[*Slot] = nullptr;
+    CompactSlots();
+}
+
+void UCameraTrajectorySubsystem::CompactSlots()
+{
+    // Destroyed cameras and removed slots both show up as stale component pointers
+    TArray<int32> Remap;
+    Remap.SetNumUninitialized(Cameras.Num());
+    int32 NewNum = 0;
+    for (int32 Slot = 0; Slot < Cameras.Num(); ++Slot)
+    {
+        if (Cameras[Slot].IsValid())
+        {
+            Remap[Slot] = NewNum++;
+        }
+        else
+        {
+            RemoveFromBlocks(Slot);
+            Remap[Slot] = INDEX_NONE;
+        }
+    }
+    if (NewNum == Cameras.Num())
+        return;
+
+    CompactArray(Cameras, Remap, NewNum);
+    CompactArray(SlotType, Remap, NewNum);
+    CompactArray(SlotBlockIndex, Remap, NewNum);
+    CompactArray(PosX, Remap, NewNum);
+    CompactArray(PosY, Remap, NewNum);
+    CompactArray(PosZ, Remap, NewNum);
+    CompactArray(RotX, Remap, NewNum);
+    CompactArray(RotY, Remap, NewNum);
+    CompactArray(RotZ, Remap, NewNum);
+    CompactArray(RotW, Remap, NewNum);
+    CompactArray(PoseFrameIndex, Remap, NewNum);
+    CompactArray(bSlotLookAt, Remap, NewNum);
+    CompactArray(SlotLookAtTarget, Remap, NewNum);
+
+    for (TArray<int32>* BlockSlots : { &Orbits.Slot, &Splines.Slot, &Walks.Slot, &PoseLists.Slot })
+    {
+        for (int32& Slot : *BlockSlots)
+        {
+            Slot = Remap[Slot];
+        }
+    }
+
+    SlotByCamera.Reset();
+    for (int32 Slot = 0; Slot < Cameras.Num(); ++Slot)
+    {
+        SlotByCamera.Add(Cameras[Slot]->GetOwner(), Slot);
+    }
+}
+
+void UCameraTrajectorySubsystem::Reset()
+{
+    Cameras.Reset();
+    SlotType.Reset();
+    SlotBlockIndex.Reset();
+    PosX.Reset();
+    PosY.Reset();
+    PosZ.Reset();
+    RotX.Reset();
+    RotY.Reset();
+    RotZ.Reset();
+    RotW.Reset();
+    PoseFrameIndex.Reset();
+    bSlotLookAt.Reset();
+    SlotLookAtTarget.Reset();
+    SlotByCamera.Reset();
+
+    Orbits = FOrbitBlock();
+    Splines = FSplineBlock();
+    Walks = FWalkBlock();
+    PoseLists = FPoseListBlock();
+    SplineTables.Reset();
+    PoseTracks.Reset();
+    PoseFileTracks.Reset();
+}
+
+int32 UCameraTrajectorySubsystem::AddSplineTable(AActor* SplineActor)
+{
+    const USplineComponent* Spline = IsValid(SplineActor) ? SplineActor->FindComponentByClass<USplineComponent>() : nullptr;
+    if (!Spline)
+    {
+        UE_LOG(LogMLCapture, Warning, TEXT("Trajectory: spline mode needs a SplineActor with a spline component"));
+        return INDEX_NONE;
+    }
+
+    FSplineTable Table;
+    Table.Length = Spline->GetSplineLength();
+    Table.bClosed = Spline->IsClosedLoop();
+    const int32 NumSamples = FMath::Clamp(FMath::CeilToInt(Table.Length / SplineSampleSpacing) + 1, 2, MaxSplineSamples);
+    Table.Spacing = Table.Length / (NumSamples - 1);
+    Table.Positions.Reserve(NumSamples);
+    Table.Rotations.Reserve(NumSamples);
+    for (int32 Sample = 0; Sample < NumSamples; ++Sample)
+    {
+        const float Distance = Sample * Table.Spacing;
+        Table.Positions.Add(Spline->GetLocationAtDistanceAlongSpline(Distance, ESplineCoordinateSpace::World));
+        Table.Rotations.Add(Spline->GetQuaternionAtDistanceAlongSpline(Distance, ESplineCoordinateSpace::World));
+    }
+    return SplineTables.Add(MoveTemp(Table));
+}
+
+bool UCameraTrajectorySubsystem::LoadPoseFile(const FString& Path, TArray<int32>& OutTracks)
+{
+    const FString FullPath = FPaths::IsRelative(Path) ? FPaths::Combine(FPaths::ProjectDir(), Path) : Path;
+    if (const TArray<int32>* Cached = PoseFileTracks.Find(FullPath))
+    {
+        OutTracks = *Cached;
+        return true;
+    }
+
+    TArray<FString> Lines;
+    if (Path.IsEmpty() || !FFileHelper::LoadFileToStringArray(Lines, *FullPath))
+    {
+        UE_LOG(LogMLCapture, Warning, TEXT("Trajectory: could not read pose file '%s'"), *FullPath);
+        return false;
+    }
+
+    TMap<int32, int32> TrackByCamera;
+    TArray<FString> Fields;
+    int32 Skipped = 0;
+    for (const FString& Line : Lines)
+    {
+        Fields.Reset();
+        Line.ParseIntoArray(Fields, TEXT(","), true);
+        // Header, comments and short rows
+        if (Fields.Num() < 8 || !Fields[0].TrimStartAndEnd().IsNumeric())
+            continue;
+
+        const int32 CameraId = FCString::Atoi(*Fields[0]);
+        double Values[7];
+        for (int32 Field = 0; Field < 7; ++Field)
+        {
+            Values[Field] = FCString::Atod(*Fields[Field + 1]);
+        }
+
+        int32& TrackIndex = TrackByCamera.FindOrAdd(CameraId, INDEX_NONE);
+        if (TrackIndex == INDEX_NONE)
+        {
+            TrackIndex = PoseTracks.AddDefaulted();
+        }
+        FPoseTrack& Track = PoseTracks[TrackIndex];
+
+        const float Time = static_cast<float>(Values[0]);
+        if (Track.Times.Num() > 0 && Time <= Track.Times.Last())
+        {
+            ++Skipped;
+            continue;
+        }
+        Track.Times.Add(Time);
+        Track.Positions.Emplace(Values[1], Values[2], Values[3]);
+        Track.Rotations.Add(FRotator(Values[4], Values[5], Values[6]).Quaternion());
+    }
+
+    if (Skipped > 0)
+    {
+        UE_LOG(LogMLCapture, Warning, TEXT("Trajectory: skipped %d pose rows of '%s' whose time was not increasing"), Skipped, *FullPath);
+    }
+    if (TrackByCamera.Num() == 0)
+    {
+        UE_LOG(LogMLCapture, Warning, TEXT("Trajectory: pose file '%s' has no poses"), *FullPath);
+        return false;
+    }
+
+    TrackByCamera.KeySort(TLess<int32>());
+    TrackByCamera.GenerateValueArray(OutTracks);
+    PoseFileTracks.Add(FullPath, OutTracks);
+
+    UE_LOG(LogMLCapture, Log, TEXT("Trajectory: loaded %d pose tracks from '%s'"), OutTracks.Num(), *FullPath);
+    return true;
+}
+
+void UCameraTrajectorySubsystem::Advance(float DeltaSeconds, int64 FrameIndex)
+{
+    if (bPaused || NumCameras() == 0 || LastAdvanceFrame == GFrameCounter)
+        return;
+    LastAdvanceFrame = GFrameCounter;
+
+    {
+        ML_CAPTURE_SCOPE(STAT_MLCapture_TrajectoryUpdate);
+        UpdateOrbits(DeltaSeconds);
+        UpdateSplines(DeltaSeconds);
+        UpdateWalks(DeltaSeconds);
+        UpdatePoseLists(DeltaSeconds);
+        ApplyLookAt();
+    }
+
+    WritePoses(FrameIndex);
+}
+
+void UCameraTrajectorySubsystem::UpdateOrbits(float DeltaSeconds)
+{
+    ForEachChunk(Orbits.Num(), [this, DeltaSeconds](int32 Begin, int32 End)
+    {
+        float* RESTRICT Angle = Orbits.Angle.GetData();
+        const float* RESTRICT AngularSpeed = Orbits.AngularSpeed.GetData();
+        const float* RESTRICT Radius = Orbits.Radius.GetData();
+
+        for (int32 i = Begin; i < End; ++i)
+        {
+            const float NewAngle = Angle[i] + AngularSpeed[i] * DeltaSeconds;
+            Angle[i] = NewAngle - UE_TWO_PI * FMath::FloorToFloat(NewAngle / UE_TWO_PI);
+        }
+
+        // Facing the center is yaw = Angle + PI; with zero roll the quaternion only needs the half-angle terms
+        auto Store = [this](int32 i, float CosR, float SinR, float SinHalfYaw, float CosHalfYaw)
+        {
+            const int32 Slot = Orbits.Slot[i];
+            const float SP = Orbits.SinHalfPitch[i];
+            const float CP = Orbits.CosHalfPitch[i];
+            PosX[Slot] = Orbits.CenterX[i] + CosR;
+            PosY[Slot] = Orbits.CenterY[i] + SinR;
+            PosZ[Slot] = Orbits.CenterZ[i];
+            RotX[Slot] = SP * SinHalfYaw;
+            RotY[Slot] = -SP * CosHalfYaw;
+            RotZ[Slot] = CP * SinHalfYaw;
+            RotW[Slot] = CP * CosHalfYaw;
+        };
+
+        int32 i = Begin;
+        const VectorRegister4Float HalfPi = VectorSetFloat1(UE_HALF_PI);
+        const VectorRegister4Float Half = VectorSetFloat1(0.5f);
+        for (; i + 4 <= End; i += 4)
+        {
+            const VectorRegister4Float Angles = VectorLoad(Angle + i);
+            const VectorRegister4Float HalfYaw = VectorMultiplyAdd(Angles, Half, HalfPi);
+            VectorRegister4Float Sin, Cos, SinHalf, CosHalf;
+            VectorSinCos(&Sin, &Cos, &Angles);
+            VectorSinCos(&SinHalf, &CosHalf, &HalfYaw);
+
+            const VectorRegister4Float Radii = VectorLoad(Radius + i);
+            alignas(16) float CosR[4], SinR[4], SinHalfYaw[4], CosHalfYaw[4];
+            VectorStoreAligned(VectorMultiply(Cos, Radii), CosR);
+            VectorStoreAligned(VectorMultiply(Sin, Radii), SinR);
+            VectorStoreAligned(SinHalf, SinHalfYaw);
+            VectorStoreAligned(CosHalf, CosHalfYaw);
+            for (int32 Lane = 0; Lane < 4; ++Lane)
+            {
+                Store(i + Lane, CosR[Lane], SinR[Lane], SinHalfYaw[Lane], CosHalfYaw[Lane]);
+            }
+        }
+        for (; i < End; ++i)
+        {
+            float Sin, Cos, SinHalf, CosHalf;
+            FMath::SinCos(&Sin, &Cos, Angle[i]);
+            FMath::SinCos(&SinHalf, &CosHalf, 0.5f * Angle[i] + UE_HALF_PI);
+            Store(i, Cos * Radius[i], Sin * Radius[i], SinHalf, CosHalf);
+        }
+    });
+}
+
+void UCameraTrajectorySubsystem::UpdateSplines(float DeltaSeconds)
+{
+    ForEachChunk(Splines.Num(), [this, DeltaSeconds](int32 Begin, int32 End)
+    {
+        for (int32 i = Begin; i < End; ++i)
+        {
+            const FSplineTable& Table = SplineTables[Splines.Table[i]];
+            float Distance = Splines.Distance[i] + Splines.Speed[i] * DeltaSeconds;
+            Distance = Splines.bLoop[i] ? WrapDistance(Distance, Table.Length) : FMath::Min(Distance, Table.Length);
+            Splines.Distance[i] = Distance;
+
+            const float Sample = Table.Spacing > 0.0f ? Distance / Table.Spacing : 0.0f;
+            const int32 Index = FMath::Min(FMath::FloorToInt32(Sample), Table.Positions.Num() - 2);
+            const float Alpha = FMath::Clamp(Sample - Index, 0.0f, 1.0f);
+            const FVector Position = FMath::Lerp(Table.Positions[Index], Table.Positions[Index + 1], Alpha);
+            const FQuat Rotation = FQuat::FastLerp(Table.Rotations[Index], Table.Rotations[Index + 1], Alpha).GetNormalized();
+
+            const int32 Slot = Splines.Slot[i];
+            PosX[Slot] = Position.X;
+            PosY[Slot] = Position.Y;
+            PosZ[Slot] = Position.Z;
+            RotX[Slot] = static_cast<float>(Rotation.X);
+            RotY[Slot] = static_cast<float>(Rotation.Y);
+            RotZ[Slot] = static_cast<float>(Rotation.Z);
+            RotW[Slot] = static_cast<float>(Rotation.W);
+        }
+    });
+}
+
+void UCameraTrajectorySubsystem::UpdateWalks(float DeltaSeconds)
+{
+    ForEachChunk(Walks.Num(), [this, DeltaSeconds](int32 Begin, int32 End)
+    {
+        for (int32 i = Begin; i < End; ++i)
+        {
+            const int32 Slot = Walks.Slot[i];
+            const FVector3f Steer = FVector3f(Walks.Random[i].VRand()) * (Walks.Acceleration[i] * DeltaSeconds);
+
+            FVector3f Velocity(Walks.VelX[i] + Steer.X, Walks.VelY[i] + Steer.Y, Walks.VelZ[i] + Steer.Z);
+            Velocity = Velocity.GetClampedToMaxSize(Walks.MaxSpeed[i]);
+
+            // Bounce off the box around the start position
+            double Position[3] = { PosX[Slot] + Velocity.X * DeltaSeconds, PosY[Slot] + Velocity.Y * DeltaSeconds, PosZ[Slot] + Velocity.Z * DeltaSeconds };
+            const double Home[3] = { Walks.HomeX[i], Walks.HomeY[i], Walks.HomeZ[i] };
+            const float Extent[3] = { Walks.ExtentX[i], Walks.ExtentY[i], Walks.ExtentZ[i] };
+            for (int32 Axis = 0; Axis < 3; ++Axis)
+            {
+                const double Offset = Position[Axis] - Home[Axis];
+                if (FMath::Abs(Offset) > Extent[Axis])
+                {
+                    Position[Axis] = Home[Axis] + FMath::Clamp<double>(Offset, -Extent[Axis], Extent[Axis]);
+                    Velocity[Axis] = -Velocity[Axis];
+                }
+            }
+
+            Walks.VelX[i] = Velocity.X;
+            Walks.VelY[i] = Velocity.Y;
+            Walks.VelZ[i] = Velocity.Z;
+            PosX[Slot] = Position[0];
+            PosY[Slot] = Position[1];
+            PosZ[Slot] = Position[2];
+
+            // Keep the last heading while nearly stopped
+            if (Velocity.SizeSquared() > 1.0f)
+            {
+                const FQuat Rotation = FacingQuat(FVector(Velocity));
+                RotX[Slot] = static_cast<float>(Rotation.X);
+                RotY[Slot] = static_cast<float>(Rotation.Y);
+                RotZ[Slot] = static_cast<float>(Rotation.Z);
+                RotW[Slot] = static_cast<float>(Rotation.W);
+            }
+        }
+    });
+}
+
+void UCameraTrajectorySubsystem::UpdatePoseLists(float DeltaSeconds)
+{
+    ForEachChunk(PoseLists.Num(), [this, DeltaSeconds](int32 Begin, int32 End)
+    {
+        for (int32 i = Begin; i < End; ++i)
+        {
+            const FPoseTrack& Track = PoseTracks[PoseLists.Track[i]];
+            // Tracks loop over their own duration
+            const float Duration = Track.Times.Last();
+            float Time = PoseLists.Time[i] + DeltaSeconds;
+            Time = Duration > 0.0f ? WrapDistance(Time, Duration) : 0.0f;
+            PoseLists.Time[i] = Time;
+
+            FVector Position = Track.Positions.Last();
+            FQuat Rotation = Track.Rotations.Last();
+            const int32 Next = Algo::UpperBound(Track.Times, Time);
+            if (Next == 0)
+            {
+                Position = Track.Positions[0];
+                Rotation = Track.Rotations[0];
+            }
+            else if (Next < Track.Times.Num())
+            {
+                const float Alpha = (Time - Track.Times[Next - 1]) / (Track.Times[Next] - Track.Times[Next - 1]);
+                Position = FMath::Lerp(Track.Positions[Next - 1], Track.Positions[Next], Alpha);
+                Rotation = FQuat::Slerp(Track.Rotations[Next - 1], Track.Rotations[Next], Alpha);
+            }
+
+            const int32 Slot = PoseLists.Slot[i];
+            PosX[Slot] = Position.X;
+            PosY[Slot] = Position.Y;
+            PosZ[Slot] = Position.Z;
+            RotX[Slot] = static_cast<float>(Rotation.X);
+            RotY[Slot] = static_cast<float>(Rotation.Y);
+            RotZ[Slot] = static_cast<float>(Rotation.Z);
+            RotW[Slot] = static_cast<float>(Rotation.W);
+        }
+    });
+}
+
+void UCameraTrajectorySubsystem::ApplyLookAt()
+{
+    ForEachChunk(NumCameras(), [this](int32 Begin, int32 End)
+    {
+        for (int32 Slot = Begin; Slot < End; ++Slot)
+        {
+            if (!bSlotLookAt[Slot] || SlotType[Slot] == EMLTrajectoryType::None)
+                continue;
+
+            const FQuat Rotation = FacingQuat(SlotLookAtTarget[Slot] - FVector(PosX[Slot], PosY[Slot], PosZ[Slot]));
+            RotX[Slot] = static_cast<float>(Rotation.X);
+            RotY[Slot] = static_cast<float>(Rotation.Y);
+            RotZ[Slot] = static_cast<float>(Rotation.Z);
+            RotW[Slot] = static_cast<float>(Rotation.W);
+        }
+    });
+}
+
+void UCameraTrajectorySubsystem::WritePoses(int64 FrameIndex)
+{
+    ML_CAPTURE_SCOPE(STAT_MLCapture_TrajectoryWrite);
+
+    // One pass over every moving root; no sweep and teleport physics, so the cost is the transform
+    // propagation to the attached capture components and nothing else
+    bool bHasStaleSlots = false;
+    for (int32 Slot = 0; Slot < Cameras.Num(); ++Slot)
+    {
+        if (SlotType[Slot] == EMLTrajectoryType::None)
+            continue;
+
+        USceneComponent* Root = Cameras[Slot].Get();
+        if (!Root)
+        {
+            bHasStaleSlots = true;
+            continue;
+        }
+
+        Root->SetWorldLocationAndRotation(FVector(PosX[Slot], PosY[Slot], PosZ[Slot]),
+            FQuat(RotX[Slot], RotY[Slot], RotZ[Slot], RotW[Slot]), false, nullptr, ETeleportType::TeleportPhysics);
+        PoseFrameIndex[Slot] = FrameIndex;
+    }
+
+    if (bHasStaleSlots)
+    {
+        CompactSlots();
+    }
+}
+
+bool UCameraTrajectorySubsystem::GetCameraPose(const AActor* Camera, FTransform& OutPose, int64& OutFrameIndex) const
+{
+    const int32* Slot = SlotByCamera.Find(Camera);
+    if (!Slot || !Cameras[*Slot].IsValid())
+        return false;
+
+    OutPose = FTransform(FQuat(RotX[*Slot], RotY[*Slot], RotZ[*Slot], RotW[*Slot]), FVector(PosX[*Slot], PosY[*Slot], PosZ[*Slot]));
+    OutFrameIndex = PoseFrameIndex[*Slot];
+    return true;
+}
@@ -0,0 +1,217 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Math/RandomStream.h"
+#include "CameraTrajectorySubsystem.generated.h"
+
+UENUM(BlueprintType)
+enum class EMLTrajectoryType : uint8
+{
+    // Cameras keep their spawn pose
+    None,
+    // Travel along a spline actor's first USplineComponent
+    Spline,
+    // Circle a center point, facing it
+    Orbit,
+    // Bounded random walk around the start position, facing the direction of travel
+    RandomWalk,
+    // Interpolate poses read from a CSV file
+    PoseList
+};
+
+// How a group of cameras moves; assigned through UCameraTrajectorySubsystem::AssignTrajectory
+USTRUCT(BlueprintType)
+struct CAMERATESTER_API FMLTrajectorySettings
+{
+    GENERATED_BODY()
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Trajectory")
+    EMLTrajectoryType Type = EMLTrajectoryType::None;
+
+    // cm/s along the spline, or the random walk's top speed
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Trajectory", meta = (ClampMin = "0"))
+    float Speed = 200.0f;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Trajectory|Spline")
+    AActor* SplineActor = nullptr;
+
+    // Space the cameras evenly along the spline instead of starting them all at its beginning
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Trajectory|Spline")
+    bool bSpreadAlongSpline = true;
+
+    // Wrap at the end of an open spline instead of stopping there
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Trajectory|Spline")
+    bool bLoop = true;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Trajectory|Orbit")
+    FVector OrbitCenter = FVector::ZeroVector;
+
+    // 0 keeps each camera's current horizontal distance to the center
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Trajectory|Orbit", meta = (ClampMin = "0"))
+    float OrbitRadius = 0.0f;
+
+    // Degrees per second; negative turns clockwise seen from above
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Trajectory|Orbit")
+    float OrbitAngularSpeed = 15.0f;
+
+    // Half size of the box around the start position the walk stays in
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Trajectory|Random Walk")
+    FVector WalkExtent = FVector(1000.0, 1000.0, 200.0);
+
+    // cm/s^2 of random steering
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Trajectory|Random Walk", meta = (ClampMin = "0"))
+    float WalkAcceleration = 400.0f;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Trajectory|Random Walk")
+    int32 Seed = 0;
+
+    // CSV of camera,time,x,y,z,pitch,yaw,roll (cm, seconds, degrees); relative paths are under the project dir
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Trajectory|Pose List")
+    FString PoseFile;
+
+    // Every camera faces LookAtTarget instead of its mode's own orientation
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Trajectory")
+    bool bLookAtTarget = false;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Trajectory", meta = (EditCondition = "bLookAtTarget"))
+    FVector LookAtTarget = FVector::ZeroVector;
+};
+
+// Moves camera rigs without per-actor ticks. Poses and motion parameters live in structure-of-arrays
+// buffers, one block per trajectory type; each frame the blocks are advanced in parallel chunks and the
+// results are written to the camera roots in a single pass on the game thread. ARenderTargetManager
+// advances it right before issuing captures so each pose is tagged with the capture frame index that
+// renders it; without a ticking manager the subsystem advances itself.
+UCLASS()
+class CAMERATESTER_API UCameraTrajectorySubsystem : public UTickableWorldSubsystem
+{
+    GENERATED_BODY()
+
+public:
+    virtual void Deinitialize() override;
+    virtual void Tick(float DeltaTime) override;
+    virtual bool IsTickable() const override { return NumCameras() > 0 && !bPaused; }
+    virtual TStatId GetStatId() const override;
+
+    // Moves the cameras with one set of settings, replacing any trajectory they had; returns how many were assigned.
+    // LayoutIndices (one per camera, out of LayoutCount) place a subset of a larger rig, e.g. one capture shard, where
+    // the whole rig would have put it; by default camera i of InCameras is camera i of InCameras.Num().
+    int32 AssignTrajectory(const TArray<AActor*>& InCameras, const FMLTrajectorySettings& Settings,
+        TConstArrayView<int32> LayoutIndices = {}, int32 LayoutCount = 0);
+
+    void RemoveCamera(AActor* Camera);
+    void Reset();
+
+    // Step every trajectory by DeltaSeconds and write the poses; FrameIndex tags them (INDEX_NONE when unknown).
+    // Called at most once per engine frame, later calls in the same frame are ignored.
+    void Advance(float DeltaSeconds, int64 FrameIndex);
+
+    void SetPaused(bool bInPaused) { bPaused = bInPaused; }
+    bool IsPaused() const { return bPaused; }
+
+    int32 NumCameras() const { return Cameras.Num(); }
+
+    // Last written pose and the capture frame index it was written for
+    bool GetCameraPose(const AActor* Camera, FTransform& OutPose, int64& OutFrameIndex) const;
+
+private:
+    struct FPoseTrack
+    {
+        TArray<float> Times;
+        TArray<FVector> Positions;
+        TArray<FQuat> Rotations;
+    };
+
+    // Distance-sampled copy of a spline so workers never touch the component
+    struct FSplineTable
+    {
+        TArray<FVector> Positions;
+        TArray<FQuat> Rotations;
+        float Spacing = 0.0f;
+        float Length = 0.0f;
+        bool bClosed = false;
+    };
+
+    struct FOrbitBlock
+    {
+        TArray<int32> Slot;
+        TArray<double> CenterX, CenterY, CenterZ;
+        // Radians; the pitch towards the center is fixed per camera and kept as its half-angle sine/cosine
+        TArray<float> Radius, Angle, AngularSpeed, SinHalfPitch, CosHalfPitch;
+
+        int32 Num() const { return Slot.Num(); }
+        void RemoveAtSwap(int32 Index);
+    };
+
+    struct FSplineBlock
+    {
+        TArray<int32> Slot;
+        TArray<int32> Table;
+        TArray<float> Distance, Speed;
+        TArray<uint8> bLoop;
+
+        int32 Num() const { return Slot.Num(); }
+        void RemoveAtSwap(int32 Index);
+    };
+
+    struct FWalkBlock
+    {
+        TArray<int32> Slot;
+        TArray<double> HomeX, HomeY, HomeZ;
+        TArray<float> VelX, VelY, VelZ;
+        TArray<float> ExtentX, ExtentY, ExtentZ;
+        TArray<float> MaxSpeed, Acceleration;
+        TArray<FRandomStream> Random;
+
+        int32 Num() const { return Slot.Num(); }
+        void RemoveAtSwap(int32 Index);
+    };
+
+    struct FPoseListBlock
+    {
+        TArray<int32> Slot;
+        TArray<int32> Track;
+        TArray<float> Time;
+
+        int32 Num() const { return Slot.Num(); }
+        void RemoveAtSwap(int32 Index);
+    };
+
+    int32 FindOrAddSlot(AActor* Camera);
+    void RemoveFromBlocks(int32 SlotIndex);
+    void CompactSlots();
+    int32 AddSplineTable(AActor* SplineActor);
+    bool LoadPoseFile(const FString& Path, TArray<int32>& OutTracks);
+
+    void UpdateOrbits(float DeltaSeconds);
+    void UpdateSplines(float DeltaSeconds);
+    void UpdateWalks(float DeltaSeconds);
+    void UpdatePoseLists(float DeltaSeconds);
+    void ApplyLookAt();
+    void WritePoses(int64 FrameIndex);
+
+    // Per camera slot; the pose arrays are written by the update blocks and read by WritePoses
+    TArray<TWeakObjectPtr<USceneComponent>> Cameras;
+    TArray<EMLTrajectoryType> SlotType;
+    TArray<int32> SlotBlockIndex;
+    TArray<double> PosX, PosY, PosZ;
+    TArray<float> RotX, RotY, RotZ, RotW;
+    TArray<int64> PoseFrameIndex;
+    TArray<uint8> bSlotLookAt;
+    TArray<FVector> SlotLookAtTarget;
+    TMap<const AActor*, int32> SlotByCamera;
+
+    FOrbitBlock Orbits;
+    FSplineBlock Splines;
+    FWalkBlock Walks;
+    FPoseListBlock PoseLists;
+
+    TArray<FSplineTable> SplineTables;
+    TArray<FPoseTrack> PoseTracks;
+    // Track indices per loaded file, ordered by the file's camera column
+    TMap<FString, TArray<int32>> PoseFileTracks;
+
+    uint64 LastAdvanceFrame = 0;
+    bool bPaused = false;
+};
@@ -0,0 +1,350 @@
+#include "CaptureBenchmark.h"
+#include "MLCaptureStats.h"
+#include "CameraSpawnerManager.h"
+#include "RenderTargetManager.h"
+#include "EngineUtils.h"
+#include "HAL/PlatformMemory.h"
+#include "JsonObjectConverter.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "RenderCore.h"
+#include "RHI.h"
+
+namespace
+{
+    float Mean(const TArray<float>& Values)
+    {
+        if (Values.Num() == 0)
+            return 0.0f;
+
+        double Sum = 0.0;
+        for (const float Value : Values)
+        {
+            Sum += Value;
+        }
+        return static_cast<float>(Sum / Values.Num());
+    }
+
+    // Nearest-rank percentile, P in [0, 1]
+    float Percentile(TArray<float> Values, float P)
+    {
+        if (Values.Num() == 0)
+            return 0.0f;
+
+        Values.Sort();
+        const int32 Index = FMath::Clamp(FMath::CeilToInt(P * Values.Num()) - 1, 0, Values.Num() - 1);
+        return Values[Index];
+    }
+
+    FString GetModeName(EMLBenchmarkUpdateMode Mode)
+    {
+        return StaticEnum<EMLBenchmarkUpdateMode>()->GetNameStringByValue(static_cast<int64>(Mode));
+    }
+}
+
+FString FMLBenchmarkCase::GetBufferSetName() const
+{
+    if (bRGB && bDepth && bMLDepth && bNormal)
+        return TEXT("All");
+
+    TArray<FString> Names;
+    if (bRGB) Names.Add(TEXT("RGB"));
+    if (bDepth) Names.Add(TEXT("Depth"));
+    if (bMLDepth) Names.Add(TEXT("MLDepth"));
+    if (bNormal) Names.Add(TEXT("Normal"));
+    return FString::Join(Names, TEXT("+"));
+}
+
+bool FMLBenchmarkCase::ParseBufferSet(const FString& BufferSet)
+{
+    // RGB is the camera's primary capture and is always present
+    bRGB = true;
+    bDepth = bMLDepth = bNormal = false;
+
+    if (BufferSet.Equals(TEXT("All"), ESearchCase::IgnoreCase))
+    {
+        bDepth = bMLDepth = bNormal = true;
+        return true;
+    }
+
+    TArray<FString> Names;
+    BufferSet.ParseIntoArray(Names, TEXT("+"));
+    for (const FString& Name : Names)
+    {
+        if (Name.Equals(TEXT("RGB"), ESearchCase::IgnoreCase)) continue;
+        else if (Name.Equals(TEXT("Depth"), ESearchCase::IgnoreCase)) bDepth = true;
+        else if (Name.Equals(TEXT("MLDepth"), ESearchCase::IgnoreCase)) bMLDepth = true;
+        else if (Name.Equals(TEXT("Normal"), ESearchCase::IgnoreCase)) bNormal = true;
+        else return false;
+    }
+    return true;
+}
+
+FString FMLBenchmarkCase::GetLabel() const
+{
+    return FString::Printf(TEXT("%dcam_%dpx_%s_%s_%s"), NumCameras, Resolution, *GetBufferSetName(), *GetModeName(UpdateMode), GetProfileSetName());
+}
+
+FString FMLBenchmarkCase::ToCommandLine() const
+{
+    return FString::Printf(TEXT("-MLBenchmarkCameras=%d -MLBenchmarkResolution=%d -MLBenchmarkBuffers=%s -MLBenchmarkMode=%s -MLBenchmarkProfiles=%s"),
+        NumCameras, Resolution, *GetBufferSetName(), *GetModeName(UpdateMode), GetProfileSetName());
+}
+
+FMLBenchmarkCase FMLBenchmarkCase::FromCommandLine(const TCHAR* CommandLine)
+{
+    FMLBenchmarkCase Case;
+    FParse::Value(CommandLine, TEXT("MLBenchmarkCameras="), Case.NumCameras);
+    FParse::Value(CommandLine, TEXT("MLBenchmarkResolution="), Case.Resolution);
+
+    FString BufferSet;
+    if (FParse::Value(CommandLine, TEXT("MLBenchmarkBuffers="), BufferSet))
+    {
+        Case.ParseBufferSet(BufferSet);
+    }
+
+    FString Mode;
+    if (FParse::Value(CommandLine, TEXT("MLBenchmarkMode="), Mode))
+    {
+        const int64 Value = StaticEnum<EMLBenchmarkUpdateMode>()->GetValueByNameString(Mode);
+        if (Value != INDEX_NONE)
+        {
+            Case.UpdateMode = static_cast<EMLBenchmarkUpdateMode>(Value);
+        }
+    }
+
+    FString Profiles;
+    if (FParse::Value(CommandLine, TEXT("MLBenchmarkProfiles="), Profiles))
+    {
+        Case.bCaptureProfiles = !Profiles.Equals(TEXT("Full"), ESearchCase::IgnoreCase);
+    }
+
+    Case.NumCameras = FMath::Max(Case.NumCameras, 1);
+    Case.Resolution = FMath::Clamp(Case.Resolution, 16, 8192);
+    return Case;
+}
+
+FString FMLBenchmarkResult::GetCsvHeader()
+{
+    return TEXT("Label,Cameras,Resolution,Buffers,Mode,Profiles,Completed,FramesMeasured,FrameMs,GameThreadMs,GameThreadMsP95,")
+           TEXT("RenderThreadMs,RenderThreadMsP95,GpuMs,GpuMsP95,GpuMsPerCapture,CapturesPerSecond,ReadbackLatencyMsP50,ReadbackLatencyMsP95,")
+           TEXT("ReadbackLatencyMsP99,ReadbacksDropped,PeakUsedPhysicalMB,RenderTargetMB,Error");
+}
+
+FString FMLBenchmarkResult::ToCsvRow() const
+{
+    return FString::Printf(TEXT("%s,%d,%d,%s,%s,%s,%d,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.4f,%.1f,%.3f,%.3f,%.3f,%lld,%.1f,%.1f,\"%s\""),
+        *Case.GetLabel(), Case.NumCameras, Case.Resolution, *Case.GetBufferSetName(), *GetModeName(Case.UpdateMode), Case.GetProfileSetName(),
+        bCompleted ? 1 : 0, FramesMeasured, FrameMs, GameThreadMs, GameThreadMsP95, RenderThreadMs, RenderThreadMsP95,
+        GpuMs, GpuMsP95, GpuMsPerCapture, CapturesPerSecond, ReadbackLatencyMsP50, ReadbackLatencyMsP95, ReadbackLatencyMsP99,
+        ReadbacksDropped, PeakUsedPhysicalMB, RenderTargetMB, *Error.Replace(TEXT("\""), TEXT("'")));
+}
+
+bool UCaptureBenchmarkSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+    return FParse::Param(FCommandLine::Get(), TEXT("MLCaptureBenchmark")) && Super::ShouldCreateSubsystem(Outer);
+}
+
+bool UCaptureBenchmarkSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+    return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UCaptureBenchmarkSubsystem::GetStatId() const
+{
+    RETURN_QUICK_DECLARE_CYCLE_STAT(UCaptureBenchmarkSubsystem, STATGROUP_Tickables);
+}
+
+void UCaptureBenchmarkSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+    Super::OnWorldBeginPlay(InWorld);
+
+    const TCHAR* CommandLine = FCommandLine::Get();
+    Case = FMLBenchmarkCase::FromCommandLine(CommandLine);
+    FParse::Value(CommandLine, TEXT("MLBenchmarkWarmup="), WarmupFrames);
+    FParse::Value(CommandLine, TEXT("MLBenchmarkFrames="), MeasureFrames);
+    FParse::Value(CommandLine, TEXT("MLBenchmarkTimeout="), TimeoutSeconds);
+    if (!FParse::Value(CommandLine, TEXT("MLBenchmarkOutput="), OutputPath))
+    {
+        OutputPath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Benchmarks"), Case.GetLabel() + TEXT(".json"));
+    }
+
+    IssuedFrames.SetNum(1024);
+    StartTime = FPlatformTime::Seconds();
+
+    UE_LOG(LogMLCapture, Display, TEXT("MLCaptureBenchmark: %s, %d warmup + %d measured frames"), *Case.GetLabel(), WarmupFrames, MeasureFrames);
+    SpawnRig(InWorld);
+}
+
+void UCaptureBenchmarkSubsystem::SpawnRig(UWorld& InWorld)
+{
+    FString CameraClassPath = TEXT("/Game/BluePrints/BP_CameraSpawner.BP_CameraSpawner_C");
+    FParse::Value(FCommandLine::Get(), TEXT("MLBenchmarkCameraClass="), CameraClassPath);
+
+    UClass* CameraClass = LoadClass<AActor>(nullptr, *CameraClassPath);
+    if (!CameraClass)
+    {
+        Finish(FString::Printf(TEXT("camera class %s not found"), *CameraClassPath));
+        return;
+    }
+
+    // The level's own rig would skew every number; the benchmark owns the cameras
+    for (TActorIterator<ACameraSpawnerManager> It(&InWorld); It; ++It)
+    {
+        It->Destroy();
+    }
+    for (TActorIterator<ARenderTargetManager> It(&InWorld); It; ++It)
+    {
+        It->Destroy();
+    }
+    for (TActorIterator<AActor> It(&InWorld, CameraClass); It; ++It)
+    {
+        It->Destroy();
+    }
+
+    Manager = InWorld.SpawnActorDeferred<ARenderTargetManager>(ARenderTargetManager::StaticClass(), FTransform::Identity);
+    Manager->TargetActorClass = CameraClass;
+    Manager->RenderTargetWidth = Case.Resolution;
+    Manager->RenderTargetHeight = Case.Resolution;
+    Manager->bCreateRGBBuffer = Case.bRGB;
+    Manager->bCreateDepthBuffer = Case.bDepth;
+    Manager->bCreateMLDepthBuffer = Case.bMLDepth;
+    Manager->bQuantizeDepthOnCPU = Case.bMLDepth;
+    Manager->bCreateNormalBuffer = Case.bNormal;
+    Manager->bCreateRuntimeBufferCaptures = true;
+    Manager->bEnableReadback = true;
+    Manager->bWriteDataset = false;
+    Manager->bStreamFrames = false;
+    Manager->bForceFrameUpdates = true;
+    Manager->bUseCaptureScheduler = Case.UpdateMode != EMLBenchmarkUpdateMode::EveryFrame;
+    Manager->bUseAtlasCapture = Case.UpdateMode == EMLBenchmarkUpdateMode::Atlas;
+    Manager->bUseCaptureProfiles = Case.bCaptureProfiles;
+    Manager->FinishSpawning(FTransform::Identity);
+    Manager->OnFrameDataReady().AddUObject(this, &UCaptureBenchmarkSubsystem::HandleFrame);
+
+    Spawner = InWorld.SpawnActorDeferred<ACameraSpawnerManager>(ACameraSpawnerManager::StaticClass(), FTransform::Identity);
+    Spawner->CameraSpawnerClass = CameraClass;
+    Spawner->SpawnCount = Case.NumCameras;
+    Spawner->Layout.LayoutType = ECameraLayoutType::Grid;
+    Spawner->FinishSpawning(FTransform::Identity);
+}
+
+void UCaptureBenchmarkSubsystem::HandleFrame(const FMLCapturedFramePtr& Frame)
+{
+    if (Phase != EPhase::Measuring)
+        return;
+
+    ++CapturesReceived;
+
+    const FIssuedFrame& Issued = IssuedFrames[Frame->FrameIndex % IssuedFrames.Num()];
+    if (Issued.FrameIndex == Frame->FrameIndex)
+    {
+        LatencySamples.Add(static_cast<float>((FPlatformTime::Seconds() - Issued.Time) * 1000.0));
+    }
+}
+
+void UCaptureBenchmarkSubsystem::Tick(float DeltaTime)
+{
+    Super::Tick(DeltaTime);
+
+    if (Phase == EPhase::Done || !IsValid(Manager) || !IsValid(Spawner))
+        return;
+
+    const double Now = FPlatformTime::Seconds();
+    if (Now - StartTime > TimeoutSeconds)
+    {
+        Finish(FString::Printf(TEXT("timed out after %.0f s in phase %d"), TimeoutSeconds, static_cast<int32>(Phase)));
+        return;
+    }
+
+    // The manager has already issued this frame's captures when tickable objects run
+    const int64 FrameIndex = Manager->GetCaptureFrameIndex();
+    FIssuedFrame& Issued = IssuedFrames[FrameIndex % IssuedFrames.Num()];
+    Issued.FrameIndex = FrameIndex;
+    Issued.Time = Now;
+
+    switch (Phase)
+    {
+    case EPhase::WaitingForCameras:
+        if (Spawner->AreCamerasReady() && Manager->AreRenderTargetsReady())
+        {
+            Phase = EPhase::Warmup;
+            PhaseFrames = 0;
+        }
+        break;
+
+    case EPhase::Warmup:
+        if (++PhaseFrames >= WarmupFrames)
+        {
+            Phase = EPhase::Measuring;
+            PhaseFrames = 0;
+            MeasureStartTime = Now;
+            ReadbacksDroppedAtStart = Manager->Readback ? Manager->Readback->GetNumDropped() : 0;
+        }
+        break;
+
+    case EPhase::Measuring:
+        FrameMsSamples.Add(DeltaTime * 1000.0f);
+        GameThreadSamples.Add(static_cast<float>(FPlatformTime::ToMilliseconds(GGameThreadTime)));
+        RenderThreadSamples.Add(static_cast<float>(FPlatformTime::ToMilliseconds(GRenderThreadTime)));
+        GpuSamples.Add(static_cast<float>(FPlatformTime::ToMilliseconds(RHIGetGPUFrameCycles(0))));
+        PeakUsedPhysical = FMath::Max<uint64>(PeakUsedPhysical, FPlatformMemory::GetStats().UsedPhysical);
+
+        if (++PhaseFrames >= MeasureFrames)
+        {
+            Finish(FString());
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+void UCaptureBenchmarkSubsystem::Finish(const FString& Error)
+{
+    Phase = EPhase::Done;
+
+    FMLBenchmarkResult Result;
+    Result.Case = Case;
+    Result.bCompleted = Error.IsEmpty();
+    Result.Error = Error;
+    Result.FramesMeasured = FrameMsSamples.Num();
+    Result.FrameMs = Mean(FrameMsSamples);
+    Result.GameThreadMs = Mean(GameThreadSamples);
+    Result.GameThreadMsP95 = Percentile(GameThreadSamples, 0.95f);
+    Result.RenderThreadMs = Mean(RenderThreadSamples);
+    Result.RenderThreadMsP95 = Percentile(RenderThreadSamples, 0.95f);
+    Result.GpuMs = Mean(GpuSamples);
+    Result.GpuMsP95 = Percentile(GpuSamples, 0.95f);
+    Result.ReadbackLatencyMsP50 = Percentile(LatencySamples, 0.50f);
+    Result.ReadbackLatencyMsP95 = Percentile(LatencySamples, 0.95f);
+    Result.ReadbackLatencyMsP99 = Percentile(LatencySamples, 0.99f);
+    Result.PeakUsedPhysicalMB = static_cast<float>(PeakUsedPhysical / (1024.0 * 1024.0));
+
+    const double MeasuredSeconds = MeasureStartTime > 0.0 ? FPlatformTime::Seconds() - MeasureStartTime : 0.0;
+    Result.CapturesPerSecond = MeasuredSeconds > 0.0 ? static_cast<float>(CapturesReceived / MeasuredSeconds) : 0.0f;
+
+    const double CapturesPerFrame = Result.FramesMeasured > 0 ? static_cast<double>(CapturesReceived) / Result.FramesMeasured : 0.0;
+    Result.GpuMsPerCapture = CapturesPerFrame > 0.0 ? static_cast<float>(Result.GpuMs / CapturesPerFrame) : 0.0f;
+
+    if (IsValid(Manager))
+    {
+        Result.ReadbacksDropped = (Manager->Readback ? Manager->Readback->GetNumDropped() : 0) - ReadbacksDroppedAtStart;
+        Result.RenderTargetMB = static_cast<float>(Manager->GetRenderTargetPoolStats().InUseBytes / (1024.0 * 1024.0));
+    }
+
+    FString Json;
+    FJsonObjectConverter::UStructToJsonObjectString(Result, Json);
+    if (!FFileHelper::SaveStringToFile(Json, *OutputPath))
+    {
+        UE_LOG(LogMLCapture, Error, TEXT("MLCaptureBenchmark: could not write %s"), *OutputPath);
+    }
+
+    UE_LOG(LogMLCapture, Display, TEXT("MLCaptureBenchmark %s: %s, GT %.2f ms, RT %.2f ms, GPU %.2f ms, %.0f captures/s, latency p95 %.1f ms"),
+        *Case.GetLabel(), Result.bCompleted ? TEXT("done") : *Error, Result.GameThreadMs, Result.RenderThreadMs, Result.GpuMs,
+        Result.CapturesPerSecond, Result.ReadbackLatencyMsP95);
+
+    FPlatformMisc::RequestExit(false, TEXT("MLCaptureBenchmark"));
+}
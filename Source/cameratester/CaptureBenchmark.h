@@ -0,0 +1,196 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "MLCaptureTypes.h"
+#include "CaptureBenchmark.generated.h"
+
+class ACameraSpawnerManager;
+class ARenderTargetManager;
+
+UENUM()
+enum class EMLBenchmarkUpdateMode : uint8
+{
+    // Budgeted CaptureScene from the capture scheduler
+    Scheduler,
+    // bCaptureEveryFrame on every component
+    EveryFrame,
+    // Scheduler plus tiled atlas targets
+    Atlas
+};
+
+// One point of the sweep
+USTRUCT()
+struct CAMERATESTER_API FMLBenchmarkCase
+{
+    GENERATED_BODY()
+
+    UPROPERTY()
+    int32 NumCameras = 16;
+
+    UPROPERTY()
+    int32 Resolution = 512;
+
+    UPROPERTY()
+    bool bRGB = true;
+
+    UPROPERTY()
+    bool bDepth = false;
+
+    UPROPERTY()
+    bool bMLDepth = false;
+
+    UPROPERTY()
+    bool bNormal = false;
+
+    UPROPERTY()
+    EMLBenchmarkUpdateMode UpdateMode = EMLBenchmarkUpdateMode::Scheduler;
+
+    // Per-buffer capture profiles ("Stripped"); off renders every buffer with the full RGB feature set ("Full")
+    UPROPERTY()
+    bool bCaptureProfiles = true;
+
+    const TCHAR* GetProfileSetName() const { return bCaptureProfiles ? TEXT("Stripped") : TEXT("Full"); }
+
+    // "RGB+Depth", "All", ...
+    FString GetBufferSetName() const;
+    bool ParseBufferSet(const FString& BufferSet);
+
+    FString GetLabel() const;
+    FString ToCommandLine() const;
+    static FMLBenchmarkCase FromCommandLine(const TCHAR* CommandLine);
+};
+
+USTRUCT()
+struct CAMERATESTER_API FMLBenchmarkResult
+{
+    GENERATED_BODY()
+
+    UPROPERTY()
+    FMLBenchmarkCase Case;
+
+    UPROPERTY()
+    bool bCompleted = false;
+
+    UPROPERTY()
+    FString Error;
+
+    UPROPERTY()
+    int32 FramesMeasured = 0;
+
+    UPROPERTY()
+    float FrameMs = 0.0f;
+
+    UPROPERTY()
+    float GameThreadMs = 0.0f;
+
+    UPROPERTY()
+    float GameThreadMsP95 = 0.0f;
+
+    UPROPERTY()
+    float RenderThreadMs = 0.0f;
+
+    UPROPERTY()
+    float RenderThreadMsP95 = 0.0f;
+
+    UPROPERTY()
+    float GpuMs = 0.0f;
+
+    UPROPERTY()
+    float GpuMsP95 = 0.0f;
+
+    // GPU frame time divided by buffers read back per frame
+    UPROPERTY()
+    float GpuMsPerCapture = 0.0f;
+
+    // Buffers that completed readback, per second
+    UPROPERTY()
+    float CapturesPerSecond = 0.0f;
+
+    // Game time from the tick a capture was issued to its pixels reaching the CPU
+    UPROPERTY()
+    float ReadbackLatencyMsP50 = 0.0f;
+
+    UPROPERTY()
+    float ReadbackLatencyMsP95 = 0.0f;
+
+    UPROPERTY()
+    float ReadbackLatencyMsP99 = 0.0f;
+
+    UPROPERTY()
+    int64 ReadbacksDropped = 0;
+
+    UPROPERTY()
+    float PeakUsedPhysicalMB = 0.0f;
+
+    UPROPERTY()
+    float RenderTargetMB = 0.0f;
+
+    static FString GetCsvHeader();
+    FString ToCsvRow() const;
+};
+
+// Drives one benchmark case inside a game process started with -MLCaptureBenchmark (see
+// UCaptureBenchmarkCommandlet). Replaces the level's camera rig with its own, waits for the cameras,
+// warms up, samples thread/GPU times and readback latency, writes a JSON result and exits.
+UCLASS()
+class CAMERATESTER_API UCaptureBenchmarkSubsystem : public UTickableWorldSubsystem
+{
+    GENERATED_BODY()
+
+public:
+    virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+    virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+    virtual void Tick(float DeltaTime) override;
+    virtual TStatId GetStatId() const override;
+
+protected:
+    virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+    enum class EPhase : uint8
+    {
+        WaitingForCameras,
+        Warmup,
+        Measuring,
+        Done
+    };
+
+    void SpawnRig(UWorld& InWorld);
+    void HandleFrame(const FMLCapturedFramePtr& Frame);
+    void Finish(const FString& Error);
+
+    UPROPERTY()
+    ACameraSpawnerManager* Spawner = nullptr;
+
+    UPROPERTY()
+    ARenderTargetManager* Manager = nullptr;
+
+    FMLBenchmarkCase Case;
+    FString OutputPath;
+    int32 WarmupFrames = 120;
+    int32 MeasureFrames = 600;
+    double TimeoutSeconds = 180.0;
+
+    EPhase Phase = EPhase::WaitingForCameras;
+    int32 PhaseFrames = 0;
+    double StartTime = 0.0;
+    double MeasureStartTime = 0.0;
+    int64 ReadbacksDroppedAtStart = 0;
+    int64 CapturesReceived = 0;
+    uint64 PeakUsedPhysical = 0;
+
+    TArray<float> FrameMsSamples;
+    TArray<float> GameThreadSamples;
+    TArray<float> RenderThreadSamples;
+    TArray<float> GpuSamples;
+    TArray<float> LatencySamples;
+
+    // Issue time of recent capture frame indices, indexed by FrameIndex % Num
+    struct FIssuedFrame
+    {
+        int64 FrameIndex = -1;
+        double Time = 0.0;
+    };
+    TArray<FIssuedFrame> IssuedFrames;
+};
@@ -0,0 +1,225 @@
+#include "CaptureBenchmarkCommandlet.h"
+#include "MLCaptureStats.h"
+#include "CaptureBenchmark.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformProcess.h"
+#include "JsonObjectConverter.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+    TArray<int32> ParseIntList(const FString& Params, const TCHAR* Key, const TArray<int32>& Default)
+    {
+        FString Value;
+        if (!FParse::Value(*Params, Key, Value, false))
+            return Default;
+
+        TArray<FString> Items;
+        Value.ParseIntoArray(Items, TEXT(","));
+        TArray<int32> Result;
+        for (const FString& Item : Items)
+        {
+            Result.Add(FCString::Atoi(*Item));
+        }
+        return Result;
+    }
+
+    TArray<FString> ParseStringList(const FString& Params, const TCHAR* Key, const TCHAR* Separator, const TArray<FString>& Default)
+    {
+        FString Value;
+        if (!FParse::Value(*Params, Key, Value, false))
+            return Default;
+
+        TArray<FString> Result;
+        Value.TrimQuotes().ParseIntoArray(Result, Separator);
+        return Result;
+    }
+}
+
+UCaptureBenchmarkCommandlet::UCaptureBenchmarkCommandlet()
+{
+    IsClient = false;
+    IsServer = false;
+    IsEditor = false;
+    LogToConsole = true;
+}
+
+int32 UCaptureBenchmarkCommandlet::Main(const FString& Params)
+{
+    const TArray<int32> CameraCounts = ParseIntList(Params, TEXT("Cameras="), { 1, 4, 16, 64, 256 });
+    const TArray<int32> Resolutions = ParseIntList(Params, TEXT("Resolutions="), { 256, 512, 1024 });
+    const TArray<FString> BufferSets = ParseStringList(Params, TEXT("Buffers="), TEXT(";"), { TEXT("RGB"), TEXT("RGB+Depth"), TEXT("All") });
+    const TArray<FString> Modes = ParseStringList(Params, TEXT("Modes="), TEXT(","), { TEXT("Scheduler"), TEXT("EveryFrame"), TEXT("Atlas") });
+    // "Stripped,Full" compares the per-buffer capture profiles against full-feature captures
+    const TArray<FString> ProfileSets = ParseStringList(Params, TEXT("Profiles="), TEXT(","), { TEXT("Stripped") });
+
+    int32 WarmupFrames = 120;
+    int32 MeasureFrames = 600;
+    float TimeoutSeconds = 300.0f;
+    FParse::Value(*Params, TEXT("Warmup="), WarmupFrames);
+    FParse::Value(*Params, TEXT("Frames="), MeasureFrames);
+    FParse::Value(*Params, TEXT("Timeout="), TimeoutSeconds);
+
+    FString Map;
+    FParse::Value(*Params, TEXT("Map="), Map);
+
+    FString OutputDirectory;
+    if (!FParse::Value(*Params, TEXT("Output="), OutputDirectory))
+    {
+        OutputDirectory = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Benchmarks"), FDateTime::Now().ToString(TEXT("%Y%m%d_%H%M%S")));
+    }
+    OutputDirectory = FPaths::ConvertRelativePathToFull(OutputDirectory);
+    IFileManager::Get().MakeDirectory(*OutputDirectory, true);
+
+    // Packaged builds take no project argument
+    FString Executable;
+    FString ProjectArgument;
+    if (!FParse::Value(*Params, TEXT("Executable="), Executable))
+    {
+        Executable = FPlatformProcess::ExecutablePath();
+        ProjectArgument = FString::Printf(TEXT("\"%s\""), *FPaths::ConvertRelativePathToFull(FPaths::GetProjectFilePath()));
+    }
+
+    FString ExtraArgs;
+    FParse::Value(*Params, TEXT("ExtraArgs="), ExtraArgs, false);
+
+    TArray<FMLBenchmarkCase> Cases;
+    for (const FString& Mode : Modes)
+    {
+        const int64 ModeValue = StaticEnum<EMLBenchmarkUpdateMode>()->GetValueByNameString(Mode);
+        if (ModeValue == INDEX_NONE)
+        {
+            UE_LOG(LogMLCapture, Error, TEXT("Unknown update mode '%s'"), *Mode);
+            return 1;
+        }
+
+        for (const FString& ProfileSet : ProfileSets)
+        {
+            const bool bStripped = ProfileSet.Equals(TEXT("Stripped"), ESearchCase::IgnoreCase);
+            if (!bStripped && !ProfileSet.Equals(TEXT("Full"), ESearchCase::IgnoreCase))
+            {
+                UE_LOG(LogMLCapture, Error, TEXT("Unknown profile set '%s' (use Stripped or Full)"), *ProfileSet);
+                return 1;
+            }
+
+            for (const FString& BufferSet : BufferSets)
+            {
+                for (const int32 Resolution : Resolutions)
+                {
+                    for (const int32 NumCameras : CameraCounts)
+                    {
+                        FMLBenchmarkCase& Case = Cases.AddDefaulted_GetRef();
+                        Case.NumCameras = NumCameras;
+                        Case.Resolution = Resolution;
+                        Case.UpdateMode = static_cast<EMLBenchmarkUpdateMode>(ModeValue);
+                        Case.bCaptureProfiles = bStripped;
+                        if (!Case.ParseBufferSet(BufferSet))
+                        {
+                            UE_LOG(LogMLCapture, Error, TEXT("Unknown buffer set '%s' (use RGB, Depth, MLDepth, Normal joined by '+', or All)"), *BufferSet);
+                            return 1;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    UE_LOG(LogMLCapture, Display, TEXT("Capture benchmark: %d cases, results in %s"), Cases.Num(), *OutputDirectory);
+
+    TArray<FMLBenchmarkResult> Results;
+    for (int32 CaseIndex = 0; CaseIndex < Cases.Num(); ++CaseIndex)
+    {
+        const FMLBenchmarkCase& Case = Cases[CaseIndex];
+        const FString Label = Case.GetLabel();
+        const FString ResultPath = FPaths::Combine(OutputDirectory, Label + TEXT(".json"));
+        IFileManager::Get().Delete(*ResultPath, false, true, true);
+
+        const FString Arguments = FString::Printf(
+            TEXT("%s %s -game -RenderOffscreen -unattended -nosplash -nosound -NoVSync -ResX=640 -ResY=360 -windowed ")
+            TEXT("-MLCaptureBenchmark %s -MLBenchmarkWarmup=%d -MLBenchmarkFrames=%d -MLBenchmarkTimeout=%.0f ")
+            TEXT("-MLBenchmarkOutput=\"%s\" -abslog=\"%s\" %s"),
+            *ProjectArgument, *Map, *Case.ToCommandLine(), WarmupFrames, MeasureFrames, TimeoutSeconds,
+            *ResultPath, *FPaths::Combine(OutputDirectory, Label + TEXT(".log")), *ExtraArgs);
+
+        UE_LOG(LogMLCapture, Display, TEXT("[%d/%d] %s"), CaseIndex + 1, Cases.Num(), *Label);
+
+        FProcHandle Process = FPlatformProcess::CreateProc(*Executable, *Arguments, false, true, true, nullptr, 0, nullptr, nullptr);
+        FString Error;
+        if (!Process.IsValid())
+        {
+            Error = TEXT("could not launch process");
+        }
+        else
+        {
+            // The child enforces its own timeout; this one only catches hangs during startup or shutdown
+            const double Deadline = FPlatformTime::Seconds() + TimeoutSeconds + 120.0;
+            while (FPlatformProcess::IsProcRunning(Process))
+            {
+                if (FPlatformTime::Seconds() > Deadline)
+                {
+                    FPlatformProcess::TerminateProc(Process, true);
+                    Error = TEXT("process hung and was terminated");
+                    break;
+                }
+                FPlatformProcess::Sleep(0.25f);
+            }
+
+            int32 ReturnCode = 0;
+            FPlatformProcess::GetProcReturnCode(Process, &ReturnCode);
+            FPlatformProcess::CloseProc(Process);
+            if (Error.IsEmpty() && ReturnCode != 0)
+            {
+                Error = FString::Printf(TEXT("process exited with code %d"), ReturnCode);
+            }
+        }
+
+        FMLBenchmarkResult Result;
+        FString Json;
+        if (FFileHelper::LoadFileToString(Json, *ResultPath) && FJsonObjectConverter::JsonObjectStringToUStruct(Json, &Result))
+        {
+            if (!Error.IsEmpty() && Result.Error.IsEmpty())
+            {
+                Result.Error = Error;
+            }
+        }
+        else
+        {
+            Result.Case = Case;
+            Result.Error = Error.IsEmpty() ? TEXT("no result written") : Error;
+        }
+
+        UE_LOG(LogMLCapture, Display, TEXT("    %s"), Result.bCompleted
+            ? *FString::Printf(TEXT("GT %.2f ms  RT %.2f ms  GPU %.2f ms (%.3f ms/capture)  %.0f captures/s  latency p50/p95/p99 %.1f/%.1f/%.1f ms  %.0f MB"),
+                Result.GameThreadMs, Result.RenderThreadMs, Result.GpuMs, Result.GpuMsPerCapture, Result.CapturesPerSecond,
+                Result.ReadbackLatencyMsP50, Result.ReadbackLatencyMsP95, Result.ReadbackLatencyMsP99, Result.PeakUsedPhysicalMB)
+            : *FString::Printf(TEXT("FAILED: %s"), *Result.Error));
+
+        Results.Add(MoveTemp(Result));
+    }
+
+    TArray<FString> CsvLines;
+    CsvLines.Add(FMLBenchmarkResult::GetCsvHeader());
+    TArray<TSharedPtr<FJsonValue>> JsonResults;
+    int32 NumFailed = 0;
+    for (const FMLBenchmarkResult& Result : Results)
+    {
+        CsvLines.Add(Result.ToCsvRow());
+        if (TSharedPtr<FJsonObject> Object = FJsonObjectConverter::UStructToJsonObject(Result))
+        {
+            JsonResults.Add(MakeShared<FJsonValueObject>(Object));
+        }
+        NumFailed += Result.bCompleted ? 0 : 1;
+    }
+
+    FString JsonText;
+    const TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&JsonText);
+    FJsonSerializer::Serialize(JsonResults, Writer);
+
+    FFileHelper::SaveStringArrayToFile(CsvLines, *FPaths::Combine(OutputDirectory, TEXT("results.csv")));
+    FFileHelper::SaveStringToFile(JsonText, *FPaths::Combine(OutputDirectory, TEXT("results.json")));
+
+    UE_LOG(LogMLCapture, Display, TEXT("Capture benchmark finished: %d/%d cases completed"), Results.Num() - NumFailed, Results.Num());
+    return NumFailed == 0 ? 0 : 1;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "CaptureBenchmarkCommandlet.generated.h"
+
+// Sweeps camera count, resolution, buffer set, update mode and capture profile set. Every case runs in a fresh headless game
+// process (-game -RenderOffscreen -MLCaptureBenchmark) so memory and warm-up never leak between cases;
+// results are collected into results.csv and results.json.
+//
+//   UnrealEditor-Cmd cameratester.uproject -run=CaptureBenchmark -Cameras=1,16,64,256 -Resolutions=256,512
+//       -Buffers="RGB;RGB+Depth;All" -Modes=Scheduler,EveryFrame,Atlas -Frames=600 -Output=/tmp/bench
+//
+// -Profiles=Stripped,Full adds the per-capture cost of the per-buffer capture profiles against full-feature captures.
+// -Executable=<packaged game binary> benchmarks a packaged build instead of the editor binary.
+UCLASS()
+class CAMERATESTER_API UCaptureBenchmarkCommandlet : public UCommandlet
+{
+    GENERATED_BODY()
+
+public:
+    UCaptureBenchmarkCommandlet();
+
+    virtual int32 Main(const FString& Params) override;
+};
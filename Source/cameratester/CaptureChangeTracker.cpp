@@ -0,0 +1,269 @@
+#include "CaptureChangeTracker.h"
+#include "MLCaptureStats.h"
+#include "CaptureIndex.h"
+#include "EngineUtils.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+#include "Components/SceneComponent.h"
+
+FCaptureChangeTracker::~FCaptureChangeTracker()
+{
+    Shutdown();
+}
+
+void FCaptureChangeTracker::Configure(const FSettings& InSettings)
+{
+    Settings = InSettings;
+    Settings.MaxViewDistance = FMath::Max(Settings.MaxViewDistance, 1.0f);
+    Stats = FMLChangeTrackerStats();
+    Stats.TrackedActors = TrackedActors.Num();
+}
+
+void FCaptureChangeTracker::Initialize(UWorld* InWorld)
+{
+    Shutdown();
+    if (!InWorld)
+        return;
+
+    World = InWorld;
+    for (TActorIterator<AActor> It(InWorld); It; ++It)
+    {
+        TrackActor(*It);
+    }
+    ActorSpawnedHandle = InWorld->AddOnActorSpawnedHandler(FOnActorSpawned::FDelegate::CreateRaw(this, &FCaptureChangeTracker::HandleActorSpawned));
+    Stats.TrackedActors = TrackedActors.Num();
+}
+
+void FCaptureChangeTracker::Shutdown()
+{
+    if (UWorld* CurrentWorld = World.Get())
+    {
+        CurrentWorld->RemoveOnActorSpawnedHandler(ActorSpawnedHandle);
+    }
+    ActorSpawnedHandle.Reset();
+    World.Reset();
+    TrackedActors.Reset();
+    MovedBounds.Reset();
+    SceneHash = 0;
+}
+
+void FCaptureChangeTracker::TrackActor(AActor* Actor)
+{
+    // Static and stationary actors cannot move at runtime; only movable roots are worth polling
+    const USceneComponent* Root = IsValid(Actor) ? Actor->GetRootComponent() : nullptr;
+    if (!Root || Root->Mobility != EComponentMobility::Movable)
+        return;
+
+    FTrackedActor& Tracked = TrackedActors.AddDefaulted_GetRef();
+    Tracked.Actor = Actor;
+    Tracked.LastTransform = Actor->GetActorTransform();
+    Tracked.LastBounds = GetActorBoundsSphere(Actor);
+}
+
+void FCaptureChangeTracker::HandleActorSpawned(AActor* Actor)
+{
+    const int32 PreviousNum = TrackedActors.Num();
+    TrackActor(Actor);
+
+    // A new actor is scene motion in its own right
+    if (TrackedActors.Num() > PreviousNum)
+    {
+        MovedBounds.Add(TrackedActors.Last().LastBounds);
+    }
+}
+
+FSphere FCaptureChangeTracker::GetActorBoundsSphere(const AActor* Actor)
+{
+    FVector Origin;
+    FVector Extent;
+    Actor->GetActorBounds(false, Origin, Extent);
+    return FSphere(Origin, Extent.Size());
+}
+
+void FCaptureChangeTracker::Rebuild(const TArray<FMLCaptureBinding>& Bindings)
+{
+    TMap<uint32, FEntry> Previous;
+    Previous.Reserve(Entries.Num());
+    for (const FEntry& Entry : Entries)
+    {
+        Previous.Add(Entry.Key, Entry);
+    }
+
+    Entries.Reset(Bindings.Num());
+    CameraActors.Reset();
+    for (const FMLCaptureBinding& Binding : Bindings)
+    {
+        CameraActors.Add(Binding.Camera);
+
+        const uint32 Key = MLCapture::MakeCaptureKey(Binding.CameraIndex, Binding.BufferType);
+
+        FEntry Entry;
+        const FEntry* Existing = Previous.Find(Key);
+        if (Existing && Existing->RenderTarget == Binding.RenderTarget)
+        {
+            Entry = *Existing;
+        }
+        Entry.Key = Key;
+        Entry.RenderTarget = Binding.RenderTarget;
+        Entries.Add(Entry);
+    }
+}
+
+void FCaptureChangeTracker::BeginFrame()
+{
+    if (!Settings.bTrackSceneMotion)
+    {
+        MovedBounds.Reset();
+        Stats.MovedActorsLastFrame = 0;
+        SceneHash = 0;
+        return;
+    }
+
+    // Spawns since the last frame were added by HandleActorSpawned
+    const int32 NumSpawned = MovedBounds.Num();
+    SceneHash = 0;
+    for (int32 TrackedIndex = TrackedActors.Num() - 1; TrackedIndex >= 0; --TrackedIndex)
+    {
+        FTrackedActor& Tracked = TrackedActors[TrackedIndex];
+        const AActor* Actor = Tracked.Actor.Get();
+        if (!IsValid(Actor))
+        {
+            // Destroyed: whatever it covered is now visible
+            MovedBounds.Add(Tracked.LastBounds);
+            TrackedActors.RemoveAtSwap(TrackedIndex, EAllowShrinking::No);
+            continue;
+        }
+
+        const FTransform Transform = Actor->GetActorTransform();
+        if (!Transform.Equals(Tracked.LastTransform, UE_KINDA_SMALL_NUMBER))
+        {
+            // Test both where it was and where it is now
+            const FSphere Bounds = GetActorBoundsSphere(Actor);
+            MovedBounds.Add(Tracked.LastBounds);
+            MovedBounds.Add(Bounds);
+            Tracked.LastTransform = Transform;
+            Tracked.LastBounds = Bounds;
+        }
+
+        // Summed so the hash does not depend on the order actors were found in
+        if (!CameraActors.Contains(Actor))
+        {
+            SceneHash += FCaptureIndex::HashTransform(Tracked.LastTransform, Settings.PositionTolerance, Settings.RotationToleranceDegrees);
+        }
+    }
+
+    Stats.TrackedActors = TrackedActors.Num();
+    Stats.MovedActorsLastFrame = NumSpawned + (MovedBounds.Num() - NumSpawned) / 2;
+
+    if (MovedBounds.Num() == 0)
+        return;
+
+    for (FEntry& Entry : Entries)
+    {
+        // Never-captured entries are dirty anyway, and a latched flag stays set until the next capture
+        if (Entry.LastCaptureTime < 0.0 || Entry.bSceneDirty)
+            continue;
+
+        for (const FSphere& Sphere : MovedBounds)
+        {
+            if (ConeIntersectsSphere(Entry, Sphere))
+            {
+                Entry.bSceneDirty = true;
+                break;
+            }
+        }
+    }
+    MovedBounds.Reset();
+}
+
+void FCaptureChangeTracker::UpdateViewCone(FEntry& Entry, const USceneCaptureComponent2D* SceneCapture)
+{
+    const FTransform& Pose = SceneCapture->GetComponentTransform();
+    Entry.Origin = Pose.GetLocation();
+    Entry.Forward = Pose.GetUnitAxis(EAxis::X);
+
+    // Cone around the frustum: half-angle through the corner of the image plane
+    float Aspect = 1.0f;
+    if (const UTextureRenderTarget2D* Target = SceneCapture->TextureTarget)
+    {
+        Aspect = Target->SizeX > 0 && Target->SizeY > 0 ? static_cast<float>(Target->SizeY) / Target->SizeX : 1.0f;
+    }
+    const float TanHalfX = FMath::Tan(FMath::DegreesToRadians(FMath::Clamp(SceneCapture->FOVAngle, 1.0f, 170.0f) * 0.5f));
+    const float TanHalfDiagonal = TanHalfX * FMath::Sqrt(1.0f + Aspect * Aspect);
+    const float HalfAngle = FMath::Atan(TanHalfDiagonal);
+    FMath::SinCos(&Entry.SinHalfAngle, &Entry.CosHalfAngle, HalfAngle);
+}
+
+bool FCaptureChangeTracker::ConeIntersectsSphere(const FEntry& Entry, const FSphere& Sphere) const
+{
+    const FVector ToCenter = Sphere.Center - Entry.Origin;
+    const double Along = FVector::DotProduct(ToCenter, Entry.Forward);
+    if (Along < -Sphere.W || Along - Sphere.W > Settings.MaxViewDistance)
+        return false;
+
+    const double DistanceSquared = ToCenter.SizeSquared();
+    if (DistanceSquared <= FMath::Square(Sphere.W))
+        return true;
+
+    // Distance from the sphere centre to the cone surface, measured perpendicular to it
+    const double Across = FMath::Sqrt(FMath::Max(DistanceSquared - Along * Along, 0.0));
+    const double SurfaceDistance = Across * Entry.CosHalfAngle - Along * Entry.SinHalfAngle;
+    return SurfaceDistance <= Sphere.W;
+}
+
+bool FCaptureChangeTracker::NeedsCapture(int32 BindingIndex, const FMLCaptureBinding& Binding, double NowSeconds)
+{
+    if (!Entries.IsValidIndex(BindingIndex) || !IsValid(Binding.SceneCapture))
+        return true;
+
+    const FEntry& Entry = Entries[BindingIndex];
+    if (Entry.LastCaptureTime < 0.0)
+    {
+        ++Stats.CapturedInitial;
+        return true;
+    }
+
+    const FTransform& Pose = Binding.SceneCapture->GetComponentTransform();
+    const bool bMoved = !Pose.GetLocation().Equals(Entry.LastPose.GetLocation(), Settings.PositionTolerance)
+        || Pose.GetRotation().AngularDistance(Entry.LastPose.GetRotation()) > FMath::DegreesToRadians(Settings.RotationToleranceDegrees)
+        || FMath::Abs(Binding.SceneCapture->FOVAngle - Entry.LastFOV) > Settings.FOVToleranceDegrees;
+    if (bMoved)
+    {
+        ++Stats.CapturedForViewChange;
+        return true;
+    }
+
+    if (Entry.bSceneDirty)
+    {
+        ++Stats.CapturedForSceneMotion;
+        return true;
+    }
+
+    if (Settings.MaxStalenessSeconds > 0.0f && NowSeconds - Entry.LastCaptureTime >= Settings.MaxStalenessSeconds)
+    {
+        ++Stats.CapturedForStaleness;
+        return true;
+    }
+
+    ++Stats.CapturesSkipped;
+    return false;
+}
+
+void FCaptureChangeTracker::MarkCaptured(int32 BindingIndex, const FMLCaptureBinding& Binding, double NowSeconds, int64 FrameIndex)
+{
+    if (!Entries.IsValidIndex(BindingIndex) || !IsValid(Binding.SceneCapture))
+        return;
+
+    FEntry& Entry = Entries[BindingIndex];
+    Entry.LastPose = Binding.SceneCapture->GetComponentTransform();
+    Entry.LastFOV = Binding.SceneCapture->FOVAngle;
+    Entry.LastCaptureTime = NowSeconds;
+    Entry.LastFrameIndex = FrameIndex;
+    Entry.bSceneDirty = false;
+    UpdateViewCone(Entry, Binding.SceneCapture);
+}
+
+int64 FCaptureChangeTracker::GetLastCapturedFrame(int32 BindingIndex) const
+{
+    return Entries.IsValidIndex(BindingIndex) ? Entries[BindingIndex].LastFrameIndex : INDEX_NONE;
+}
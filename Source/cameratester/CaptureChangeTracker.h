@@ -0,0 +1,123 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MLCaptureTypes.h"
+#include "CaptureChangeTracker.generated.h"
+
+// Why captures were issued or skipped, accumulated since the tracker was configured
+USTRUCT(BlueprintType)
+struct CAMERATESTER_API FMLChangeTrackerStats
+{
+    GENERATED_BODY()
+
+    UPROPERTY(BlueprintReadOnly, Category = "Change Detection")
+    int64 CapturesSkipped = 0;
+
+    // First capture of a binding, or its render target changed
+    UPROPERTY(BlueprintReadOnly, Category = "Change Detection")
+    int64 CapturedInitial = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Change Detection")
+    int64 CapturedForViewChange = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Change Detection")
+    int64 CapturedForSceneMotion = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Change Detection")
+    int64 CapturedForStaleness = 0;
+
+    // Movable actors currently watched for scene motion
+    UPROPERTY(BlueprintReadOnly, Category = "Change Detection")
+    int32 TrackedActors = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Change Detection")
+    int32 MovedActorsLastFrame = 0;
+};
+
+// Decides whether a capture binding has to be re-rendered: its view (transform, FOV) moved, a movable actor
+// moved inside its view cone, or the last capture is older than the staleness limit. Scene motion is found by
+// comparing the transforms of movable actors once per frame; moved bounds are tested against each binding's
+// bounding cone and latched until the binding is captured again.
+class CAMERATESTER_API FCaptureChangeTracker
+{
+public:
+    struct FSettings
+    {
+        float PositionTolerance = 0.5f;
+        float RotationToleranceDegrees = 0.05f;
+        float FOVToleranceDegrees = 0.01f;
+        // 0 = never force a capture of an unchanged view
+        float MaxStalenessSeconds = 5.0f;
+        float MaxViewDistance = 100000.0f;
+        bool bTrackSceneMotion = true;
+    };
+
+    ~FCaptureChangeTracker();
+
+    void Configure(const FSettings& InSettings);
+
+    // Start watching the world's movable actors; actors spawned later are picked up automatically
+    void Initialize(UWorld* InWorld);
+    void Shutdown();
+
+    // Rebuild per-binding state; history is kept for bindings whose render target did not change
+    void Rebuild(const TArray<FMLCaptureBinding>& Bindings);
+
+    // Once per frame before any NeedsCapture call: find moved actors and latch them into the bindings that see them
+    void BeginFrame();
+
+    bool NeedsCapture(int32 BindingIndex, const FMLCaptureBinding& Binding, double NowSeconds);
+    void MarkCaptured(int32 BindingIndex, const FMLCaptureBinding& Binding, double NowSeconds, int64 FrameIndex);
+
+    // Frame whose pixels are still current for a skipped binding; INDEX_NONE if it was never captured
+    int64 GetLastCapturedFrame(int32 BindingIndex) const;
+
+    // Order-independent hash of every tracked actor's transform except the capturing cameras, quantized to the
+    // change tolerances; updated by BeginFrame, 0 without scene motion tracking
+    uint64 GetSceneHash() const { return SceneHash; }
+
+    const FMLChangeTrackerStats& GetStats() const { return Stats; }
+
+private:
+    struct FEntry
+    {
+        uint32 Key = 0;
+        const UTextureRenderTarget2D* RenderTarget = nullptr;
+        FTransform LastPose;
+        float LastFOV = 0.0f;
+        double LastCaptureTime = -1.0;
+        int64 LastFrameIndex = INDEX_NONE;
+        bool bSceneDirty = false;
+
+        // Bounding cone of the view, refreshed on capture
+        FVector Origin = FVector::ZeroVector;
+        FVector Forward = FVector::ForwardVector;
+        float SinHalfAngle = 1.0f;
+        float CosHalfAngle = 0.0f;
+    };
+
+    struct FTrackedActor
+    {
+        TWeakObjectPtr<AActor> Actor;
+        FTransform LastTransform;
+        FSphere LastBounds;
+    };
+
+    void TrackActor(AActor* Actor);
+    void HandleActorSpawned(AActor* Actor);
+    bool ConeIntersectsSphere(const FEntry& Entry, const FSphere& Sphere) const;
+    static FSphere GetActorBoundsSphere(const AActor* Actor);
+    static void UpdateViewCone(FEntry& Entry, const USceneCaptureComponent2D* SceneCapture);
+
+    FSettings Settings;
+    TArray<FEntry> Entries;
+    TArray<FTrackedActor> TrackedActors;
+    TArray<FSphere> MovedBounds;
+    // Only compared, never dereferenced
+    TSet<const AActor*> CameraActors;
+    uint64 SceneHash = 0;
+
+    TWeakObjectPtr<UWorld> World;
+    FDelegateHandle ActorSpawnedHandle;
+    FMLChangeTrackerStats Stats;
+};
@@ -0,0 +1,228 @@
+#include "CaptureCoordinatorCommandlet.h"
+#include "MLCaptureStats.h"
+#include "DatasetManifest.h"
+#include "ShardCoordinator.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformProcess.h"
+#include "Misc/DateTime.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+    bool MergeShards(const TArray<FString>& Manifests, const FString& OutputDirectory)
+    {
+        FMLMergedDataset Dataset;
+        FString Error;
+        if (!DatasetManifest::Merge(Manifests, OutputDirectory, Dataset, Error))
+        {
+            UE_LOG(LogMLCapture, Error, TEXT("Merge failed: %s"), *Error);
+            return false;
+        }
+
+        UE_LOG(LogMLCapture, Display, TEXT("Merged dataset: %lld records, %d cameras, frames %lld-%lld -> %s"), Dataset.Records,
+            Dataset.Cameras.Num(), Dataset.FirstFrame, Dataset.LastFrame, *FPaths::Combine(OutputDirectory, TEXT("dataset.idx")));
+        return Dataset.MissingShards.Num() == 0;
+    }
+}
+
+UCaptureCoordinatorCommandlet::UCaptureCoordinatorCommandlet()
+{
+    IsClient = false;
+    IsServer = false;
+    IsEditor = false;
+    LogToConsole = true;
+}
+
+int32 UCaptureCoordinatorCommandlet::Main(const FString& Params)
+{
+    int32 ShardCount = 2;
+    int32 Seed = 0;
+    int32 Port = 0;
+    int32 Frames = 600;
+    int32 Retries = 1;
+    float TimeoutSeconds = 3600.0f;
+    FParse::Value(*Params, TEXT("Shards="), ShardCount);
+    FParse::Value(*Params, TEXT("Seed="), Seed);
+    FParse::Value(*Params, TEXT("Port="), Port);
+    FParse::Value(*Params, TEXT("Frames="), Frames);
+    FParse::Value(*Params, TEXT("Retries="), Retries);
+    FParse::Value(*Params, TEXT("Timeout="), TimeoutSeconds);
+    ShardCount = FMath::Max(ShardCount, 1);
+
+    EMLShardMode Mode = EMLShardMode::IndexRange;
+    FString ModeName;
+    if (FParse::Value(*Params, TEXT("Mode="), ModeName))
+    {
+        const int64 ModeValue = StaticEnum<EMLShardMode>()->GetValueByNameString(ModeName);
+        if (ModeValue == INDEX_NONE)
+        {
+            UE_LOG(LogMLCapture, Error, TEXT("Unknown shard mode '%s' (use IndexRange or Hash)"), *ModeName);
+            return 1;
+        }
+        Mode = static_cast<EMLShardMode>(ModeValue);
+    }
+
+    FString OutputDirectory;
+    if (!FParse::Value(*Params, TEXT("Output="), OutputDirectory))
+    {
+        OutputDirectory = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Captures"), FDateTime::Now().ToString(TEXT("%Y%m%d_%H%M%S")));
+    }
+    OutputDirectory = FPaths::ConvertRelativePathToFull(OutputDirectory);
+    IFileManager::Get().MakeDirectory(*OutputDirectory, true);
+
+    if (FParse::Param(*Params, TEXT("MergeOnly")))
+    {
+        TArray<FString> Parts;
+        IFileManager::Get().FindFiles(Parts, *FPaths::Combine(OutputDirectory, TEXT("part_*")), false, true);
+        Parts.Sort();
+
+        TArray<FString> Manifests;
+        for (const FString& Part : Parts)
+        {
+            const FString Manifest = FPaths::Combine(OutputDirectory, Part, TEXT("manifest.json"));
+            if (IFileManager::Get().FileExists(*Manifest))
+            {
+                Manifests.Add(Manifest);
+            }
+        }
+        return MergeShards(Manifests, OutputDirectory) ? 0 : 1;
+    }
+
+    FShardCoordinator Coordinator(ShardCount, Mode, Seed);
+    if (!Coordinator.Start(Port))
+        return 1;
+
+    FString Map;
+    FParse::Value(*Params, TEXT("Map="), Map);
+
+    // Packaged builds take no project argument
+    FString Executable;
+    FString ProjectArgument;
+    if (!FParse::Value(*Params, TEXT("Executable="), Executable))
+    {
+        Executable = FPlatformProcess::ExecutablePath();
+        ProjectArgument = FString::Printf(TEXT("\"%s\""), *FPaths::ConvertRelativePathToFull(FPaths::GetProjectFilePath()));
+    }
+
+    FString ExtraArgs;
+    FParse::Value(*Params, TEXT("ExtraArgs="), ExtraArgs, false);
+
+    const bool bLaunch = !FParse::Param(*Params, TEXT("NoLaunch"));
+    TArray<FProcHandle> Processes;
+    int32 NumLaunched = 0;
+    auto LaunchWorker = [&]()
+    {
+        // Workers are interchangeable; the coordinator decides which shard each one captures
+        const FString Arguments = FString::Printf(
+            TEXT("%s %s -game -RenderOffscreen -unattended -nosplash -nosound -NoVSync -ResX=640 -ResY=360 -windowed ")
+            TEXT("-MLOffline -MLOfflineFrames=%d -MLOfflineExit -MLWriteDataset -MLDatasetDir=\"%s\" -MLCoordinator=127.0.0.1:%d ")
+            TEXT("-abslog=\"%s\" %s"),
+            *ProjectArgument, *Map, Frames, *OutputDirectory, Coordinator.GetPort(),
+            *FPaths::Combine(OutputDirectory, FString::Printf(TEXT("worker_%02d.log"), NumLaunched)), *ExtraArgs);
+
+        FProcHandle Process = FPlatformProcess::CreateProc(*Executable, *Arguments, false, true, true, nullptr, 0, nullptr, nullptr);
+        if (!Process.IsValid())
+        {
+            UE_LOG(LogMLCapture, Error, TEXT("Could not launch capture worker %d"), NumLaunched);
+            return false;
+        }
+        Processes.Add(Process);
+        ++NumLaunched;
+        return true;
+    };
+
+    if (bLaunch)
+    {
+        for (int32 WorkerIndex = 0; WorkerIndex < ShardCount; ++WorkerIndex)
+        {
+            if (!LaunchWorker())
+                return 1;
+        }
+    }
+    else
+    {
+        UE_LOG(LogMLCapture, Display, TEXT("Waiting for %d workers started with -MLCoordinator=127.0.0.1:%d -MLWriteDataset -MLDatasetDir=\"%s\""),
+            ShardCount, Coordinator.GetPort(), *OutputDirectory);
+    }
+
+    const double Deadline = FPlatformTime::Seconds() + TimeoutSeconds;
+    double NextReport = FPlatformTime::Seconds() + 5.0;
+    int32 RetriesLeft = Retries;
+    FString Error;
+    while (!Coordinator.IsComplete())
+    {
+        Coordinator.Poll();
+
+        for (int32 Index = Processes.Num() - 1; Index >= 0; --Index)
+        {
+            if (FPlatformProcess::IsProcRunning(Processes[Index]))
+                continue;
+
+            int32 ReturnCode = 0;
+            FPlatformProcess::GetProcReturnCode(Processes[Index], &ReturnCode);
+            FPlatformProcess::CloseProc(Processes[Index]);
+            Processes.RemoveAtSwap(Index);
+            UE_CLOG(ReturnCode != 0, LogMLCapture, Warning, TEXT("A capture worker exited with code %d"), ReturnCode);
+        }
+
+        // Replace workers that died before finishing their shard
+        const int32 NumMissing = Coordinator.GetShardCount() - Coordinator.GetNumDone() - Processes.Num();
+        if (bLaunch && NumMissing > 0 && !Coordinator.IsComplete())
+        {
+            Coordinator.Poll();
+            if (Coordinator.IsComplete())
+                break;
+            if (RetriesLeft <= 0)
+            {
+                Error = FString::Printf(TEXT("%d shards unfinished and no retries left"), Coordinator.GetShardCount() - Coordinator.GetNumDone());
+                break;
+            }
+            --RetriesLeft;
+            LaunchWorker();
+        }
+
+        if (FPlatformTime::Seconds() > Deadline)
+        {
+            Error = TEXT("timed out");
+            break;
+        }
+
+        if (FPlatformTime::Seconds() >= NextReport)
+        {
+            NextReport = FPlatformTime::Seconds() + 5.0;
+            for (const FMLShardProgress& Shard : Coordinator.GetProgress())
+            {
+                UE_LOG(LogMLCapture, Display, TEXT("    shard %d: %s%d cameras, %lld frames, %lld records, %.1f MB"), Shard.ShardIndex,
+                    Shard.bDone ? TEXT("done, ") : TEXT(""), Shard.Cameras, Shard.FramesCaptured, Shard.RecordsWritten, Shard.BytesWritten / (1024.0 * 1024.0));
+            }
+        }
+
+        FPlatformProcess::Sleep(0.1f);
+    }
+
+    // Finished workers exit on their own once their writers are closed
+    const double ExitDeadline = FPlatformTime::Seconds() + 60.0;
+    for (FProcHandle& Process : Processes)
+    {
+        while (FPlatformProcess::IsProcRunning(Process))
+        {
+            if (!Error.IsEmpty() || FPlatformTime::Seconds() > ExitDeadline)
+            {
+                FPlatformProcess::TerminateProc(Process, true);
+                break;
+            }
+            FPlatformProcess::Sleep(0.25f);
+        }
+        FPlatformProcess::CloseProc(Process);
+    }
+    Coordinator.Stop();
+
+    if (!Error.IsEmpty())
+    {
+        UE_LOG(LogMLCapture, Error, TEXT("Sharded capture failed: %s (%d/%d shards done)"), *Error, Coordinator.GetNumDone(), Coordinator.GetShardCount());
+    }
+
+    const TArray<FString> Manifests = Coordinator.GetManifests();
+    const bool bMerged = Manifests.Num() > 0 && MergeShards(Manifests, OutputDirectory);
+    return Error.IsEmpty() && bMerged ? 0 : 1;
+}
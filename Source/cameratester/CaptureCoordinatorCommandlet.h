@@ -0,0 +1,27 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "CaptureCoordinatorCommandlet.generated.h"
+
+// Splits one camera layout over several local game processes and merges their datasets. Runs the shard coordinator
+// (see FShardCoordinator), launches one offline capture process per shard (-game -RenderOffscreen -MLOffline
+// -MLWriteDataset -MLCoordinator=...), relaunches processes that die before finishing, then merges the per-shard
+// manifests into <Output>/dataset.idx and dataset.json.
+//
+//   UnrealEditor-Cmd cameratester.uproject -run=CaptureCoordinator -Map=/Game/Maps/Capture -Shards=4 -Mode=Hash
+//       -Frames=600 -Output=/data/run1
+//
+// -NoLaunch only coordinates: start the workers yourself with -MLCoordinator=127.0.0.1:<Port>.
+// -MergeOnly merges the part_*/manifest.json already under -Output without capturing.
+// -Executable=<packaged game binary> runs a packaged build instead of the editor binary.
+UCLASS()
+class CAMERATESTER_API UCaptureCoordinatorCommandlet : public UCommandlet
+{
+    GENERATED_BODY()
+
+public:
+    UCaptureCoordinatorCommandlet();
+
+    virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,361 @@
+#include "CaptureIndex.h"
+#include "MLCaptureStats.h"
+#include "DatasetShardWriter.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/PlatformFileManager.h"
+#include "Math/Float16.h"
+#include "Misc/Crc.h"
+#include "Misc/ScopeRWLock.h"
+
+namespace
+{
+    // Entries appended between flushes; the OS has every write anyway, this only bounds what a power loss costs
+    constexpr int64 FlushInterval = 256;
+
+    FORCEINLINE uint64 Mix(uint64 Hash, uint64 Value)
+    {
+        // splitmix64 finaliser over the running hash
+        uint64 X = Hash ^ (Value + 0x9E3779B97F4A7C15ull + (Hash << 6) + (Hash >> 2));
+        X = (X ^ (X >> 30)) * 0xBF58476D1CE4E5B9ull;
+        X = (X ^ (X >> 27)) * 0x94D049BB133111EBull;
+        return X ^ (X >> 31);
+    }
+
+    FORCEINLINE uint64 Quantize(double Value, float Quantum)
+    {
+        return static_cast<uint64>(FMath::RoundToInt64(Value / FMath::Max(Quantum, UE_KINDA_SMALL_NUMBER)));
+    }
+
+    FORCEINLINE float LoadHalf(const uint8* Data)
+    {
+        FFloat16 Half;
+        FMemory::Memcpy(&Half, Data, sizeof(Half));
+        return Half.GetFloat();
+    }
+
+    FORCEINLINE float LoadFloat(const uint8* Data)
+    {
+        float Value;
+        FMemory::Memcpy(&Value, Data, sizeof(Value));
+        return Value;
+    }
+
+    // Luminance of colour formats, the first channel of everything else
+    float LoadSample(const uint8* Pixel, EPixelFormat PixelFormat)
+    {
+        float Value = 0.0f;
+        switch (PixelFormat)
+        {
+        case PF_B8G8R8A8:        Value = 0.0722f * Pixel[0] + 0.7152f * Pixel[1] + 0.2126f * Pixel[2]; break;
+        case PF_R8G8B8A8:        Value = 0.2126f * Pixel[0] + 0.7152f * Pixel[1] + 0.0722f * Pixel[2]; break;
+        case PF_FloatRGBA:       Value = 0.2126f * LoadHalf(Pixel) + 0.7152f * LoadHalf(Pixel + 2) + 0.0722f * LoadHalf(Pixel + 4); break;
+        case PF_A32B32G32R32F:   Value = 0.2126f * LoadFloat(Pixel) + 0.7152f * LoadFloat(Pixel + 4) + 0.0722f * LoadFloat(Pixel + 8); break;
+        case PF_R32_FLOAT:       Value = LoadFloat(Pixel); break;
+        case PF_R16F:            Value = LoadHalf(Pixel); break;
+        case PF_G16:             Value = static_cast<float>(Pixel[0] | (Pixel[1] << 8)); break;
+        default:                 Value = Pixel[0]; break;
+        }
+        // Sky depth and similar sentinels must still compare
+        return FMath::IsFinite(Value) ? FMath::Clamp(Value, -1.0e30f, 1.0e30f) : (FMath::IsNaN(Value) ? 0.0f : (Value > 0.0f ? 1.0e30f : -1.0e30f));
+    }
+}
+
+FCaptureIndex::FCaptureIndex(const FSettings& InSettings)
+    : Settings(InSettings)
+{
+}
+
+FCaptureIndex::~FCaptureIndex()
+{
+    Close();
+}
+
+bool FCaptureIndex::Open()
+{
+    Close();
+
+    Header = FMLCaptureIndexHeader();
+    Header.EntrySize = sizeof(FMLCaptureIndexEntry);
+    Header.PositionQuantum = Settings.PositionQuantum;
+    Header.RotationQuantumDegrees = Settings.RotationQuantumDegrees;
+
+    FWriteScopeLock WriteLock(Lock);
+    FrameByView.Reset();
+    CommittedFrames.Reset();
+    LastHashByCapture.Reset();
+    Stats = FMLCaptureIndexStats();
+
+    const int64 ValidBytes = LoadEntries();
+    if (ValidBytes < 0)
+        return false;
+
+    IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+    File.Reset(PlatformFile.OpenWrite(*Settings.Path, ValidBytes > 0, true));
+    if (!File)
+    {
+        UE_LOG(LogMLCapture, Error, TEXT("Capture index could not open %s for writing"), *Settings.Path);
+        return false;
+    }
+
+    if (ValidBytes > 0)
+    {
+        const int64 FileBytes = File->Size();
+        if (FileBytes > ValidBytes)
+        {
+            UE_LOG(LogMLCapture, Warning, TEXT("Capture index %s: discarding %lld bytes of torn entries"), *Settings.Path, FileBytes - ValidBytes);
+            Stats.BytesDiscarded = FileBytes - ValidBytes;
+            File->Truncate(ValidBytes);
+        }
+        File->Seek(ValidBytes);
+    }
+    else
+    {
+        File->Write(reinterpret_cast<const uint8*>(&Header), sizeof(Header));
+        File->Flush();
+    }
+
+    UE_LOG(LogMLCapture, Log, TEXT("Capture index %s: %lld entries, resuming after frame %lld"),
+        *Settings.Path, Stats.EntriesLoaded, Stats.ResumeFrame);
+    return true;
+}
+
+int64 FCaptureIndex::LoadEntries()
+{
+    IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+    if (PlatformFile.FileSize(*Settings.Path) < static_cast<int64>(sizeof(FMLCaptureIndexHeader)))
+        return 0;
+
+    TUniquePtr<IMappedFileHandle> Mapped(PlatformFile.OpenMapped(*Settings.Path));
+    TUniquePtr<IMappedFileRegion> Region(Mapped ? Mapped->MapRegion(0, Mapped->GetFileSize()) : nullptr);
+    if (!Region)
+    {
+        // Never start over on top of entries that only failed to map
+        UE_LOG(LogMLCapture, Error, TEXT("Capture index could not map %s"), *Settings.Path);
+        return -1;
+    }
+
+    const uint8* Data = Region->GetMappedPtr();
+    const int64 FileBytes = Region->GetMappedSize();
+
+    FMLCaptureIndexHeader OnDisk;
+    FMemory::Memcpy(&OnDisk, Data, sizeof(OnDisk));
+    if (OnDisk.Magic != Header.Magic)
+    {
+        UE_LOG(LogMLCapture, Warning, TEXT("%s is not a capture index; starting a new one"), *Settings.Path);
+        return 0;
+    }
+    if (OnDisk.Version > Header.Version || OnDisk.EntrySize != sizeof(FMLCaptureIndexEntry))
+    {
+        UE_LOG(LogMLCapture, Error, TEXT("Capture index %s has unsupported version %u"), *Settings.Path, OnDisk.Version);
+        return -1;
+    }
+
+    // Keys are only comparable under the quantization they were made with
+    UE_CLOG(OnDisk.PositionQuantum != Header.PositionQuantum || OnDisk.RotationQuantumDegrees != Header.RotationQuantumDegrees,
+        LogMLCapture, Warning, TEXT("Capture index %s keeps its quantization (%.3f cm, %.3f deg)"),
+        *Settings.Path, OnDisk.PositionQuantum, OnDisk.RotationQuantumDegrees);
+    Header = OnDisk;
+
+    const int64 NumEntries = (FileBytes - static_cast<int64>(sizeof(FMLCaptureIndexHeader))) / sizeof(FMLCaptureIndexEntry);
+    const FMLCaptureIndexEntry* Entries = reinterpret_cast<const FMLCaptureIndexEntry*>(Data + sizeof(FMLCaptureIndexHeader));
+    FrameByView.Reserve(NumEntries);
+    CommittedFrames.Reserve(NumEntries);
+
+    // Entries are appended in order, so the first bad CRC is where the crash tore the file
+    int64 NumValid = 0;
+    for (; NumValid < NumEntries; ++NumValid)
+    {
+        const FMLCaptureIndexEntry& Entry = Entries[NumValid];
+        if (FCrc::MemCrc32(&Entry, STRUCT_OFFSET(FMLCaptureIndexEntry, Crc)) != Entry.Crc)
+            break;
+
+        AddEntryLocked(Entry);
+        Stats.ResumeFrame = FMath::Max(Stats.ResumeFrame, Entry.FrameIndex);
+    }
+
+    Stats.EntriesLoaded = NumValid;
+    return sizeof(FMLCaptureIndexHeader) + NumValid * sizeof(FMLCaptureIndexEntry);
+}
+
+void FCaptureIndex::Close()
+{
+    FWriteScopeLock WriteLock(Lock);
+    if (File)
+    {
+        File->Flush();
+        File.Reset();
+    }
+    UnflushedEntries = 0;
+}
+
+uint64 FCaptureIndex::HashTransform(const FTransform& Transform, float PositionQuantum, float RotationQuantumDegrees)
+{
+    const FVector Location = Transform.GetLocation();
+    const FRotator Rotation = Transform.Rotator().GetNormalized();
+
+    uint64 Hash = Mix(0, Quantize(Location.X, PositionQuantum));
+    Hash = Mix(Hash, Quantize(Location.Y, PositionQuantum));
+    Hash = Mix(Hash, Quantize(Location.Z, PositionQuantum));
+    Hash = Mix(Hash, Quantize(Rotation.Pitch, RotationQuantumDegrees));
+    Hash = Mix(Hash, Quantize(Rotation.Yaw, RotationQuantumDegrees));
+    return Mix(Hash, Quantize(Rotation.Roll, RotationQuantumDegrees));
+}
+
+uint64 FCaptureIndex::HashPose(const FTransform& Pose, float FOVAngle) const
+{
+    return Mix(HashTransform(Pose, Header.PositionQuantum, Header.RotationQuantumDegrees), Quantize(FOVAngle, 0.01f));
+}
+
+uint64 FCaptureIndex::MakeViewKey(int32 CameraIndex, EMLBufferType BufferType, uint64 PoseHash, uint64 SceneHash)
+{
+    return Mix(Mix(Mix(0, MLCapture::MakeCaptureKey(CameraIndex, BufferType)), PoseHash), SceneHash);
+}
+
+uint64 FCaptureIndex::MakeFrameKey(int64 FrameIndex, int32 CameraIndex, EMLBufferType BufferType)
+{
+    return Mix(Mix(0, static_cast<uint64>(FrameIndex)), MLCapture::MakeCaptureKey(CameraIndex, BufferType));
+}
+
+bool FCaptureIndex::ComputePerceptualHash(const FMLCapturedFrame& Frame, uint64& OutHash)
+{
+    const int32 BytesPerPixel = Frame.BytesPerPixel;
+    if (Frame.Codec != EMLFrameCodec::Raw || Frame.PixelFormat == PF_Unknown || Frame.Width <= 0 || Frame.Height <= 0 || BytesPerPixel <= 0
+        || static_cast<int64>(Frame.Width) * Frame.Height * BytesPerPixel > Frame.Pixels.Num())
+        return false;
+
+    // Average a 4x4 sample grid per cell; one pixel per sample keeps this a few microseconds per frame
+    constexpr int32 CellsX = 9;
+    constexpr int32 CellsY = 8;
+    constexpr int32 SamplesPerAxis = 4;
+    float Cells[CellsY][CellsX];
+    const uint8* Pixels = Frame.Pixels.GetData();
+    for (int32 CellY = 0; CellY < CellsY; ++CellY)
+    {
+        for (int32 CellX = 0; CellX < CellsX; ++CellX)
+        {
+            float Sum = 0.0f;
+            for (int32 SampleY = 0; SampleY < SamplesPerAxis; ++SampleY)
+            {
+                const int64 Y = ((CellY * SamplesPerAxis + SampleY) * 2 + 1) * static_cast<int64>(Frame.Height) / (CellsY * SamplesPerAxis * 2);
+                for (int32 SampleX = 0; SampleX < SamplesPerAxis; ++SampleX)
+                {
+                    const int64 X = ((CellX * SamplesPerAxis + SampleX) * 2 + 1) * static_cast<int64>(Frame.Width) / (CellsX * SamplesPerAxis * 2);
+                    Sum += LoadSample(Pixels + (Y * Frame.Width + X) * BytesPerPixel, Frame.PixelFormat) / (SamplesPerAxis * SamplesPerAxis);
+                }
+            }
+            Cells[CellY][CellX] = Sum;
+        }
+    }
+
+    // One bit per horizontal neighbour pair: does the image get brighter (or deeper) to the right
+    uint64 Hash = 0;
+    for (int32 CellY = 0; CellY < CellsY; ++CellY)
+    {
+        for (int32 CellX = 0; CellX < CellsX - 1; ++CellX)
+        {
+            if (Cells[CellY][CellX] < Cells[CellY][CellX + 1])
+            {
+                Hash |= 1ull << (CellY * (CellsX - 1) + CellX);
+            }
+        }
+    }
+    OutHash = Hash;
+    return true;
+}
+
+int64 FCaptureIndex::FindView(uint64 ViewKey) const
+{
+    FReadScopeLock ReadLock(Lock);
+    const int64* FrameIndex = FrameByView.Find(ViewKey);
+    return FrameIndex ? *FrameIndex : INDEX_NONE;
+}
+
+bool FCaptureIndex::IsCommitted(int64 FrameIndex, int32 CameraIndex, EMLBufferType BufferType) const
+{
+    FReadScopeLock ReadLock(Lock);
+    return CommittedFrames.Contains(MakeFrameKey(FrameIndex, CameraIndex, BufferType));
+}
+
+int64 FCaptureIndex::GetResumeFrame() const
+{
+    FReadScopeLock ReadLock(Lock);
+    return Stats.ResumeFrame;
+}
+
+int64 FCaptureIndex::FindNearDuplicate(int32 CameraIndex, EMLBufferType BufferType, uint64 PerceptualHash) const
+{
+    if (Settings.NearDuplicateBits < 0)
+        return INDEX_NONE;
+
+    FReadScopeLock ReadLock(Lock);
+    const FLastHash* Last = LastHashByCapture.Find(MLCapture::MakeCaptureKey(CameraIndex, BufferType));
+    if (!Last || FMath::CountBits(Last->Hash ^ PerceptualHash) > static_cast<uint64>(Settings.NearDuplicateBits))
+        return INDEX_NONE;
+    return Last->FrameIndex;
+}
+
+void FCaptureIndex::Commit(const FMLCapturedFrame& Frame, bool bHasPerceptualHash, uint64 PerceptualHash, int64 NearDuplicateOf)
+{
+    FMLCaptureIndexEntry Entry;
+    Entry.PoseHash = HashPose(Frame.CameraPose, Frame.FOVAngle);
+    Entry.SceneHash = Frame.SceneStateHash;
+    Entry.ViewKey = MakeViewKey(Frame.CameraIndex, Frame.BufferType, Entry.PoseHash, Entry.SceneHash);
+    Entry.PerceptualHash = bHasPerceptualHash ? PerceptualHash : 0;
+    Entry.FrameIndex = Frame.FrameIndex;
+    Entry.NearDuplicateOf = NearDuplicateOf;
+    Entry.CameraIndex = Frame.CameraIndex;
+    Entry.BufferType = static_cast<uint8>(Frame.BufferType);
+    Entry.Flags = bHasPerceptualHash ? EMLCaptureIndexFlags::HasPerceptualHash : EMLCaptureIndexFlags::None;
+    Entry.Crc = FCrc::MemCrc32(&Entry, STRUCT_OFFSET(FMLCaptureIndexEntry, Crc));
+
+    FWriteScopeLock WriteLock(Lock);
+    if (!File)
+        return;
+
+    File->Write(reinterpret_cast<const uint8*>(&Entry), sizeof(Entry));
+    if (++UnflushedEntries >= FlushInterval)
+    {
+        File->Flush();
+        UnflushedEntries = 0;
+    }
+
+    AddEntryLocked(Entry);
+    ++Stats.EntriesCommitted;
+    if (NearDuplicateOf != INDEX_NONE)
+    {
+        ++Stats.NearDuplicates;
+    }
+}
+
+void FCaptureIndex::AddRecoveredRecords(TConstArrayView<FMLShardIndexRecord> Records)
+{
+    FWriteScopeLock WriteLock(Lock);
+    CommittedFrames.Reserve(CommittedFrames.Num() + Records.Num());
+    for (const FMLShardIndexRecord& Record : Records)
+    {
+        CommittedFrames.Add(MakeFrameKey(Record.FrameIndex, Record.CameraIndex, static_cast<EMLBufferType>(Record.BufferType)));
+        Stats.ResumeFrame = FMath::Max(Stats.ResumeFrame, Record.FrameIndex);
+    }
+}
+
+void FCaptureIndex::AddEntryLocked(const FMLCaptureIndexEntry& Entry)
+{
+    const EMLBufferType BufferType = static_cast<EMLBufferType>(Entry.BufferType);
+
+    // The first frame of a view is the one later duplicates point at
+    FrameByView.FindOrAdd(Entry.ViewKey, Entry.FrameIndex);
+    CommittedFrames.Add(MakeFrameKey(Entry.FrameIndex, Entry.CameraIndex, BufferType));
+
+    if (Entry.Flags & EMLCaptureIndexFlags::HasPerceptualHash)
+    {
+        FLastHash& Last = LastHashByCapture.FindOrAdd(MLCapture::MakeCaptureKey(Entry.CameraIndex, BufferType));
+        Last.Hash = Entry.PerceptualHash;
+        Last.FrameIndex = Entry.FrameIndex;
+    }
+}
+
+FMLCaptureIndexStats FCaptureIndex::GetStats() const
+{
+    FReadScopeLock ReadLock(Lock);
+    return Stats;
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MLCaptureTypes.h"
+#include "CaptureIndex.generated.h"
+
+class IFileHandle;
+struct FMLShardIndexRecord;
+
+// On-disk layout of capture_index.bin, kept next to the shards. Append-only: Header followed by fixed-size
+// entries, each sealed with a CRC so a tail torn by a crash is detected and cut off on reopen.
+#pragma pack(push, 1)
+struct FMLCaptureIndexHeader
+{
+    uint32 Magic = 0x58434C4D; // "MLCX"
+    uint16 Version = 1;
+    uint16 EntrySize = 0;
+    // Quantization the pose and scene hashes were taken with; a reopened index keeps its own
+    float PositionQuantum = 1.0f;
+    float RotationQuantumDegrees = 0.1f;
+    uint8 Reserved[16] = {};
+};
+
+struct FMLCaptureIndexEntry
+{
+    // Camera, buffer type, quantized pose and scene state: captures with equal keys render the same image
+    uint64 ViewKey = 0;
+    uint64 PoseHash = 0;
+    uint64 SceneHash = 0;
+    // 64-bit difference hash of the pixels; only meaningful with EMLCaptureIndexFlags::HasPerceptualHash
+    uint64 PerceptualHash = 0;
+    int64 FrameIndex = 0;
+    // Earlier frame of the same capture whose perceptual hash is within NearDuplicateBits; INDEX_NONE if none
+    int64 NearDuplicateOf = INDEX_NONE;
+    int32 CameraIndex = 0;
+    uint8 BufferType = 0;
+    uint8 Flags = 0;           // EMLCaptureIndexFlags
+    uint8 Reserved[6] = {};
+    // FCrc::MemCrc32 of every byte before it
+    uint32 Crc = 0;
+};
+#pragma pack(pop)
+
+namespace EMLCaptureIndexFlags
+{
+    enum : uint8
+    {
+        None = 0,
+        HasPerceptualHash = 1 << 0,
+    };
+}
+
+static_assert(sizeof(FMLCaptureIndexHeader) == 32, "Capture index header layout is part of the file format");
+static_assert(sizeof(FMLCaptureIndexEntry) == 64, "Capture index entry layout is part of the file format");
+
+USTRUCT(BlueprintType)
+struct CAMERATESTER_API FMLCaptureIndexStats
+{
+    GENERATED_BODY()
+
+    // Entries found on disk when the index was opened
+    UPROPERTY(BlueprintReadOnly, Category = "Deduplication")
+    int64 EntriesLoaded = 0;
+
+    // Entries appended since
+    UPROPERTY(BlueprintReadOnly, Category = "Deduplication")
+    int64 EntriesCommitted = 0;
+
+    // Bytes cut from a torn tail on open
+    UPROPERTY(BlueprintReadOnly, Category = "Deduplication")
+    int64 BytesDiscarded = 0;
+
+    // Last frame committed before this session; the run resumes after it
+    UPROPERTY(BlueprintReadOnly, Category = "Deduplication")
+    int64 ResumeFrame = INDEX_NONE;
+
+    // Captures not rendered because that frame was already in the dataset
+    UPROPERTY(BlueprintReadOnly, Category = "Deduplication")
+    int64 CapturesResumed = 0;
+
+    // Captures not rendered because an identical view was already in the dataset
+    UPROPERTY(BlueprintReadOnly, Category = "Deduplication")
+    int64 CapturesDeduplicated = 0;
+
+    // Frames written but flagged EMLShardRecordFlags::NearDuplicate
+    UPROPERTY(BlueprintReadOnly, Category = "Deduplication")
+    int64 NearDuplicates = 0;
+};
+
+// Persistent record of every frame committed to a dataset, keyed by what the capture saw. Opening maps the
+// existing file and rebuilds the lookups from it; commits append one entry each. Lookups run on the game
+// thread while the dataset writer's workers commit, so every access takes the lock.
+class CAMERATESTER_API FCaptureIndex
+{
+public:
+    struct FSettings
+    {
+        // Absolute path of capture_index.bin
+        FString Path;
+        // Pose quantization: views closer than this count as the same view
+        float PositionQuantum = 1.0f;
+        float RotationQuantumDegrees = 0.1f;
+        // Hamming distance between perceptual hashes at or below which a frame is a near-duplicate; negative disables
+        int32 NearDuplicateBits = 3;
+    };
+
+    explicit FCaptureIndex(const FSettings& InSettings);
+    ~FCaptureIndex();
+
+    // Loads the existing entries and opens the file for appending; false if it cannot be written
+    bool Open();
+    void Close();
+
+    bool IsOpen() const { return File.IsValid(); }
+
+    // Position and rotation quantized with the index's quanta, plus FOV; stable across runs
+    uint64 HashPose(const FTransform& Pose, float FOVAngle) const;
+    static uint64 HashTransform(const FTransform& Transform, float PositionQuantum, float RotationQuantumDegrees);
+    static uint64 MakeViewKey(int32 CameraIndex, EMLBufferType BufferType, uint64 PoseHash, uint64 SceneHash);
+
+    // 64-bit difference hash of a raw frame over a 9x8 grid of cell averages (luminance for colour formats,
+    // the first channel otherwise); false for encoded or pixel-less frames
+    static bool ComputePerceptualHash(const FMLCapturedFrame& Frame, uint64& OutHash);
+
+    // Frame an identical view was committed at, or INDEX_NONE
+    int64 FindView(uint64 ViewKey) const;
+    bool IsCommitted(int64 FrameIndex, int32 CameraIndex, EMLBufferType BufferType) const;
+
+    // Last frame found in the index or the recovered shards; captures up to it may already be in the dataset
+    int64 GetResumeFrame() const;
+
+    // Writer workers. Earlier frame of the same capture whose pixels hash within NearDuplicateBits, or INDEX_NONE.
+    int64 FindNearDuplicate(int32 CameraIndex, EMLBufferType BufferType, uint64 PerceptualHash) const;
+
+    // Writer workers, once the frame's shard record is written
+    void Commit(const FMLCapturedFrame& Frame, bool bHasPerceptualHash, uint64 PerceptualHash, int64 NearDuplicateOf);
+
+    // Records recovered from the shards of an interrupted run; they count as committed even without an entry
+    void AddRecoveredRecords(TConstArrayView<FMLShardIndexRecord> Records);
+
+    // Game thread counters
+    void CountResumed() { ++Stats.CapturesResumed; }
+    void CountDeduplicated() { ++Stats.CapturesDeduplicated; }
+
+    FMLCaptureIndexStats GetStats() const;
+
+private:
+    struct FLastHash
+    {
+        uint64 Hash = 0;
+        int64 FrameIndex = INDEX_NONE;
+    };
+
+    static uint64 MakeFrameKey(int64 FrameIndex, int32 CameraIndex, EMLBufferType BufferType);
+    int64 LoadEntries();
+    void AddEntryLocked(const FMLCaptureIndexEntry& Entry);
+
+    FSettings Settings;
+    FMLCaptureIndexHeader Header;
+    TUniquePtr<IFileHandle> File;
+
+    mutable FRWLock Lock;
+    TMap<uint64, int64> FrameByView;
+    TSet<uint64> CommittedFrames;
+    TMap<uint32, FLastHash> LastHashByCapture;
+    int64 UnflushedEntries = 0;
+    FMLCaptureIndexStats Stats;
+};
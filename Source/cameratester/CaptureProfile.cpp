@@ -0,0 +1,142 @@
+#include "CaptureProfile.h"
+#include "MLCaptureStats.h"
+#include "ShowFlags.h"
+
+namespace
+{
+    // Lighting and its inputs; geometry buffers are written by the base pass before any of this runs
+    const TCHAR* const LightingFlags[] =
+    {
+        TEXT("DynamicShadows"), TEXT("ContactShadows"), TEXT("CapsuleShadows"), TEXT("RayTracedDistanceFieldShadows"),
+        TEXT("GlobalIllumination"), TEXT("LumenGlobalIllumination"), TEXT("LumenReflections"),
+        TEXT("ReflectionEnvironment"), TEXT("ScreenSpaceReflections"), TEXT("SkyLighting"),
+        TEXT("AmbientOcclusion"), TEXT("ScreenSpaceAO"), TEXT("DistanceFieldAO"),
+        TEXT("Fog"), TEXT("VolumetricFog"), TEXT("Atmosphere"), TEXT("Cloud"), TEXT("LightShafts"),
+        TEXT("SubsurfaceScattering"),
+    };
+
+    // Image-space effects with no meaning for data buffers
+    const TCHAR* const PostProcessFlags[] =
+    {
+        TEXT("Bloom"), TEXT("MotionBlur"), TEXT("EyeAdaptation"), TEXT("LensFlares"), TEXT("DepthOfField"),
+        TEXT("AntiAliasing"), TEXT("TemporalAA"), TEXT("Vignette"), TEXT("Grain"), TEXT("SceneColorFringe"),
+        TEXT("ColorGrading"),
+    };
+
+    // Translucent surfaces write neither depth nor GBuffer normals
+    const TCHAR* const TranslucencyFlags[] =
+    {
+        TEXT("Translucency"), TEXT("Particles"), TEXT("Niagara"), TEXT("Refraction"),
+    };
+
+    template <int32 N>
+    void Disable(FMLCaptureProfile& Profile, const TCHAR* const (&Flags)[N])
+    {
+        for (const TCHAR* Flag : Flags)
+        {
+            FEngineShowFlagsSetting& Setting = Profile.ShowFlagSettings.AddDefaulted_GetRef();
+            Setting.ShowFlagName = Flag;
+            Setting.Enabled = false;
+        }
+    }
+}
+
+namespace MLCaptureProfile
+{
+    FMLCaptureProfile MakeDefault(EMLBufferType BufferType)
+    {
+        FMLCaptureProfile Profile;
+        switch (BufferType)
+        {
+        case EMLBufferType::RGB:
+            // 10x the depth range is the old fixed 1 km at the default MaxDepthDistance
+            Profile.ViewDistanceScale = 10.0f;
+            break;
+
+        case EMLBufferType::SceneDepth:
+            Disable(Profile, LightingFlags);
+            Disable(Profile, PostProcessFlags);
+            Disable(Profile, TranslucencyFlags);
+            Disable(Profile, { TEXT("Decals"), TEXT("PostProcessing") });
+            break;
+
+        case EMLBufferType::MLDepth:
+            // Written through a post-process material, so post-processing itself stays on.
+            // 8/16-bit quantization hides the error of coarser LODs.
+            Disable(Profile, LightingFlags);
+            Disable(Profile, PostProcessFlags);
+            Disable(Profile, TranslucencyFlags);
+            Disable(Profile, { TEXT("Decals") });
+            Profile.LODDistanceFactor = 2.0f;
+            break;
+
+        case EMLBufferType::Normal:
+            // DBuffer decals modify GBuffer normals, so they stay on
+            Disable(Profile, LightingFlags);
+            Disable(Profile, PostProcessFlags);
+            Disable(Profile, TranslucencyFlags);
+            Disable(Profile, { TEXT("PostProcessing") });
+            break;
+
+        case EMLBufferType::Segmentation:
+            // Stencil IDs come out of a post-process material; anti-aliasing would blend neighbouring IDs into false ones
+            Disable(Profile, LightingFlags);
+            Disable(Profile, PostProcessFlags);
+            Disable(Profile, TranslucencyFlags);
+            Disable(Profile, { TEXT("Decals") });
+            break;
+
+        default:
+            break;
+        }
+        return Profile;
+    }
+
+    void Apply(const FMLCaptureProfile& Profile, USceneCaptureComponent2D* SceneCapture, float MaxDepthDistance)
+    {
+        if (!IsValid(SceneCapture))
+            return;
+
+        for (const FEngineShowFlagsSetting& Setting : Profile.ShowFlagSettings)
+        {
+            const int32 FlagIndex = FEngineShowFlags::FindIndexByName(*Setting.ShowFlagName);
+            if (FlagIndex == INDEX_NONE)
+            {
+                UE_LOG(LogMLCapture, Warning, TEXT("Capture profile: unknown show flag '%s'"), *Setting.ShowFlagName);
+                continue;
+            }
+            SceneCapture->ShowFlags.SetSingleFlag(FlagIndex, Setting.Enabled);
+        }
+
+        if (Profile.bOverridePostProcess)
+        {
+            SceneCapture->PostProcessSettings = Profile.PostProcessSettings;
+            SceneCapture->PostProcessBlendWeight = Profile.PostProcessBlendWeight;
+        }
+
+        // Negative disables the override
+        SceneCapture->MaxViewDistanceOverride = Profile.ViewDistanceScale > 0.0f ? MaxDepthDistance * Profile.ViewDistanceScale : -1.0f;
+        SceneCapture->LODDistanceFactor = Profile.LODDistanceFactor;
+
+        for (AActor* Actor : Profile.HiddenActors)
+        {
+            if (IsValid(Actor))
+            {
+                SceneCapture->HiddenActors.AddUnique(Actor);
+            }
+        }
+
+        if (Profile.ShowOnlyActors.Num() > 0)
+        {
+            SceneCapture->PrimitiveRenderMode = ESceneCapturePrimitiveRenderMode::PRM_UseShowOnlyList;
+            SceneCapture->ShowOnlyActors.Reset();
+            for (AActor* Actor : Profile.ShowOnlyActors)
+            {
+                if (IsValid(Actor))
+                {
+                    SceneCapture->ShowOnlyActors.Add(Actor);
+                }
+            }
+        }
+    }
+}
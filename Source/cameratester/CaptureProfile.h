@@ -0,0 +1,51 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/Scene.h"
+#include "MLCaptureTypes.h"
+#include "CaptureProfile.generated.h"
+
+// Rendering features a scene capture pays for, chosen per buffer type. Depth and normal passes only need
+// geometry, so their defaults strip lighting, shadows, GI, reflections, fog, translucency and post-processing.
+USTRUCT(BlueprintType)
+struct CAMERATESTER_API FMLCaptureProfile
+{
+    GENERATED_BODY()
+
+    // Show flags forced on or off by name ("DynamicShadows", "LumenGlobalIllumination", ...); others keep their defaults
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Capture Profile")
+    TArray<FEngineShowFlagsSetting> ShowFlagSettings;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Capture Profile")
+    bool bOverridePostProcess = false;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Capture Profile", meta = (EditCondition = "bOverridePostProcess"))
+    FPostProcessSettings PostProcessSettings;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Capture Profile", meta = (ClampMin = "0", ClampMax = "1", EditCondition = "bOverridePostProcess"))
+    float PostProcessBlendWeight = 1.0f;
+
+    // Primitives beyond MaxDepthDistance * ViewDistanceScale are culled; 0 = no limit
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Capture Profile", meta = (ClampMin = "0"))
+    float ViewDistanceScale = 1.0f;
+
+    // Above 1 selects coarser LODs sooner
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Capture Profile", meta = (ClampMin = "0.1"))
+    float LODDistanceFactor = 1.0f;
+
+    // Added to the capture's own hidden list
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Capture Profile")
+    TArray<AActor*> HiddenActors;
+
+    // When set, the capture renders only these actors
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Capture Profile")
+    TArray<AActor*> ShowOnlyActors;
+};
+
+namespace MLCaptureProfile
+{
+    // Shipped defaults: RGB renders everything, the geometry buffers skip whatever does not affect them
+    CAMERATESTER_API FMLCaptureProfile MakeDefault(EMLBufferType BufferType);
+
+    CAMERATESTER_API void Apply(const FMLCaptureProfile& Profile, USceneCaptureComponent2D* SceneCapture, float MaxDepthDistance);
+}
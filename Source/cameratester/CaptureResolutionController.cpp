@@ -0,0 +1,199 @@
+#include "CaptureResolutionController.h"
+#include "RHI.h"
+
+void FCaptureResolutionController::Configure(const FSettings& InSettings)
+{
+    Settings = InSettings;
+    Settings.TargetFrameMs = FMath::Max(Settings.TargetFrameMs, 1.0f);
+    Settings.AdjustIntervalFrames = FMath::Max(Settings.AdjustIntervalFrames, 1);
+    Settings.TierScales.RemoveAll([](float Scale) { return Scale <= 0.0f; });
+    if (Settings.TierScales.Num() == 0)
+    {
+        Settings.TierScales.Add(1.0f);
+    }
+    Settings.TierScales.Sort(TGreater<float>());
+
+    for (FEntry& Entry : Entries)
+    {
+        ApplyRange(Entry);
+    }
+    UpdateStats();
+}
+
+void FCaptureResolutionController::Rebuild(const TArray<FMLCaptureBinding>& Bindings)
+{
+    TMap<uint32, FEntry> Previous;
+    Previous.Reserve(Entries.Num());
+    for (const FEntry& Entry : Entries)
+    {
+        Previous.Add(Entry.Key, Entry);
+    }
+
+    Entries.Reset(Bindings.Num());
+    for (const FMLCaptureBinding& Binding : Bindings)
+    {
+        const uint32 Key = MLCapture::MakeCaptureKey(Binding.CameraIndex, Binding.BufferType);
+
+        FEntry Entry;
+        const FEntry* Existing = Previous.Find(Key);
+        Entry.Key = Key;
+        ApplyRange(Entry);
+        // New captures start at their maximum; the controller degrades them if the budget says so
+        Entry.Tier = Existing ? FMath::Clamp(Existing->Tier, Entry.MaxTier, Entry.MinTier) : Entry.MaxTier;
+        Entries.Add(Entry);
+    }
+    UpdateStats();
+}
+
+int32 FCaptureResolutionController::FindTier(float Scale, bool bRoundUp) const
+{
+    // Tiers are sorted largest first
+    const TArray<float>& Tiers = Settings.TierScales;
+    if (bRoundUp)
+    {
+        // Smallest tier still at or above Scale
+        for (int32 Tier = Tiers.Num() - 1; Tier >= 0; --Tier)
+        {
+            if (Tiers[Tier] >= Scale - UE_KINDA_SMALL_NUMBER)
+                return Tier;
+        }
+        return 0;
+    }
+
+    // Largest tier not above Scale
+    for (int32 Tier = 0; Tier < Tiers.Num(); ++Tier)
+    {
+        if (Tiers[Tier] <= Scale + UE_KINDA_SMALL_NUMBER)
+            return Tier;
+    }
+    return Tiers.Num() - 1;
+}
+
+void FCaptureResolutionController::ApplyRange(FEntry& Entry) const
+{
+    const int32 CameraIndex = static_cast<int32>(Entry.Key >> 8);
+    const EMLBufferType BufferType = static_cast<EMLBufferType>(Entry.Key & 0xFF);
+
+    float MinScale = Settings.DefaultMinScale;
+    float MaxScale = Settings.DefaultMaxScale;
+    int32 Priority = 0;
+
+    // Camera-specific overrides win over the all-camera ones
+    const FMLCaptureResolutionOverride* Best = nullptr;
+    for (const FMLCaptureResolutionOverride& Override : Settings.Overrides)
+    {
+        if (Override.BufferType != BufferType)
+            continue;
+        if (Override.CameraIndex == CameraIndex || (Override.CameraIndex < 0 && !Best))
+        {
+            Best = &Override;
+        }
+    }
+    if (Best)
+    {
+        MinScale = Best->MinResolutionScale;
+        MaxScale = Best->MaxResolutionScale;
+        Priority = Best->Priority;
+    }
+
+    Entry.Priority = Priority;
+    Entry.MaxTier = FindTier(MaxScale, false);
+    Entry.MinTier = FMath::Max(FindTier(MinScale, true), Entry.MaxTier);
+    Entry.Tier = FMath::Clamp(Entry.Tier, Entry.MaxTier, Entry.MinTier);
+}
+
+void FCaptureResolutionController::Update(TArray<FTierChange>& OutChanges)
+{
+    OutChanges.Reset();
+
+    const float GpuMs = static_cast<float>(FPlatformTime::ToMilliseconds(RHIGetGPUFrameCycles()));
+    SmoothedGpuMs = SmoothedGpuMs > 0.0f ? FMath::Lerp(SmoothedGpuMs, GpuMs, 0.2f) : GpuMs;
+    Stats.GpuFrameMs = SmoothedGpuMs;
+
+    // Resizes take a few frames to show up in GPU time; wait for them before judging again
+    if (++FramesSinceAdjust < Settings.AdjustIntervalFrames || Entries.Num() == 0)
+        return;
+    FramesSinceAdjust = 0;
+
+    const float Load = SmoothedGpuMs / Settings.TargetFrameMs;
+    if (Load > 1.0f)
+    {
+        // Lowest priority first, then the largest captures, since they free the most pixels
+        OrderScratch.Reset();
+        for (int32 EntryIndex = 0; EntryIndex < Entries.Num(); ++EntryIndex)
+        {
+            if (!Entries[EntryIndex].bFixed && Entries[EntryIndex].Tier < Entries[EntryIndex].MinTier)
+            {
+                OrderScratch.Add(EntryIndex);
+            }
+        }
+        OrderScratch.Sort([this](int32 A, int32 B)
+        {
+            const FEntry& EntryA = Entries[A];
+            const FEntry& EntryB = Entries[B];
+            return EntryA.Priority != EntryB.Priority ? EntryA.Priority < EntryB.Priority : EntryA.Tier < EntryB.Tier;
+        });
+
+        // Drop more captures the further over budget we are
+        const int32 NumSteps = FMath::Min(OrderScratch.Num(), FMath::Max(1, FMath::CeilToInt(OrderScratch.Num() * (Load - 1.0f))));
+        for (int32 i = 0; i < NumSteps; ++i)
+        {
+            FEntry& Entry = Entries[OrderScratch[i]];
+            ++Entry.Tier;
+            OutChanges.Add({ OrderScratch[i], Entry.Tier });
+        }
+    }
+    else if (Load < Settings.Headroom)
+    {
+        // Probe upwards one capture at a time: highest priority, then the most degraded
+        int32 BestIndex = INDEX_NONE;
+        for (int32 EntryIndex = 0; EntryIndex < Entries.Num(); ++EntryIndex)
+        {
+            const FEntry& Entry = Entries[EntryIndex];
+            if (Entry.bFixed || Entry.Tier <= Entry.MaxTier)
+                continue;
+            if (BestIndex == INDEX_NONE || Entry.Priority > Entries[BestIndex].Priority
+                || (Entry.Priority == Entries[BestIndex].Priority && Entry.Tier > Entries[BestIndex].Tier))
+            {
+                BestIndex = EntryIndex;
+            }
+        }
+        if (BestIndex != INDEX_NONE)
+        {
+            FEntry& Entry = Entries[BestIndex];
+            --Entry.Tier;
+            OutChanges.Add({ BestIndex, Entry.Tier });
+        }
+    }
+
+    Stats.TierChanges += OutChanges.Num();
+    if (OutChanges.Num() > 0)
+    {
+        UpdateStats();
+    }
+}
+
+void FCaptureResolutionController::SetFixed(int32 BindingIndex)
+{
+    if (Entries.IsValidIndex(BindingIndex))
+    {
+        Entries[BindingIndex].bFixed = true;
+        UpdateStats();
+    }
+}
+
+void FCaptureResolutionController::UpdateStats()
+{
+    double Pixels = 0.0;
+    double MaxPixels = 0.0;
+    Stats.NumDegraded = 0;
+    for (const FEntry& Entry : Entries)
+    {
+        if (Entry.bFixed)
+            continue;
+        Pixels += FMath::Square(GetTierScale(Entry.Tier));
+        MaxPixels += FMath::Square(GetTierScale(Entry.MaxTier));
+        Stats.NumDegraded += Entry.Tier > Entry.MaxTier ? 1 : 0;
+    }
+    Stats.PixelFraction = MaxPixels > 0.0 ? static_cast<float>(Pixels / MaxPixels) : 1.0f;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MLCaptureTypes.h"
+#include "CaptureResolutionController.generated.h"
+
+// Per camera/buffer resolution range and priority, as scales of the manager's RenderTargetWidth/Height.
+// CameraIndex -1 applies to every camera.
+USTRUCT(BlueprintType)
+struct CAMERATESTER_API FMLCaptureResolutionOverride
+{
+    GENERATED_BODY()
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Adaptive Resolution")
+    int32 CameraIndex = -1;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Adaptive Resolution")
+    EMLBufferType BufferType = EMLBufferType::RGB;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Adaptive Resolution", meta = (ClampMin = "0.05"))
+    float MinResolutionScale = 0.25f;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Adaptive Resolution", meta = (ClampMin = "0.05"))
+    float MaxResolutionScale = 1.0f;
+
+    // Lower priorities lose resolution first and regain it last
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Adaptive Resolution")
+    int32 Priority = 0;
+};
+
+USTRUCT(BlueprintType)
+struct CAMERATESTER_API FMLResolutionControllerStats
+{
+    GENERATED_BODY()
+
+    // Smoothed GPU frame time the controller steers by
+    UPROPERTY(BlueprintReadOnly, Category = "Adaptive Resolution")
+    float GpuFrameMs = 0.0f;
+
+    // Captures currently below their maximum tier
+    UPROPERTY(BlueprintReadOnly, Category = "Adaptive Resolution")
+    int32 NumDegraded = 0;
+
+    // Captured pixels over the pixels at every capture's maximum tier
+    UPROPERTY(BlueprintReadOnly, Category = "Adaptive Resolution")
+    float PixelFraction = 1.0f;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Adaptive Resolution")
+    int64 TierChanges = 0;
+};
+
+// Steps capture resolutions through a fixed ladder of size tiers so GPU frame time stays under a target.
+// Over budget, the lowest-priority captures drop a tier first (several per step when far over); with
+// headroom, the highest-priority degraded capture climbs back one tier at a time.
+class CAMERATESTER_API FCaptureResolutionController
+{
+public:
+    struct FSettings
+    {
+        float TargetFrameMs = 16.6f;
+        // Only climb back while below this fraction of the target
+        float Headroom = 0.85f;
+        int32 AdjustIntervalFrames = 15;
+        // Descending scales; every render target size is BaseSize * one of these
+        TArray<float> TierScales = { 1.0f, 0.75f, 0.5f, 0.375f, 0.25f };
+        float DefaultMinScale = 0.25f;
+        float DefaultMaxScale = 1.0f;
+        TArray<FMLCaptureResolutionOverride> Overrides;
+    };
+
+    struct FTierChange
+    {
+        int32 BindingIndex = INDEX_NONE;
+        int32 Tier = 0;
+    };
+
+    void Configure(const FSettings& InSettings);
+
+    // Rebuild per-binding state; current tiers are kept for bindings that still exist
+    void Rebuild(const TArray<FMLCaptureBinding>& Bindings);
+
+    // Once per frame; fills OutChanges with bindings that must switch tier now
+    void Update(TArray<FTierChange>& OutChanges);
+
+    int32 GetTier(int32 BindingIndex) const { return Entries.IsValidIndex(BindingIndex) ? Entries[BindingIndex].Tier : 0; }
+    int32 GetMaxTier(int32 BindingIndex) const { return Entries.IsValidIndex(BindingIndex) ? Entries[BindingIndex].MaxTier : 0; }
+    int32 GetMinTier(int32 BindingIndex) const { return Entries.IsValidIndex(BindingIndex) ? Entries[BindingIndex].MinTier : 0; }
+    float GetTierScale(int32 Tier) const { return Settings.TierScales.IsValidIndex(Tier) ? Settings.TierScales[Tier] : 1.0f; }
+    int32 NumTiers() const { return Settings.TierScales.Num(); }
+
+    // Largest size any capture can reach
+    float GetLargestScale() const { return Settings.TierScales.Num() > 0 ? Settings.TierScales[0] : 1.0f; }
+
+    // Exclude a binding whose target cannot be swapped (atlas tiles, persistent assets)
+    void SetFixed(int32 BindingIndex);
+
+    const FMLResolutionControllerStats& GetStats() const { return Stats; }
+
+private:
+    struct FEntry
+    {
+        uint32 Key = 0;
+        int32 Priority = 0;
+        // Tier indices: MaxTier is the largest allowed size, MinTier the smallest (MaxTier <= Tier <= MinTier)
+        int32 MaxTier = 0;
+        int32 MinTier = 0;
+        int32 Tier = 0;
+        bool bFixed = false;
+    };
+
+    void ApplyRange(FEntry& Entry) const;
+    int32 FindTier(float Scale, bool bRoundUp) const;
+    void UpdateStats();
+
+    FSettings Settings;
+    TArray<FEntry> Entries;
+    TArray<int32> OrderScratch;
+    float SmoothedGpuMs = 0.0f;
+    int32 FramesSinceAdjust = 0;
+    FMLResolutionControllerStats Stats;
+};
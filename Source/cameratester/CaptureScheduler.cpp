@@ -0,0 +1,193 @@
+#include "CaptureScheduler.h"
+#include "MLCaptureStats.h"
+#include "RHI.h"
+
+void FCaptureScheduler::Configure(const FSettings& InSettings)
+{
+    Settings = InSettings;
+    Settings.MaxCapturesPerFrame = FMath::Max(1, Settings.MaxCapturesPerFrame);
+    CaptureLimit = Settings.MaxCapturesPerFrame;
+
+    for (FEntry& Entry : Entries)
+    {
+        ApplyRate(Entry);
+    }
+}
+
+void FCaptureScheduler::Rebuild(const TArray<FMLCaptureBinding>& Bindings)
+{
+    TMap<uint32, FEntry> Previous;
+    Previous.Reserve(Entries.Num());
+    for (const FEntry& Entry : Entries)
+    {
+        Previous.Add(Entry.Key, Entry);
+    }
+
+    Entries.Reset(Bindings.Num());
+    for (int32 BindingIndex = 0; BindingIndex < Bindings.Num(); ++BindingIndex)
+    {
+        const FMLCaptureBinding& Binding = Bindings[BindingIndex];
+        const uint32 Key = MLCapture::MakeCaptureKey(Binding.CameraIndex, Binding.BufferType);
+
+        FEntry Entry;
+        if (const FEntry* Existing = Previous.Find(Key))
+        {
+            Entry = *Existing;
+        }
+        Entry.Key = Key;
+        Entry.BindingIndex = BindingIndex;
+        ApplyRate(Entry);
+        Entries.Add(Entry);
+    }
+}
+
+void FCaptureScheduler::ApplyRate(FEntry& Entry) const
+{
+    const int32 CameraIndex = static_cast<int32>(Entry.Key >> 8);
+    const EMLBufferType BufferType = static_cast<EMLBufferType>(Entry.Key & 0xFF);
+
+    float RateHz = Settings.DefaultTargetRateHz;
+    int32 Priority = 0;
+
+    // Camera-specific overrides win over the all-camera ones
+    const FMLCaptureRateOverride* Best = nullptr;
+    for (const FMLCaptureRateOverride& Override : Settings.Overrides)
+    {
+        if (Override.BufferType != BufferType)
+            continue;
+        if (Override.CameraIndex == CameraIndex || (Override.CameraIndex < 0 && !Best))
+        {
+            Best = &Override;
+        }
+    }
+    if (Best)
+    {
+        RateHz = Best->TargetRateHz;
+        Priority = Best->Priority;
+    }
+
+    Entry.Priority = Priority;
+    Entry.TargetPeriod = RateHz > 0.0f ? 1.0 / RateHz : 0.0;
+}
+
+void FCaptureScheduler::SetCaptureRate(int32 CameraIndex, EMLBufferType BufferType, float TargetRateHz, int32 Priority)
+{
+    FMLCaptureRateOverride* Existing = Settings.Overrides.FindByPredicate([&](const FMLCaptureRateOverride& Override)
+    {
+        return Override.CameraIndex == CameraIndex && Override.BufferType == BufferType;
+    });
+    if (!Existing)
+    {
+        Existing = &Settings.Overrides.AddDefaulted_GetRef();
+        Existing->CameraIndex = CameraIndex;
+        Existing->BufferType = BufferType;
+    }
+    Existing->TargetRateHz = TargetRateHz;
+    Existing->Priority = Priority;
+
+    for (FEntry& Entry : Entries)
+    {
+        ApplyRate(Entry);
+    }
+}
+
+void FCaptureScheduler::UpdateCaptureLimit()
+{
+    Stats.GpuFrameMs = static_cast<float>(FPlatformTime::ToMilliseconds(RHIGetGPUFrameCycles()));
+
+    if (Settings.BudgetMode == EMLCaptureBudgetMode::CaptureCount)
+    {
+        CaptureLimit = Settings.MaxCapturesPerFrame;
+        return;
+    }
+
+    // AIMD: back off quickly when over budget, probe upwards slowly when there is headroom
+    if (Stats.GpuFrameMs > Settings.GpuFrameBudgetMs)
+    {
+        CaptureLimit = FMath::Max(1, FMath::FloorToInt(CaptureLimit * 0.75f));
+    }
+    else if (Stats.GpuFrameMs < Settings.GpuFrameBudgetMs * 0.9f)
+    {
+        CaptureLimit = FMath::Min(Settings.MaxCapturesPerFrame, CaptureLimit + 1);
+    }
+}
+
+void FCaptureScheduler::SelectCaptures(double NowSeconds, float DeltaSeconds, TArray<int32>& OutBindingIndices)
+{
+    ML_CAPTURE_SCOPE(STAT_MLCapture_Schedule);
+
+    OutBindingIndices.Reset();
+    UpdateCaptureLimit();
+
+    const double FrameTime = FMath::Max(static_cast<double>(DeltaSeconds), 1.0e-4);
+
+    DueScratch.Reset();
+    for (int32 EntryIndex = 0; EntryIndex < Entries.Num(); ++EntryIndex)
+    {
+        const FEntry& Entry = Entries[EntryIndex];
+        const double Elapsed = Entry.LastCaptureTime < 0.0 ? TNumericLimits<float>::Max() : NowSeconds - Entry.LastCaptureTime;
+
+        // Allow half a frame of slack so a 30 Hz target on a 60 Hz tick doesn't slip to 20 Hz
+        if (Entry.TargetPeriod > 0.0 && Elapsed + FrameTime * 0.5 < Entry.TargetPeriod)
+            continue;
+
+        const double Staleness = Elapsed / FMath::Max(Entry.TargetPeriod, FrameTime);
+        const float Score = static_cast<float>(Entry.Priority * 1000.0 + FMath::Min(Staleness, 999.0));
+        DueScratch.Emplace(Score, EntryIndex);
+    }
+
+    DueScratch.Sort([](const TPair<float, int32>& A, const TPair<float, int32>& B)
+    {
+        return A.Key > B.Key;
+    });
+
+    const int32 NumToIssue = FMath::Min(CaptureLimit, DueScratch.Num());
+    for (int32 i = 0; i < NumToIssue; ++i)
+    {
+        FEntry& Entry = Entries[DueScratch[i].Value];
+        if (Entry.FirstCaptureTime < 0.0)
+        {
+            Entry.FirstCaptureTime = NowSeconds;
+        }
+        Entry.LastCaptureTime = NowSeconds;
+        ++Entry.CaptureCount;
+        OutBindingIndices.Add(Entry.BindingIndex);
+    }
+
+    // Report
+    const float InstantRate = static_cast<float>(NumToIssue / FrameTime);
+    SmoothedCapturesPerSecond = FMath::Lerp(SmoothedCapturesPerSecond, InstantRate, 0.1f);
+
+    float FulfilmentSum = 0.0f;
+    int32 FulfilmentCount = 0;
+    for (const FEntry& Entry : Entries)
+    {
+        if (Entry.TargetPeriod > 0.0 && Entry.FirstCaptureTime >= 0.0 && NowSeconds - Entry.FirstCaptureTime > Entry.TargetPeriod)
+        {
+            const double Achieved = Entry.CaptureCount / (NowSeconds - Entry.FirstCaptureTime);
+            FulfilmentSum += static_cast<float>(FMath::Min(Achieved * Entry.TargetPeriod, 1.0));
+            ++FulfilmentCount;
+        }
+    }
+
+    Stats.CapturesIssued = NumToIssue;
+    Stats.CapturesDue = DueScratch.Num();
+    Stats.CapturesDeferred = DueScratch.Num() - NumToIssue;
+    Stats.CaptureLimit = CaptureLimit;
+    Stats.CapturesPerSecond = SmoothedCapturesPerSecond;
+    Stats.TargetRateFulfilment = FulfilmentCount > 0 ? FulfilmentSum / FulfilmentCount : 1.0f;
+    Stats.TotalCaptures += NumToIssue;
+}
+
+float FCaptureScheduler::GetAchievedRate(int32 CameraIndex, EMLBufferType BufferType, double NowSeconds) const
+{
+    const uint32 Key = MLCapture::MakeCaptureKey(CameraIndex, BufferType);
+    for (const FEntry& Entry : Entries)
+    {
+        if (Entry.Key == Key && Entry.FirstCaptureTime >= 0.0 && NowSeconds > Entry.FirstCaptureTime)
+        {
+            return static_cast<float>(Entry.CaptureCount / (NowSeconds - Entry.FirstCaptureTime));
+        }
+    }
+    return 0.0f;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MLCaptureTypes.h"
+#include "CaptureScheduler.generated.h"
+
+UENUM(BlueprintType)
+enum class EMLCaptureBudgetMode : uint8
+{
+    // Issue at most MaxCapturesPerFrame captures each frame
+    CaptureCount,
+    // Adapt the per-frame capture count so GPU frame time stays under GpuFrameBudgetMs
+    GpuTime
+};
+
+// Per camera/buffer rate and priority. CameraIndex -1 applies to every camera.
+USTRUCT(BlueprintType)
+struct CAMERATESTER_API FMLCaptureRateOverride
+{
+    GENERATED_BODY()
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Scheduler")
+    int32 CameraIndex = -1;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Scheduler")
+    EMLBufferType BufferType = EMLBufferType::RGB;
+
+    // 0 = as often as the budget allows
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Scheduler", meta = (ClampMin = "0"))
+    float TargetRateHz = 0.0f;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Scheduler")
+    int32 Priority = 0;
+};
+
+// What the scheduler actually achieved, refreshed every frame
+USTRUCT(BlueprintType)
+struct CAMERATESTER_API FMLCaptureSchedulerStats
+{
+    GENERATED_BODY()
+
+    UPROPERTY(BlueprintReadOnly, Category = "Scheduler")
+    int32 CapturesIssued = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Scheduler")
+    int32 CapturesDue = 0;
+
+    // Due this frame but pushed back by the budget
+    UPROPERTY(BlueprintReadOnly, Category = "Scheduler")
+    int32 CapturesDeferred = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Scheduler")
+    int32 CaptureLimit = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Scheduler")
+    float CapturesPerSecond = 0.0f;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Scheduler")
+    float GpuFrameMs = 0.0f;
+
+    // Mean of achieved / target rate over captures that have a target rate
+    UPROPERTY(BlueprintReadOnly, Category = "Scheduler")
+    float TargetRateFulfilment = 1.0f;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Scheduler")
+    int64 TotalCaptures = 0;
+};
+
+// Prioritized round-robin over capture bindings under a per-frame budget.
+// Entries that miss a frame accumulate staleness, so equal-priority captures rotate fairly.
+class CAMERATESTER_API FCaptureScheduler
+{
+public:
+    struct FSettings
+    {
+        EMLCaptureBudgetMode BudgetMode = EMLCaptureBudgetMode::CaptureCount;
+        int32 MaxCapturesPerFrame = 16;
+        float GpuFrameBudgetMs = 16.0f;
+        float DefaultTargetRateHz = 0.0f;
+        TArray<FMLCaptureRateOverride> Overrides;
+    };
+
+    void Configure(const FSettings& InSettings);
+
+    // Rebuild the entry list; per-binding history is kept for bindings that still exist
+    void Rebuild(const TArray<FMLCaptureBinding>& Bindings);
+
+    // Pick the bindings to capture this frame (indices into the array given to Rebuild)
+    void SelectCaptures(double NowSeconds, float DeltaSeconds, TArray<int32>& OutBindingIndices);
+
+    void SetCaptureRate(int32 CameraIndex, EMLBufferType BufferType, float TargetRateHz, int32 Priority);
+
+    float GetAchievedRate(int32 CameraIndex, EMLBufferType BufferType, double NowSeconds) const;
+
+    const FMLCaptureSchedulerStats& GetStats() const { return Stats; }
+    int32 Num() const { return Entries.Num(); }
+
+private:
+    struct FEntry
+    {
+        uint32 Key = 0;
+        int32 BindingIndex = INDEX_NONE;
+        int32 Priority = 0;
+        double TargetPeriod = 0.0;
+        double LastCaptureTime = -1.0;
+        double FirstCaptureTime = -1.0;
+        int64 CaptureCount = 0;
+    };
+
+    void ApplyRate(FEntry& Entry) const;
+    void UpdateCaptureLimit();
+
+    FSettings Settings;
+    TArray<FEntry> Entries;
+    TArray<TPair<float, int32>> DueScratch;
+
+    int32 CaptureLimit = 16;
+    float SmoothedCapturesPerSecond = 0.0f;
+    FMLCaptureSchedulerStats Stats;
+};
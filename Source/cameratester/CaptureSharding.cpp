@@ -0,0 +1,177 @@
+#include "CaptureSharding.h"
+#include "MLCaptureStats.h"
+#include "ShardCoordinator.h"
+#include "Engine/Engine.h"
+#include "Engine/GameInstance.h"
+#include "Engine/World.h"
+#include "Misc/CommandLine.h"
+
+bool FMLShardAssignment::Owns(int32 GlobalIndex, int32 Total) const
+{
+    if (!IsSharded())
+        return true;
+
+    if (Mode == EMLShardMode::Hash)
+    {
+        // Murmur3 finalizer; consecutive indices land on unrelated shards
+        uint32 Hash = static_cast<uint32>(GlobalIndex) * 0x9E3779B1u ^ static_cast<uint32>(Seed);
+        Hash ^= Hash >> 16;
+        Hash *= 0x85EBCA6Bu;
+        Hash ^= Hash >> 13;
+        Hash *= 0xC2B2AE35u;
+        Hash ^= Hash >> 16;
+        return static_cast<int32>(Hash % static_cast<uint32>(ShardCount)) == ShardIndex;
+    }
+
+    const int64 Begin = static_cast<int64>(Total) * ShardIndex / ShardCount;
+    const int64 End = static_cast<int64>(Total) * (ShardIndex + 1) / ShardCount;
+    return GlobalIndex >= Begin && GlobalIndex < End;
+}
+
+FString FMLShardAssignment::GetPartName() const
+{
+    return FString::Printf(TEXT("part_%02d"), ShardIndex);
+}
+
+FString FMLShardAssignment::ToString() const
+{
+    return FString::Printf(TEXT("shard %d/%d (%s, seed %d)"), ShardIndex, ShardCount,
+        *StaticEnum<EMLShardMode>()->GetNameStringByValue(static_cast<int64>(Mode)), Seed);
+}
+
+bool FMLShardAssignment::ParseCommandLine(const TCHAR* CommandLine, FMLShardAssignment& OutAssignment)
+{
+    FMLShardAssignment Assignment;
+    if (!FParse::Value(CommandLine, TEXT("MLShard="), Assignment.ShardIndex) || !FParse::Value(CommandLine, TEXT("MLShardCount="), Assignment.ShardCount))
+        return false;
+
+    FString ModeName;
+    if (FParse::Value(CommandLine, TEXT("MLShardMode="), ModeName))
+    {
+        const int64 ModeValue = StaticEnum<EMLShardMode>()->GetValueByNameString(ModeName);
+        if (ModeValue == INDEX_NONE)
+        {
+            UE_LOG(LogMLCapture, Error, TEXT("Unknown shard mode '%s' (use IndexRange or Hash)"), *ModeName);
+            return false;
+        }
+        Assignment.Mode = static_cast<EMLShardMode>(ModeValue);
+    }
+    FParse::Value(CommandLine, TEXT("MLShardSeed="), Assignment.Seed);
+
+    if (!Assignment.IsValid())
+    {
+        UE_LOG(LogMLCapture, Error, TEXT("Invalid shard %d of %d"), Assignment.ShardIndex, Assignment.ShardCount);
+        return false;
+    }
+
+    OutAssignment = Assignment;
+    return true;
+}
+
+bool UCaptureShardSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+    const TCHAR* CommandLine = FCommandLine::Get();
+    return (FCString::Stristr(CommandLine, TEXT("-MLCoordinator=")) || FCString::Stristr(CommandLine, TEXT("-MLShard=")))
+        && Super::ShouldCreateSubsystem(Outer);
+}
+
+void UCaptureShardSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+    Super::Initialize(Collection);
+
+    const TCHAR* CommandLine = FCommandLine::Get();
+    FString Address;
+    if (FParse::Value(CommandLine, TEXT("MLCoordinator="), Address))
+    {
+        double TimeoutSeconds = 30.0;
+        int32 PreferredShard = INDEX_NONE;
+        FParse::Value(CommandLine, TEXT("MLCoordinatorTimeout="), TimeoutSeconds);
+        FParse::Value(CommandLine, TEXT("MLShard="), PreferredShard);
+
+        Client = MakeUnique<FShardCoordinatorClient>();
+        bHasAssignment = Client->Connect(Address, PreferredShard, TimeoutSeconds, Assignment);
+        if (!bHasAssignment)
+        {
+            // Capturing the whole layout instead would duplicate another worker's cameras
+            UE_LOG(LogMLCapture, Error, TEXT("No shard from coordinator %s; exiting"), *Address);
+            Client.Reset();
+            FPlatformMisc::RequestExitWithStatus(false, 1);
+            return;
+        }
+
+        TickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &UCaptureShardSubsystem::TickProgress), 1.0f);
+    }
+    else
+    {
+        bHasAssignment = FMLShardAssignment::ParseCommandLine(CommandLine, Assignment);
+    }
+
+    Progress.ShardIndex = Assignment.ShardIndex;
+    UE_CLOG(bHasAssignment, LogMLCapture, Log, TEXT("Capturing %s"), *Assignment.ToString());
+}
+
+void UCaptureShardSubsystem::Deinitialize()
+{
+    FTSTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+    TickerHandle.Reset();
+
+    if (Client && bProgressDirty && !Progress.bDone)
+    {
+        Client->SendProgress(Progress, false);
+    }
+    Client.Reset();
+
+    Super::Deinitialize();
+}
+
+UCaptureShardSubsystem* UCaptureShardSubsystem::Get(const UObject* WorldContext)
+{
+    const UWorld* World = GEngine ? GEngine->GetWorldFromContextObject(WorldContext, EGetWorldErrorMode::ReturnNull) : nullptr;
+    const UGameInstance* GameInstance = World ? World->GetGameInstance() : nullptr;
+    UCaptureShardSubsystem* Subsystem = GameInstance ? GameInstance->GetSubsystem<UCaptureShardSubsystem>() : nullptr;
+    return Subsystem && Subsystem->bHasAssignment ? Subsystem : nullptr;
+}
+
+FMLShardAssignment UCaptureShardSubsystem::Resolve(const UObject* WorldContext, const FMLShardAssignment& Fallback)
+{
+    if (const UCaptureShardSubsystem* Subsystem = Get(WorldContext))
+        return Subsystem->Assignment;
+
+    return Fallback;
+}
+
+void UCaptureShardSubsystem::ReportProgress(int32 Cameras, int64 FramesCaptured, int64 RecordsWritten, int64 BytesWritten)
+{
+    if (Progress.bDone)
+        return;
+
+    Progress.Cameras = Cameras;
+    Progress.FramesCaptured = FramesCaptured;
+    Progress.RecordsWritten = RecordsWritten;
+    Progress.BytesWritten = BytesWritten;
+    bProgressDirty = true;
+}
+
+void UCaptureShardSubsystem::ReportDone(const FString& ManifestPath)
+{
+    if (Progress.bDone)
+        return;
+
+    Progress.Manifest = ManifestPath;
+    Progress.bDone = true;
+    if (Client)
+    {
+        Client->SendProgress(Progress, true);
+    }
+    UE_LOG(LogMLCapture, Log, TEXT("Shard %d done: %s"), Assignment.ShardIndex, *ManifestPath);
+}
+
+bool UCaptureShardSubsystem::TickProgress(float DeltaTime)
+{
+    if (Client && bProgressDirty && !Progress.bDone)
+    {
+        Client->SendProgress(Progress, false);
+        bProgressDirty = false;
+    }
+    return true;
+}
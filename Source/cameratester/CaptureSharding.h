@@ -0,0 +1,121 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "Containers/Ticker.h"
+#include "CaptureSharding.generated.h"
+
+class FShardCoordinatorClient;
+
+UENUM(BlueprintType)
+enum class EMLShardMode : uint8
+{
+    // Shard k spawns layout indices [Count * k / N, Count * (k + 1) / N); neighbouring cameras stay together
+    IndexRange,
+    // Layout index hashed with Seed; spreads dense and sparse parts of the layout evenly over the shards
+    Hash
+};
+
+// Which part of a camera layout one process captures. Every process generates the same full layout and keeps only
+// the indices it owns, so cameras keep their global index (and actor name) whichever process spawns them.
+USTRUCT(BlueprintType)
+struct CAMERATESTER_API FMLShardAssignment
+{
+    GENERATED_BODY()
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Sharding", meta = (ClampMin = "0"))
+    int32 ShardIndex = 0;
+
+    // 1 = unsharded
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Sharding", meta = (ClampMin = "1"))
+    int32 ShardCount = 1;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Sharding")
+    EMLShardMode Mode = EMLShardMode::IndexRange;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Sharding", meta = (EditCondition = "Mode == EMLShardMode::Hash"))
+    int32 Seed = 0;
+
+    bool IsSharded() const { return ShardCount > 1; }
+    bool IsValid() const { return ShardCount >= 1 && ShardIndex >= 0 && ShardIndex < ShardCount; }
+
+    // Whether layout index GlobalIndex of Total belongs to this shard
+    bool Owns(int32 GlobalIndex, int32 Total) const;
+
+    // Dataset subdirectory of this shard: "part_<k>"
+    FString GetPartName() const;
+
+    FString ToString() const;
+
+    // -MLShard=<k> -MLShardCount=<N> [-MLShardMode=IndexRange|Hash] [-MLShardSeed=<s>]
+    static bool ParseCommandLine(const TCHAR* CommandLine, FMLShardAssignment& OutAssignment);
+};
+
+// Per-shard figures reported to the coordinator
+USTRUCT()
+struct CAMERATESTER_API FMLShardProgress
+{
+    GENERATED_BODY()
+
+    UPROPERTY()
+    int32 ShardIndex = INDEX_NONE;
+
+    UPROPERTY()
+    int32 Cameras = 0;
+
+    UPROPERTY()
+    int64 FramesCaptured = 0;
+
+    UPROPERTY()
+    int64 RecordsWritten = 0;
+
+    UPROPERTY()
+    int64 BytesWritten = 0;
+
+    // Absolute path of the shard's manifest.json once its dataset is closed
+    UPROPERTY()
+    FString Manifest;
+
+    UPROPERTY()
+    bool bDone = false;
+};
+
+// The capture shard of this process. Resolved once per game instance from the command line: -MLCoordinator=<host:port>
+// asks a UCaptureCoordinatorCommandlet for a shard (blocking until it answers or MLCoordinatorTimeout= seconds pass),
+// otherwise -MLShard=/-MLShardCount= assign one directly. Not created when neither is given.
+UCLASS()
+class CAMERATESTER_API UCaptureShardSubsystem : public UGameInstanceSubsystem
+{
+    GENERATED_BODY()
+
+public:
+    virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+    virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+    virtual void Deinitialize() override;
+
+    // The process assignment when there is one, otherwise Fallback (a spawner's own setting)
+    static FMLShardAssignment Resolve(const UObject* WorldContext, const FMLShardAssignment& Fallback);
+
+    // Null when this process is not sharded
+    static UCaptureShardSubsystem* Get(const UObject* WorldContext);
+
+    const FMLShardAssignment& GetAssignment() const { return Assignment; }
+    bool HasAssignment() const { return bHasAssignment; }
+
+    // Latest figures; sent to the coordinator at most once per second
+    void ReportProgress(int32 Cameras, int64 FramesCaptured, int64 RecordsWritten, int64 BytesWritten);
+
+    // The shard's dataset is closed; sent immediately
+    void ReportDone(const FString& ManifestPath);
+
+private:
+    bool TickProgress(float DeltaTime);
+
+    FMLShardAssignment Assignment;
+    bool bHasAssignment = false;
+
+    FMLShardProgress Progress;
+    bool bProgressDirty = false;
+    TUniquePtr<FShardCoordinatorClient> Client;
+    FTSTicker::FDelegateHandle TickerHandle;
+};
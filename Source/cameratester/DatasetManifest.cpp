@@ -0,0 +1,221 @@
+#include "DatasetManifest.h"
+#include "MLCaptureStats.h"
+#include "Algo/Sort.h"
+#include "HAL/FileManager.h"
+#include "JsonObjectConverter.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+    template <typename StructType>
+    bool SaveJson(const StructType& Value, const FString& Path)
+    {
+        FString Json;
+        if (!FJsonObjectConverter::UStructToJsonObjectString(Value, Json) || !FFileHelper::SaveStringToFile(Json, *Path))
+        {
+            UE_LOG(LogMLCapture, Error, TEXT("Could not write %s"), *Path);
+            return false;
+        }
+        return true;
+    }
+
+    // Records of one shard index, validated against the manifest that lists it
+    bool LoadShardIndex(const FString& IndexPath, int64 ExpectedRecords, TArray<FMLShardIndexRecord>& OutRecords, FString& OutError)
+    {
+        TArray<uint8> Bytes;
+        if (!FFileHelper::LoadFileToArray(Bytes, *IndexPath))
+        {
+            OutError = FString::Printf(TEXT("%s is missing"), *IndexPath);
+            return false;
+        }
+
+        FMLShardIndexHeader Header;
+        if (Bytes.Num() < static_cast<int64>(sizeof(Header)))
+        {
+            OutError = FString::Printf(TEXT("%s is truncated"), *IndexPath);
+            return false;
+        }
+        FMemory::Memcpy(&Header, Bytes.GetData(), sizeof(Header));
+        if (Header.Magic != FMLShardIndexHeader().Magic || Header.Version > FMLShardIndexHeader().Version || Header.RecordSize != sizeof(FMLShardIndexRecord))
+        {
+            OutError = FString::Printf(TEXT("%s is not a version %d shard index"), *IndexPath, FMLShardIndexHeader().Version);
+            return false;
+        }
+
+        const int64 StoredRecords = (Bytes.Num() - static_cast<int64>(sizeof(Header))) / Header.RecordSize;
+        if (static_cast<int64>(Header.RecordCount) != ExpectedRecords || StoredRecords < ExpectedRecords)
+        {
+            OutError = FString::Printf(TEXT("%s holds %lld records, its manifest lists %lld"), *IndexPath, StoredRecords, ExpectedRecords);
+            return false;
+        }
+
+        OutRecords.SetNumUninitialized(ExpectedRecords);
+        FMemory::Memcpy(OutRecords.GetData(), Bytes.GetData() + sizeof(Header), ExpectedRecords * sizeof(FMLShardIndexRecord));
+        return true;
+    }
+}
+
+bool DatasetManifest::Save(const FMLDatasetManifest& Manifest, const FString& Path)
+{
+    return SaveJson(Manifest, Path);
+}
+
+bool DatasetManifest::Load(const FString& Path, FMLDatasetManifest& OutManifest)
+{
+    FString Json;
+    return FFileHelper::LoadFileToString(Json, *Path) && FJsonObjectConverter::JsonObjectStringToUStruct(Json, &OutManifest);
+}
+
+bool DatasetManifest::Merge(const TArray<FString>& ManifestPaths, const FString& OutputDirectory, FMLMergedDataset& OutDataset, FString& OutError)
+{
+    if (ManifestPaths.Num() == 0)
+    {
+        OutError = TEXT("no manifests to merge");
+        return false;
+    }
+
+    TArray<FMLDatasetManifest> Manifests;
+    Manifests.SetNum(ManifestPaths.Num());
+    for (int32 Index = 0; Index < ManifestPaths.Num(); ++Index)
+    {
+        if (!Load(ManifestPaths[Index], Manifests[Index]))
+        {
+            OutError = FString::Printf(TEXT("could not read %s"), *ManifestPaths[Index]);
+            return false;
+        }
+    }
+
+    // Every part must come from the same split of the same layout, each shard once
+    FMLMergedDataset Dataset;
+    const FMLShardAssignment& First = Manifests[0].Shard;
+    Dataset.ShardCount = First.ShardCount;
+    Dataset.Mode = First.Mode;
+    Dataset.Seed = First.Seed;
+
+    TArray<bool> ShardSeen;
+    ShardSeen.SetNumZeroed(Dataset.ShardCount);
+    TMap<int32, int32> CameraOwners;
+    for (int32 Index = 0; Index < Manifests.Num(); ++Index)
+    {
+        const FMLShardAssignment& Shard = Manifests[Index].Shard;
+        if (Shard.ShardCount != First.ShardCount || Shard.Mode != First.Mode || Shard.Seed != First.Seed || !Shard.IsValid())
+        {
+            OutError = FString::Printf(TEXT("%s is %s, expected a shard of %s"), *ManifestPaths[Index], *Shard.ToString(), *First.ToString());
+            return false;
+        }
+        if (ShardSeen[Shard.ShardIndex])
+        {
+            OutError = FString::Printf(TEXT("shard %d appears twice (%s)"), Shard.ShardIndex, *ManifestPaths[Index]);
+            return false;
+        }
+        ShardSeen[Shard.ShardIndex] = true;
+
+        for (const int32 Camera : Manifests[Index].Cameras)
+        {
+            if (const int32* Owner = CameraOwners.Find(Camera))
+            {
+                OutError = FString::Printf(TEXT("camera %d was captured by shards %d and %d"), Camera, *Owner, Shard.ShardIndex);
+                return false;
+            }
+            CameraOwners.Add(Camera, Shard.ShardIndex);
+        }
+    }
+    for (int32 ShardIndex = 0; ShardIndex < ShardSeen.Num(); ++ShardIndex)
+    {
+        if (!ShardSeen[ShardIndex])
+        {
+            Dataset.MissingShards.Add(ShardIndex);
+        }
+    }
+
+    TArray<FMLMergedIndexRecord> Merged;
+    TArray<FMLShardIndexRecord> Records;
+    const FString OutputRoot = FPaths::ConvertRelativePathToFull(OutputDirectory) / TEXT("");
+    for (int32 Index = 0; Index < Manifests.Num(); ++Index)
+    {
+        const FString ManifestDirectory = FPaths::GetPath(FPaths::ConvertRelativePathToFull(ManifestPaths[Index]));
+        for (const FMLDatasetShardFile& File : Manifests[Index].Files)
+        {
+            const FString BasePath = FPaths::Combine(ManifestDirectory, File.Name);
+            if (!LoadShardIndex(BasePath + TEXT(".idx"), File.Records, Records, OutError))
+                return false;
+
+            FString RelativePath = BasePath;
+            FPaths::MakePathRelativeTo(RelativePath, *OutputRoot);
+            const uint32 FileId = static_cast<uint32>(Dataset.Files.Add(RelativePath));
+
+            Merged.Reserve(Merged.Num() + Records.Num());
+            for (const FMLShardIndexRecord& Record : Records)
+            {
+                FMLMergedIndexRecord& Entry = Merged.AddDefaulted_GetRef();
+                Entry.Record = Record;
+                Entry.FileId = FileId;
+            }
+        }
+    }
+
+    Algo::Sort(Merged, [](const FMLMergedIndexRecord& A, const FMLMergedIndexRecord& B)
+    {
+        if (A.Record.FrameIndex != B.Record.FrameIndex)
+            return A.Record.FrameIndex < B.Record.FrameIndex;
+        if (A.Record.CameraIndex != B.Record.CameraIndex)
+            return A.Record.CameraIndex < B.Record.CameraIndex;
+        return A.Record.BufferType < B.Record.BufferType;
+    });
+
+    for (int32 Index = 1; Index < Merged.Num(); ++Index)
+    {
+        const FMLShardIndexRecord& Previous = Merged[Index - 1].Record;
+        const FMLShardIndexRecord& Current = Merged[Index].Record;
+        if (Previous.FrameIndex == Current.FrameIndex && Previous.CameraIndex == Current.CameraIndex && Previous.BufferType == Current.BufferType)
+        {
+            OutError = FString::Printf(TEXT("frame %lld of camera %d (buffer %d) is recorded twice, in %s and %s"),
+                Current.FrameIndex, Current.CameraIndex, Current.BufferType,
+                *Dataset.Files[Merged[Index - 1].FileId], *Dataset.Files[Merged[Index].FileId]);
+            return false;
+        }
+    }
+
+    CameraOwners.GenerateKeyArray(Dataset.Cameras);
+    Dataset.Cameras.Sort();
+    Dataset.Records = Merged.Num();
+    if (Merged.Num() > 0)
+    {
+        Dataset.FirstFrame = Merged[0].Record.FrameIndex;
+        Dataset.LastFrame = Merged.Last().Record.FrameIndex;
+    }
+
+    FMLMergedIndexHeader Header;
+    Header.RecordSize = sizeof(FMLMergedIndexRecord);
+    Header.FileCount = static_cast<uint32>(Dataset.Files.Num());
+    Header.RecordCount = static_cast<uint64>(Merged.Num());
+
+    const FString IndexPath = FPaths::Combine(OutputDirectory, TEXT("dataset.idx"));
+    TUniquePtr<FArchive> IndexFile(IFileManager::Get().CreateFileWriter(*IndexPath));
+    if (!IndexFile)
+    {
+        OutError = FString::Printf(TEXT("could not write %s"), *IndexPath);
+        return false;
+    }
+    IndexFile->Serialize(&Header, sizeof(Header));
+    IndexFile->Serialize(Merged.GetData(), Merged.Num() * sizeof(FMLMergedIndexRecord));
+    if (!IndexFile->Close())
+    {
+        OutError = FString::Printf(TEXT("could not write %s"), *IndexPath);
+        return false;
+    }
+
+    if (!SaveJson(Dataset, FPaths::Combine(OutputDirectory, TEXT("dataset.json"))))
+    {
+        OutError = TEXT("could not write dataset.json");
+        return false;
+    }
+
+    UE_LOG(LogMLCapture, Log, TEXT("Merged %d shard manifests: %lld records, %d cameras, %d files%s"), Manifests.Num(), Dataset.Records,
+        Dataset.Cameras.Num(), Dataset.Files.Num(),
+        Dataset.MissingShards.Num() > 0 ? *FString::Printf(TEXT(", %d shards missing"), Dataset.MissingShards.Num()) : TEXT(""));
+
+    OutDataset = MoveTemp(Dataset);
+    return true;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CaptureSharding.h"
+#include "DatasetShardWriter.h"
+#include "DatasetManifest.generated.h"
+
+// One closed shard_<worker>_<seq> pair of a dataset directory
+USTRUCT()
+struct CAMERATESTER_API FMLDatasetShardFile
+{
+    GENERATED_BODY()
+
+    // Relative to the manifest's directory, without extension
+    UPROPERTY()
+    FString Name;
+
+    UPROPERTY()
+    int64 Records = 0;
+
+    UPROPERTY()
+    int64 DataBytes = 0;
+
+    UPROPERTY()
+    int64 FirstFrame = INDEX_NONE;
+
+    UPROPERTY()
+    int64 LastFrame = INDEX_NONE;
+};
+
+// manifest.json, written by FDatasetShardWriter when it stops: what one process captured and where it went
+USTRUCT()
+struct CAMERATESTER_API FMLDatasetManifest
+{
+    GENERATED_BODY()
+
+    UPROPERTY()
+    int32 Version = 1;
+
+    UPROPERTY()
+    FMLShardAssignment Shard;
+
+    // Camera indices with at least one record, ascending
+    UPROPERTY()
+    TArray<int32> Cameras;
+
+    UPROPERTY()
+    int64 Records = 0;
+
+    UPROPERTY()
+    int64 FramesDropped = 0;
+
+    UPROPERTY()
+    TArray<FMLDatasetShardFile> Files;
+};
+
+// dataset.json next to a merged dataset.idx; FileId in the merged records indexes Files
+USTRUCT()
+struct CAMERATESTER_API FMLMergedDataset
+{
+    GENERATED_BODY()
+
+    UPROPERTY()
+    int32 Version = 1;
+
+    UPROPERTY()
+    int32 ShardCount = 1;
+
+    UPROPERTY()
+    EMLShardMode Mode = EMLShardMode::IndexRange;
+
+    UPROPERTY()
+    int32 Seed = 0;
+
+    // Shards without a manifest; the merged index simply has no records for their cameras
+    UPROPERTY()
+    TArray<int32> MissingShards;
+
+    UPROPERTY()
+    TArray<int32> Cameras;
+
+    UPROPERTY()
+    int64 Records = 0;
+
+    UPROPERTY()
+    int64 FirstFrame = INDEX_NONE;
+
+    UPROPERTY()
+    int64 LastFrame = INDEX_NONE;
+
+    // Shard file pairs relative to the merged directory, without extension
+    UPROPERTY()
+    TArray<FString> Files;
+};
+
+// Merged index (dataset.idx): Header followed by Header.RecordCount records sorted by frame, camera and buffer type.
+// Each record is the shard record unchanged plus the FMLMergedDataset::Files entry its Offset refers to.
+#pragma pack(push, 1)
+struct FMLMergedIndexHeader
+{
+    uint32 Magic = 0x494D4C4D; // "MLMI"
+    uint16 Version = 1;
+    uint16 RecordSize = 0;
+    uint32 FileCount = 0;
+    uint32 Reserved = 0;
+    uint64 RecordCount = 0;
+    uint64 Reserved2 = 0;
+};
+
+struct FMLMergedIndexRecord
+{
+    FMLShardIndexRecord Record;
+    uint32 FileId = 0;
+    uint32 Reserved = 0;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(FMLMergedIndexHeader) == 32, "Merged index header layout is part of the file format");
+static_assert(sizeof(FMLMergedIndexRecord) == 72, "Merged index record layout is part of the file format");
+
+namespace DatasetManifest
+{
+    CAMERATESTER_API bool Save(const FMLDatasetManifest& Manifest, const FString& Path);
+    CAMERATESTER_API bool Load(const FString& Path, FMLDatasetManifest& OutManifest);
+
+    // Combines the per-shard manifests of one sharded capture into OutputDirectory/dataset.idx and dataset.json.
+    // Fails without writing anything when the shards disagree on the layout split, share cameras, or two records
+    // claim the same frame, camera and buffer.
+    CAMERATESTER_API bool Merge(const TArray<FString>& ManifestPaths, const FString& OutputDirectory, FMLMergedDataset& OutDataset, FString& OutError);
+}
@@ -0,0 +1,524 @@
+#include "DatasetShardWriter.h"
+#include "MLCaptureStats.h"
+#include "DatasetManifest.h"
+#include "TemporalFrameCodec.h"
+#include "CaptureIndex.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/RunnableThread.h"
+#include "HAL/Event.h"
+#include "Misc/Paths.h"
+
+FDatasetShardWriter::FDatasetShardWriter(const FDatasetShardWriterSettings& InSettings)
+    : Settings(InSettings)
+{
+    Settings.NumWorkers = FMath::Clamp(Settings.NumWorkers, 1, 32);
+    Settings.ShardDataAlignment = FMath::Max<uint32>(Settings.ShardDataAlignment, 1);
+}
+
+FDatasetShardWriter::~FDatasetShardWriter()
+{
+    Stop();
+}
+
+bool FDatasetShardWriter::Start()
+{
+    if (IsRunning())
+        return true;
+
+    if (!IFileManager::Get().MakeDirectory(*Settings.OutputDirectory, true))
+    {
+        UE_LOG(LogMLCapture, Error, TEXT("Dataset writer could not create output directory %s"), *Settings.OutputDirectory);
+        return false;
+    }
+
+    ManifestPath.Reset();
+    RecoveredShards.Reset();
+    RecoveredCameras.Reset();
+    FirstShardId = 0;
+    if (Settings.bResume)
+    {
+        RecoverShards();
+    }
+
+    for (int32 WorkerId = 0; WorkerId < Settings.NumWorkers; ++WorkerId)
+    {
+        TUniquePtr<FWorker> Worker = MakeUnique<FWorker>(*this, WorkerId);
+        Worker->Thread = FRunnableThread::Create(Worker.Get(), *FString::Printf(TEXT("MLDatasetWriter_%d"), WorkerId), 0, TPri_BelowNormal);
+        Workers.Add(MoveTemp(Worker));
+    }
+
+    UE_LOG(LogMLCapture, Log, TEXT("Dataset writer started: %d I/O threads, %lld MB shards, %lld MB queue -> %s"),
+        Settings.NumWorkers, Settings.MaxShardBytes / (1024 * 1024), Settings.MaxQueuedBytes / (1024 * 1024), *Settings.OutputDirectory);
+    return true;
+}
+
+void FDatasetShardWriter::Stop()
+{
+    if (!IsRunning())
+        return;
+
+    for (TUniquePtr<FWorker>& Worker : Workers)
+    {
+        Worker->Stop();
+    }
+    for (TUniquePtr<FWorker>& Worker : Workers)
+    {
+        if (Worker->Thread)
+        {
+            Worker->Thread->WaitForCompletion();
+            delete Worker->Thread;
+            Worker->Thread = nullptr;
+        }
+    }
+    if (Settings.bWriteManifest)
+    {
+        WriteManifest();
+    }
+    Workers.Empty();
+
+    UE_LOG(LogMLCapture, Log, TEXT("Dataset writer stopped: %lld frames, %lld bytes written, %lld dropped"),
+        FramesWritten.load(), BytesWritten.load(), FramesDropped.load());
+}
+
+void FDatasetShardWriter::WriteManifest()
+{
+    FMLDatasetManifest Manifest;
+    Manifest.Shard = Settings.Shard;
+    Manifest.FramesDropped = FramesDropped.load();
+
+    auto AddFile = [&Manifest](const FClosedShard& Closed)
+    {
+        FMLDatasetShardFile& File = Manifest.Files.AddDefaulted_GetRef();
+        File.Name = Closed.Name;
+        File.Records = static_cast<int64>(Closed.Records);
+        File.DataBytes = static_cast<int64>(Closed.DataBytes);
+        File.FirstFrame = Closed.FirstFrame;
+        File.LastFrame = Closed.LastFrame;
+        Manifest.Records += File.Records;
+    };
+
+    TSet<int32> Cameras = RecoveredCameras;
+    for (const FClosedShard& Closed : RecoveredShards)
+    {
+        AddFile(Closed);
+    }
+    for (const TUniquePtr<FWorker>& Worker : Workers)
+    {
+        Cameras.Append(Worker->Cameras);
+        for (const FClosedShard& Closed : Worker->ClosedShards)
+        {
+            AddFile(Closed);
+        }
+    }
+    Manifest.Cameras = Cameras.Array();
+    Manifest.Cameras.Sort();
+    Manifest.Files.Sort([](const FMLDatasetShardFile& A, const FMLDatasetShardFile& B) { return A.Name < B.Name; });
+
+    const FString Path = FPaths::Combine(Settings.OutputDirectory, TEXT("manifest.json"));
+    if (DatasetManifest::Save(Manifest, Path))
+    {
+        ManifestPath = Path;
+    }
+}
+
+void FDatasetShardWriter::RecoverShards()
+{
+    TArray<FString> IndexFiles;
+    IFileManager::Get().FindFiles(IndexFiles, *FPaths::Combine(Settings.OutputDirectory, TEXT("shard_*.idx")), true, false);
+    IndexFiles.Sort();
+
+    int64 NumRecords = 0;
+    TArray<FMLShardIndexRecord> Records;
+    for (const FString& IndexFile : IndexFiles)
+    {
+        FClosedShard Shard;
+        uint32 ShardId = 0;
+        if (!RecoverShard(FPaths::Combine(Settings.OutputDirectory, FPaths::GetBaseFilename(IndexFile)), Shard, Records, ShardId))
+            continue;
+
+        for (const FMLShardIndexRecord& Record : Records)
+        {
+            RecoveredCameras.Add(Record.CameraIndex);
+        }
+        if (Settings.CaptureIndex)
+        {
+            Settings.CaptureIndex->AddRecoveredRecords(Records);
+        }
+
+        NumRecords += Records.Num();
+        FirstShardId = FMath::Max(FirstShardId, ShardId + 1);
+        RecoveredShards.Add(MoveTemp(Shard));
+    }
+
+    UE_CLOG(RecoveredShards.Num() > 0, LogMLCapture, Log, TEXT("Dataset writer resuming %s: %d shards, %lld records kept"),
+        *Settings.OutputDirectory, RecoveredShards.Num(), NumRecords);
+}
+
+bool FDatasetShardWriter::RecoverShard(const FString& BaseName, FClosedShard& OutShard, TArray<FMLShardIndexRecord>& OutRecords, uint32& OutShardId) const
+{
+    OutRecords.Reset();
+
+    IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+    const int64 DataBytes = PlatformFile.FileSize(*(BaseName + TEXT(".bin")));
+    TUniquePtr<IFileHandle> IndexFile(PlatformFile.OpenWrite(*(BaseName + TEXT(".idx")), true, true));
+
+    FMLShardIndexHeader Header;
+    const int64 IndexBytes = IndexFile ? IndexFile->Size() : 0;
+    if (DataBytes < 0 || IndexBytes < static_cast<int64>(sizeof(Header)) || !IndexFile->Seek(0)
+        || !IndexFile->Read(reinterpret_cast<uint8*>(&Header), sizeof(Header))
+        || Header.Magic != FMLShardIndexHeader().Magic || Header.RecordSize != sizeof(FMLShardIndexRecord))
+    {
+        UE_LOG(LogMLCapture, Warning, TEXT("Dataset writer ignores %s: not a readable shard"), *BaseName);
+        return false;
+    }
+
+    const int64 NumRecords = (IndexBytes - static_cast<int64>(sizeof(Header))) / sizeof(FMLShardIndexRecord);
+    OutRecords.SetNumUninitialized(NumRecords);
+    if (!IndexFile->Read(reinterpret_cast<uint8*>(OutRecords.GetData()), NumRecords * sizeof(FMLShardIndexRecord)))
+    {
+        OutRecords.Reset();
+        return false;
+    }
+
+    // Records follow their bytes, but a crash can still cut the .bin short of the last few
+    int32 NumValid = OutRecords.Num();
+    while (NumValid > 0)
+    {
+        const FMLShardIndexRecord& Last = OutRecords[NumValid - 1];
+        if ((Last.Flags & EMLShardRecordFlags::Reused) || static_cast<int64>(Last.Offset + Last.Size) <= DataBytes)
+            break;
+        --NumValid;
+    }
+    OutRecords.SetNum(NumValid);
+
+    // Finalise the header the interrupted run never closed
+    const int64 ValidBytes = sizeof(Header) + static_cast<int64>(NumValid) * sizeof(FMLShardIndexRecord);
+    if (IndexBytes > ValidBytes)
+    {
+        IndexFile->Truncate(ValidBytes);
+    }
+    Header.RecordCount = NumValid;
+    Header.DataBytes = DataBytes;
+    IndexFile->Seek(0);
+    IndexFile->Write(reinterpret_cast<const uint8*>(&Header), sizeof(Header));
+    IndexFile->Flush();
+
+    OutShard.Name = FPaths::GetCleanFilename(BaseName);
+    OutShard.Records = Header.RecordCount;
+    OutShard.DataBytes = Header.DataBytes;
+    for (const FMLShardIndexRecord& Record : OutRecords)
+    {
+        OutShard.FirstFrame = OutShard.FirstFrame == INDEX_NONE ? Record.FrameIndex : FMath::Min(OutShard.FirstFrame, Record.FrameIndex);
+        OutShard.LastFrame = FMath::Max(OutShard.LastFrame, Record.FrameIndex);
+    }
+    OutShardId = Header.ShardId;
+    return true;
+}
+
+bool FDatasetShardWriter::Submit(const FMLCapturedFramePtr& Frame)
+{
+    if (!IsRunning() || !Frame.IsValid())
+        return false;
+
+    // Residuals after a dropped temporal frame cannot be decoded; skip them until the capture's next keyframe
+    const bool bTemporal = Frame->Codec == EMLFrameCodec::TemporalDelta && Frame->ReusedFrameIndex == INDEX_NONE;
+    const uint32 CaptureKey = MLCapture::MakeCaptureKey(Frame->CameraIndex, Frame->BufferType);
+    if (bTemporal)
+    {
+        FMLTemporalFrameHeader Header;
+        if (TemporalFrameCodec::ReadHeader(Frame->Pixels.GetData(), Frame->Pixels.Num(), Header) && Header.IsKeyframe())
+        {
+            BrokenTemporalChains.Remove(CaptureKey);
+        }
+        else if (BrokenTemporalChains.Contains(CaptureKey))
+        {
+            FramesDropped.fetch_add(1);
+            return false;
+        }
+    }
+
+    const int64 FrameBytes = Frame->Pixels.Num();
+    if (Settings.bBlockWhenFull)
+    {
+        // An empty queue always accepts, so oversized frames cannot wait forever
+        while (QueuedBytes.load() > 0 && QueuedBytes.load() + FrameBytes > Settings.MaxQueuedBytes)
+        {
+            FPlatformProcess::SleepNoStats(0.0005f);
+        }
+    }
+    else if (QueuedBytes.load() + FrameBytes > Settings.MaxQueuedBytes)
+    {
+        FramesDropped.fetch_add(1);
+        if (bTemporal)
+        {
+            BrokenTemporalChains.Add(CaptureKey);
+        }
+        return false;
+    }
+
+    QueuedBytes.fetch_add(FrameBytes);
+    Workers[FMath::Abs(Frame->CameraIndex) % Workers.Num()]->Enqueue(Frame);
+    return true;
+}
+
+FDatasetShardWriter::FWorker::FWorker(FDatasetShardWriter& InOwner, int32 InWorkerId)
+    : Owner(InOwner)
+    , WorkerId(InWorkerId)
+    , NextShardId(InOwner.FirstShardId)
+{
+    WakeEvent = FPlatformProcess::GetSynchEventFromPool(false);
+}
+
+FDatasetShardWriter::FWorker::~FWorker()
+{
+    CloseShard();
+    FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+}
+
+void FDatasetShardWriter::FWorker::Enqueue(const FMLCapturedFramePtr& Frame)
+{
+    Queue.Enqueue(Frame);
+    WakeEvent->Trigger();
+}
+
+void FDatasetShardWriter::FWorker::Stop()
+{
+    bStopRequested.store(true);
+    WakeEvent->Trigger();
+}
+
+uint32 FDatasetShardWriter::FWorker::Run()
+{
+    while (!bStopRequested.load())
+    {
+        WakeEvent->Wait(100);
+        DrainQueue();
+    }
+
+    // Flush whatever arrived before the stop request
+    DrainQueue();
+    CloseShard();
+    return 0;
+}
+
+void FDatasetShardWriter::FWorker::DrainQueue()
+{
+    FMLCapturedFramePtr Frame;
+    while (Queue.Dequeue(Frame))
+    {
+        const int64 FrameBytes = Frame->Pixels.Num();
+
+        // Same rule as Submit for frames lost here: a capture's frames all reach this worker in order, so the
+        // residuals after a failed write are dropped until its next keyframe
+        const bool bTemporal = Frame->Codec == EMLFrameCodec::TemporalDelta && Frame->ReusedFrameIndex == INDEX_NONE;
+        const uint32 CaptureKey = MLCapture::MakeCaptureKey(Frame->CameraIndex, Frame->BufferType);
+        bool bChainBroken = false;
+        if (bTemporal && BrokenTemporalChains.Contains(CaptureKey))
+        {
+            FMLTemporalFrameHeader TemporalHeader;
+            if (TemporalFrameCodec::ReadHeader(Frame->Pixels.GetData(), Frame->Pixels.Num(), TemporalHeader) && TemporalHeader.IsKeyframe())
+            {
+                BrokenTemporalChains.Remove(CaptureKey);
+            }
+            else
+            {
+                bChainBroken = true;
+            }
+        }
+
+        if (!bChainBroken && WriteFrame(*Frame))
+        {
+            Owner.FramesWritten.fetch_add(1);
+            Owner.BytesWritten.fetch_add(FrameBytes);
+        }
+        else
+        {
+            Owner.FramesDropped.fetch_add(1);
+            if (bTemporal)
+            {
+                BrokenTemporalChains.Add(CaptureKey);
+            }
+        }
+        Owner.QueuedBytes.fetch_sub(FrameBytes);
+    }
+}
+
+bool FDatasetShardWriter::FWorker::OpenShard()
+{
+    const FString BaseName = FPaths::Combine(Owner.Settings.OutputDirectory, FString::Printf(TEXT("shard_%02d_%05u"), WorkerId, NextShardId));
+
+    IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+    DataFile.Reset(PlatformFile.OpenWrite(*(BaseName + TEXT(".bin")), false, true));
+    IndexFile.Reset(PlatformFile.OpenWrite(*(BaseName + TEXT(".idx")), false, true));
+    if (!DataFile || !IndexFile)
+    {
+        UE_LOG(LogMLCapture, Error, TEXT("Dataset writer could not open shard %s"), *BaseName);
+        DataFile.Reset();
+        IndexFile.Reset();
+        return false;
+    }
+
+    Current = FClosedShard();
+    Current.Name = FPaths::GetCleanFilename(BaseName);
+
+    Header = FMLShardIndexHeader();
+    Header.RecordSize = sizeof(FMLShardIndexRecord);
+    Header.ShardId = NextShardId++;
+    Header.WorkerId = WorkerId;
+    if (!IndexFile->Write(reinterpret_cast<const uint8*>(&Header), sizeof(Header)))
+    {
+        UE_LOG(LogMLCapture, Error, TEXT("Dataset writer could not write the header of shard %s"), *BaseName);
+        DataFile.Reset();
+        IndexFile.Reset();
+        return false;
+    }
+
+    DataOffset = 0;
+    return true;
+}
+
+void FDatasetShardWriter::FWorker::CloseShard()
+{
+    if (IndexFile)
+    {
+        // Finalise the header in place so mapped readers see the exact record count
+        Header.DataBytes = DataOffset;
+        IndexFile->Seek(0);
+        IndexFile->Write(reinterpret_cast<const uint8*>(&Header), sizeof(Header));
+        IndexFile->Flush();
+
+        Current.Records = Header.RecordCount;
+        Current.DataBytes = DataOffset;
+        ClosedShards.Add(Current);
+    }
+    if (DataFile)
+    {
+        DataFile->Flush();
+    }
+
+    IndexFile.Reset();
+    DataFile.Reset();
+}
+
+void FDatasetShardWriter::FWorker::DiscardPartialWrite()
+{
+    const int64 IndexBytes = sizeof(Header) + static_cast<int64>(Header.RecordCount) * sizeof(FMLShardIndexRecord);
+    const bool bDataRestored = DataFile->Seek(DataOffset) && DataFile->Truncate(DataOffset);
+    const bool bIndexRestored = IndexFile->Seek(IndexBytes) && IndexFile->Truncate(IndexBytes);
+    if (!bDataRestored || !bIndexRestored)
+    {
+        // The header records the good extent; the next frame starts a new shard
+        UE_LOG(LogMLCapture, Warning, TEXT("Dataset writer could not roll back shard %s; closing it"), *Current.Name);
+        CloseShard();
+    }
+}
+
+bool FDatasetShardWriter::FWorker::WriteFrame(const FMLCapturedFrame& Frame)
+{
+    ML_CAPTURE_SCOPE(STAT_MLCapture_ShardWrite);
+
+    const uint64 FrameBytes = Frame.Pixels.Num();
+    if (DataFile && DataOffset > 0 && DataOffset + FrameBytes > static_cast<uint64>(Owner.Settings.MaxShardBytes))
+    {
+        CloseShard();
+    }
+    if (!DataFile && !OpenShard())
+        return false;
+
+    const bool bReused = Frame.ReusedFrameIndex != INDEX_NONE;
+    if (!bReused && !DataFile->Write(Frame.Pixels.GetData(), FrameBytes))
+    {
+        DiscardPartialWrite();
+        return false;
+    }
+
+    // The encoder hashed the raw pixels already; raw frames are hashed here
+    FCaptureIndex* CaptureIndex = Owner.Settings.CaptureIndex.Get();
+    bool bHasPerceptualHash = Frame.bHasPerceptualHash;
+    uint64 PerceptualHash = Frame.PerceptualHash;
+    int64 NearDuplicateOf = INDEX_NONE;
+    if (CaptureIndex && !bReused)
+    {
+        if (!bHasPerceptualHash)
+        {
+            bHasPerceptualHash = FCaptureIndex::ComputePerceptualHash(Frame, PerceptualHash);
+        }
+        if (bHasPerceptualHash)
+        {
+            NearDuplicateOf = CaptureIndex->FindNearDuplicate(Frame.CameraIndex, Frame.BufferType, PerceptualHash);
+        }
+    }
+
+    FMLShardIndexRecord Record;
+    Record.FrameIndex = Frame.FrameIndex;
+    Record.Offset = bReused ? static_cast<uint64>(Frame.ReusedFrameIndex) : DataOffset;
+    Record.Size = static_cast<uint32>(FrameBytes);
+    Record.Flags = bReused ? EMLShardRecordFlags::Reused : EMLShardRecordFlags::None;
+    FMLTemporalFrameHeader TemporalHeader;
+    if (!bReused && Frame.Codec == EMLFrameCodec::TemporalDelta && TemporalFrameCodec::ReadHeader(Frame.Pixels.GetData(), Frame.Pixels.Num(), TemporalHeader)
+        && TemporalHeader.IsKeyframe())
+    {
+        Record.Flags |= EMLShardRecordFlags::Keyframe;
+    }
+    if (NearDuplicateOf != INDEX_NONE)
+    {
+        Record.Flags |= EMLShardRecordFlags::NearDuplicate;
+    }
+    Record.CameraIndex = Frame.CameraIndex;
+    Record.BufferType = static_cast<uint8>(Frame.BufferType);
+    Record.PixelFormat = static_cast<uint8>(Frame.PixelFormat);
+    Record.Codec = static_cast<uint8>(Frame.Codec);
+    Record.RawSize = static_cast<uint32>(Frame.Codec == EMLFrameCodec::Raw ? FrameBytes : Frame.RawBytes);
+    Record.Width = static_cast<uint16>(Frame.Width);
+    Record.Height = static_cast<uint16>(Frame.Height);
+
+    const FVector Location = Frame.CameraPose.GetLocation();
+    const FQuat Rotation = Frame.CameraPose.GetRotation();
+    Record.Position[0] = static_cast<float>(Location.X);
+    Record.Position[1] = static_cast<float>(Location.Y);
+    Record.Position[2] = static_cast<float>(Location.Z);
+    Record.Rotation[0] = static_cast<float>(Rotation.X);
+    Record.Rotation[1] = static_cast<float>(Rotation.Y);
+    Record.Rotation[2] = static_cast<float>(Rotation.Z);
+    Record.Rotation[3] = static_cast<float>(Rotation.W);
+
+    if (!IndexFile->Write(reinterpret_cast<const uint8*>(&Record), sizeof(Record)))
+    {
+        DiscardPartialWrite();
+        return false;
+    }
+    ++Header.RecordCount;
+
+    // Only once the record is down, so a resumed run never skips a frame the dataset does not have
+    if (CaptureIndex && !bReused)
+    {
+        CaptureIndex->Commit(Frame, bHasPerceptualHash, PerceptualHash, NearDuplicateOf);
+    }
+
+    Current.FirstFrame = Current.FirstFrame == INDEX_NONE ? Frame.FrameIndex : FMath::Min(Current.FirstFrame, Frame.FrameIndex);
+    Current.LastFrame = FMath::Max(Current.LastFrame, Frame.FrameIndex);
+    Cameras.Add(Frame.CameraIndex);
+
+    if (bReused)
+        return true;
+
+    // Pad so the next frame starts aligned for direct mapping
+    DataOffset += FrameBytes;
+    const uint64 Alignment = Owner.Settings.ShardDataAlignment;
+    const uint64 PadBytes = (Alignment - (DataOffset % Alignment)) % Alignment;
+    if (PadBytes > 0)
+    {
+        Padding.SetNumZeroed(PadBytes, EAllowShrinking::No);
+        if (!DataFile->Write(Padding.GetData(), PadBytes))
+        {
+            // The frame itself is complete; start the next one in a new shard rather than misaligned
+            CloseShard();
+            return true;
+        }
+        DataOffset += PadBytes;
+    }
+
+    return true;
+}
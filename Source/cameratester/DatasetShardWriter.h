@@ -0,0 +1,198 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "Containers/Queue.h"
+#include "MLCaptureTypes.h"
+#include "CaptureSharding.h"
+#include <atomic>
+
+class FRunnableThread;
+class IFileHandle;
+class FCaptureIndex;
+
+// On-disk layout of a shard index (<shard>.idx). Both structs are fixed-size and little-endian so the
+// file can be memory-mapped and used as a flat array: Header followed by Header.RecordCount records.
+// Frame bytes live in the matching <shard>.bin at Record.Offset, each frame aligned to ShardDataAlignment.
+// Version 2: records flagged Reused carry no bytes (Size 0); Offset then holds the FrameIndex whose pixels still apply.
+#pragma pack(push, 1)
+struct FMLShardIndexHeader
+{
+    uint32 Magic = 0x49534C4D; // "MLSI"
+    uint16 Version = 2;
+    uint16 RecordSize = 0;
+    uint32 ShardId = 0;
+    uint32 WorkerId = 0;
+    uint64 RecordCount = 0;    // Finalised on close; readers may also use (FileSize - sizeof(Header)) / RecordSize
+    uint64 DataBytes = 0;
+};
+
+struct FMLShardIndexRecord
+{
+    int64 FrameIndex = 0;
+    uint64 Offset = 0;
+    uint32 Size = 0;
+    int32 CameraIndex = 0;
+    uint8 BufferType = 0;
+    uint8 PixelFormat = 0;
+    uint8 Codec = 0;           // EMLFrameCodec
+    uint8 Flags = 0;           // EMLShardRecordFlags
+    uint16 Width = 0;
+    uint16 Height = 0;
+    float Position[3] = { 0.f, 0.f, 0.f };
+    float Rotation[4] = { 0.f, 0.f, 0.f, 1.f };
+    uint32 RawSize = 0;        // Decoded byte size; equals Size for raw frames
+};
+#pragma pack(pop)
+
+namespace EMLShardRecordFlags
+{
+    enum : uint8
+    {
+        None = 0,
+        // Capture skipped because nothing in view changed
+        Reused = 1 << 0,
+        // TemporalDelta frame decodable on its own; random access into a temporal stream starts here
+        Keyframe = 1 << 1,
+        // Pixels hash within FCaptureIndex's NearDuplicateBits of the previous frame of the same capture
+        NearDuplicate = 1 << 2,
+    };
+}
+
+static_assert(sizeof(FMLShardIndexHeader) == 32, "Shard index header layout is part of the file format");
+static_assert(sizeof(FMLShardIndexRecord) == 64, "Shard index record layout is part of the file format");
+
+struct FDatasetShardWriterSettings
+{
+    // Absolute directory that receives shard_<worker>_<seq>.bin/.idx pairs
+    FString OutputDirectory;
+
+    int64 MaxShardBytes = 1024ll * 1024 * 1024;
+    int32 NumWorkers = 2;
+
+    // Frames beyond this many queued bytes are rejected instead of blocking the caller
+    int64 MaxQueuedBytes = 256ll * 1024 * 1024;
+
+    // Wait for the workers to catch up instead of rejecting frames once MaxQueuedBytes is reached
+    bool bBlockWhenFull = false;
+
+    uint32 ShardDataAlignment = 4096;
+
+    // Recorded in manifest.json, which Stop() writes next to the shards for DatasetManifest::Merge
+    FMLShardAssignment Shard;
+    bool bWriteManifest = true;
+
+    // Keep the shards already in OutputDirectory: repair the ones an interrupted run left open, list them in the
+    // manifest and number new shards after them
+    bool bResume = false;
+
+    // Written frames are committed here and checked for near-duplicates; recovered records are added on Start()
+    TSharedPtr<FCaptureIndex, ESPMode::ThreadSafe> CaptureIndex;
+};
+
+// Streams captured frames into large append-only shard files on a dedicated pool of I/O threads.
+// Submit() never blocks by default: when the bounded queues are full the frame is rejected and counted as dropped.
+class CAMERATESTER_API FDatasetShardWriter
+{
+public:
+    explicit FDatasetShardWriter(const FDatasetShardWriterSettings& InSettings);
+    ~FDatasetShardWriter();
+
+    bool Start();
+
+    // Drains every queue, finalises the open shards and joins the workers
+    void Stop();
+
+    // Game thread. Frames of one camera always go to the same worker, so they stay ordered within its shards.
+    bool Submit(const FMLCapturedFramePtr& Frame);
+
+    bool IsRunning() const { return Workers.Num() > 0; }
+    bool IsSaturated() const { return QueuedBytes.load() >= Settings.MaxQueuedBytes; }
+
+    int64 GetQueuedBytes() const { return QueuedBytes.load(); }
+    int64 GetFramesWritten() const { return FramesWritten.load(); }
+    int64 GetBytesWritten() const { return BytesWritten.load(); }
+    int64 GetFramesDropped() const { return FramesDropped.load(); }
+
+    const FDatasetShardWriterSettings& GetSettings() const { return Settings; }
+
+    // Empty until Stop() has written the manifest
+    const FString& GetManifestPath() const { return ManifestPath; }
+
+private:
+    // Per closed shard pair, gathered into the manifest once the workers are joined
+    struct FClosedShard
+    {
+        FString Name;
+        uint64 Records = 0;
+        uint64 DataBytes = 0;
+        int64 FirstFrame = INDEX_NONE;
+        int64 LastFrame = INDEX_NONE;
+    };
+
+    void WriteManifest();
+    void RecoverShards();
+    // Cuts records whose bytes never reached the .bin and finalises the header; false if BaseName is not a shard
+    bool RecoverShard(const FString& BaseName, FClosedShard& OutShard, TArray<FMLShardIndexRecord>& OutRecords, uint32& OutShardId) const;
+
+    class FWorker : public FRunnable
+    {
+    public:
+        FWorker(FDatasetShardWriter& InOwner, int32 InWorkerId);
+        virtual ~FWorker() override;
+
+        virtual uint32 Run() override;
+        virtual void Stop() override;
+
+        void Enqueue(const FMLCapturedFramePtr& Frame);
+
+        FRunnableThread* Thread = nullptr;
+
+    private:
+        void DrainQueue();
+        bool WriteFrame(const FMLCapturedFrame& Frame);
+        bool OpenShard();
+        void CloseShard();
+        // Cut both files back to the last complete record after a failed write
+        void DiscardPartialWrite();
+
+        FDatasetShardWriter& Owner;
+        const int32 WorkerId;
+
+        TQueue<FMLCapturedFramePtr, EQueueMode::Spsc> Queue;
+        FEvent* WakeEvent = nullptr;
+        std::atomic<bool> bStopRequested { false };
+
+        TUniquePtr<IFileHandle> DataFile;
+        TUniquePtr<IFileHandle> IndexFile;
+        FMLShardIndexHeader Header;
+        FClosedShard Current;
+        uint32 NextShardId = 0;
+        uint64 DataOffset = 0;
+        TArray<uint8> Padding;
+        // Captures whose TemporalDelta chain lost a frame to a failed write and wait for a keyframe
+        TSet<uint32> BrokenTemporalChains;
+
+    public:
+        // Only read after the thread is joined
+        TArray<FClosedShard> ClosedShards;
+        TSet<int32> Cameras;
+    };
+
+    FDatasetShardWriterSettings Settings;
+    TArray<TUniquePtr<FWorker>> Workers;
+
+    std::atomic<int64> QueuedBytes { 0 };
+    std::atomic<int64> FramesWritten { 0 };
+    std::atomic<int64> BytesWritten { 0 };
+    std::atomic<int64> FramesDropped { 0 };
+
+    // Game thread; captures whose TemporalDelta chain lost a frame and wait for a keyframe
+    TSet<uint32> BrokenTemporalChains;
+    FString ManifestPath;
+
+    // Left by an earlier run, set by Start()
+    TArray<FClosedShard> RecoveredShards;
+    TSet<int32> RecoveredCameras;
+    uint32 FirstShardId = 0;
+};
@@ -0,0 +1,639 @@
+#include "DepthQuantization.h"
+#include "MLCaptureStats.h"
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
+#include "Math/RandomStream.h"
+
+#if PLATFORM_CPU_X86_FAMILY
+    #include <immintrin.h>
+    #if defined(_MSC_VER) && !defined(__clang__)
+        #include <intrin.h>
+    #else
+        #include <cpuid.h>
+    #endif
+    #define ML_DEPTH_SSE 1
+#else
+    #define ML_DEPTH_SSE 0
+#endif
+
+#if PLATFORM_CPU_ARM_FAMILY && PLATFORM_64BITS
+    #include <arm_neon.h>
+    #define ML_DEPTH_NEON 1
+#else
+    #define ML_DEPTH_NEON 0
+#endif
+
+// AVX2 code is compiled per function so the module itself doesn't need -mavx2
+#if ML_DEPTH_SSE && (defined(__clang__) || defined(__GNUC__))
+    #define ML_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+    #define ML_TARGET_AVX2
+#endif
+
+namespace DepthQuantization
+{
+namespace
+{
+    // log2(1 + f) on [0, 1), least-squares fit, max error 4e-7. Shared by every path so results match bit for bit.
+    constexpr float Log2C0 = 1.442664027e+00f;
+    constexpr float Log2C1 = -7.205156088e-01f;
+    constexpr float Log2C2 = 4.731138945e-01f;
+    constexpr float Log2C3 = -3.246179819e-01f;
+    constexpr float Log2C4 = 1.923874021e-01f;
+    constexpr float Log2C5 = -7.815992087e-02f;
+    constexpr float Log2C6 = 1.512840483e-02f;
+
+    struct FKernelConstants
+    {
+        float MinDepth = 0.0f;
+        float MaxDepth = 1.0f;
+        // T = (X - Offset) * Scale, where X is D, 1/D or log2(D) depending on the encoding
+        float Offset = 0.0f;
+        float Scale = 1.0f;
+    };
+
+    // Each step is its own statement so the compiler can't contract into FMA and diverge from the SIMD paths
+    FORCEINLINE float Log2Approx(float X)
+    {
+        const uint32 Bits = BitCast<uint32>(X);
+        const float Exponent = static_cast<float>(static_cast<int32>((Bits >> 23) & 0xFF) - 127);
+        float F = BitCast<float>((Bits & 0x007FFFFFu) | 0x3F800000u);
+        F = F - 1.0f;
+
+        float P = Log2C6;
+        P = P * F; P = P + Log2C5;
+        P = P * F; P = P + Log2C4;
+        P = P * F; P = P + Log2C3;
+        P = P * F; P = P + Log2C2;
+        P = P * F; P = P + Log2C1;
+        P = P * F; P = P + Log2C0;
+        P = P * F;
+        return P + Exponent;
+    }
+
+    FKernelConstants MakeConstants(const FParams& Params)
+    {
+        FKernelConstants K;
+        const float MinDepth = FMath::Max(Params.MinDepth, 1.0e-3f);
+        const float MaxDepth = FMath::Max(Params.MaxDepth, MinDepth * 2.0f);
+
+        switch (Params.Encoding)
+        {
+        case EMLDepthEncoding::Linear:
+            K.MinDepth = 0.0f;
+            K.MaxDepth = MaxDepth;
+            K.Offset = 0.0f;
+            K.Scale = 1.0f / MaxDepth;
+            break;
+        case EMLDepthEncoding::Inverse:
+            K.MinDepth = MinDepth;
+            K.MaxDepth = MaxDepth;
+            K.Offset = 1.0f / MaxDepth;
+            K.Scale = 1.0f / (1.0f / MinDepth - 1.0f / MaxDepth);
+            break;
+        case EMLDepthEncoding::Log:
+            K.MinDepth = MinDepth;
+            K.MaxDepth = MaxDepth;
+            K.Offset = Log2Approx(MinDepth);
+            K.Scale = 1.0f / (Log2Approx(MaxDepth) - Log2Approx(MinDepth));
+            break;
+        }
+        return K;
+    }
+
+    // Scalar reference
+
+    template<EMLDepthEncoding Encoding>
+    FORCEINLINE float NormalizeScalar(float D, const FKernelConstants& K)
+    {
+        D = D > K.MinDepth ? D : K.MinDepth;
+        D = D < K.MaxDepth ? D : K.MaxDepth;
+
+        float X = D;
+        if constexpr (Encoding == EMLDepthEncoding::Inverse)
+        {
+            X = 1.0f / D;
+        }
+        else if constexpr (Encoding == EMLDepthEncoding::Log)
+        {
+            X = Log2Approx(D);
+        }
+
+        float T = X - K.Offset;
+        T = T * K.Scale;
+        T = T > 0.0f ? T : 0.0f;
+        T = T < 1.0f ? T : 1.0f;
+        return T;
+    }
+
+    FORCEINLINE uint32 QuantizeScalar(float T, float QuantScale)
+    {
+        float S = T * QuantScale;
+        S = S + 0.5f;
+        return static_cast<uint32>(S);
+    }
+
+    template<EMLDepthEncoding Encoding, typename OutType>
+    void RowScalar(const float* Src, OutType* Dst, int32 Begin, int32 Count, const FKernelConstants& K)
+    {
+        const float QuantScale = static_cast<float>(TNumericLimits<OutType>::Max());
+        for (int32 i = Begin; i < Count; ++i)
+        {
+            Dst[i] = static_cast<OutType>(QuantizeScalar(NormalizeScalar<Encoding>(Src[i], K), QuantScale));
+        }
+    }
+
+#if ML_DEPTH_SSE
+    // SSE2
+
+    FORCEINLINE __m128 Log2SSE(__m128 X)
+    {
+        const __m128i Bits = _mm_castps_si128(X);
+        const __m128i ExponentBits = _mm_sub_epi32(_mm_and_si128(_mm_srli_epi32(Bits, 23), _mm_set1_epi32(0xFF)), _mm_set1_epi32(127));
+        const __m128 Exponent = _mm_cvtepi32_ps(ExponentBits);
+        __m128 F = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(Bits, _mm_set1_epi32(0x007FFFFF)), _mm_set1_epi32(0x3F800000)));
+        F = _mm_sub_ps(F, _mm_set1_ps(1.0f));
+
+        __m128 P = _mm_set1_ps(Log2C6);
+        P = _mm_add_ps(_mm_mul_ps(P, F), _mm_set1_ps(Log2C5));
+        P = _mm_add_ps(_mm_mul_ps(P, F), _mm_set1_ps(Log2C4));
+        P = _mm_add_ps(_mm_mul_ps(P, F), _mm_set1_ps(Log2C3));
+        P = _mm_add_ps(_mm_mul_ps(P, F), _mm_set1_ps(Log2C2));
+        P = _mm_add_ps(_mm_mul_ps(P, F), _mm_set1_ps(Log2C1));
+        P = _mm_add_ps(_mm_mul_ps(P, F), _mm_set1_ps(Log2C0));
+        P = _mm_mul_ps(P, F);
+        return _mm_add_ps(P, Exponent);
+    }
+
+    template<EMLDepthEncoding Encoding>
+    FORCEINLINE __m128i QuantizeSSE(const float* Src, const FKernelConstants& K, __m128 QuantScale)
+    {
+        // _mm_max_ps/_mm_min_ps return the second operand on NaN, matching the scalar ternaries
+        __m128 D = _mm_loadu_ps(Src);
+        D = _mm_max_ps(D, _mm_set1_ps(K.MinDepth));
+        D = _mm_min_ps(D, _mm_set1_ps(K.MaxDepth));
+
+        __m128 X = D;
+        if constexpr (Encoding == EMLDepthEncoding::Inverse)
+        {
+            X = _mm_div_ps(_mm_set1_ps(1.0f), D);
+        }
+        else if constexpr (Encoding == EMLDepthEncoding::Log)
+        {
+            X = Log2SSE(D);
+        }
+
+        __m128 T = _mm_mul_ps(_mm_sub_ps(X, _mm_set1_ps(K.Offset)), _mm_set1_ps(K.Scale));
+        T = _mm_max_ps(T, _mm_setzero_ps());
+        T = _mm_min_ps(T, _mm_set1_ps(1.0f));
+        return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(T, QuantScale), _mm_set1_ps(0.5f)));
+    }
+
+    template<EMLDepthEncoding Encoding>
+    void RowSSE_U8(const float* Src, uint8* Dst, int32 Count, const FKernelConstants& K)
+    {
+        const __m128 QuantScale = _mm_set1_ps(255.0f);
+        int32 i = 0;
+        for (; i + 16 <= Count; i += 16)
+        {
+            const __m128i Q0 = QuantizeSSE<Encoding>(Src + i, K, QuantScale);
+            const __m128i Q1 = QuantizeSSE<Encoding>(Src + i + 4, K, QuantScale);
+            const __m128i Q2 = QuantizeSSE<Encoding>(Src + i + 8, K, QuantScale);
+            const __m128i Q3 = QuantizeSSE<Encoding>(Src + i + 12, K, QuantScale);
+            const __m128i Packed = _mm_packus_epi16(_mm_packs_epi32(Q0, Q1), _mm_packs_epi32(Q2, Q3));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(Dst + i), Packed);
+        }
+        RowScalar<Encoding, uint8>(Src, Dst, i, Count, K);
+    }
+
+    template<EMLDepthEncoding Encoding>
+    void RowSSE_U16(const float* Src, uint16* Dst, int32 Count, const FKernelConstants& K)
+    {
+        // SSE2 has no unsigned 32->16 pack: bias into int16 range, signed pack, then flip the top bit back
+        const __m128 QuantScale = _mm_set1_ps(65535.0f);
+        const __m128i Bias = _mm_set1_epi32(32768);
+        const __m128i SignFlip = _mm_set1_epi16(static_cast<int16>(0x8000));
+        int32 i = 0;
+        for (; i + 8 <= Count; i += 8)
+        {
+            const __m128i Q0 = _mm_sub_epi32(QuantizeSSE<Encoding>(Src + i, K, QuantScale), Bias);
+            const __m128i Q1 = _mm_sub_epi32(QuantizeSSE<Encoding>(Src + i + 4, K, QuantScale), Bias);
+            const __m128i Packed = _mm_xor_si128(_mm_packs_epi32(Q0, Q1), SignFlip);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(Dst + i), Packed);
+        }
+        RowScalar<Encoding, uint16>(Src, Dst, i, Count, K);
+    }
+
+    // AVX2
+
+    ML_TARGET_AVX2 FORCEINLINE __m256 Log2AVX2(__m256 X)
+    {
+        const __m256i Bits = _mm256_castps_si256(X);
+        const __m256i ExponentBits = _mm256_sub_epi32(_mm256_and_si256(_mm256_srli_epi32(Bits, 23), _mm256_set1_epi32(0xFF)), _mm256_set1_epi32(127));
+        const __m256 Exponent = _mm256_cvtepi32_ps(ExponentBits);
+        __m256 F = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(Bits, _mm256_set1_epi32(0x007FFFFF)), _mm256_set1_epi32(0x3F800000)));
+        F = _mm256_sub_ps(F, _mm256_set1_ps(1.0f));
+
+        __m256 P = _mm256_set1_ps(Log2C6);
+        P = _mm256_add_ps(_mm256_mul_ps(P, F), _mm256_set1_ps(Log2C5));
+        P = _mm256_add_ps(_mm256_mul_ps(P, F), _mm256_set1_ps(Log2C4));
+        P = _mm256_add_ps(_mm256_mul_ps(P, F), _mm256_set1_ps(Log2C3));
+        P = _mm256_add_ps(_mm256_mul_ps(P, F), _mm256_set1_ps(Log2C2));
+        P = _mm256_add_ps(_mm256_mul_ps(P, F), _mm256_set1_ps(Log2C1));
+        P = _mm256_add_ps(_mm256_mul_ps(P, F), _mm256_set1_ps(Log2C0));
+        P = _mm256_mul_ps(P, F);
+        return _mm256_add_ps(P, Exponent);
+    }
+
+    template<EMLDepthEncoding Encoding>
+    ML_TARGET_AVX2 FORCEINLINE __m256i QuantizeAVX2(const float* Src, const FKernelConstants& K, __m256 QuantScale)
+    {
+        __m256 D = _mm256_loadu_ps(Src);
+        D = _mm256_max_ps(D, _mm256_set1_ps(K.MinDepth));
+        D = _mm256_min_ps(D, _mm256_set1_ps(K.MaxDepth));
+
+        __m256 X = D;
+        if constexpr (Encoding == EMLDepthEncoding::Inverse)
+        {
+            X = _mm256_div_ps(_mm256_set1_ps(1.0f), D);
+        }
+        else if constexpr (Encoding == EMLDepthEncoding::Log)
+        {
+            X = Log2AVX2(D);
+        }
+
+        __m256 T = _mm256_mul_ps(_mm256_sub_ps(X, _mm256_set1_ps(K.Offset)), _mm256_set1_ps(K.Scale));
+        T = _mm256_max_ps(T, _mm256_setzero_ps());
+        T = _mm256_min_ps(T, _mm256_set1_ps(1.0f));
+        return _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(T, QuantScale), _mm256_set1_ps(0.5f)));
+    }
+
+    template<EMLDepthEncoding Encoding>
+    ML_TARGET_AVX2 void RowAVX2_U8(const float* Src, uint8* Dst, int32 Count, const FKernelConstants& K)
+    {
+        const __m256 QuantScale = _mm256_set1_ps(255.0f);
+        // Packs work per 128-bit lane; this permutation restores linear order
+        const __m256i LaneOrder = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+        int32 i = 0;
+        for (; i + 32 <= Count; i += 32)
+        {
+            const __m256i Q0 = QuantizeAVX2<Encoding>(Src + i, K, QuantScale);
+            const __m256i Q1 = QuantizeAVX2<Encoding>(Src + i + 8, K, QuantScale);
+            const __m256i Q2 = QuantizeAVX2<Encoding>(Src + i + 16, K, QuantScale);
+            const __m256i Q3 = QuantizeAVX2<Encoding>(Src + i + 24, K, QuantScale);
+            const __m256i Packed = _mm256_packus_epi16(_mm256_packs_epi32(Q0, Q1), _mm256_packs_epi32(Q2, Q3));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(Dst + i), _mm256_permutevar8x32_epi32(Packed, LaneOrder));
+        }
+        RowScalar<Encoding, uint8>(Src, Dst, i, Count, K);
+    }
+
+    template<EMLDepthEncoding Encoding>
+    ML_TARGET_AVX2 void RowAVX2_U16(const float* Src, uint16* Dst, int32 Count, const FKernelConstants& K)
+    {
+        const __m256 QuantScale = _mm256_set1_ps(65535.0f);
+        const __m256i Bias = _mm256_set1_epi32(32768);
+        const __m256i SignFlip = _mm256_set1_epi16(static_cast<int16>(0x8000));
+        int32 i = 0;
+        for (; i + 16 <= Count; i += 16)
+        {
+            const __m256i Q0 = _mm256_sub_epi32(QuantizeAVX2<Encoding>(Src + i, K, QuantScale), Bias);
+            const __m256i Q1 = _mm256_sub_epi32(QuantizeAVX2<Encoding>(Src + i + 8, K, QuantScale), Bias);
+            const __m256i Packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(Q0, Q1), 0xD8);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(Dst + i), _mm256_xor_si256(Packed, SignFlip));
+        }
+        RowScalar<Encoding, uint16>(Src, Dst, i, Count, K);
+    }
+
+    bool DetectAVX2()
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        int Info[4];
+        __cpuid(Info, 0);
+        if (Info[0] < 7)
+            return false;
+        __cpuid(Info, 1);
+        const bool bOSXSave = (Info[2] & (1 << 27)) != 0;
+        const bool bAVX = (Info[2] & (1 << 28)) != 0;
+        if (!bOSXSave || !bAVX || (_xgetbv(0) & 0x6) != 0x6)
+            return false;
+        __cpuidex(Info, 7, 0);
+        return (Info[1] & (1 << 5)) != 0;
+#else
+        unsigned int A = 0, B = 0, C = 0, D = 0;
+        if (!__get_cpuid(1, &A, &B, &C, &D))
+            return false;
+        if (!(C & bit_OSXSAVE) || !(C & bit_AVX))
+            return false;
+        unsigned int XcrLow = 0, XcrHigh = 0;
+        __asm__ volatile("xgetbv" : "=a"(XcrLow), "=d"(XcrHigh) : "c"(0));
+        if ((XcrLow & 0x6) != 0x6)
+            return false;
+        if (!__get_cpuid_count(7, 0, &A, &B, &C, &D))
+            return false;
+        return (B & bit_AVX2) != 0;
+#endif
+    }
+#endif // ML_DEPTH_SSE
+
+#if ML_DEPTH_NEON
+    // NEON (AArch64)
+
+    FORCEINLINE float32x4_t SelectGreater(float32x4_t A, float32x4_t B)
+    {
+        // A > B ? A : B, with the scalar path's NaN behaviour
+        return vbslq_f32(vcgtq_f32(A, B), A, B);
+    }
+
+    FORCEINLINE float32x4_t SelectLess(float32x4_t A, float32x4_t B)
+    {
+        return vbslq_f32(vcltq_f32(A, B), A, B);
+    }
+
+    FORCEINLINE float32x4_t Log2NEON(float32x4_t X)
+    {
+        const uint32x4_t Bits = vreinterpretq_u32_f32(X);
+        const int32x4_t ExponentBits = vsubq_s32(vreinterpretq_s32_u32(vandq_u32(vshrq_n_u32(Bits, 23), vdupq_n_u32(0xFF))), vdupq_n_s32(127));
+        const float32x4_t Exponent = vcvtq_f32_s32(ExponentBits);
+        float32x4_t F = vreinterpretq_f32_u32(vorrq_u32(vandq_u32(Bits, vdupq_n_u32(0x007FFFFF)), vdupq_n_u32(0x3F800000)));
+        F = vsubq_f32(F, vdupq_n_f32(1.0f));
+
+        // Separate multiply and add; vfmaq would round differently from the scalar reference
+        float32x4_t P = vdupq_n_f32(Log2C6);
+        P = vaddq_f32(vmulq_f32(P, F), vdupq_n_f32(Log2C5));
+        P = vaddq_f32(vmulq_f32(P, F), vdupq_n_f32(Log2C4));
+        P = vaddq_f32(vmulq_f32(P, F), vdupq_n_f32(Log2C3));
+        P = vaddq_f32(vmulq_f32(P, F), vdupq_n_f32(Log2C2));
+        P = vaddq_f32(vmulq_f32(P, F), vdupq_n_f32(Log2C1));
+        P = vaddq_f32(vmulq_f32(P, F), vdupq_n_f32(Log2C0));
+        P = vmulq_f32(P, F);
+        return vaddq_f32(P, Exponent);
+    }
+
+    template<EMLDepthEncoding Encoding>
+    FORCEINLINE uint32x4_t QuantizeNEON(const float* Src, const FKernelConstants& K, float32x4_t QuantScale)
+    {
+        float32x4_t D = vld1q_f32(Src);
+        D = SelectGreater(D, vdupq_n_f32(K.MinDepth));
+        D = SelectLess(D, vdupq_n_f32(K.MaxDepth));
+
+        float32x4_t X = D;
+        if constexpr (Encoding == EMLDepthEncoding::Inverse)
+        {
+            X = vdivq_f32(vdupq_n_f32(1.0f), D);
+        }
+        else if constexpr (Encoding == EMLDepthEncoding::Log)
+        {
+            X = Log2NEON(D);
+        }
+
+        float32x4_t T = vmulq_f32(vsubq_f32(X, vdupq_n_f32(K.Offset)), vdupq_n_f32(K.Scale));
+        T = SelectGreater(T, vdupq_n_f32(0.0f));
+        T = SelectLess(T, vdupq_n_f32(1.0f));
+        return vcvtq_u32_f32(vaddq_f32(vmulq_f32(T, QuantScale), vdupq_n_f32(0.5f)));
+    }
+
+    template<EMLDepthEncoding Encoding>
+    void RowNEON_U8(const float* Src, uint8* Dst, int32 Count, const FKernelConstants& K)
+    {
+        const float32x4_t QuantScale = vdupq_n_f32(255.0f);
+        int32 i = 0;
+        for (; i + 16 <= Count; i += 16)
+        {
+            const uint16x8_t Low = vcombine_u16(vqmovn_u32(QuantizeNEON<Encoding>(Src + i, K, QuantScale)), vqmovn_u32(QuantizeNEON<Encoding>(Src + i + 4, K, QuantScale)));
+            const uint16x8_t High = vcombine_u16(vqmovn_u32(QuantizeNEON<Encoding>(Src + i + 8, K, QuantScale)), vqmovn_u32(QuantizeNEON<Encoding>(Src + i + 12, K, QuantScale)));
+            vst1q_u8(Dst + i, vcombine_u8(vqmovn_u16(Low), vqmovn_u16(High)));
+        }
+        RowScalar<Encoding, uint8>(Src, Dst, i, Count, K);
+    }
+
+    template<EMLDepthEncoding Encoding>
+    void RowNEON_U16(const float* Src, uint16* Dst, int32 Count, const FKernelConstants& K)
+    {
+        const float32x4_t QuantScale = vdupq_n_f32(65535.0f);
+        int32 i = 0;
+        for (; i + 8 <= Count; i += 8)
+        {
+            vst1q_u16(Dst + i, vcombine_u16(vqmovn_u32(QuantizeNEON<Encoding>(Src + i, K, QuantScale)), vqmovn_u32(QuantizeNEON<Encoding>(Src + i + 4, K, QuantScale))));
+        }
+        RowScalar<Encoding, uint16>(Src, Dst, i, Count, K);
+    }
+#endif // ML_DEPTH_NEON
+
+    template<EMLDepthEncoding Encoding>
+    void DispatchU8(const float* Src, uint8* Dst, int32 Count, const FKernelConstants& K, EKernelPath Path)
+    {
+        switch (Path)
+        {
+#if ML_DEPTH_SSE
+        case EKernelPath::SSE2: RowSSE_U8<Encoding>(Src, Dst, Count, K); return;
+        case EKernelPath::AVX2: RowAVX2_U8<Encoding>(Src, Dst, Count, K); return;
+#endif
+#if ML_DEPTH_NEON
+        case EKernelPath::NEON: RowNEON_U8<Encoding>(Src, Dst, Count, K); return;
+#endif
+        default: RowScalar<Encoding, uint8>(Src, Dst, 0, Count, K); return;
+        }
+    }
+
+    template<EMLDepthEncoding Encoding>
+    void DispatchU16(const float* Src, uint16* Dst, int32 Count, const FKernelConstants& K, EKernelPath Path)
+    {
+        switch (Path)
+        {
+#if ML_DEPTH_SSE
+        case EKernelPath::SSE2: RowSSE_U16<Encoding>(Src, Dst, Count, K); return;
+        case EKernelPath::AVX2: RowAVX2_U16<Encoding>(Src, Dst, Count, K); return;
+#endif
+#if ML_DEPTH_NEON
+        case EKernelPath::NEON: RowNEON_U16<Encoding>(Src, Dst, Count, K); return;
+#endif
+        default: RowScalar<Encoding, uint16>(Src, Dst, 0, Count, K); return;
+        }
+    }
+
+    EKernelPath ResolvePath(EKernelPath Path)
+    {
+        return (Path == EKernelPath::Count || !IsPathSupported(Path)) ? GetBestPath() : Path;
+    }
+
+    void QuantizeRow(const float* Src, void* Dst, int32 Count, bool b16Bit, EMLDepthEncoding Encoding, const FKernelConstants& K, EKernelPath Path)
+    {
+        switch (Encoding)
+        {
+        case EMLDepthEncoding::Linear:
+            b16Bit ? DispatchU16<EMLDepthEncoding::Linear>(Src, static_cast<uint16*>(Dst), Count, K, Path)
+                   : DispatchU8<EMLDepthEncoding::Linear>(Src, static_cast<uint8*>(Dst), Count, K, Path);
+            break;
+        case EMLDepthEncoding::Inverse:
+            b16Bit ? DispatchU16<EMLDepthEncoding::Inverse>(Src, static_cast<uint16*>(Dst), Count, K, Path)
+                   : DispatchU8<EMLDepthEncoding::Inverse>(Src, static_cast<uint8*>(Dst), Count, K, Path);
+            break;
+        case EMLDepthEncoding::Log:
+            b16Bit ? DispatchU16<EMLDepthEncoding::Log>(Src, static_cast<uint16*>(Dst), Count, K, Path)
+                   : DispatchU8<EMLDepthEncoding::Log>(Src, static_cast<uint8*>(Dst), Count, K, Path);
+            break;
+        }
+    }
+}
+
+bool IsPathSupported(EKernelPath Path)
+{
+    switch (Path)
+    {
+    case EKernelPath::Scalar:
+        return true;
+#if ML_DEPTH_SSE
+    case EKernelPath::SSE2:
+        return true;
+    case EKernelPath::AVX2:
+    {
+        static const bool bHasAVX2 = DetectAVX2();
+        return bHasAVX2;
+    }
+#endif
+#if ML_DEPTH_NEON
+    case EKernelPath::NEON:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+EKernelPath GetBestPath()
+{
+    if (IsPathSupported(EKernelPath::AVX2)) return EKernelPath::AVX2;
+    if (IsPathSupported(EKernelPath::NEON)) return EKernelPath::NEON;
+    if (IsPathSupported(EKernelPath::SSE2)) return EKernelPath::SSE2;
+    return EKernelPath::Scalar;
+}
+
+const TCHAR* GetPathName(EKernelPath Path)
+{
+    switch (Path)
+    {
+    case EKernelPath::Scalar: return TEXT("Scalar");
+    case EKernelPath::SSE2:   return TEXT("SSE2");
+    case EKernelPath::AVX2:   return TEXT("AVX2");
+    case EKernelPath::NEON:   return TEXT("NEON");
+    default:                  return TEXT("Unknown");
+    }
+}
+
+void QuantizeToU8(const float* Src, uint8* Dst, int32 Count, const FParams& Params, EKernelPath Path)
+{
+    QuantizeRow(Src, Dst, Count, false, Params.Encoding, MakeConstants(Params), ResolvePath(Path));
+}
+
+void QuantizeToU16(const float* Src, uint16* Dst, int32 Count, const FParams& Params, EKernelPath Path)
+{
+    QuantizeRow(Src, Dst, Count, true, Params.Encoding, MakeConstants(Params), ResolvePath(Path));
+}
+
+void QuantizeImage(const float* Src, int32 Width, int32 Height, void* Dst, bool b16Bit, const FParams& Params, EKernelPath Path)
+{
+    if (Width <= 0 || Height <= 0)
+        return;
+
+    ML_CAPTURE_SCOPE(STAT_MLCapture_Quantize);
+    const FKernelConstants K = MakeConstants(Params);
+    const EKernelPath ResolvedPath = ResolvePath(Path);
+    const int32 BytesPerOut = b16Bit ? 2 : 1;
+
+    // Blocks of rows keep task overhead small relative to the per-row work
+    const int32 RowsPerTask = FMath::Max(1, 16384 / Width);
+    const int32 NumTasks = FMath::DivideAndRoundUp(Height, RowsPerTask);
+
+    ParallelFor(NumTasks, [&](int32 TaskIndex)
+    {
+        const int32 FirstRow = TaskIndex * RowsPerTask;
+        const int32 LastRow = FMath::Min(Height, FirstRow + RowsPerTask);
+        const int64 Offset = static_cast<int64>(FirstRow) * Width;
+        const int32 Count = (LastRow - FirstRow) * Width;
+
+        QuantizeRow(Src + Offset, static_cast<uint8*>(Dst) + Offset * BytesPerOut, Count, b16Bit, Params.Encoding, K, ResolvedPath);
+    });
+}
+
+FMLCapturedFramePtr MakeMLDepthFrame(const FMLCapturedFrame& DepthFrame, bool b16Bit, const FParams& Params)
+{
+    if (DepthFrame.PixelFormat != PF_R32_FLOAT || DepthFrame.Pixels.Num() < DepthFrame.Width * DepthFrame.Height * 4)
+        return nullptr;
+
+    FMLCapturedFramePtr Frame = MakeShared<FMLCapturedFrame, ESPMode::ThreadSafe>();
+    Frame->FrameIndex = DepthFrame.FrameIndex;
+    Frame->CameraIndex = DepthFrame.CameraIndex;
+    Frame->BufferType = EMLBufferType::MLDepth;
+    Frame->Width = DepthFrame.Width;
+    Frame->Height = DepthFrame.Height;
+    Frame->PixelFormat = b16Bit ? PF_G16 : PF_G8;
+    Frame->BytesPerPixel = b16Bit ? 2 : 1;
+    Frame->CameraPose = DepthFrame.CameraPose;
+    Frame->FOVAngle = DepthFrame.FOVAngle;
+    Frame->SceneStateHash = DepthFrame.SceneStateHash;
+    Frame->Pixels.SetNumUninitialized(Frame->Width * Frame->Height * Frame->BytesPerPixel);
+
+    QuantizeImage(reinterpret_cast<const float*>(DepthFrame.Pixels.GetData()), Frame->Width, Frame->Height, Frame->Pixels.GetData(), b16Bit, Params);
+    return Frame;
+}
+
+namespace
+{
+    // Throughput of every supported path in GB/s of depth input. Bit-exactness against the scalar reference is
+    // covered by the cameratester.DepthQuantization automation tests.
+    void RunKernelBenchmark()
+    {
+        constexpr int32 Width = 2048;
+        constexpr int32 Height = 2048;
+        constexpr int32 Iterations = 10;
+
+        TArray<float> Depth;
+        Depth.SetNumUninitialized(Width * Height);
+        FRandomStream Stream(42);
+        for (float& Value : Depth)
+        {
+            Value = Stream.FRandRange(-100.0f, 15000.0f);
+        }
+
+        TArray<uint8> Output;
+        Output.SetNumUninitialized(Width * Height * 2);
+
+        const EMLDepthEncoding Encodings[] = { EMLDepthEncoding::Linear, EMLDepthEncoding::Inverse, EMLDepthEncoding::Log };
+        for (const EMLDepthEncoding Encoding : Encodings)
+        {
+            for (const bool b16Bit : { false, true })
+            {
+                FParams Params;
+                Params.Encoding = Encoding;
+
+                for (uint8 PathIndex = 0; PathIndex < static_cast<uint8>(EKernelPath::Count); ++PathIndex)
+                {
+                    const EKernelPath Path = static_cast<EKernelPath>(PathIndex);
+                    if (!IsPathSupported(Path))
+                        continue;
+
+                    // Warm-up pass
+                    QuantizeImage(Depth.GetData(), Width, Height, Output.GetData(), b16Bit, Params, Path);
+
+                    const double Start = FPlatformTime::Seconds();
+                    for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+                    {
+                        QuantizeImage(Depth.GetData(), Width, Height, Output.GetData(), b16Bit, Params, Path);
+                    }
+                    const double Seconds = FPlatformTime::Seconds() - Start;
+                    const double GBPerSecond = (static_cast<double>(Depth.Num()) * sizeof(float) * Iterations) / Seconds / 1.0e9;
+
+                    UE_LOG(LogMLCapture, Display, TEXT("DepthKernels %-7s %-7s %s: %6.2f GB/s"),
+                        *UEnum::GetDisplayValueAsText(Encoding).ToString(), b16Bit ? TEXT("uint16") : TEXT("uint8"),
+                        GetPathName(Path), GBPerSecond);
+                }
+            }
+        }
+    }
+
+    FAutoConsoleCommand DepthKernelBenchmarkCommand(
+        TEXT("ml.DepthKernels.Benchmark"),
+        TEXT("Report the throughput of each supported depth quantization kernel path in GB/s"),
+        FConsoleCommandDelegate::CreateStatic(&RunKernelBenchmark));
+}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MLCaptureTypes.h"
+#include "DepthQuantization.generated.h"
+
+// How scene depth is mapped to [0, 1] before quantization
+UENUM(BlueprintType)
+enum class EMLDepthEncoding : uint8
+{
+    // d / MaxDepth
+    Linear,
+    // (1/d - 1/Max) / (1/Min - 1/Max): more precision up close
+    Inverse,
+    // log(d/Min) / log(Max/Min)
+    Log
+};
+
+// Converts read-back R32f SceneDepth into normalized uint8/uint16 depth for ML.
+// Every kernel has a scalar reference and SSE2/AVX2/NEON paths that produce bit-identical output:
+// the SIMD paths use the same operation order, IEEE division and a shared polynomial log2, and never FMA.
+namespace DepthQuantization
+{
+    enum class EKernelPath : uint8
+    {
+        Scalar,
+        SSE2,
+        AVX2,
+        NEON,
+        Count
+    };
+
+    struct FParams
+    {
+        EMLDepthEncoding Encoding = EMLDepthEncoding::Linear;
+        float MinDepth = 10.0f;      // Near clamp (cm); also the zero point of Inverse/Log
+        float MaxDepth = 10000.0f;   // Far clamp (cm), ARenderTargetManager::MaxDepthDistance
+    };
+
+    CAMERATESTER_API bool IsPathSupported(EKernelPath Path);
+    CAMERATESTER_API EKernelPath GetBestPath();
+    CAMERATESTER_API const TCHAR* GetPathName(EKernelPath Path);
+
+    // One row (or any contiguous run) of depth values
+    CAMERATESTER_API void QuantizeToU8(const float* Src, uint8* Dst, int32 Count, const FParams& Params, EKernelPath Path = EKernelPath::Count);
+    CAMERATESTER_API void QuantizeToU16(const float* Src, uint16* Dst, int32 Count, const FParams& Params, EKernelPath Path = EKernelPath::Count);
+
+    // Whole image split over rows with ParallelFor. Path::Count picks the best supported path.
+    CAMERATESTER_API void QuantizeImage(const float* Src, int32 Width, int32 Height, void* Dst, bool b16Bit, const FParams& Params, EKernelPath Path = EKernelPath::Count);
+
+    // New G8/G16 frame carrying the same camera, index, pose and scene hash as an R32f SceneDepth frame; any thread
+    CAMERATESTER_API FMLCapturedFramePtr MakeMLDepthFrame(const FMLCapturedFrame& DepthFrame, bool b16Bit, const FParams& Params);
+}
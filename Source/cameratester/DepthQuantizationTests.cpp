@@ -0,0 +1,214 @@
+#include "DepthQuantization.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+#include <cmath>
+#include <limits>
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+    using namespace DepthQuantization;
+
+    constexpr EAutomationTestFlags DepthTestFlags = EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter;
+
+    const EMLDepthEncoding TestEncodings[] = { EMLDepthEncoding::Linear, EMLDepthEncoding::Inverse, EMLDepthEncoding::Log };
+
+    // Default clamps, a short indoor range and a range wide enough to stress the log fit
+    TArray<FParams> MakeTestParams()
+    {
+        TArray<FParams> Result;
+        for (const EMLDepthEncoding Encoding : TestEncodings)
+        {
+            const float Ranges[][2] = { { 10.0f, 10000.0f }, { 37.5f, 2500.0f }, { 0.5f, 200000.0f } };
+            for (const auto& Range : Ranges)
+            {
+                FParams& Params = Result.AddDefaulted_GetRef();
+                Params.Encoding = Encoding;
+                Params.MinDepth = Range[0];
+                Params.MaxDepth = Range[1];
+            }
+        }
+        return Result;
+    }
+
+    // Random depths around the clamps with every edge value repeated, so each lands in head, body and tail lanes
+    TArray<float> MakeTestDepths(const FParams& Params, int32 Num)
+    {
+        const float Edges[] = {
+            0.0f, -0.0f, -1.0f, -1.0e30f, Params.MinDepth, Params.MaxDepth, Params.MaxDepth * 4.0f, 1.0e30f,
+            TNumericLimits<float>::Quiet_NaN(), -TNumericLimits<float>::Quiet_NaN(),
+            std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(),
+            TNumericLimits<float>::Min(), 1.0e-40f,
+            std::nextafter(Params.MinDepth, 0.0f), std::nextafter(Params.MaxDepth, TNumericLimits<float>::Max())
+        };
+
+        FRandomStream Stream(0x5EED + Num);
+        TArray<float> Depths;
+        Depths.SetNumUninitialized(Num);
+        for (int32 Index = 0; Index < Num; ++Index)
+        {
+            Depths[Index] = (Index % 3 == 0)
+                ? Edges[(Index / 3) % UE_ARRAY_COUNT(Edges)]
+                : Stream.FRandRange(-0.1f * Params.MaxDepth, 1.5f * Params.MaxDepth);
+        }
+        return Depths;
+    }
+
+    FString DescribeCase(const FParams& Params, bool b16Bit, EKernelPath Path, int32 Width)
+    {
+        return FString::Printf(TEXT("%s %s [%g, %g] %s width %d"), *UEnum::GetDisplayValueAsText(Params.Encoding).ToString(),
+            b16Bit ? TEXT("uint16") : TEXT("uint8"), Params.MinDepth, Params.MaxDepth, GetPathName(Path), Width);
+    }
+
+    // Quantizes Src with Path into Out, which must match Reference byte for byte
+    template<typename OutType>
+    bool CheckRow(FAutomationTestBase& Test, const TArray<float>& Src, int32 SrcOffset, int32 Width, const FParams& Params, EKernelPath Path,
+        TArray<OutType>& Reference, TArray<OutType>& Out)
+    {
+        Reference.SetNumUninitialized(Width);
+        Out.SetNumUninitialized(Width);
+        if constexpr (sizeof(OutType) == 2)
+        {
+            QuantizeToU16(Src.GetData() + SrcOffset, Reference.GetData(), Width, Params, EKernelPath::Scalar);
+            QuantizeToU16(Src.GetData() + SrcOffset, Out.GetData(), Width, Params, Path);
+        }
+        else
+        {
+            QuantizeToU8(Src.GetData() + SrcOffset, Reference.GetData(), Width, Params, EKernelPath::Scalar);
+            QuantizeToU8(Src.GetData() + SrcOffset, Out.GetData(), Width, Params, Path);
+        }
+
+        for (int32 Index = 0; Index < Width; ++Index)
+        {
+            if (Out[Index] != Reference[Index])
+            {
+                Test.AddError(FString::Printf(TEXT("%s, offset %d: value %d (depth %g) is %u, scalar gives %u"),
+                    *DescribeCase(Params, sizeof(OutType) == 2, Path, Width), SrcOffset, Index, Src[SrcOffset + Index],
+                    static_cast<uint32>(Out[Index]), static_cast<uint32>(Reference[Index])));
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMLDepthKernelsBitExactTest, "cameratester.DepthQuantization.SIMDBitExact", DepthTestFlags)
+
+bool FMLDepthKernelsBitExactTest::RunTest(const FString& Parameters)
+{
+    // Every width up to two AVX2 vectors, then a few large ones with ragged tails
+    TArray<int32> Widths;
+    for (int32 Width = 1; Width <= 33; ++Width)
+    {
+        Widths.Add(Width);
+    }
+    Widths.Append({ 63, 64, 65, 1023, 1029 });
+
+    TArray<uint8> Reference8, Out8;
+    TArray<uint16> Reference16, Out16;
+    int32 NumPaths = 0;
+    for (uint8 PathIndex = 0; PathIndex < static_cast<uint8>(EKernelPath::Count); ++PathIndex)
+    {
+        const EKernelPath Path = static_cast<EKernelPath>(PathIndex);
+        if (Path == EKernelPath::Scalar || !IsPathSupported(Path))
+            continue;
+
+        ++NumPaths;
+        for (const FParams& Params : MakeTestParams())
+        {
+            const TArray<float> Depths = MakeTestDepths(Params, 1029 + 3);
+            for (const int32 Width : Widths)
+            {
+                // Offset 1 makes every SIMD load unaligned
+                for (const int32 Offset : { 0, 1 })
+                {
+                    if (!CheckRow(*this, Depths, Offset, Width, Params, Path, Reference8, Out8)
+                        || !CheckRow(*this, Depths, Offset, Width, Params, Path, Reference16, Out16))
+                        return false;
+                }
+            }
+        }
+    }
+
+    if (NumPaths == 0)
+    {
+        AddInfo(TEXT("No SIMD depth kernel path is supported on this CPU; only the scalar reference ran"));
+    }
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMLDepthKernelsImageTest, "cameratester.DepthQuantization.ImageBitExact", DepthTestFlags)
+
+bool FMLDepthKernelsImageTest::RunTest(const FString& Parameters)
+{
+    // Odd width, so rows split over ParallelFor never start on a vector boundary
+    constexpr int32 Width = 333;
+    constexpr int32 Height = 67;
+
+    TArray<uint8> Reference, Out;
+    for (const FParams& Params : MakeTestParams())
+    {
+        const TArray<float> Depths = MakeTestDepths(Params, Width * Height);
+        for (const bool b16Bit : { false, true })
+        {
+            const int32 OutBytes = Width * Height * (b16Bit ? 2 : 1);
+            Reference.SetNumUninitialized(OutBytes);
+            Out.SetNumUninitialized(OutBytes);
+            QuantizeImage(Depths.GetData(), Width, Height, Reference.GetData(), b16Bit, Params, EKernelPath::Scalar);
+
+            for (uint8 PathIndex = 0; PathIndex < static_cast<uint8>(EKernelPath::Count); ++PathIndex)
+            {
+                const EKernelPath Path = static_cast<EKernelPath>(PathIndex);
+                if (Path == EKernelPath::Scalar || !IsPathSupported(Path))
+                    continue;
+
+                QuantizeImage(Depths.GetData(), Width, Height, Out.GetData(), b16Bit, Params, Path);
+                if (FMemory::Memcmp(Reference.GetData(), Out.GetData(), OutBytes) != 0)
+                {
+                    AddError(FString::Printf(TEXT("%s: image differs from the scalar reference"), *DescribeCase(Params, b16Bit, Path, Width)));
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMLDepthKernelsScalarTest, "cameratester.DepthQuantization.ScalarReference", DepthTestFlags)
+
+bool FMLDepthKernelsScalarTest::RunTest(const FString& Parameters)
+{
+    // The reference itself: clamps and the ends of each encoding's range
+    for (const EMLDepthEncoding Encoding : TestEncodings)
+    {
+        FParams Params;
+        Params.Encoding = Encoding;
+        Params.MinDepth = 25.0f;
+        Params.MaxDepth = 5000.0f;
+
+        const bool bNearIsZero = Encoding != EMLDepthEncoding::Inverse;
+        const float Depths[] = { Params.MinDepth, Params.MaxDepth, -1.0f, Params.MaxDepth * 2.0f, std::numeric_limits<float>::infinity() };
+        const uint16 Expected16[] = {
+            static_cast<uint16>(bNearIsZero ? (Encoding == EMLDepthEncoding::Linear ? 328 : 0) : 65535),
+            static_cast<uint16>(bNearIsZero ? 65535 : 0),
+            static_cast<uint16>(bNearIsZero ? 0 : 65535),
+            static_cast<uint16>(bNearIsZero ? 65535 : 0),
+            static_cast<uint16>(bNearIsZero ? 65535 : 0)
+        };
+
+        uint16 Out16[UE_ARRAY_COUNT(Depths)];
+        uint8 Out8[UE_ARRAY_COUNT(Depths)];
+        QuantizeToU16(Depths, Out16, UE_ARRAY_COUNT(Depths), Params, EKernelPath::Scalar);
+        QuantizeToU8(Depths, Out8, UE_ARRAY_COUNT(Depths), Params, EKernelPath::Scalar);
+        for (int32 Index = 0; Index < UE_ARRAY_COUNT(Depths); ++Index)
+        {
+            const FString Case = FString::Printf(TEXT("%s depth %g"), *UEnum::GetDisplayValueAsText(Encoding).ToString(), Depths[Index]);
+            TestEqual(*(Case + TEXT(" (uint16)")), static_cast<int32>(Out16[Index]), static_cast<int32>(Expected16[Index]));
+            TestEqual(*(Case + TEXT(" (uint8)")), static_cast<int32>(Out8[Index]), (static_cast<int32>(Expected16[Index]) * 255 + 32767) / 65535);
+        }
+    }
+    return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,465 @@
+#include "FrameEncoder.h"
+#include "MLCaptureStats.h"
+#include "TemporalFrameCodec.h"
+#include "CaptureIndex.h"
+#include "IImageWrapper.h"
+#include "IImageWrapperModule.h"
+#include "Misc/Compression.h"
+#include "Modules/ModuleManager.h"
+
+namespace
+{
+    // Each word minus the same channel of the previous pixel in its row. Decode with a running sum per channel.
+    template<typename WordType>
+    void EncodeRowDeltas(const uint8* Src, uint8* Dst, int32 Width, int32 Height, int32 Channels)
+    {
+        const int32 RowWords = Width * Channels;
+        const int64 RowBytes = static_cast<int64>(RowWords) * sizeof(WordType);
+        for (int32 Y = 0; Y < Height; ++Y)
+        {
+            const uint8* SrcRow = Src + Y * RowBytes;
+            uint8* DstRow = Dst + Y * RowBytes;
+            for (int32 i = 0; i < RowWords; ++i)
+            {
+                WordType Value;
+                WordType Previous = 0;
+                FMemory::Memcpy(&Value, SrcRow + i * sizeof(WordType), sizeof(WordType));
+                if (i >= Channels)
+                {
+                    FMemory::Memcpy(&Previous, SrcRow + (i - Channels) * sizeof(WordType), sizeof(WordType));
+                }
+                const WordType Delta = static_cast<WordType>(Value - Previous);
+                FMemory::Memcpy(DstRow + i * sizeof(WordType), &Delta, sizeof(WordType));
+            }
+        }
+    }
+
+    bool CompressInto(FName Format, const uint8* Src, int32 SrcBytes, TArray<uint8>& Out)
+    {
+        int32 CompressedBytes = FCompression::CompressMemoryBound(Format, SrcBytes);
+        Out.SetNumUninitialized(CompressedBytes, EAllowShrinking::No);
+        if (!FCompression::CompressMemory(Format, Out.GetData(), CompressedBytes, Src, SrcBytes, COMPRESS_BiasSpeed))
+            return false;
+
+        Out.SetNum(CompressedBytes, EAllowShrinking::No);
+        return true;
+    }
+
+    bool GetPNGFormat(EPixelFormat PixelFormat, ERGBFormat& OutFormat, int32& OutBitDepth)
+    {
+        switch (PixelFormat)
+        {
+        case PF_B8G8R8A8: OutFormat = ERGBFormat::BGRA; OutBitDepth = 8; return true;
+        case PF_R8G8B8A8: OutFormat = ERGBFormat::RGBA; OutBitDepth = 8; return true;
+        case PF_G8:       OutFormat = ERGBFormat::Gray; OutBitDepth = 8; return true;
+        case PF_G16:      OutFormat = ERGBFormat::Gray; OutBitDepth = 16; return true;
+        default:          return false;
+        }
+    }
+
+    // EXR is always written as half floats; 32-bit sources are converted first
+    bool GetEXRFormat(EPixelFormat PixelFormat, ERGBFormat& OutFormat, bool& bOutNeedsHalfConversion)
+    {
+        switch (PixelFormat)
+        {
+        case PF_R32_FLOAT:     OutFormat = ERGBFormat::GrayF; bOutNeedsHalfConversion = true;  return true;
+        case PF_R16F:          OutFormat = ERGBFormat::GrayF; bOutNeedsHalfConversion = false; return true;
+        case PF_A32B32G32R32F: OutFormat = ERGBFormat::RGBAF; bOutNeedsHalfConversion = true;  return true;
+        case PF_FloatRGBA:     OutFormat = ERGBFormat::RGBAF; bOutNeedsHalfConversion = false; return true;
+        default:               return false;
+        }
+    }
+}
+
+TArray<uint8> FFrameEncoder::FBufferPool::Acquire(int64 Capacity)
+{
+    TArray<uint8> Buffer;
+    {
+        FScopeLock ScopeLock(&Lock);
+        if (FreeBuffers.Num() > 0)
+        {
+            Buffer = FreeBuffers.Pop(EAllowShrinking::No);
+        }
+    }
+    // Keeps the existing allocation when it is already large enough
+    Buffer.Reset(static_cast<int32>(Capacity));
+    return Buffer;
+}
+
+void FFrameEncoder::FBufferPool::Release(TArray<uint8>&& Buffer)
+{
+    if (Buffer.Max() == 0)
+        return;
+
+    FScopeLock ScopeLock(&Lock);
+    if (FreeBuffers.Num() < MaxBuffers)
+    {
+        FreeBuffers.Add(MoveTemp(Buffer));
+    }
+}
+
+FFrameEncoder::FSharedState::FSharedState(const FFrameEncoderSettings& InSettings)
+    : Settings(InSettings)
+    , Pool(FMath::Max(InSettings.MaxFramesInFlight, 1) * 2)
+{
+    // Module loading has to happen on the game thread; wrapper creation from workers is fine afterwards
+    ImageWrapperModule = &FModuleManager::LoadModuleChecked<IImageWrapperModule>(FName(TEXT("ImageWrapper")));
+}
+
+FFrameEncoder::FFrameEncoder(const FFrameEncoderSettings& InSettings)
+    : Shared(MakeShared<FSharedState, ESPMode::ThreadSafe>(InSettings))
+{
+}
+
+FFrameEncoder::~FFrameEncoder()
+{
+    UE::Tasks::Wait(Tasks);
+
+    // Unclaimed frames reference the shared state through their pool deleter; drop them so it can be freed
+    FMLCapturedFramePtr Frame;
+    while (Shared->Completed.Dequeue(Frame))
+    {
+    }
+}
+
+bool FFrameEncoder::SupportsCodec(EMLFrameCodec Codec, EPixelFormat PixelFormat)
+{
+    ERGBFormat Format;
+    int32 BitDepth = 0;
+    bool bNeedsHalfConversion = false;
+
+    switch (Codec)
+    {
+    case EMLFrameCodec::Raw:
+    case EMLFrameCodec::Compressed:
+    case EMLFrameCodec::DeltaCompressed:
+    case EMLFrameCodec::TemporalDelta:
+        return true;
+    case EMLFrameCodec::PNG:
+        return GetPNGFormat(PixelFormat, Format, BitDepth);
+    case EMLFrameCodec::EXR:
+        return GetEXRFormat(PixelFormat, Format, bNeedsHalfConversion);
+    default:
+        return false;
+    }
+}
+
+EMLFrameCodec FFrameEncoder::ResolveCodec(EMLBufferType BufferType, EPixelFormat PixelFormat) const
+{
+    const int32 TypeIndex = static_cast<int32>(BufferType);
+    if (TypeIndex < 0 || TypeIndex >= static_cast<int32>(EMLBufferType::Count))
+        return EMLFrameCodec::Compressed;
+
+    const EMLFrameCodec Requested = Shared->Settings.Codecs[TypeIndex];
+    return SupportsCodec(Requested, PixelFormat) ? Requested : EMLFrameCodec::Compressed;
+}
+
+bool FFrameEncoder::Submit(const FMLCapturedFramePtr& Frame)
+{
+    if (!Frame.IsValid())
+        return false;
+
+    const EMLFrameCodec Codec = ResolveCodec(Frame->BufferType, Frame->PixelFormat);
+
+    // Nothing to do for raw, already encoded or reused (pixel-less) frames; still delivered through Tick() to keep a
+    // single output path
+    if (Codec == EMLFrameCodec::Raw || Frame->Codec != EMLFrameCodec::Raw || Frame->Pixels.Num() == 0)
+    {
+        FCodecCounters& Counters = Shared->Counters[static_cast<int32>(Frame->Codec)];
+        Counters.Frames.fetch_add(1);
+        Counters.RawBytes.fetch_add(Frame->Codec == EMLFrameCodec::Raw ? Frame->Pixels.Num() : Frame->RawBytes);
+        Counters.EncodedBytes.fetch_add(Frame->Pixels.Num());
+        Shared->Completed.Enqueue(Frame);
+        return true;
+    }
+
+    Tasks.RemoveAllSwap([](const UE::Tasks::FTask& Task) { return Task.IsCompleted(); }, EAllowShrinking::No);
+
+    if (Shared->NumInFlight.load() >= Shared->Settings.MaxFramesInFlight)
+    {
+        if (!Shared->Settings.bBlockWhenFull)
+        {
+            ++FramesDropped;
+            return false;
+        }
+
+        while (Shared->NumInFlight.load() >= Shared->Settings.MaxFramesInFlight && Tasks.Num() > 0)
+        {
+            Tasks[0].Wait();
+            Tasks.RemoveAllSwap([](const UE::Tasks::FTask& Task) { return Task.IsCompleted(); }, EAllowShrinking::No);
+        }
+    }
+
+    // Only frames that will actually be encoded may become references
+    FMLCapturedFramePtr Reference;
+    UE::Tasks::TTask<bool> ReferenceTask;
+    int64 KeyframeIndex = Frame->FrameIndex;
+    FTemporalHistory* History = Codec == EMLFrameCodec::TemporalDelta ? &AdvanceTemporalHistory(Frame, Reference, ReferenceTask, KeyframeIndex) : nullptr;
+
+    auto Encode = [SharedRef = Shared, Frame, Reference, ReferenceTask, KeyframeIndex, Codec]() mutable
+    {
+        // A residual against a frame that fell back to another codec could never be decoded; restart the chain here
+        if (Reference && !ReferenceTask.GetResult())
+        {
+            Reference.Reset();
+            KeyframeIndex = Frame->FrameIndex;
+        }
+        return EncodeFrame(SharedRef, Frame, Reference, KeyframeIndex, Codec);
+    };
+
+    Shared->NumInFlight.fetch_add(1);
+    UE::Tasks::TTask<bool> Task = Reference
+        ? UE::Tasks::Launch(UE_SOURCE_LOCATION, MoveTemp(Encode), UE::Tasks::Prerequisites(ReferenceTask))
+        : UE::Tasks::Launch(UE_SOURCE_LOCATION, MoveTemp(Encode));
+    if (History)
+    {
+        History->PreviousTask = Task;
+    }
+    Tasks.Add(Task);
+
+    return true;
+}
+
+FFrameEncoder::FTemporalHistory& FFrameEncoder::AdvanceTemporalHistory(const FMLCapturedFramePtr& Frame, FMLCapturedFramePtr& OutReference,
+    UE::Tasks::TTask<bool>& OutReferenceTask, int64& OutKeyframeIndex)
+{
+    FTemporalHistory& History = TemporalHistory.FindOrAdd(MLCapture::MakeCaptureKey(Frame->CameraIndex, Frame->BufferType));
+    const FMLCapturedFrame* Previous = History.Previous.Get();
+
+    // A previous frame known to have fallen back is no reference; one still encoding is checked by the task itself
+    const bool bPreviousFellBack = History.PreviousTask.IsValid() && History.PreviousTask.IsCompleted() && !History.PreviousTask.GetResult();
+
+    // Resolution changes (adaptive resolution, re-detection) restart the chain
+    const bool bKeyframe = !Previous || bPreviousFellBack || History.FramesSinceKeyframe + 1 >= Shared->Settings.KeyframeInterval
+        || Previous->Width != Frame->Width || Previous->Height != Frame->Height || Previous->PixelFormat != Frame->PixelFormat
+        || Previous->Pixels.Num() != Frame->Pixels.Num() || Previous->FrameIndex >= Frame->FrameIndex;
+    if (bKeyframe)
+    {
+        History.KeyframeIndex = Frame->FrameIndex;
+        History.FramesSinceKeyframe = 0;
+        OutReference.Reset();
+    }
+    else
+    {
+        ++History.FramesSinceKeyframe;
+        OutReference = History.Previous;
+        OutReferenceTask = History.PreviousTask;
+    }
+
+    OutKeyframeIndex = History.KeyframeIndex;
+    History.Previous = Frame;
+    return History;
+}
+
+void FFrameEncoder::Tick()
+{
+    FMLCapturedFramePtr Frame;
+    while (Shared->Completed.Dequeue(Frame))
+    {
+        FrameEncodedDelegate.Broadcast(Frame);
+    }
+}
+
+void FFrameEncoder::Flush()
+{
+    UE::Tasks::Wait(Tasks);
+    Tasks.Reset();
+    Tick();
+}
+
+bool FFrameEncoder::EncodeFrame(const FSharedStateRef& InShared, const FMLCapturedFramePtr& Source, const FMLCapturedFramePtr& Reference, int64 KeyframeIndex, EMLFrameCodec Codec)
+{
+    ML_CAPTURE_SCOPE(STAT_MLCapture_Encode);
+    const uint64 StartCycles = FPlatformTime::Cycles64();
+
+    // The encoded stream goes back to the pool when the last consumer lets go of the frame
+    FSharedStateRef PoolOwner = InShared;
+    FMLCapturedFramePtr Encoded(new FMLCapturedFrame(), [PoolOwner](FMLCapturedFrame* Frame)
+    {
+        PoolOwner->Pool.Release(MoveTemp(Frame->Pixels));
+        delete Frame;
+    });
+
+    Encoded->FrameIndex = Source->FrameIndex;
+    Encoded->CameraIndex = Source->CameraIndex;
+    Encoded->BufferType = Source->BufferType;
+    Encoded->Width = Source->Width;
+    Encoded->Height = Source->Height;
+    Encoded->PixelFormat = Source->PixelFormat;
+    Encoded->BytesPerPixel = Source->BytesPerPixel;
+    Encoded->CameraPose = Source->CameraPose;
+    Encoded->FOVAngle = Source->FOVAngle;
+    Encoded->SceneStateHash = Source->SceneStateHash;
+    Encoded->RawBytes = Source->Pixels.Num();
+    if (InShared->Settings.bComputePerceptualHash)
+    {
+        Encoded->bHasPerceptualHash = FCaptureIndex::ComputePerceptualHash(*Source, Encoded->PerceptualHash);
+    }
+    Encoded->Pixels = InShared->Pool.Acquire(Source->Pixels.Num());
+
+    EMLFrameCodec UsedCodec = Codec;
+    if (!EncodeInto(*InShared, *Source, Reference.Get(), KeyframeIndex, Codec, Encoded->Pixels))
+    {
+        UsedCodec = EMLFrameCodec::Compressed;
+        if (Codec == EMLFrameCodec::Compressed || !EncodeInto(*InShared, *Source, nullptr, KeyframeIndex, UsedCodec, Encoded->Pixels))
+        {
+            UsedCodec = EMLFrameCodec::Raw;
+            Encoded->Pixels.Reset();
+            Encoded->Pixels.Append(Source->Pixels);
+        }
+    }
+    Encoded->Codec = UsedCodec;
+
+    FCodecCounters& Counters = InShared->Counters[static_cast<int32>(UsedCodec)];
+    Counters.Frames.fetch_add(1);
+    Counters.RawBytes.fetch_add(Source->Pixels.Num());
+    Counters.EncodedBytes.fetch_add(Encoded->Pixels.Num());
+    Counters.EncodeCycles.fetch_add(FPlatformTime::Cycles64() - StartCycles);
+
+    InShared->Completed.Enqueue(Encoded);
+    InShared->NumInFlight.fetch_sub(1);
+    return UsedCodec == Codec;
+}
+
+bool FFrameEncoder::EncodeInto(FSharedState& InShared, const FMLCapturedFrame& Source, const FMLCapturedFrame* Reference, int64 KeyframeIndex, EMLFrameCodec Codec, TArray<uint8>& Out)
+{
+    const int32 SrcBytes = Source.Pixels.Num();
+    Out.Reset();
+
+    switch (Codec)
+    {
+    case EMLFrameCodec::Compressed:
+        return CompressInto(InShared.Settings.CompressionFormat, Source.Pixels.GetData(), SrcBytes, Out);
+
+    case EMLFrameCodec::DeltaCompressed:
+    {
+        int32 WordBytes = 1;
+        int32 Channels = 1;
+        TemporalFrameCodec::GetWordLayout(Source.PixelFormat, Source.BytesPerPixel, WordBytes, Channels);
+        if (static_cast<int64>(Source.Width) * Source.Height * Channels * WordBytes != SrcBytes)
+            return false;
+
+        TArray<uint8> Residuals = InShared.Pool.Acquire(SrcBytes);
+        Residuals.SetNumUninitialized(SrcBytes);
+        switch (WordBytes)
+        {
+        case 4:  EncodeRowDeltas<uint32>(Source.Pixels.GetData(), Residuals.GetData(), Source.Width, Source.Height, Channels); break;
+        case 2:  EncodeRowDeltas<uint16>(Source.Pixels.GetData(), Residuals.GetData(), Source.Width, Source.Height, Channels); break;
+        default: EncodeRowDeltas<uint8>(Source.Pixels.GetData(), Residuals.GetData(), Source.Width, Source.Height, Channels); break;
+        }
+
+        const bool bCompressed = CompressInto(InShared.Settings.CompressionFormat, Residuals.GetData(), SrcBytes, Out);
+        InShared.Pool.Release(MoveTemp(Residuals));
+        return bCompressed;
+    }
+
+    case EMLFrameCodec::TemporalDelta:
+    {
+        TArray<uint8> Scratch = InShared.Pool.Acquire(SrcBytes);
+        const bool bEncoded = TemporalFrameCodec::Encode(Source, Reference, KeyframeIndex, InShared.Settings.CompressionFormat, Scratch, Out);
+        InShared.Pool.Release(MoveTemp(Scratch));
+        return bEncoded;
+    }
+
+    case EMLFrameCodec::PNG:
+    {
+        ERGBFormat Format;
+        int32 BitDepth = 0;
+        if (!GetPNGFormat(Source.PixelFormat, Format, BitDepth))
+            return false;
+
+        TSharedPtr<IImageWrapper> Wrapper = InShared.ImageWrapperModule->CreateImageWrapper(EImageFormat::PNG);
+        if (!Wrapper.IsValid())
+            return false;
+
+        // Lossy mode: clearing low bits leaves long runs that deflate compresses far better
+        const int32 DroppedBits = FMath::Clamp(InShared.Settings.PNGDroppedBits, 0, 7);
+        TArray<uint8> Quantized;
+        const uint8* Pixels = Source.Pixels.GetData();
+        if (DroppedBits > 0 && BitDepth == 8)
+        {
+            Quantized = InShared.Pool.Acquire(SrcBytes);
+            Quantized.SetNumUninitialized(SrcBytes);
+            const uint8 Mask = static_cast<uint8>(0xFF << DroppedBits);
+            for (int32 i = 0; i < SrcBytes; ++i)
+            {
+                Quantized[i] = Source.Pixels[i] & Mask;
+            }
+            Pixels = Quantized.GetData();
+        }
+
+        const bool bSet = Wrapper->SetRaw(Pixels, SrcBytes, Source.Width, Source.Height, Format, BitDepth);
+        if (bSet)
+        {
+            const TArray64<uint8> Compressed = Wrapper->GetCompressed(static_cast<int32>(EImageCompressionQuality::Default));
+            Out.Append(Compressed.GetData(), static_cast<int32>(Compressed.Num()));
+        }
+        InShared.Pool.Release(MoveTemp(Quantized));
+        return bSet && Out.Num() > 0;
+    }
+
+    case EMLFrameCodec::EXR:
+    {
+        ERGBFormat Format;
+        bool bNeedsHalfConversion = false;
+        if (!GetEXRFormat(Source.PixelFormat, Format, bNeedsHalfConversion))
+            return false;
+
+        TSharedPtr<IImageWrapper> Wrapper = InShared.ImageWrapperModule->CreateImageWrapper(EImageFormat::EXR);
+        if (!Wrapper.IsValid())
+            return false;
+
+        TArray<uint8> HalfPixels;
+        const uint8* Pixels = Source.Pixels.GetData();
+        int32 PixelBytes = SrcBytes;
+        if (bNeedsHalfConversion)
+        {
+            const int32 NumFloats = SrcBytes / sizeof(float);
+            PixelBytes = NumFloats * sizeof(FFloat16);
+            HalfPixels = InShared.Pool.Acquire(PixelBytes);
+            HalfPixels.SetNumUninitialized(PixelBytes);
+
+            const float* Floats = reinterpret_cast<const float*>(Source.Pixels.GetData());
+            FFloat16* Halves = reinterpret_cast<FFloat16*>(HalfPixels.GetData());
+            for (int32 i = 0; i < NumFloats; ++i)
+            {
+                Halves[i] = FFloat16(Floats[i]);
+            }
+            Pixels = HalfPixels.GetData();
+        }
+
+        const bool bSet = Wrapper->SetRaw(Pixels, PixelBytes, Source.Width, Source.Height, Format, 16);
+        if (bSet)
+        {
+            const TArray64<uint8> Compressed = Wrapper->GetCompressed(static_cast<int32>(EImageCompressionQuality::Default));
+            Out.Append(Compressed.GetData(), static_cast<int32>(Compressed.Num()));
+        }
+        InShared.Pool.Release(MoveTemp(HalfPixels));
+        return bSet && Out.Num() > 0;
+    }
+
+    default:
+        return false;
+    }
+}
+
+TArray<FMLCodecStats> FFrameEncoder::GetStats() const
+{
+    TArray<FMLCodecStats> Stats;
+    for (int32 CodecIndex = 0; CodecIndex < static_cast<int32>(EMLFrameCodec::Count); ++CodecIndex)
+    {
+        const FCodecCounters& Counters = Shared->Counters[CodecIndex];
+        const int64 Frames = Counters.Frames.load();
+        if (Frames == 0)
+            continue;
+
+        FMLCodecStats& Entry = Stats.AddDefaulted_GetRef();
+        Entry.Codec = static_cast<EMLFrameCodec>(CodecIndex);
+        Entry.Frames = Frames;
+        Entry.RawBytes = Counters.RawBytes.load();
+        Entry.EncodedBytes = Counters.EncodedBytes.load();
+        Entry.AverageEncodeMs = static_cast<float>(FPlatformTime::ToMilliseconds64(Counters.EncodeCycles.load()) / Frames);
+        Entry.CompressionRatio = Entry.EncodedBytes > 0 ? static_cast<float>(static_cast<double>(Entry.RawBytes) / Entry.EncodedBytes) : 1.0f;
+    }
+    return Stats;
+}
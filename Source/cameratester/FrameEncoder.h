@@ -0,0 +1,161 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+#include "Tasks/Task.h"
+#include "MLCaptureTypes.h"
+#include <atomic>
+#include "FrameEncoder.generated.h"
+
+class IImageWrapperModule;
+
+// Throughput of one codec since the encoder was created
+USTRUCT(BlueprintType)
+struct CAMERATESTER_API FMLCodecStats
+{
+    GENERATED_BODY()
+
+    UPROPERTY(BlueprintReadOnly, Category = "Encoding")
+    EMLFrameCodec Codec = EMLFrameCodec::Raw;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Encoding")
+    int64 Frames = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Encoding")
+    int64 RawBytes = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Encoding")
+    int64 EncodedBytes = 0;
+
+    // Task time per frame, summed over workers
+    UPROPERTY(BlueprintReadOnly, Category = "Encoding")
+    float AverageEncodeMs = 0.0f;
+
+    // RawBytes / EncodedBytes
+    UPROPERTY(BlueprintReadOnly, Category = "Encoding")
+    float CompressionRatio = 1.0f;
+};
+
+struct FFrameEncoderSettings
+{
+    // Requested codec per EMLBufferType; unsupported combinations fall back to Compressed
+    EMLFrameCodec Codecs[static_cast<int32>(EMLBufferType::Count)] = {
+        EMLFrameCodec::PNG,              // RGB
+        EMLFrameCodec::TemporalDelta,    // SceneDepth
+        EMLFrameCodec::PNG,              // MLDepth
+        EMLFrameCodec::TemporalDelta,    // Normal
+        EMLFrameCodec::PNG,              // Segmentation
+        EMLFrameCodec::Compressed        // Labels
+    };
+
+    // Frames beyond this many being encoded are rejected instead of queueing more work
+    int32 MaxFramesInFlight = 128;
+
+    // Wait for an encode to finish instead of rejecting the frame at MaxFramesInFlight
+    bool bBlockWhenFull = false;
+
+    // Low bits cleared per 8-bit channel before PNG encoding; 0 keeps PNG lossless
+    int32 PNGDroppedBits = 0;
+
+    // TemporalDelta frames per capture from one keyframe to the next; bounds the frames decoded for random access
+    int32 KeyframeInterval = 30;
+
+    // Take the perceptual hash of every frame from its raw pixels before encoding
+    bool bComputePerceptualHash = false;
+
+    FName CompressionFormat = NAME_Oodle;
+};
+
+// Encoding stage between readback and the dataset writer. Every frame is encoded by its own task on the
+// task graph, so encoders scale with the worker pool instead of a single thread. Output buffers come from a
+// pool and return to it when the encoded frame is released. Encoded frames are broadcast from Tick().
+// TemporalDelta residuals are taken against the previous source frame, which stays alive until its successor is
+// submitted. A residual's task waits for its reference's, and becomes a keyframe if the reference fell back to
+// another codec, so every residual in the output references a stored TemporalDelta frame.
+class CAMERATESTER_API FFrameEncoder
+{
+public:
+    explicit FFrameEncoder(const FFrameEncoderSettings& InSettings);
+    ~FFrameEncoder();
+
+    // Game thread. The source frame is never modified. Returns false (frame dropped) when too many are in flight,
+    // unless bBlockWhenFull is set.
+    bool Submit(const FMLCapturedFramePtr& Frame);
+
+    // Broadcast frames finished since the last call
+    void Tick();
+
+    // Wait for every submitted frame and broadcast it
+    void Flush();
+
+    // Codec actually used for a buffer type and pixel format after fallbacks
+    EMLFrameCodec ResolveCodec(EMLBufferType BufferType, EPixelFormat PixelFormat) const;
+    static bool SupportsCodec(EMLFrameCodec Codec, EPixelFormat PixelFormat);
+
+    TArray<FMLCodecStats> GetStats() const;
+    int32 GetNumInFlight() const { return Shared->NumInFlight.load(); }
+    int64 GetFramesDropped() const { return FramesDropped; }
+
+    FOnMLFrameDataReady& OnFrameEncoded() { return FrameEncodedDelegate; }
+
+private:
+    class FBufferPool
+    {
+    public:
+        explicit FBufferPool(int32 InMaxBuffers) : MaxBuffers(InMaxBuffers) {}
+
+        TArray<uint8> Acquire(int64 Capacity);
+        void Release(TArray<uint8>&& Buffer);
+
+    private:
+        FCriticalSection Lock;
+        TArray<TArray<uint8>> FreeBuffers;
+        const int32 MaxBuffers;
+    };
+
+    struct FCodecCounters
+    {
+        std::atomic<int64> Frames { 0 };
+        std::atomic<int64> RawBytes { 0 };
+        std::atomic<int64> EncodedBytes { 0 };
+        std::atomic<uint64> EncodeCycles { 0 };
+    };
+
+    // Everything an encode task touches; tasks and pooled frames keep it alive past the encoder
+    struct FSharedState
+    {
+        explicit FSharedState(const FFrameEncoderSettings& InSettings);
+
+        const FFrameEncoderSettings Settings;
+        IImageWrapperModule* ImageWrapperModule = nullptr;
+        FBufferPool Pool;
+        FCodecCounters Counters[static_cast<int32>(EMLFrameCodec::Count)];
+        TQueue<FMLCapturedFramePtr, EQueueMode::Mpsc> Completed;
+        std::atomic<int32> NumInFlight { 0 };
+    };
+
+    using FSharedStateRef = TSharedRef<FSharedState, ESPMode::ThreadSafe>;
+
+    // Game thread; last frame of each capture submitted as TemporalDelta
+    struct FTemporalHistory
+    {
+        FMLCapturedFramePtr Previous;
+        // Encode of Previous; true if it was stored as TemporalDelta
+        UE::Tasks::TTask<bool> PreviousTask;
+        int64 KeyframeIndex = INDEX_NONE;
+        int32 FramesSinceKeyframe = 0;
+    };
+
+    // Reference (null for a keyframe), its encode task and keyframe index for Frame, which becomes the next reference
+    FTemporalHistory& AdvanceTemporalHistory(const FMLCapturedFramePtr& Frame, FMLCapturedFramePtr& OutReference, UE::Tasks::TTask<bool>& OutReferenceTask, int64& OutKeyframeIndex);
+
+    // Worker thread; true if the frame was stored with Codec
+    static bool EncodeFrame(const FSharedStateRef& InShared, const FMLCapturedFramePtr& Source, const FMLCapturedFramePtr& Reference, int64 KeyframeIndex, EMLFrameCodec Codec);
+    static bool EncodeInto(FSharedState& InShared, const FMLCapturedFrame& Source, const FMLCapturedFrame* Reference, int64 KeyframeIndex, EMLFrameCodec Codec, TArray<uint8>& Out);
+
+    FSharedStateRef Shared;
+    TArray<UE::Tasks::FTask> Tasks;
+    TMap<uint32, FTemporalHistory> TemporalHistory;
+    int64 FramesDropped = 0;
+    FOnMLFrameDataReady FrameEncodedDelegate;
+};
@@ -0,0 +1,85 @@
+#include "MLCaptureStats.h"
+
+DEFINE_LOG_CATEGORY(LogMLCapture);
+
+DEFINE_STAT(STAT_MLCapture_Detection);
+DEFINE_STAT(STAT_MLCapture_Configure);
+DEFINE_STAT(STAT_MLCapture_Schedule);
+DEFINE_STAT(STAT_MLCapture_Dispatch);
+DEFINE_STAT(STAT_MLCapture_ReadbackEnqueue);
+DEFINE_STAT(STAT_MLCapture_ReadbackPoll);
+DEFINE_STAT(STAT_MLCapture_ReadbackBroadcast);
+DEFINE_STAT(STAT_MLCapture_Export);
+DEFINE_STAT(STAT_MLCapture_Quantize);
+DEFINE_STAT(STAT_MLCapture_Encode);
+DEFINE_STAT(STAT_MLCapture_StreamPublish);
+DEFINE_STAT(STAT_MLCapture_ShardWrite);
+DEFINE_STAT(STAT_MLCapture_TrajectoryUpdate);
+DEFINE_STAT(STAT_MLCapture_TrajectoryWrite);
+DEFINE_STAT(STAT_MLCapture_BackProject);
+DEFINE_STAT(STAT_MLCapture_PointCloudWrite);
+DEFINE_STAT(STAT_MLCapture_Label);
+
+DEFINE_STAT(STAT_MLCapture_CapturesIssued);
+DEFINE_STAT(STAT_MLCapture_CapturesSkipped);
+DEFINE_STAT(STAT_MLCapture_ReadbacksDropped);
+DEFINE_STAT(STAT_MLCapture_FramesReadBack);
+DEFINE_STAT(STAT_MLCapture_BytesReadBack);
+DEFINE_STAT(STAT_MLCapture_ReadbacksPending);
+DEFINE_STAT(STAT_MLCapture_EncodesInFlight);
+DEFINE_STAT(STAT_MLCapture_WriterQueuedBytes);
+DEFINE_STAT(STAT_MLCapture_RenderTargetMemory);
+DEFINE_STAT(STAT_MLCapture_PooledRenderTargetMemory);
+DEFINE_STAT(STAT_MLCapture_StagingMemory);
+DEFINE_STAT(STAT_MLCapture_RenderTargetBudget);
+
+UE_TRACE_CHANNEL_DEFINE(MLCaptureChannel);
+
+TRACE_DECLARE_INT_COUNTER(MLCapture_CapturesIssued, TEXT("MLCapture/Captures Issued"));
+TRACE_DECLARE_INT_COUNTER(MLCapture_CapturesSkipped, TEXT("MLCapture/Captures Skipped"));
+TRACE_DECLARE_INT_COUNTER(MLCapture_ReadbacksDropped, TEXT("MLCapture/Readbacks Dropped"));
+TRACE_DECLARE_INT_COUNTER(MLCapture_FramesReadBack, TEXT("MLCapture/Frames Read Back"));
+TRACE_DECLARE_MEMORY_COUNTER(MLCapture_BytesReadBack, TEXT("MLCapture/Bytes Read Back"));
+TRACE_DECLARE_INT_COUNTER(MLCapture_ReadbacksPending, TEXT("MLCapture/Readbacks Pending"));
+TRACE_DECLARE_INT_COUNTER(MLCapture_EncodesInFlight, TEXT("MLCapture/Encodes In Flight"));
+TRACE_DECLARE_MEMORY_COUNTER(MLCapture_WriterQueuedBytes, TEXT("MLCapture/Writer Queue"));
+TRACE_DECLARE_MEMORY_COUNTER(MLCapture_RenderTargetBytes, TEXT("MLCapture/Render Targets In Use"));
+TRACE_DECLARE_MEMORY_COUNTER(MLCapture_PooledRenderTargetBytes, TEXT("MLCapture/Render Targets Pooled"));
+TRACE_DECLARE_MEMORY_COUNTER(MLCapture_StagingBytes, TEXT("MLCapture/Readback Staging"));
+
+namespace MLCaptureStats
+{
+    void Publish(FMLCaptureFrameCounters& Counters)
+    {
+        INC_DWORD_STAT_BY(STAT_MLCapture_CapturesIssued, Counters.CapturesIssued);
+        INC_DWORD_STAT_BY(STAT_MLCapture_CapturesSkipped, Counters.CapturesSkipped);
+        INC_DWORD_STAT_BY(STAT_MLCapture_ReadbacksDropped, Counters.ReadbacksDropped);
+        INC_DWORD_STAT_BY(STAT_MLCapture_FramesReadBack, Counters.FramesReadBack);
+        SET_MEMORY_STAT(STAT_MLCapture_BytesReadBack, Counters.BytesReadBack);
+        SET_DWORD_STAT(STAT_MLCapture_ReadbacksPending, Counters.ReadbacksPending);
+        SET_DWORD_STAT(STAT_MLCapture_EncodesInFlight, Counters.EncodesInFlight);
+        SET_MEMORY_STAT(STAT_MLCapture_WriterQueuedBytes, Counters.WriterQueuedBytes);
+        SET_MEMORY_STAT(STAT_MLCapture_RenderTargetMemory, Counters.RenderTargetBytes);
+        SET_MEMORY_STAT(STAT_MLCapture_PooledRenderTargetMemory, Counters.PooledRenderTargetBytes);
+        SET_MEMORY_STAT(STAT_MLCapture_StagingMemory, Counters.StagingBytes);
+        SET_MEMORY_STAT(STAT_MLCapture_RenderTargetBudget, Counters.BudgetBytes);
+
+        TRACE_COUNTER_SET(MLCapture_CapturesIssued, Counters.CapturesIssued);
+        TRACE_COUNTER_SET(MLCapture_CapturesSkipped, Counters.CapturesSkipped);
+        TRACE_COUNTER_SET(MLCapture_ReadbacksDropped, Counters.ReadbacksDropped);
+        TRACE_COUNTER_SET(MLCapture_FramesReadBack, Counters.FramesReadBack);
+        TRACE_COUNTER_SET(MLCapture_BytesReadBack, Counters.BytesReadBack);
+        TRACE_COUNTER_SET(MLCapture_ReadbacksPending, Counters.ReadbacksPending);
+        TRACE_COUNTER_SET(MLCapture_EncodesInFlight, Counters.EncodesInFlight);
+        TRACE_COUNTER_SET(MLCapture_WriterQueuedBytes, Counters.WriterQueuedBytes);
+        TRACE_COUNTER_SET(MLCapture_RenderTargetBytes, Counters.RenderTargetBytes);
+        TRACE_COUNTER_SET(MLCapture_PooledRenderTargetBytes, Counters.PooledRenderTargetBytes);
+        TRACE_COUNTER_SET(MLCapture_StagingBytes, Counters.StagingBytes);
+
+        Counters.CapturesIssued = 0;
+        Counters.CapturesSkipped = 0;
+        Counters.ReadbacksDropped = 0;
+        Counters.FramesReadBack = 0;
+        Counters.BytesReadBack = 0;
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "ProfilingDebugging/CountersTrace.h"
+
+// Per-camera and per-frame messages are Verbose; Shipping compiles them out entirely
+#if UE_BUILD_SHIPPING
+CAMERATESTER_API DECLARE_LOG_CATEGORY_EXTERN(LogMLCapture, Log, Log);
+#else
+CAMERATESTER_API DECLARE_LOG_CATEGORY_EXTERN(LogMLCapture, Log, All);
+#endif
+
+// "stat MLCapture" in the console; the same scopes show up in Insights as CPU events
+DECLARE_STATS_GROUP(TEXT("ML Capture"), STATGROUP_MLCapture, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Detection"), STAT_MLCapture_Detection, STATGROUP_MLCapture, CAMERATESTER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Configure Captures"), STAT_MLCapture_Configure, STATGROUP_MLCapture, CAMERATESTER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Schedule Captures"), STAT_MLCapture_Schedule, STATGROUP_MLCapture, CAMERATESTER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("CaptureScene Dispatch"), STAT_MLCapture_Dispatch, STATGROUP_MLCapture, CAMERATESTER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Readback Enqueue"), STAT_MLCapture_ReadbackEnqueue, STATGROUP_MLCapture, CAMERATESTER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Readback Poll (RT)"), STAT_MLCapture_ReadbackPoll, STATGROUP_MLCapture, CAMERATESTER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Readback Broadcast"), STAT_MLCapture_ReadbackBroadcast, STATGROUP_MLCapture, CAMERATESTER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Export"), STAT_MLCapture_Export, STATGROUP_MLCapture, CAMERATESTER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Depth Quantize"), STAT_MLCapture_Quantize, STATGROUP_MLCapture, CAMERATESTER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Encode"), STAT_MLCapture_Encode, STATGROUP_MLCapture, CAMERATESTER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Stream Publish"), STAT_MLCapture_StreamPublish, STATGROUP_MLCapture, CAMERATESTER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Shard Write"), STAT_MLCapture_ShardWrite, STATGROUP_MLCapture, CAMERATESTER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Trajectory Update"), STAT_MLCapture_TrajectoryUpdate, STATGROUP_MLCapture, CAMERATESTER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Trajectory Write"), STAT_MLCapture_TrajectoryWrite, STATGROUP_MLCapture, CAMERATESTER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Point Cloud Projection"), STAT_MLCapture_BackProject, STATGROUP_MLCapture, CAMERATESTER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Point Cloud Write"), STAT_MLCapture_PointCloudWrite, STATGROUP_MLCapture, CAMERATESTER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Segmentation Labels"), STAT_MLCapture_Label, STATGROUP_MLCapture, CAMERATESTER_API);
+
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Captures Issued"), STAT_MLCapture_CapturesIssued, STATGROUP_MLCapture, CAMERATESTER_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Captures Skipped"), STAT_MLCapture_CapturesSkipped, STATGROUP_MLCapture, CAMERATESTER_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Readbacks Dropped"), STAT_MLCapture_ReadbacksDropped, STATGROUP_MLCapture, CAMERATESTER_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Frames Read Back"), STAT_MLCapture_FramesReadBack, STATGROUP_MLCapture, CAMERATESTER_API);
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Bytes Read Back"), STAT_MLCapture_BytesReadBack, STATGROUP_MLCapture, CAMERATESTER_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Readbacks Pending"), STAT_MLCapture_ReadbacksPending, STATGROUP_MLCapture, CAMERATESTER_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Encodes In Flight"), STAT_MLCapture_EncodesInFlight, STATGROUP_MLCapture, CAMERATESTER_API);
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Writer Queue"), STAT_MLCapture_WriterQueuedBytes, STATGROUP_MLCapture, CAMERATESTER_API);
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Render Targets In Use"), STAT_MLCapture_RenderTargetMemory, STATGROUP_MLCapture, CAMERATESTER_API);
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Render Targets Pooled"), STAT_MLCapture_PooledRenderTargetMemory, STATGROUP_MLCapture, CAMERATESTER_API);
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Readback Staging"), STAT_MLCapture_StagingMemory, STATGROUP_MLCapture, CAMERATESTER_API);
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Render Target Budget"), STAT_MLCapture_RenderTargetBudget, STATGROUP_MLCapture, CAMERATESTER_API);
+
+UE_TRACE_CHANNEL_EXTERN(MLCaptureChannel, CAMERATESTER_API);
+
+// One Insights event per scope: the cycle stat traces itself, and builds without stats use the MLCapture channel.
+// Safe on any thread.
+#if STATS
+#define ML_CAPTURE_SCOPE(StatId) SCOPE_CYCLE_COUNTER(StatId)
+#else
+#define ML_CAPTURE_SCOPE(StatId) TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL(StatId, MLCaptureChannel)
+#endif
+
+// Pipeline figures gathered over one manager tick and published to stats and Insights counters at its end
+struct FMLCaptureFrameCounters
+{
+    // Reset after every publish
+    int32 CapturesIssued = 0;
+    int32 CapturesSkipped = 0;
+    int32 ReadbacksDropped = 0;
+    int32 FramesReadBack = 0;
+    int64 BytesReadBack = 0;
+
+    // Sampled just before publishing
+    int32 ReadbacksPending = 0;
+    int32 EncodesInFlight = 0;
+    int64 WriterQueuedBytes = 0;
+    int64 RenderTargetBytes = 0;
+    int64 PooledRenderTargetBytes = 0;
+    int64 StagingBytes = 0;
+    int64 BudgetBytes = 0;
+};
+
+namespace MLCaptureStats
+{
+    CAMERATESTER_API void Publish(FMLCaptureFrameCounters& Counters);
+}
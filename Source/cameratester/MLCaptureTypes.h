@@ -0,0 +1,196 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PixelFormat.h"
+#include "Components/SceneCaptureComponent2D.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "MLCaptureTypes.generated.h"
+
+// Buffer types produced per camera by ARenderTargetManager
+UENUM(BlueprintType)
+enum class EMLBufferType : uint8
+{
+    RGB,
+    SceneDepth,
+    MLDepth,
+    Normal,
+    // Custom stencil value of each pixel: the instance ID assigned to tagged actors, 0 for everything else
+    Segmentation,
+    // Derived on the CPU from Segmentation: one FMLInstanceLabel record per visible instance
+    Labels UMETA(Hidden),
+    Count UMETA(Hidden)
+};
+
+// How a frame's pixel bytes are stored once they leave FFrameEncoder
+UENUM(BlueprintType)
+enum class EMLFrameCodec : uint8
+{
+    // Tightly packed pixels as read back
+    Raw,
+    // Raw pixels through the engine's generic compressor (Oodle)
+    Compressed,
+    // 8/16-bit PNG; lossless unless low bits are dropped first
+    PNG,
+    // Half-float single-channel EXR for depth
+    EXR,
+    // Per-row horizontal deltas of the pixel words, then Compressed; lossless, suited to depth
+    DeltaCompressed,
+    // Periodic keyframes plus residuals against the previous frame of the same capture; lossless, suited to depth
+    // and normals from slowly moving cameras. See TemporalFrameCodec.
+    TemporalDelta,
+    Count UMETA(Hidden)
+};
+
+// One scene capture component bound to the render target it fills
+USTRUCT(BlueprintType)
+struct CAMERATESTER_API FMLCaptureBinding
+{
+    GENERATED_BODY()
+
+    UPROPERTY(BlueprintReadOnly, Category = "Capture")
+    AActor* Camera = nullptr;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Capture")
+    USceneCaptureComponent2D* SceneCapture = nullptr;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Capture")
+    UTextureRenderTarget2D* RenderTarget = nullptr;
+
+    // 0-based index of the camera in detection order
+    UPROPERTY(BlueprintReadOnly, Category = "Capture")
+    int32 CameraIndex = INDEX_NONE;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Capture")
+    EMLBufferType BufferType = EMLBufferType::RGB;
+};
+
+// CPU copy of one captured buffer, handed out once its GPU readback lands
+struct FMLCapturedFrame
+{
+    int64 FrameIndex = 0;
+    int32 CameraIndex = INDEX_NONE;
+    EMLBufferType BufferType = EMLBufferType::RGB;
+
+    // Size the buffer was actually captured at; varies per frame under adaptive resolution
+    int32 Width = 0;
+    int32 Height = 0;
+    EPixelFormat PixelFormat = PF_Unknown;
+    int32 BytesPerPixel = 0;
+
+    // Camera world transform at the time the readback was queued
+    FTransform CameraPose;
+
+    // Horizontal field of view of the capture in degrees, taken with CameraPose
+    float FOVAngle = 90.0f;
+
+    // Tightly packed rows (Width * BytesPerPixel bytes each), or the encoded stream when Codec != Raw
+    TArray<uint8> Pixels;
+
+    EMLFrameCodec Codec = EMLFrameCodec::Raw;
+
+    // Decoded size of Pixels when Codec != Raw
+    int64 RawBytes = 0;
+
+    // Set when the capture was skipped as unchanged: Pixels is empty and this earlier frame's pixels still apply
+    int64 ReusedFrameIndex = INDEX_NONE;
+
+    // Quantized transforms of the scene's movable actors in the frame the capture was issued; 0 when not tracked
+    uint64 SceneStateHash = 0;
+
+    // Difference hash of the raw pixels for the capture index; set by the encoder, the last stage to see them raw
+    uint64 PerceptualHash = 0;
+    bool bHasPerceptualHash = false;
+};
+
+using FMLCapturedFramePtr = TSharedPtr<FMLCapturedFrame, ESPMode::ThreadSafe>;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FOnMLFrameReadback, int32, CameraIndex, EMLBufferType, BufferType, int64, FrameIndex);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_FourParams(FOnMLCaptureSkipped, int32, CameraIndex, EMLBufferType, BufferType, int64, FrameIndex, int64, ReusedFrameIndex);
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnMLFrameDataReady, const FMLCapturedFramePtr& /*Frame*/);
+
+namespace MLCapture
+{
+    // Stable key for per-camera, per-buffer bookkeeping
+    FORCEINLINE uint32 MakeCaptureKey(int32 CameraIndex, EMLBufferType BufferType)
+    {
+        return (static_cast<uint32>(CameraIndex) << 8) | static_cast<uint32>(BufferType);
+    }
+
+    FORCEINLINE const TCHAR* GetBufferTypeName(EMLBufferType BufferType)
+    {
+        switch (BufferType)
+        {
+        case EMLBufferType::RGB:          return TEXT("RGB");
+        case EMLBufferType::SceneDepth:   return TEXT("Depth");
+        case EMLBufferType::MLDepth:      return TEXT("DepthML");
+        case EMLBufferType::Normal:       return TEXT("Normal");
+        case EMLBufferType::Segmentation: return TEXT("Segmentation");
+        case EMLBufferType::Labels:       return TEXT("Labels");
+        default:                          return TEXT("Unknown");
+        }
+    }
+
+    FORCEINLINE const TCHAR* GetCodecName(EMLFrameCodec Codec)
+    {
+        switch (Codec)
+        {
+        case EMLFrameCodec::Raw:             return TEXT("Raw");
+        case EMLFrameCodec::Compressed:      return TEXT("Compressed");
+        case EMLFrameCodec::PNG:             return TEXT("PNG");
+        case EMLFrameCodec::EXR:             return TEXT("EXR");
+        case EMLFrameCodec::DeltaCompressed: return TEXT("DeltaCompressed");
+        case EMLFrameCodec::TemporalDelta:   return TEXT("TemporalDelta");
+        default:                             return TEXT("Unknown");
+        }
+    }
+
+    // Component tag marking segmentation captures, whose LDR output and R8 target look like ML depth otherwise
+    inline const FName SegmentationCaptureTag(TEXT("MLSegmentation"));
+
+    // Infer which ML buffer an existing capture component feeds
+    FORCEINLINE EMLBufferType ClassifyCapture(const USceneCaptureComponent2D* SceneCapture)
+    {
+        if (SceneCapture->ComponentHasTag(SegmentationCaptureTag))
+        {
+            return EMLBufferType::Segmentation;
+        }
+
+        switch (SceneCapture->CaptureSource)
+        {
+        case ESceneCaptureSource::SCS_SceneDepth:
+            return EMLBufferType::SceneDepth;
+        case ESceneCaptureSource::SCS_Normal:
+            return EMLBufferType::Normal;
+        default:
+            break;
+        }
+
+        if (IsValid(SceneCapture->TextureTarget) && SceneCapture->TextureTarget->RenderTargetFormat == RTF_R8)
+        {
+            return EMLBufferType::MLDepth;
+        }
+        return EMLBufferType::RGB;
+    }
+
+    // Render target format each buffer type is created with
+    FORCEINLINE ETextureRenderTargetFormat GetDefaultFormat(EMLBufferType BufferType)
+    {
+        switch (BufferType)
+        {
+        case EMLBufferType::SceneDepth:   return RTF_R32f;
+        case EMLBufferType::MLDepth:      return RTF_R8;
+        case EMLBufferType::Segmentation: return RTF_R8;
+        default:                          return RTF_RGBA8;
+        }
+    }
+
+    FORCEINLINE ESceneCaptureSource GetCaptureSource(EMLBufferType BufferType)
+    {
+        switch (BufferType)
+        {
+        case EMLBufferType::SceneDepth: return ESceneCaptureSource::SCS_SceneDepth;
+        case EMLBufferType::Normal:     return ESceneCaptureSource::SCS_Normal;
+        default:                        return ESceneCaptureSource::SCS_FinalColorLDR;
+        }
+    }
+}
@@ -0,0 +1,464 @@
+#include "PointCloudExporter.h"
+#include "MLCaptureStats.h"
+#include "HAL/PlatformFileManager.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/RunnableThread.h"
+#include "HAL/Event.h"
+#include "Math/Float16.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+    // Points serialised per write call, so the staging buffer stays small however large a cloud is
+    constexpr int32 WriteBatchPoints = 65536;
+
+    // Width of the zero-padded vertex count patched into the PLY header on close
+    constexpr int32 PlyCountDigits = 10;
+
+    FORCEINLINE uint64 MakePendingKey(int64 FrameIndex, int32 CameraIndex)
+    {
+        return (static_cast<uint64>(FrameIndex) << 24) | (static_cast<uint32>(CameraIndex) & 0xFFFFFF);
+    }
+
+    FORCEINLINE int64 GetPendingFrameIndex(uint64 Key)
+    {
+        return static_cast<int64>(Key >> 24);
+    }
+}
+
+FPointCloudExporter::FPointCloudExporter(const FPointCloudExporterSettings& InSettings)
+    : Settings(InSettings)
+{
+    Settings.MaxFramesInFlight = FMath::Max(Settings.MaxFramesInFlight, 1);
+    Settings.MaxPointsPerFile = FMath::Max<int64>(Settings.MaxPointsPerFile, WriteBatchPoints);
+    Settings.FusionFrameLag = FMath::Max(Settings.FusionFrameLag, 0);
+    if (Settings.Fusion != EMLPointCloudFusion::PerCamera)
+    {
+        Settings.VoxelSize = FMath::Max(Settings.VoxelSize, 1.0f);
+    }
+    WakeEvent = FPlatformProcess::GetSynchEventFromPool(false);
+}
+
+FPointCloudExporter::~FPointCloudExporter()
+{
+    StopExport();
+    FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+}
+
+bool FPointCloudExporter::Start()
+{
+    if (IsRunning())
+        return true;
+
+    if (!IFileManager::Get().MakeDirectory(*Settings.OutputDirectory, true))
+    {
+        UE_LOG(LogMLCapture, Error, TEXT("Point cloud export could not create output directory %s"), *Settings.OutputDirectory);
+        return false;
+    }
+
+    bStopRequested.store(false);
+    Thread = FRunnableThread::Create(this, TEXT("MLPointCloudWriter"), 0, TPri_BelowNormal);
+
+    UE_LOG(LogMLCapture, Log, TEXT("Point cloud export started: %s, %s, voxel %.1f cm, stride %d%s -> %s"),
+        Settings.Format == EMLPointCloudFormat::PLY ? TEXT("PLY") : TEXT("Compact"),
+        *UEnum::GetDisplayValueAsText(Settings.Fusion).ToString(), Settings.VoxelSize, Settings.Projection.PixelStride,
+        Settings.bColor ? TEXT(", color") : TEXT(""), *Settings.OutputDirectory);
+    return Thread != nullptr;
+}
+
+void FPointCloudExporter::StopExport()
+{
+    if (!IsRunning())
+        return;
+
+    // Depth still waiting for color is projected without it
+    for (const TPair<uint64, FPendingFrame>& Entry : Pending)
+    {
+        if (Entry.Value.Depth)
+        {
+            Launch(Entry.Value.Depth, Entry.Value.Color);
+        }
+    }
+    Pending.Reset();
+
+    UE::Tasks::Wait(Tasks);
+    Tasks.Reset();
+
+    Stop();
+    Thread->WaitForCompletion();
+    delete Thread;
+    Thread = nullptr;
+
+    const FMLPointCloudStats Stats = GetStats();
+    UE_LOG(LogMLCapture, Log, TEXT("Point cloud export stopped: %lld frames, %lld points projected (%.1f M/s per task), %lld written to %d files, %lld frames dropped"),
+        Stats.FramesProjected, Stats.PointsProjected, Stats.PointsPerSecond / 1.0e6f, Stats.PointsWritten, Stats.FilesWritten, Stats.FramesDropped);
+}
+
+void FPointCloudExporter::Submit(const FMLCapturedFramePtr& Frame)
+{
+    if (!IsRunning() || !Frame.IsValid() || Frame->ReusedFrameIndex != INDEX_NONE)
+        return;
+
+    const bool bDepth = Frame->BufferType == EMLBufferType::SceneDepth && PointCloudProjection::CanBackProject(*Frame);
+    const bool bColor = Settings.bColor && Frame->BufferType == EMLBufferType::RGB && PointCloudProjection::CanSampleColor(*Frame);
+    if (!bDepth && !bColor)
+        return;
+
+    if (Frame->FrameIndex > NewestFrameIndex)
+    {
+        NewestFrameIndex = Frame->FrameIndex;
+        FlushStalePending(NewestFrameIndex);
+    }
+
+    if (!Settings.bColor)
+    {
+        Launch(Frame, nullptr);
+        return;
+    }
+
+    const uint64 Key = MakePendingKey(Frame->FrameIndex, Frame->CameraIndex);
+    FPendingFrame& Entry = Pending.FindOrAdd(Key);
+    (bDepth ? Entry.Depth : Entry.Color) = Frame;
+    if (Entry.Depth && Entry.Color)
+    {
+        Launch(Entry.Depth, Entry.Color);
+        Pending.Remove(Key);
+    }
+}
+
+void FPointCloudExporter::FlushStalePending(int64 InNewestFrameIndex)
+{
+    for (auto It = Pending.CreateIterator(); It; ++It)
+    {
+        if (GetPendingFrameIndex(It.Key()) > InNewestFrameIndex - Settings.ColorWaitFrames)
+            continue;
+
+        // Color never came (no RGB capture, or it was dropped); unmatched color is simply discarded
+        if (It.Value().Depth)
+        {
+            Launch(It.Value().Depth, nullptr);
+        }
+        It.RemoveCurrent();
+    }
+}
+
+void FPointCloudExporter::Launch(const FMLCapturedFramePtr& Depth, const FMLCapturedFramePtr& Color)
+{
+    Tasks.RemoveAllSwap([](const UE::Tasks::FTask& Task) { return Task.IsCompleted(); }, EAllowShrinking::No);
+
+    // In flight counts until the writer has consumed the cloud, so a slow disk throttles projection too
+    if (NumInFlight.load() >= Settings.MaxFramesInFlight)
+    {
+        if (!Settings.bBlockWhenFull)
+        {
+            FramesDropped.fetch_add(1);
+            return;
+        }
+        while (NumInFlight.load() >= Settings.MaxFramesInFlight)
+        {
+            WakeEvent->Trigger();
+            FPlatformProcess::SleepNoStats(0.0005f);
+        }
+    }
+
+    NumInFlight.fetch_add(1);
+    Tasks.Add(UE::Tasks::Launch(UE_SOURCE_LOCATION,
+        [this, Depth, Color]()
+        {
+            TUniquePtr<FMLPointBuffer> Points = MakeUnique<FMLPointBuffer>();
+
+            const uint64 StartCycles = FPlatformTime::Cycles64();
+            const int32 NumPoints = PointCloudProjection::BackProject(*Depth, Color.Get(), Settings.Projection, *Points);
+            ProjectCycles.fetch_add(FPlatformTime::Cycles64() - StartCycles);
+            PointsProjected.fetch_add(NumPoints);
+            FramesProjected.fetch_add(1);
+
+            // Fused modes downsample once, in the shared grid
+            if (Settings.Fusion == EMLPointCloudFusion::PerCamera)
+            {
+                PointCloudProjection::VoxelDownsample(*Points, Settings.VoxelSize);
+            }
+
+            Projected.Enqueue(MoveTemp(Points));
+            WakeEvent->Trigger();
+        }));
+}
+
+FMLPointCloudStats FPointCloudExporter::GetStats() const
+{
+    FMLPointCloudStats Stats;
+    Stats.FramesProjected = FramesProjected.load();
+    Stats.FramesDropped = FramesDropped.load();
+    Stats.PointsProjected = PointsProjected.load();
+    Stats.PointsWritten = PointsWritten.load();
+    Stats.FilesWritten = FilesWritten.load();
+
+    const double Seconds = FPlatformTime::ToSeconds64(ProjectCycles.load());
+    Stats.PointsPerSecond = Seconds > 0.0 ? static_cast<float>(Stats.PointsProjected / Seconds) : 0.0f;
+    return Stats;
+}
+
+void FPointCloudExporter::Stop()
+{
+    bStopRequested.store(true);
+    WakeEvent->Trigger();
+}
+
+uint32 FPointCloudExporter::Run()
+{
+    while (!bStopRequested.load())
+    {
+        WakeEvent->Wait(100);
+        DrainQueue();
+    }
+
+    // Everything projected before the stop request, then whatever is still being fused
+    DrainQueue();
+    FlushFusedFrames(TNumericLimits<int64>::Max());
+    if (Accumulated && Accumulated->Num() > 0)
+    {
+        FMLPointBuffer Points;
+        Accumulated->Extract(Points);
+        Points.FrameIndex = NewestFusedFrame;
+        WriteCloud(Points);
+        Accumulated.Reset();
+    }
+    CloseFile();
+    return 0;
+}
+
+void FPointCloudExporter::DrainQueue()
+{
+    TUniquePtr<FMLPointBuffer> Points;
+    while (Projected.Dequeue(Points))
+    {
+        Consume(MoveTemp(Points));
+        NumInFlight.fetch_sub(1);
+    }
+}
+
+void FPointCloudExporter::Consume(TUniquePtr<FMLPointBuffer> Points)
+{
+    switch (Settings.Fusion)
+    {
+    case EMLPointCloudFusion::PerCamera:
+        WriteCloud(*Points);
+        break;
+
+    case EMLPointCloudFusion::PerFrame:
+    {
+        TUniquePtr<FPointCloudVoxelGrid>& Grid = FusedFrames.FindOrAdd(Points->FrameIndex);
+        if (!Grid)
+        {
+            Grid = MakeUnique<FPointCloudVoxelGrid>(Settings.VoxelSize);
+        }
+        Grid->Add(*Points);
+
+        NewestFusedFrame = FMath::Max(NewestFusedFrame, Points->FrameIndex);
+        FlushFusedFrames(NewestFusedFrame - Settings.FusionFrameLag);
+        break;
+    }
+
+    case EMLPointCloudFusion::Accumulate:
+        if (!Accumulated)
+        {
+            Accumulated = MakeUnique<FPointCloudVoxelGrid>(Settings.VoxelSize);
+        }
+        Accumulated->Add(*Points);
+        NewestFusedFrame = FMath::Max(NewestFusedFrame, Points->FrameIndex);
+        break;
+    }
+}
+
+void FPointCloudExporter::FlushFusedFrames(int64 MaxFrameIndex)
+{
+    TArray<int64> ReadyFrames;
+    for (const TPair<int64, TUniquePtr<FPointCloudVoxelGrid>>& Entry : FusedFrames)
+    {
+        if (Entry.Key <= MaxFrameIndex)
+        {
+            ReadyFrames.Add(Entry.Key);
+        }
+    }
+    ReadyFrames.Sort();
+
+    FMLPointBuffer Points;
+    for (const int64 FrameIndex : ReadyFrames)
+    {
+        TUniquePtr<FPointCloudVoxelGrid> Grid = MoveTemp(FusedFrames.FindChecked(FrameIndex));
+        FusedFrames.Remove(FrameIndex);
+        Grid->Extract(Points);
+        Points.FrameIndex = FrameIndex;
+        WriteCloud(Points);
+    }
+}
+
+bool FPointCloudExporter::OpenFile(bool bWithColor)
+{
+    const TCHAR* Extension = Settings.Format == EMLPointCloudFormat::PLY ? TEXT("ply") : TEXT("mlpc");
+    const FString Path = FPaths::Combine(Settings.OutputDirectory, FString::Printf(TEXT("points_%05d.%s"), NextFileId++, Extension));
+
+    File.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenWrite(*Path, false, false));
+    if (!File)
+    {
+        UE_LOG(LogMLCapture, Error, TEXT("Point cloud export could not open %s"), *Path);
+        return false;
+    }
+
+    bFileHasColor = bWithColor;
+    FilePointCount = 0;
+    FileChunkCount = 0;
+
+    if (Settings.Format == EMLPointCloudFormat::PLY)
+    {
+        // The vertex count is unknown until the file closes; reserve fixed-width digits and patch them then
+        const FString Prefix = TEXT("ply\nformat binary_little_endian 1.0\ncomment cameratester MLCapture point cloud\nelement vertex ");
+        FString Suffix = TEXT("\nproperty float x\nproperty float y\nproperty float z\n");
+        if (bWithColor)
+        {
+            Suffix += TEXT("property uchar red\nproperty uchar green\nproperty uchar blue\n");
+        }
+        Suffix += TEXT("end_header\n");
+
+        const FString Header = Prefix + FString::ChrN(PlyCountDigits, TEXT('0')) + Suffix;
+        PointCountOffset = Prefix.Len();
+        File->Write(reinterpret_cast<const uint8*>(TCHAR_TO_ANSI(*Header)), Header.Len());
+    }
+    else
+    {
+        FMLPointCloudFileHeader Header;
+        Header.Flags = (bWithColor ? EMLPointCloudFileFlags::Color : 0) | (Settings.bHalfPrecision ? EMLPointCloudFileFlags::HalfPositions : 0);
+        File->Write(reinterpret_cast<const uint8*>(&Header), sizeof(Header));
+    }
+    return true;
+}
+
+void FPointCloudExporter::CloseFile()
+{
+    if (!File)
+        return;
+
+    if (Settings.Format == EMLPointCloudFormat::PLY)
+    {
+        const FString Count = FString::Printf(TEXT("%0*lld"), PlyCountDigits, FilePointCount);
+        File->Seek(PointCountOffset);
+        File->Write(reinterpret_cast<const uint8*>(TCHAR_TO_ANSI(*Count)), Count.Len());
+    }
+    else
+    {
+        FMLPointCloudFileHeader Header;
+        Header.Flags = (bFileHasColor ? EMLPointCloudFileFlags::Color : 0) | (Settings.bHalfPrecision ? EMLPointCloudFileFlags::HalfPositions : 0);
+        Header.ChunkCount = FileChunkCount;
+        Header.PointCount = FilePointCount;
+        File->Seek(0);
+        File->Write(reinterpret_cast<const uint8*>(&Header), sizeof(Header));
+    }
+
+    File->Flush();
+    File.Reset();
+    FilesWritten.fetch_add(1);
+}
+
+void FPointCloudExporter::WriteCloud(const FMLPointBuffer& Points)
+{
+    ML_CAPTURE_SCOPE(STAT_MLCapture_PointCloudWrite);
+
+    const int32 NumPoints = Points.Num();
+    if (NumPoints == 0)
+        return;
+
+    const bool bWithColor = Points.HasColor();
+    if (File && (bWithColor != bFileHasColor || FilePointCount + NumPoints > Settings.MaxPointsPerFile))
+    {
+        CloseFile();
+    }
+    if (!File && !OpenFile(bWithColor))
+        return;
+
+    if (Settings.Format == EMLPointCloudFormat::PLY)
+    {
+        // Interleaved vertices, positions rebased from the cloud's origin to the export's world origin
+        const FVector3f Offset(Points.Origin - Settings.WorldOrigin);
+        const int32 VertexBytes = 3 * sizeof(float) + (bWithColor ? 3 : 0);
+        for (int32 Begin = 0; Begin < NumPoints; Begin += WriteBatchPoints)
+        {
+            const int32 Count = FMath::Min(WriteBatchPoints, NumPoints - Begin);
+            WriteBuffer.SetNumUninitialized(Count * VertexBytes, EAllowShrinking::No);
+            uint8* Out = WriteBuffer.GetData();
+            for (int32 i = Begin; i < Begin + Count; ++i)
+            {
+                const float Position[3] = { Points.X[i] + Offset.X, Points.Y[i] + Offset.Y, Points.Z[i] + Offset.Z };
+                FMemory::Memcpy(Out, Position, sizeof(Position));
+                Out += sizeof(Position);
+                if (bWithColor)
+                {
+                    *Out++ = Points.Colors[i].R;
+                    *Out++ = Points.Colors[i].G;
+                    *Out++ = Points.Colors[i].B;
+                }
+            }
+            File->Write(WriteBuffer.GetData(), WriteBuffer.Num());
+        }
+    }
+    else
+    {
+        FMLPointCloudChunkHeader Chunk;
+        Chunk.FrameIndex = Points.FrameIndex;
+        Chunk.CameraIndex = Points.CameraIndex;
+        Chunk.PointCount = static_cast<uint32>(NumPoints);
+        Chunk.Origin[0] = Points.Origin.X;
+        Chunk.Origin[1] = Points.Origin.Y;
+        Chunk.Origin[2] = Points.Origin.Z;
+        File->Write(reinterpret_cast<const uint8*>(&Chunk), sizeof(Chunk));
+
+        const int32 ComponentBytes = Settings.bHalfPrecision ? sizeof(FFloat16) : sizeof(float);
+        for (int32 Begin = 0; Begin < NumPoints; Begin += WriteBatchPoints)
+        {
+            const int32 Count = FMath::Min(WriteBatchPoints, NumPoints - Begin);
+            WriteBuffer.SetNumUninitialized(Count * 3 * ComponentBytes, EAllowShrinking::No);
+            if (Settings.bHalfPrecision)
+            {
+                FFloat16* Out = reinterpret_cast<FFloat16*>(WriteBuffer.GetData());
+                for (int32 i = Begin; i < Begin + Count; ++i)
+                {
+                    *Out++ = FFloat16(Points.X[i]);
+                    *Out++ = FFloat16(Points.Y[i]);
+                    *Out++ = FFloat16(Points.Z[i]);
+                }
+            }
+            else
+            {
+                float* Out = reinterpret_cast<float*>(WriteBuffer.GetData());
+                for (int32 i = Begin; i < Begin + Count; ++i)
+                {
+                    *Out++ = Points.X[i];
+                    *Out++ = Points.Y[i];
+                    *Out++ = Points.Z[i];
+                }
+            }
+            File->Write(WriteBuffer.GetData(), WriteBuffer.Num());
+        }
+
+        // Colors follow all positions of the chunk
+        if (bWithColor)
+        {
+            for (int32 Begin = 0; Begin < NumPoints; Begin += WriteBatchPoints)
+            {
+                const int32 Count = FMath::Min(WriteBatchPoints, NumPoints - Begin);
+                WriteBuffer.SetNumUninitialized(Count * 3, EAllowShrinking::No);
+                uint8* Out = WriteBuffer.GetData();
+                for (int32 i = Begin; i < Begin + Count; ++i)
+                {
+                    *Out++ = Points.Colors[i].R;
+                    *Out++ = Points.Colors[i].G;
+                    *Out++ = Points.Colors[i].B;
+                }
+                File->Write(WriteBuffer.GetData(), WriteBuffer.Num());
+            }
+        }
+    }
+
+    FilePointCount += NumPoints;
+    ++FileChunkCount;
+    PointsWritten.fetch_add(NumPoints);
+}
@@ -0,0 +1,211 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "Containers/Queue.h"
+#include "Tasks/Task.h"
+#include "MLCaptureTypes.h"
+#include "PointCloudProjection.h"
+#include <atomic>
+#include "PointCloudExporter.generated.h"
+
+class FRunnableThread;
+class IFileHandle;
+
+UENUM(BlueprintType)
+enum class EMLPointCloudFormat : uint8
+{
+    // Binary little-endian PLY: float x, y, z and optional uchar red, green, blue
+    PLY,
+    // .mlpc chunks of float or half positions relative to a per-chunk origin, tagged with frame and camera
+    Compact
+};
+
+UENUM(BlueprintType)
+enum class EMLPointCloudFusion : uint8
+{
+    // One cloud per camera and frame
+    PerCamera,
+    // Every camera of a capture frame fused into one voxel-downsampled cloud
+    PerFrame,
+    // Everything captured fused into one cloud, written when export stops
+    Accumulate
+};
+
+USTRUCT(BlueprintType)
+struct CAMERATESTER_API FMLPointCloudStats
+{
+    GENERATED_BODY()
+
+    UPROPERTY(BlueprintReadOnly, Category = "Point Cloud")
+    int64 FramesProjected = 0;
+
+    // Depth frames rejected while too many were in flight
+    UPROPERTY(BlueprintReadOnly, Category = "Point Cloud")
+    int64 FramesDropped = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Point Cloud")
+    int64 PointsProjected = 0;
+
+    // After voxel downsampling
+    UPROPERTY(BlueprintReadOnly, Category = "Point Cloud")
+    int64 PointsWritten = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Point Cloud")
+    int32 FilesWritten = 0;
+
+    // Back-projection throughput of a single task
+    UPROPERTY(BlueprintReadOnly, Category = "Point Cloud")
+    float PointsPerSecond = 0.0f;
+};
+
+// On-disk layout of a .mlpc file: Header, then Header.ChunkCount chunks of ChunkHeader + positions (+ colors).
+// Positions are interleaved xyz, float or half per Flags, relative to the chunk's Origin; colors are RGB bytes.
+#pragma pack(push, 1)
+struct FMLPointCloudFileHeader
+{
+    uint32 Magic = 0x43504C4D; // "MLPC"
+    uint16 Version = 1;
+    uint16 Flags = 0;          // EMLPointCloudFileFlags
+    uint32 ChunkCount = 0;     // Finalised on close
+    uint32 Reserved = 0;
+    uint64 PointCount = 0;     // Finalised on close
+};
+
+struct FMLPointCloudChunkHeader
+{
+    int64 FrameIndex = 0;
+    int32 CameraIndex = 0;     // -1 for fused chunks
+    uint32 PointCount = 0;
+    double Origin[3] = { 0.0, 0.0, 0.0 };
+};
+#pragma pack(pop)
+
+namespace EMLPointCloudFileFlags
+{
+    enum : uint16
+    {
+        None = 0,
+        Color = 1 << 0,
+        HalfPositions = 1 << 1,
+    };
+}
+
+static_assert(sizeof(FMLPointCloudFileHeader) == 24, "Point cloud header layout is part of the file format");
+static_assert(sizeof(FMLPointCloudChunkHeader) == 40, "Point cloud chunk layout is part of the file format");
+
+struct FPointCloudExporterSettings
+{
+    // Absolute directory that receives points_<seq>.ply/.mlpc
+    FString OutputDirectory;
+
+    EMLPointCloudFormat Format = EMLPointCloudFormat::PLY;
+    EMLPointCloudFusion Fusion = EMLPointCloudFusion::PerCamera;
+
+    // Join color from the RGB frame of the same camera and frame index
+    bool bColor = true;
+
+    // Compact format only: half positions, about 1/1000 of the distance to the chunk origin in precision
+    bool bHalfPrecision = false;
+
+    // 0 keeps every point in PerCamera mode; the fused modes need a grid and use at least 1 cm
+    float VoxelSize = 0.0f;
+
+    PointCloudProjection::FParams Projection;
+
+    // PLY positions are written relative to this point so they stay precise as floats
+    FVector WorldOrigin = FVector::ZeroVector;
+
+    // A new file is started once the next cloud would pass this many points
+    int64 MaxPointsPerFile = 16 * 1024 * 1024;
+
+    // Depth frames being projected or waiting for the writer; beyond this they are dropped
+    int32 MaxFramesInFlight = 32;
+
+    // Wait instead of dropping once MaxFramesInFlight is reached
+    bool bBlockWhenFull = false;
+
+    // PerFrame fusion writes a frame once this many newer frames have arrived; later stragglers get their own cloud
+    int32 FusionFrameLag = 4;
+
+    // Depth frames wait this many capture frames for their color before being projected without it
+    int32 ColorWaitFrames = 4;
+};
+
+// Back-projects read-back SceneDepth into world-space point clouds and streams them to disk. Depth frames are
+// paired with the RGB frame of the same camera and frame index, projected on the task graph, then fused and
+// written by a single I/O thread in bounded files.
+class CAMERATESTER_API FPointCloudExporter : public FRunnable
+{
+public:
+    explicit FPointCloudExporter(const FPointCloudExporterSettings& InSettings);
+    virtual ~FPointCloudExporter() override;
+
+    bool Start();
+
+    // Projects every pending depth frame, writes whatever is still being fused and joins the I/O thread
+    void StopExport();
+
+    // Game thread. Takes raw SceneDepth frames and, when joining color, raw RGB frames; everything else is ignored.
+    void Submit(const FMLCapturedFramePtr& Frame);
+
+    bool IsRunning() const { return Thread != nullptr; }
+
+    FMLPointCloudStats GetStats() const;
+    const FPointCloudExporterSettings& GetSettings() const { return Settings; }
+
+    // FRunnable
+    virtual uint32 Run() override;
+    virtual void Stop() override;
+
+private:
+    struct FPendingFrame
+    {
+        FMLCapturedFramePtr Depth;
+        FMLCapturedFramePtr Color;
+    };
+
+    void Launch(const FMLCapturedFramePtr& Depth, const FMLCapturedFramePtr& Color);
+    void FlushStalePending(int64 NewestFrameIndex);
+
+    // I/O thread
+    void DrainQueue();
+    void Consume(TUniquePtr<FMLPointBuffer> Points);
+    void FlushFusedFrames(int64 MaxFrameIndex);
+    void WriteCloud(const FMLPointBuffer& Points);
+    bool OpenFile(bool bWithColor);
+    void CloseFile();
+
+    FPointCloudExporterSettings Settings;
+
+    // Game thread
+    TMap<uint64, FPendingFrame> Pending;
+    TArray<UE::Tasks::FTask> Tasks;
+    int64 NewestFrameIndex = INDEX_NONE;
+
+    // Shared with the projection tasks
+    TQueue<TUniquePtr<FMLPointBuffer>, EQueueMode::Mpsc> Projected;
+    std::atomic<int32> NumInFlight { 0 };
+    std::atomic<int64> FramesProjected { 0 };
+    std::atomic<int64> FramesDropped { 0 };
+    std::atomic<int64> PointsProjected { 0 };
+    std::atomic<uint64> ProjectCycles { 0 };
+    std::atomic<int64> PointsWritten { 0 };
+    std::atomic<int32> FilesWritten { 0 };
+
+    // I/O thread
+    FRunnableThread* Thread = nullptr;
+    FEvent* WakeEvent = nullptr;
+    std::atomic<bool> bStopRequested { false };
+    TMap<int64, TUniquePtr<FPointCloudVoxelGrid>> FusedFrames;
+    TUniquePtr<FPointCloudVoxelGrid> Accumulated;
+    int64 NewestFusedFrame = INDEX_NONE;
+
+    TUniquePtr<IFileHandle> File;
+    bool bFileHasColor = false;
+    int64 FilePointCount = 0;
+    int32 FileChunkCount = 0;
+    int64 PointCountOffset = 0;
+    int32 NextFileId = 0;
+    TArray<uint8> WriteBuffer;
+};
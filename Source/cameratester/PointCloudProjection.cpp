@@ -0,0 +1,453 @@
+#include "PointCloudProjection.h"
+#include "MLCaptureStats.h"
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
+#include "Math/RandomStream.h"
+
+void FMLPointBuffer::SetNum(int32 NewNum, bool bWithColor)
+{
+    X.SetNumUninitialized(NewNum, EAllowShrinking::No);
+    Y.SetNumUninitialized(NewNum, EAllowShrinking::No);
+    Z.SetNumUninitialized(NewNum, EAllowShrinking::No);
+    Colors.SetNumUninitialized(bWithColor ? NewNum : 0, EAllowShrinking::No);
+}
+
+namespace PointCloudProjection
+{
+namespace
+{
+    // Output rows per ParallelFor task at 4 KB of depth per row, matching the quantization kernels' task size
+    int32 GetRowsPerTask(int32 Width)
+    {
+        return FMath::Max(1, 16384 / FMath::Max(Width, 1));
+    }
+
+    FORCEINLINE bool IsValidDepth(float Depth, float MinDepth, float MaxDepth)
+    {
+        // False for NaN as well
+        return Depth > MinDepth && Depth < MaxDepth;
+    }
+
+    struct FColorSampler
+    {
+        const FColor* Pixels = nullptr;
+        int32 Width = 0;
+        int32 Height = 0;
+        bool bSwapRB = false;
+
+        FORCEINLINE FColor Sample(int32 DepthX, int32 DepthY, int32 DepthWidth, int32 DepthHeight) const
+        {
+            const int32 SampleX = static_cast<int32>(static_cast<int64>(DepthX) * Width / DepthWidth);
+            const int32 SampleY = static_cast<int32>(static_cast<int64>(DepthY) * Height / DepthHeight);
+            FColor Color = Pixels[SampleY * Width + SampleX];
+            if (bSwapRB)
+            {
+                Swap(Color.R, Color.B);
+            }
+            return Color;
+        }
+    };
+
+    // One output row: Forward + Up * RowSlope is shared by the row, Right * RaySlope[i] varies per column
+    struct FRowBasis
+    {
+        float A[3];
+        float B[3];
+    };
+
+    // Columns [Begin, Count) of one row; valid points are appended at InOutNum with their column
+    void WriteRowScalar(const float* RESTRICT Depth, const float* RESTRICT RaySlope, int32 Begin, int32 Count, const FRowBasis& Basis,
+        const FParams& Params, float* RESTRICT OutX, float* RESTRICT OutY, float* RESTRICT OutZ, int32* RESTRICT OutColumns, int32& InOutNum)
+    {
+        for (int32 i = Begin; i < Count; ++i)
+        {
+            const float D = Depth[i];
+            if (!IsValidDepth(D, Params.MinDepth, Params.MaxDepth))
+                continue;
+
+            const int32 Out = InOutNum++;
+            OutX[Out] = D * (Basis.A[0] + Basis.B[0] * RaySlope[i]);
+            OutY[Out] = D * (Basis.A[1] + Basis.B[1] * RaySlope[i]);
+            OutZ[Out] = D * (Basis.A[2] + Basis.B[2] * RaySlope[i]);
+            OutColumns[Out] = i;
+        }
+    }
+
+    void WriteRowVector(const float* RESTRICT Depth, const float* RESTRICT RaySlope, int32 Count, const FRowBasis& Basis,
+        const FParams& Params, float* RESTRICT OutX, float* RESTRICT OutY, float* RESTRICT OutZ, int32* RESTRICT OutColumns, int32& InOutNum)
+    {
+        const VectorRegister4Float Ax = VectorSetFloat1(Basis.A[0]);
+        const VectorRegister4Float Ay = VectorSetFloat1(Basis.A[1]);
+        const VectorRegister4Float Az = VectorSetFloat1(Basis.A[2]);
+        const VectorRegister4Float Bx = VectorSetFloat1(Basis.B[0]);
+        const VectorRegister4Float By = VectorSetFloat1(Basis.B[1]);
+        const VectorRegister4Float Bz = VectorSetFloat1(Basis.B[2]);
+        const VectorRegister4Float MinDepth = VectorSetFloat1(Params.MinDepth);
+        const VectorRegister4Float MaxDepth = VectorSetFloat1(Params.MaxDepth);
+
+        int32 i = 0;
+        for (; i + 4 <= Count; i += 4)
+        {
+            const VectorRegister4Float D = VectorLoad(Depth + i);
+            const int32 ValidMask = VectorMaskBits(VectorBitwiseAnd(VectorCompareGT(D, MinDepth), VectorCompareLT(D, MaxDepth)));
+            if (ValidMask == 0)
+                continue;
+
+            const VectorRegister4Float Slope = VectorLoad(RaySlope + i);
+            alignas(16) float PX[4], PY[4], PZ[4];
+            VectorStoreAligned(VectorMultiply(D, VectorMultiplyAdd(Bx, Slope, Ax)), PX);
+            VectorStoreAligned(VectorMultiply(D, VectorMultiplyAdd(By, Slope, Ay)), PY);
+            VectorStoreAligned(VectorMultiply(D, VectorMultiplyAdd(Bz, Slope, Az)), PZ);
+
+            // Compact the valid lanes
+            for (int32 Lane = 0; Lane < 4; ++Lane)
+            {
+                if (ValidMask & (1 << Lane))
+                {
+                    const int32 Out = InOutNum++;
+                    OutX[Out] = PX[Lane];
+                    OutY[Out] = PY[Lane];
+                    OutZ[Out] = PZ[Lane];
+                    OutColumns[Out] = i + Lane;
+                }
+            }
+        }
+
+        WriteRowScalar(Depth, RaySlope, i, Count, Basis, Params, OutX, OutY, OutZ, OutColumns, InOutNum);
+    }
+}
+
+bool CanBackProject(const FMLCapturedFrame& Depth)
+{
+    return Depth.Codec == EMLFrameCodec::Raw && Depth.PixelFormat == PF_R32_FLOAT && Depth.Width > 0 && Depth.Height > 0
+        && Depth.Pixels.Num() >= static_cast<int64>(Depth.Width) * Depth.Height * sizeof(float);
+}
+
+bool CanSampleColor(const FMLCapturedFrame& Color)
+{
+    return Color.Codec == EMLFrameCodec::Raw && (Color.PixelFormat == PF_B8G8R8A8 || Color.PixelFormat == PF_R8G8B8A8)
+        && Color.Width > 0 && Color.Height > 0 && Color.Pixels.Num() >= static_cast<int64>(Color.Width) * Color.Height * 4;
+}
+
+int32 BackProject(const FMLCapturedFrame& Depth, const FMLCapturedFrame* Color, const FParams& Params, FMLPointBuffer& Out, EKernelPath Path)
+{
+    ML_CAPTURE_SCOPE(STAT_MLCapture_BackProject);
+
+    Out.SetNum(0, false);
+    Out.FrameIndex = Depth.FrameIndex;
+    Out.CameraIndex = Depth.CameraIndex;
+    Out.Origin = Depth.CameraPose.GetLocation();
+    if (!CanBackProject(Depth))
+        return 0;
+
+    FColorSampler Sampler;
+    const bool bColor = Color && CanSampleColor(*Color);
+    if (bColor)
+    {
+        Sampler.Pixels = reinterpret_cast<const FColor*>(Color->Pixels.GetData());
+        Sampler.Width = Color->Width;
+        Sampler.Height = Color->Height;
+        // FColor is BGRA in memory
+        Sampler.bSwapRB = Color->PixelFormat == PF_R8G8B8A8;
+    }
+
+    const int32 Stride = FMath::Max(Params.PixelStride, 1);
+    const int32 Width = Depth.Width;
+    const int32 Height = Depth.Height;
+    const int32 OutWidth = FMath::DivideAndRoundUp(Width, Stride);
+    const int32 OutHeight = FMath::DivideAndRoundUp(Height, Stride);
+
+    // Scene captures use a horizontal FOV; the vertical extent follows the aspect ratio
+    const float TanHalfX = FMath::Tan(FMath::DegreesToRadians(FMath::Clamp(Depth.FOVAngle, 1.0f, 170.0f) * 0.5f));
+    const float TanHalfY = TanHalfX * Height / Width;
+
+    TArray<float> RaySlope;
+    RaySlope.SetNumUninitialized(OutWidth);
+    for (int32 Column = 0; Column < OutWidth; ++Column)
+    {
+        RaySlope[Column] = (2.0f * (Column * Stride + 0.5f) / Width - 1.0f) * TanHalfX;
+    }
+
+    const FVector3f Forward(Depth.CameraPose.GetUnitAxis(EAxis::X));
+    const FVector3f Right(Depth.CameraPose.GetUnitAxis(EAxis::Y));
+    const FVector3f Up(Depth.CameraPose.GetUnitAxis(EAxis::Z));
+    auto MakeRowBasis = [&](int32 PixelY)
+    {
+        const float RowSlope = (1.0f - 2.0f * (PixelY + 0.5f) / Height) * TanHalfY;
+        const FVector3f A = Forward + Up * RowSlope;
+        return FRowBasis{ { A.X, A.Y, A.Z }, { Right.X, Right.Y, Right.Z } };
+    };
+
+    const float* DepthPixels = reinterpret_cast<const float*>(Depth.Pixels.GetData());
+    auto GetRow = [&](int32 OutRow, TArray<float>& Scratch) -> const float*
+    {
+        const float* Row = DepthPixels + static_cast<int64>(OutRow) * Stride * Width;
+        if (Stride == 1)
+            return Row;
+
+        Scratch.SetNumUninitialized(OutWidth, EAllowShrinking::No);
+        for (int32 Column = 0; Column < OutWidth; ++Column)
+        {
+            Scratch[Column] = Row[Column * Stride];
+        }
+        return Scratch.GetData();
+    };
+
+    // Pass 1 counts valid pixels per task so pass 2 can write straight into the final arrays
+    const int32 RowsPerTask = GetRowsPerTask(OutWidth);
+    const int32 NumTasks = FMath::DivideAndRoundUp(OutHeight, RowsPerTask);
+    TArray<int32> TaskOffsets;
+    TaskOffsets.SetNumZeroed(NumTasks + 1);
+
+    ParallelFor(NumTasks, [&](int32 TaskIndex)
+    {
+        TArray<float> Scratch;
+        int32 Count = 0;
+        for (int32 OutRow = TaskIndex * RowsPerTask; OutRow < FMath::Min(OutHeight, (TaskIndex + 1) * RowsPerTask); ++OutRow)
+        {
+            const float* Row = GetRow(OutRow, Scratch);
+            for (int32 Column = 0; Column < OutWidth; ++Column)
+            {
+                Count += IsValidDepth(Row[Column], Params.MinDepth, Params.MaxDepth) ? 1 : 0;
+            }
+        }
+        TaskOffsets[TaskIndex + 1] = Count;
+    });
+
+    for (int32 TaskIndex = 0; TaskIndex < NumTasks; ++TaskIndex)
+    {
+        TaskOffsets[TaskIndex + 1] += TaskOffsets[TaskIndex];
+    }
+    Out.SetNum(TaskOffsets[NumTasks], bColor);
+
+    ParallelFor(NumTasks, [&](int32 TaskIndex)
+    {
+        TArray<float> Scratch;
+        TArray<int32> Columns;
+        Columns.SetNumUninitialized(OutWidth);
+
+        int32 Written = TaskOffsets[TaskIndex];
+        for (int32 OutRow = TaskIndex * RowsPerTask; OutRow < FMath::Min(OutHeight, (TaskIndex + 1) * RowsPerTask); ++OutRow)
+        {
+            const float* Row = GetRow(OutRow, Scratch);
+            const FRowBasis Basis = MakeRowBasis(OutRow * Stride);
+
+            int32 RowCount = 0;
+            float* OutX = Out.X.GetData() + Written;
+            float* OutY = Out.Y.GetData() + Written;
+            float* OutZ = Out.Z.GetData() + Written;
+            if (Path == EKernelPath::Vector)
+            {
+                WriteRowVector(Row, RaySlope.GetData(), OutWidth, Basis, Params, OutX, OutY, OutZ, Columns.GetData(), RowCount);
+            }
+            else
+            {
+                WriteRowScalar(Row, RaySlope.GetData(), 0, OutWidth, Basis, Params, OutX, OutY, OutZ, Columns.GetData(), RowCount);
+            }
+
+            if (bColor)
+            {
+                FColor* OutColors = Out.Colors.GetData() + Written;
+                for (int32 Point = 0; Point < RowCount; ++Point)
+                {
+                    OutColors[Point] = Sampler.Sample(Columns[Point] * Stride, OutRow * Stride, Width, Height);
+                }
+            }
+            Written += RowCount;
+        }
+    });
+
+    return Out.Num();
+}
+
+void VoxelDownsample(FMLPointBuffer& Points, float VoxelSize)
+{
+    if (VoxelSize <= 0.0f || Points.Num() == 0)
+        return;
+
+    FPointCloudVoxelGrid Grid(VoxelSize);
+    Grid.Add(Points);
+
+    const int64 FrameIndex = Points.FrameIndex;
+    const int32 CameraIndex = Points.CameraIndex;
+    Grid.Extract(Points);
+    Points.FrameIndex = FrameIndex;
+    Points.CameraIndex = CameraIndex;
+}
+}
+
+FPointCloudVoxelGrid::FPointCloudVoxelGrid(float InVoxelSize)
+    : VoxelSize(FMath::Max(InVoxelSize, 0.01f))
+{
+}
+
+void FPointCloudVoxelGrid::Add(const FMLPointBuffer& Points)
+{
+    const int32 NumPoints = Points.Num();
+    if (NumPoints == 0)
+        return;
+
+    if (!bHasReference)
+    {
+        Reference = Points.Origin;
+        bHasReference = true;
+    }
+    bHasColor = bHasColor && Points.HasColor();
+    PointsAdded += NumPoints;
+
+    // Keys in parallel; the map insert below is the only serial part
+    const FVector3f Offset(Points.Origin - Reference);
+    const float InvVoxelSize = 1.0f / VoxelSize;
+    KeyScratch.SetNumUninitialized(NumPoints, EAllowShrinking::No);
+    ParallelFor(FMath::DivideAndRoundUp(NumPoints, 16384), [&](int32 TaskIndex)
+    {
+        const int32 End = FMath::Min(NumPoints, (TaskIndex + 1) * 16384);
+        for (int32 i = TaskIndex * 16384; i < End; ++i)
+        {
+            KeyScratch[i] = FIntVector(
+                FMath::FloorToInt32((Points.X[i] + Offset.X) * InvVoxelSize),
+                FMath::FloorToInt32((Points.Y[i] + Offset.Y) * InvVoxelSize),
+                FMath::FloorToInt32((Points.Z[i] + Offset.Z) * InvVoxelSize));
+        }
+    });
+
+    for (int32 i = 0; i < NumPoints; ++i)
+    {
+        int32& VoxelIndex = VoxelByKey.FindOrAdd(KeyScratch[i], INDEX_NONE);
+        if (VoxelIndex == INDEX_NONE)
+        {
+            VoxelIndex = Voxels.AddDefaulted();
+        }
+
+        FVoxel& Voxel = Voxels[VoxelIndex];
+        Voxel.Sum[0] += Points.X[i] + Offset.X;
+        Voxel.Sum[1] += Points.Y[i] + Offset.Y;
+        Voxel.Sum[2] += Points.Z[i] + Offset.Z;
+        if (bHasColor)
+        {
+            Voxel.ColorSum[0] += Points.Colors[i].R;
+            Voxel.ColorSum[1] += Points.Colors[i].G;
+            Voxel.ColorSum[2] += Points.Colors[i].B;
+        }
+        ++Voxel.Count;
+    }
+}
+
+void FPointCloudVoxelGrid::Extract(FMLPointBuffer& Out) const
+{
+    Out.SetNum(Voxels.Num(), bHasColor && Voxels.Num() > 0);
+    Out.Origin = Reference;
+    Out.CameraIndex = INDEX_NONE;
+
+    for (int32 i = 0; i < Voxels.Num(); ++i)
+    {
+        const FVoxel& Voxel = Voxels[i];
+        const double InvCount = 1.0 / Voxel.Count;
+        Out.X[i] = static_cast<float>(Voxel.Sum[0] * InvCount);
+        Out.Y[i] = static_cast<float>(Voxel.Sum[1] * InvCount);
+        Out.Z[i] = static_cast<float>(Voxel.Sum[2] * InvCount);
+        if (bHasColor)
+        {
+            Out.Colors[i] = FColor(static_cast<uint8>(Voxel.ColorSum[0] / Voxel.Count), static_cast<uint8>(Voxel.ColorSum[1] / Voxel.Count),
+                static_cast<uint8>(Voxel.ColorSum[2] / Voxel.Count));
+        }
+    }
+}
+
+void FPointCloudVoxelGrid::Reset()
+{
+    bHasReference = false;
+    bHasColor = true;
+    PointsAdded = 0;
+    VoxelByKey.Reset();
+    Voxels.Reset();
+}
+
+namespace PointCloudProjection
+{
+namespace
+{
+    // Checks the vector kernel against the scalar one and reports back-projection and voxel throughput in points/s
+    void RunPointCloudBenchmark()
+    {
+        constexpr int32 Width = 2048;
+        constexpr int32 Height = 2048;
+        constexpr int32 Iterations = 10;
+
+        FMLCapturedFrame Depth;
+        Depth.Width = Width;
+        Depth.Height = Height;
+        Depth.PixelFormat = PF_R32_FLOAT;
+        Depth.BytesPerPixel = 4;
+        Depth.FOVAngle = 90.0f;
+        Depth.CameraPose = FTransform(FRotator(-20.0f, 35.0f, 0.0f), FVector(120000.0, -40000.0, 500.0));
+        Depth.Pixels.SetNumUninitialized(Width * Height * sizeof(float));
+
+        // About 10% sky beyond MaxDepth, the rest spread over the depth range
+        FRandomStream Stream(42);
+        float* DepthPixels = reinterpret_cast<float*>(Depth.Pixels.GetData());
+        for (int32 i = 0; i < Width * Height; ++i)
+        {
+            DepthPixels[i] = Stream.FRand() < 0.1f ? 1.0e6f : Stream.FRandRange(20.0f, 9000.0f);
+        }
+
+        FMLCapturedFrame Color;
+        Color.Width = Width / 2;
+        Color.Height = Height / 2;
+        Color.PixelFormat = PF_B8G8R8A8;
+        Color.BytesPerPixel = 4;
+        Color.Pixels.SetNumUninitialized(Color.Width * Color.Height * 4);
+        for (uint8& Byte : Color.Pixels)
+        {
+            Byte = static_cast<uint8>(Stream.RandHelper(256));
+        }
+
+        const FParams Params;
+        FMLPointBuffer Reference;
+        FMLPointBuffer Points;
+        BackProject(Depth, nullptr, Params, Reference, EKernelPath::Scalar);
+
+        for (const EKernelPath Path : { EKernelPath::Scalar, EKernelPath::Vector })
+        {
+            for (const bool bWithColor : { false, true })
+            {
+                BackProject(Depth, bWithColor ? &Color : nullptr, Params, Points, Path);
+                float MaxError = Points.Num() == Reference.Num() ? 0.0f : TNumericLimits<float>::Max();
+                for (int32 i = 0; i < Points.Num() && i < Reference.Num(); ++i)
+                {
+                    MaxError = FMath::Max(MaxError, FMath::Abs(Points.X[i] - Reference.X[i]) + FMath::Abs(Points.Y[i] - Reference.Y[i]) + FMath::Abs(Points.Z[i] - Reference.Z[i]));
+                }
+
+                const double Start = FPlatformTime::Seconds();
+                for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+                {
+                    BackProject(Depth, bWithColor ? &Color : nullptr, Params, Points, Path);
+                }
+                const double Seconds = FPlatformTime::Seconds() - Start;
+
+                UE_LOG(LogMLCapture, Display, TEXT("PointCloud back-projection %-6s %-8s: %7.1f Mpoints/s (%d points, max error %.4f cm vs scalar)"),
+                    Path == EKernelPath::Vector ? TEXT("Vector") : TEXT("Scalar"), bWithColor ? TEXT("+color") : TEXT("xyz"),
+                    Points.Num() * static_cast<double>(Iterations) / Seconds / 1.0e6, Points.Num(), MaxError);
+            }
+        }
+
+        for (const float VoxelSize : { 5.0f, 20.0f })
+        {
+            const double Start = FPlatformTime::Seconds();
+            FPointCloudVoxelGrid Grid(VoxelSize);
+            Grid.Add(Reference);
+            FMLPointBuffer Downsampled;
+            Grid.Extract(Downsampled);
+            const double Seconds = FPlatformTime::Seconds() - Start;
+
+            UE_LOG(LogMLCapture, Display, TEXT("PointCloud voxel grid %4.0f cm: %7.1f Mpoints/s (%d -> %d points)"),
+                VoxelSize, Reference.Num() / Seconds / 1.0e6, Reference.Num(), Downsampled.Num());
+        }
+    }
+
+    FAutoConsoleCommand PointCloudBenchmarkCommand(
+        TEXT("ml.PointCloud.Benchmark"),
+        TEXT("Verify the vector back-projection kernel against the scalar one and report points/s for projection and voxel fusion"),
+        FConsoleCommandDelegate::CreateStatic(&RunPointCloudBenchmark));
+}
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MLCaptureTypes.h"
+
+// Structure-of-arrays point set. Positions are relative to Origin so they keep float precision far from the world origin.
+struct CAMERATESTER_API FMLPointBuffer
+{
+    FVector Origin = FVector::ZeroVector;
+    TArray<float> X;
+    TArray<float> Y;
+    TArray<float> Z;
+
+    // Empty when the points carry no color
+    TArray<FColor> Colors;
+
+    int64 FrameIndex = 0;
+
+    // INDEX_NONE for clouds fused from several cameras
+    int32 CameraIndex = INDEX_NONE;
+
+    int32 Num() const { return X.Num(); }
+    bool HasColor() const { return X.Num() > 0 && Colors.Num() == X.Num(); }
+
+    void SetNum(int32 NewNum, bool bWithColor);
+};
+
+// Turns read-back SceneDepth into world-space points using the capture's FOV, size and pose.
+// Depth is planar (distance along the view axis), so a pixel's point is its camera ray scaled by depth.
+namespace PointCloudProjection
+{
+    enum class EKernelPath : uint8
+    {
+        Scalar,
+        // Four pixels per step with the engine's portable vector registers
+        Vector
+    };
+
+    struct FParams
+    {
+        float MinDepth = 1.0f;       // Closer pixels are dropped (cm)
+        float MaxDepth = 10000.0f;   // Farther pixels, sky included, are dropped (cm)
+        int32 PixelStride = 1;       // Use every Nth pixel in both directions
+    };
+
+    // Raw R32f depth with pixels
+    CAMERATESTER_API bool CanBackProject(const FMLCapturedFrame& Depth);
+
+    // Raw 8-bit BGRA/RGBA; any size, it is sampled at the depth pixel's relative position
+    CAMERATESTER_API bool CanSampleColor(const FMLCapturedFrame& Color);
+
+    // Fills Out with one point per valid pixel, Origin at the camera. Rows are split over ParallelFor; returns the point count.
+    CAMERATESTER_API int32 BackProject(const FMLCapturedFrame& Depth, const FMLCapturedFrame* Color, const FParams& Params,
+        FMLPointBuffer& Out, EKernelPath Path = EKernelPath::Vector);
+
+    // Replaces the points with one centroid per occupied VoxelSize cube
+    CAMERATESTER_API void VoxelDownsample(FMLPointBuffer& Points, float VoxelSize);
+}
+
+// Fuses point sets from any number of cameras and frames into one world-space voxel grid.
+// Each occupied voxel keeps the running sum of its points, so the result is the centroid (and mean color) per voxel.
+class CAMERATESTER_API FPointCloudVoxelGrid
+{
+public:
+    explicit FPointCloudVoxelGrid(float InVoxelSize);
+
+    void Add(const FMLPointBuffer& Points);
+
+    // Centroids relative to the grid's reference point; color only if every added set had it
+    void Extract(FMLPointBuffer& Out) const;
+
+    int32 Num() const { return Voxels.Num(); }
+    int64 GetPointsAdded() const { return PointsAdded; }
+    void Reset();
+
+private:
+    struct FVoxel
+    {
+        double Sum[3] = { 0.0, 0.0, 0.0 };
+        uint32 ColorSum[3] = { 0, 0, 0 };
+        uint32 Count = 0;
+    };
+
+    float VoxelSize;
+    // First added origin; voxel keys and sums are relative to it
+    FVector Reference = FVector::ZeroVector;
+    bool bHasReference = false;
+    bool bHasColor = true;
+    int64 PointsAdded = 0;
+    TMap<FIntVector, int32> VoxelByKey;
+    TArray<FVoxel> Voxels;
+    TArray<FIntVector> KeyScratch;
+};
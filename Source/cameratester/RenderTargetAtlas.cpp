@@ -0,0 +1,266 @@
+#include "RenderTargetAtlas.h"
+#include "MLCaptureStats.h"
+#include "RenderTargetReadback.h"
+#include "RenderTargetPool.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "RenderingThread.h"
+#include "TextureResource.h"
+#include "RHICommandList.h"
+
+namespace
+{
+    // Frames older than this are assumed dropped by the readback ring
+    constexpr int64 MaxPendingAtlasFrames = 64;
+}
+
+void FRenderTargetAtlas::Build(UObject* Outer, FRenderTargetPool& InPool, TArray<FMLCaptureBinding>& Bindings, int32 TileWidth, int32 TileHeight)
+{
+    Reset();
+    Pool = &InPool;
+
+    if (TileWidth <= 0 || TileHeight <= 0)
+        return;
+
+    const int32 MaxColumns = FMath::Max(1, MaxAtlasDimension / TileWidth);
+    const int32 MaxRows = FMath::Max(1, MaxAtlasDimension / TileHeight);
+
+    for (uint8 TypeIndex = 0; TypeIndex < static_cast<uint8>(EMLBufferType::Count); ++TypeIndex)
+    {
+        const EMLBufferType BufferType = static_cast<EMLBufferType>(TypeIndex);
+
+        TArray<int32> BindingIndices;
+        for (int32 BindingIndex = 0; BindingIndex < Bindings.Num(); ++BindingIndex)
+        {
+            if (Bindings[BindingIndex].BufferType == BufferType && IsValid(Bindings[BindingIndex].SceneCapture))
+            {
+                BindingIndices.Add(BindingIndex);
+            }
+        }
+        if (BindingIndices.Num() == 0)
+            continue;
+
+        const int32 Columns = FMath::Min(FMath::CeilToInt(FMath::Sqrt(static_cast<float>(BindingIndices.Num()))), MaxColumns);
+        const int32 Rows = FMath::Min(FMath::DivideAndRoundUp(BindingIndices.Num(), Columns), MaxRows);
+        const int32 Capacity = Columns * Rows;
+        if (Capacity < BindingIndices.Num())
+        {
+            UE_LOG(LogMLCapture, Warning, TEXT("%s atlas holds %d of %d cameras at %dx%d; the rest keep their own render targets"),
+                MLCapture::GetBufferTypeName(BufferType), Capacity, BindingIndices.Num(), TileWidth, TileHeight);
+        }
+
+        FBufferAtlas& BufferAtlas = Atlases.AddDefaulted_GetRef();
+        BufferAtlas.BufferType = BufferType;
+        const ETextureRenderTargetFormat Format = MLCapture::GetDefaultFormat(BufferType);
+        BufferAtlas.Atlas = Pool->Acquire(Outer, Columns * TileWidth, Rows * TileHeight, Format);
+        BufferAtlas.Scratch = Pool->Acquire(Outer, TileWidth, TileHeight, Format);
+
+        const int32 NumTiles = FMath::Min(Capacity, BindingIndices.Num());
+        for (int32 TileIndex = 0; TileIndex < NumTiles; ++TileIndex)
+        {
+            FMLCaptureBinding& Binding = Bindings[BindingIndices[TileIndex]];
+
+            FMLAtlasTile& Tile = BufferAtlas.Tiles.AddDefaulted_GetRef();
+            Tile.CameraIndex = Binding.CameraIndex;
+            Tile.BufferType = BufferType;
+            Tile.TileIndex = TileIndex;
+            Tile.Origin = FIntPoint((TileIndex % Columns) * TileWidth, (TileIndex / Columns) * TileHeight);
+            Tile.Size = FIntPoint(TileWidth, TileHeight);
+            BufferAtlas.TileByCamera.Add(Binding.CameraIndex, TileIndex);
+
+            Binding.RenderTarget = BufferAtlas.Atlas;
+            Binding.SceneCapture->TextureTarget = BufferAtlas.Scratch;
+        }
+
+        UE_LOG(LogMLCapture, Log, TEXT("✓ Built %s atlas: %d tiles in %dx%d (%dx%d px)"),
+            MLCapture::GetBufferTypeName(BufferType), NumTiles, Columns, Rows, Columns * TileWidth, Rows * TileHeight);
+    }
+}
+
+void FRenderTargetAtlas::Reset()
+{
+    if (Pool)
+    {
+        for (FBufferAtlas& BufferAtlas : Atlases)
+        {
+            Pool->Release(BufferAtlas.Atlas);
+            Pool->Release(BufferAtlas.Scratch);
+        }
+    }
+    Atlases.Reset();
+}
+
+FRenderTargetAtlas::FBufferAtlas* FRenderTargetAtlas::FindAtlas(EMLBufferType BufferType)
+{
+    return Atlases.FindByPredicate([BufferType](const FBufferAtlas& Atlas) { return Atlas.BufferType == BufferType; });
+}
+
+const FRenderTargetAtlas::FBufferAtlas* FRenderTargetAtlas::FindAtlas(EMLBufferType BufferType) const
+{
+    return Atlases.FindByPredicate([BufferType](const FBufferAtlas& Atlas) { return Atlas.BufferType == BufferType; });
+}
+
+bool FRenderTargetAtlas::ContainsCapture(const FMLCaptureBinding& Binding) const
+{
+    const FBufferAtlas* BufferAtlas = FindAtlas(Binding.BufferType);
+    return BufferAtlas && BufferAtlas->TileByCamera.Contains(Binding.CameraIndex);
+}
+
+bool FRenderTargetAtlas::CaptureIntoAtlas(const FMLCaptureBinding& Binding)
+{
+    FBufferAtlas* BufferAtlas = FindAtlas(Binding.BufferType);
+    if (!BufferAtlas || !IsValid(Binding.SceneCapture) || !IsValid(BufferAtlas->Atlas) || !IsValid(BufferAtlas->Scratch))
+        return false;
+
+    const int32* TileIndex = BufferAtlas->TileByCamera.Find(Binding.CameraIndex);
+    if (!TileIndex)
+        return false;
+
+    Binding.SceneCapture->TextureTarget = BufferAtlas->Scratch;
+    Binding.SceneCapture->CaptureScene();
+
+    // Captures and copies are serialised on the render thread, so one scratch target serves every camera
+    FTextureRenderTargetResource* ScratchResource = BufferAtlas->Scratch->GameThread_GetRenderTargetResource();
+    FTextureRenderTargetResource* AtlasResource = BufferAtlas->Atlas->GameThread_GetRenderTargetResource();
+    const FMLAtlasTile& Tile = BufferAtlas->Tiles[*TileIndex];
+    const FIntVector DestPosition(Tile.Origin.X, Tile.Origin.Y, 0);
+    const FIntVector CopySize(Tile.Size.X, Tile.Size.Y, 1);
+
+    ENQUEUE_RENDER_COMMAND(MLCopyToAtlasTile)(
+        [ScratchResource, AtlasResource, DestPosition, CopySize](FRHICommandListImmediate& RHICmdList)
+        {
+            FRHITexture* SrcTexture = ScratchResource->GetRenderTargetTexture();
+            FRHITexture* DstTexture = AtlasResource->GetRenderTargetTexture();
+            if (!SrcTexture || !DstTexture)
+                return;
+
+            FRHICopyTextureInfo CopyInfo;
+            CopyInfo.Size = CopySize;
+            CopyInfo.DestPosition = DestPosition;
+
+            RHICmdList.Transition({
+                FRHITransitionInfo(SrcTexture, ERHIAccess::Unknown, ERHIAccess::CopySrc),
+                FRHITransitionInfo(DstTexture, ERHIAccess::Unknown, ERHIAccess::CopyDest) });
+            RHICmdList.CopyTexture(SrcTexture, DstTexture, CopyInfo);
+            RHICmdList.Transition({
+                FRHITransitionInfo(SrcTexture, ERHIAccess::CopySrc, ERHIAccess::SRVMask),
+                FRHITransitionInfo(DstTexture, ERHIAccess::CopyDest, ERHIAccess::SRVMask) });
+        });
+
+    FWrittenTile& Written = BufferAtlas->WrittenTiles.AddDefaulted_GetRef();
+    Written.TileIndex = *TileIndex;
+    Written.Pose = Binding.SceneCapture->GetComponentTransform();
+    Written.FOVAngle = Binding.SceneCapture->FOVAngle;
+    return true;
+}
+
+void FRenderTargetAtlas::EndFrame(int64 FrameIndex, FRenderTargetReadback& Readback)
+{
+    for (FBufferAtlas& BufferAtlas : Atlases)
+    {
+        if (BufferAtlas.WrittenTiles.Num() == 0)
+            continue;
+
+        // A scheduled frame often writes a few tiles of a large atlas; copy just the rectangle around them
+        FIntRect ReadRect;
+        for (const FWrittenTile& Written : BufferAtlas.WrittenTiles)
+        {
+            const FMLAtlasTile& Tile = BufferAtlas.Tiles[Written.TileIndex];
+            const FIntRect TileRect(Tile.Origin, Tile.Origin + Tile.Size);
+            if (ReadRect.IsEmpty())
+            {
+                ReadRect = TileRect;
+            }
+            else
+            {
+                ReadRect.Union(TileRect);
+            }
+        }
+
+        if (Readback.EnqueueReadback(INDEX_NONE, BufferAtlas.BufferType, FrameIndex, BufferAtlas.Atlas, FTransform::Identity, 90.0f, ReadRect))
+        {
+            FPendingFrame& Pending = BufferAtlas.PendingFrames.Add(FrameIndex);
+            Pending.ReadOrigin = ReadRect.Min;
+            Pending.Tiles = MoveTemp(BufferAtlas.WrittenTiles);
+        }
+        BufferAtlas.WrittenTiles.Reset();
+
+        for (auto It = BufferAtlas.PendingFrames.CreateIterator(); It; ++It)
+        {
+            if (It.Key() < FrameIndex - MaxPendingAtlasFrames)
+            {
+                It.RemoveCurrent();
+            }
+        }
+    }
+}
+
+void FRenderTargetAtlas::SplitFrame(const FMLCapturedFramePtr& AtlasFrame, TArray<FMLCapturedFramePtr>& OutFrames)
+{
+    FBufferAtlas* BufferAtlas = FindAtlas(AtlasFrame->BufferType);
+    FPendingFrame Pending;
+    if (!BufferAtlas || !BufferAtlas->PendingFrames.RemoveAndCopyValue(AtlasFrame->FrameIndex, Pending))
+        return;
+
+    const int32 BytesPerPixel = AtlasFrame->BytesPerPixel;
+    const int32 AtlasPitch = AtlasFrame->Width * BytesPerPixel;
+
+    for (const FWrittenTile& Written : Pending.Tiles)
+    {
+        const FMLAtlasTile& Tile = BufferAtlas->Tiles[Written.TileIndex];
+        const FIntPoint Origin = Tile.Origin - Pending.ReadOrigin;
+        if (Origin.X < 0 || Origin.Y < 0 || Origin.X + Tile.Size.X > AtlasFrame->Width || Origin.Y + Tile.Size.Y > AtlasFrame->Height)
+            continue;
+
+        FMLCapturedFramePtr Frame = MakeShared<FMLCapturedFrame, ESPMode::ThreadSafe>();
+        Frame->FrameIndex = AtlasFrame->FrameIndex;
+        Frame->CameraIndex = Tile.CameraIndex;
+        Frame->BufferType = AtlasFrame->BufferType;
+        Frame->Width = Tile.Size.X;
+        Frame->Height = Tile.Size.Y;
+        Frame->PixelFormat = AtlasFrame->PixelFormat;
+        Frame->BytesPerPixel = BytesPerPixel;
+        Frame->CameraPose = Written.Pose;
+        Frame->FOVAngle = Written.FOVAngle;
+
+        const int32 TilePitch = Tile.Size.X * BytesPerPixel;
+        Frame->Pixels.SetNumUninitialized(TilePitch * Tile.Size.Y);
+
+        const uint8* Src = AtlasFrame->Pixels.GetData() + Origin.Y * AtlasPitch + Origin.X * BytesPerPixel;
+        for (int32 Y = 0; Y < Tile.Size.Y; ++Y)
+        {
+            FMemory::Memcpy(Frame->Pixels.GetData() + Y * TilePitch, Src + Y * AtlasPitch, TilePitch);
+        }
+
+        OutFrames.Add(Frame);
+    }
+}
+
+TArray<FMLAtlasTile> FRenderTargetAtlas::GetTiles(EMLBufferType BufferType) const
+{
+    const FBufferAtlas* BufferAtlas = FindAtlas(BufferType);
+    return BufferAtlas ? BufferAtlas->Tiles : TArray<FMLAtlasTile>();
+}
+
+UTextureRenderTarget2D* FRenderTargetAtlas::GetAtlasTarget(EMLBufferType BufferType) const
+{
+    const FBufferAtlas* BufferAtlas = FindAtlas(BufferType);
+    return BufferAtlas ? BufferAtlas->Atlas.Get() : nullptr;
+}
+
+void FRenderTargetAtlas::GetRenderTargets(TArray<UTextureRenderTarget2D*>& OutTargets) const
+{
+    for (const FBufferAtlas& BufferAtlas : Atlases)
+    {
+        OutTargets.Add(BufferAtlas.Atlas);
+        OutTargets.Add(BufferAtlas.Scratch);
+    }
+}
+
+void FRenderTargetAtlas::AddReferencedObjects(FReferenceCollector& Collector)
+{
+    for (FBufferAtlas& BufferAtlas : Atlases)
+    {
+        Collector.AddReferencedObject(BufferAtlas.Atlas);
+        Collector.AddReferencedObject(BufferAtlas.Scratch);
+    }
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/GCObject.h"
+#include "MLCaptureTypes.h"
+#include "RenderTargetAtlas.generated.h"
+
+class FRenderTargetReadback;
+class FRenderTargetPool;
+
+// Where one camera's image lives inside its buffer type's atlas
+USTRUCT(BlueprintType)
+struct CAMERATESTER_API FMLAtlasTile
+{
+    GENERATED_BODY()
+
+    UPROPERTY(BlueprintReadOnly, Category = "Atlas")
+    int32 CameraIndex = INDEX_NONE;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Atlas")
+    EMLBufferType BufferType = EMLBufferType::RGB;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Atlas")
+    int32 TileIndex = INDEX_NONE;
+
+    // Top-left pixel and size of the tile in the atlas
+    UPROPERTY(BlueprintReadOnly, Category = "Atlas")
+    FIntPoint Origin = FIntPoint::ZeroValue;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Atlas")
+    FIntPoint Size = FIntPoint::ZeroValue;
+};
+
+// Packs every camera of one buffer type into a single tiled render target.
+// Each camera renders into a shared scratch target which is copied into its tile on the GPU, so a frame costs
+// one atlas resolve and one readback per buffer type regardless of camera count. The readback covers only the
+// rectangle around the tiles written that frame.
+class CAMERATESTER_API FRenderTargetAtlas : public FGCObject
+{
+public:
+    // Largest atlas edge we allocate; the owner gives cameras that don't fit their own render target
+    static constexpr int32 MaxAtlasDimension = 16384;
+
+    // Build atlases for the given bindings. Bindings that were packed get their RenderTarget pointed at the atlas.
+    void Build(UObject* Outer, FRenderTargetPool& InPool, TArray<FMLCaptureBinding>& Bindings, int32 TileWidth, int32 TileHeight);
+
+    // Return the atlas targets to the pool they came from
+    void Reset();
+
+    bool IsEmpty() const { return Atlases.Num() == 0; }
+    bool ContainsCapture(const FMLCaptureBinding& Binding) const;
+
+    // Render the binding into the scratch target and copy it into its tile
+    bool CaptureIntoAtlas(const FMLCaptureBinding& Binding);
+
+    // Queue one readback per atlas that received tiles since the last call
+    void EndFrame(int64 FrameIndex, FRenderTargetReadback& Readback);
+
+    // Split a read-back atlas into per-camera frames for the tiles written in that frame
+    void SplitFrame(const FMLCapturedFramePtr& AtlasFrame, TArray<FMLCapturedFramePtr>& OutFrames);
+
+    TArray<FMLAtlasTile> GetTiles(EMLBufferType BufferType) const;
+    UTextureRenderTarget2D* GetAtlasTarget(EMLBufferType BufferType) const;
+    void GetRenderTargets(TArray<UTextureRenderTarget2D*>& OutTargets) const;
+
+    // FGCObject
+    virtual void AddReferencedObjects(FReferenceCollector& Collector) override;
+    virtual FString GetReferencerName() const override { return TEXT("FRenderTargetAtlas"); }
+
+private:
+    struct FWrittenTile
+    {
+        int32 TileIndex = INDEX_NONE;
+        FTransform Pose;
+        float FOVAngle = 90.0f;
+    };
+
+    struct FPendingFrame
+    {
+        // Atlas pixel the read-back frame starts at
+        FIntPoint ReadOrigin = FIntPoint::ZeroValue;
+        TArray<FWrittenTile> Tiles;
+    };
+
+    struct FBufferAtlas
+    {
+        EMLBufferType BufferType = EMLBufferType::RGB;
+        TObjectPtr<UTextureRenderTarget2D> Atlas = nullptr;
+        TObjectPtr<UTextureRenderTarget2D> Scratch = nullptr;
+        TArray<FMLAtlasTile> Tiles;
+        TMap<int32, int32> TileByCamera;
+
+        // Tiles written since the last EndFrame, and per read-back frame awaiting its data
+        TArray<FWrittenTile> WrittenTiles;
+        TMap<int64, FPendingFrame> PendingFrames;
+    };
+
+    FBufferAtlas* FindAtlas(EMLBufferType BufferType);
+    const FBufferAtlas* FindAtlas(EMLBufferType BufferType) const;
+
+    TArray<FBufferAtlas> Atlases;
+    FRenderTargetPool* Pool = nullptr;
+};
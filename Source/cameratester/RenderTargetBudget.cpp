@@ -0,0 +1,134 @@
+#include "RenderTargetBudget.h"
+#include "DynamicRHI.h"
+#include "RHIResources.h"
+
+int64 RenderTargetBudget::ComputeTextureBytes(int32 Width, int32 Height, EPixelFormat Format, bool bStaging)
+{
+    if (Width <= 0 || Height <= 0)
+        return 0;
+
+    if (GDynamicRHI)
+    {
+        const FRHITextureCreateDesc Desc = FRHITextureCreateDesc::Create2D(TEXT("MLBudgetQuery"), Width, Height, Format)
+            .SetFlags(bStaging ? ETextureCreateFlags::CPUReadback : ETextureCreateFlags::RenderTargetable | ETextureCreateFlags::ShaderResource);
+        return static_cast<int64>(RHICalcTexturePlatformSize(Desc).Size);
+    }
+
+    // No RHI (commandlets, null renderer): tightly packed
+    return static_cast<int64>(Width) * Height * GPixelFormats[Format].BlockBytes;
+}
+
+int64 RenderTargetBudget::ComputeTargetBytes(int32 Width, int32 Height, ETextureRenderTargetFormat Format, bool bStaging)
+{
+    return ComputeTextureBytes(Width, Height, GetPixelFormatFromRenderTargetFormat(Format), bStaging);
+}
+
+FIntPoint RenderTargetBudget::ScaleSize(const FIntPoint& BaseSize, float Scale)
+{
+    if (Scale >= 1.0f)
+        return BaseSize;
+
+    // Multiples of 4 keep half- and quarter-resolution passes aligned
+    return FIntPoint(
+        FMath::Max(16, FMath::RoundToInt(BaseSize.X * Scale / 4.0f) * 4),
+        FMath::Max(16, FMath::RoundToInt(BaseSize.Y * Scale / 4.0f) * 4));
+}
+
+int64 RenderTargetBudget::ComputeCameraBytes(const TArray<FTargetDemand>& Targets, const FPlan& InPlan, int32 StagingCopies)
+{
+    int64 Bytes = 0;
+    for (const FTargetDemand& Target : Targets)
+    {
+        if (InPlan.IsDropped(Target.BufferType))
+            continue;
+
+        const FIntPoint Size = Target.bOwned ? ScaleSize(Target.Size, InPlan.ResolutionScale) : Target.Size;
+        if (Target.bOwned)
+        {
+            Bytes += ComputeTargetBytes(Size.X, Size.Y, Target.Format);
+        }
+        if (StagingCopies > 0)
+        {
+            Bytes += StagingCopies * ComputeTargetBytes(Size.X, Size.Y, Target.Format, true);
+        }
+    }
+    return Bytes;
+}
+
+RenderTargetBudget::FPlan RenderTargetBudget::Plan(const TArray<TArray<FTargetDemand>>& Cameras, const FSettings& Settings)
+{
+    auto ComputeTotal = [&Cameras, &Settings](const FPlan& Candidate)
+    {
+        int64 Total = 0;
+        for (const TArray<FTargetDemand>& Targets : Cameras)
+        {
+            Total += ComputeCameraBytes(Targets, Candidate, Settings.StagingCopies);
+        }
+        return Total;
+    };
+
+    FPlan Result;
+    Result.NumCameras = Cameras.Num();
+    Result.PlannedBytes = ComputeTotal(Result);
+    if (Settings.BudgetBytes <= 0 || Result.PlannedBytes <= Settings.BudgetBytes)
+        return Result;
+
+    const bool bDrop = Settings.Policy == EMLMemoryBudgetPolicy::DropOptionalBuffers || Settings.Policy == EMLMemoryBudgetPolicy::DropThenReduce;
+    const bool bReduce = Settings.Policy == EMLMemoryBudgetPolicy::ReduceResolution || Settings.Policy == EMLMemoryBudgetPolicy::DropThenReduce;
+
+    if (bDrop)
+    {
+        for (const EMLBufferType BufferType : Settings.OptionalBuffers)
+        {
+            Result.DroppedBuffers.AddUnique(BufferType);
+            Result.PlannedBytes = ComputeTotal(Result);
+            if (Result.PlannedBytes <= Settings.BudgetBytes)
+                return Result;
+        }
+    }
+
+    if (bReduce)
+    {
+        const float MinScale = FMath::Clamp(Settings.MinResolutionScale, 0.05f, 1.0f);
+        Result.ResolutionScale = MinScale;
+        Result.PlannedBytes = ComputeTotal(Result);
+        if (Result.PlannedBytes <= Settings.BudgetBytes)
+        {
+            // Bytes only grow with scale, so bisect for the largest scale that still fits
+            float Low = MinScale;
+            float High = 1.0f;
+            for (int32 Iteration = 0; Iteration < 12; ++Iteration)
+            {
+                FPlan Candidate = Result;
+                Candidate.ResolutionScale = 0.5f * (Low + High);
+                const int64 CandidateBytes = ComputeTotal(Candidate);
+                if (CandidateBytes <= Settings.BudgetBytes)
+                {
+                    Low = Candidate.ResolutionScale;
+                    Result.PlannedBytes = CandidateBytes;
+                }
+                else
+                {
+                    High = Candidate.ResolutionScale;
+                }
+            }
+            Result.ResolutionScale = Low;
+            return Result;
+        }
+    }
+
+    // Last resort: the first cameras that fit keep every remaining buffer, the rest get nothing
+    int64 Used = 0;
+    Result.NumCameras = 0;
+    for (const TArray<FTargetDemand>& Targets : Cameras)
+    {
+        const int64 CameraBytes = ComputeCameraBytes(Targets, Result, Settings.StagingCopies);
+        if (Used + CameraBytes > Settings.BudgetBytes)
+            break;
+
+        Used += CameraBytes;
+        ++Result.NumCameras;
+    }
+    Result.PlannedBytes = Used;
+    return Result;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "MLCaptureTypes.h"
+#include "RenderTargetBudget.generated.h"
+
+// What the manager gives up when a camera rig's render targets would not fit RenderTargetBudgetMB
+UENUM(BlueprintType)
+enum class EMLMemoryBudgetPolicy : uint8
+{
+    // Cameras beyond the budget get no capture targets
+    Refuse,
+    // Skip OptionalBuffers, in order, until the rig fits; then refuse
+    DropOptionalBuffers,
+    // Scale every manager-created target down uniformly, no lower than MinBudgetResolutionScale; then refuse
+    ReduceResolution,
+    // Drop optional buffers, then reduce resolution, then refuse
+    DropThenReduce
+};
+
+USTRUCT(BlueprintType)
+struct CAMERATESTER_API FMLRenderTargetMemoryStats
+{
+    GENERATED_BODY()
+
+    // Targets bound to captures, including atlas and scratch targets
+    UPROPERTY(BlueprintReadOnly, Category = "Memory Budget")
+    int64 RenderTargetBytes = 0;
+
+    // Released targets the pool keeps for reuse
+    UPROPERTY(BlueprintReadOnly, Category = "Memory Budget")
+    int64 PooledBytes = 0;
+
+    // CPU-readable staging copies held by the readback rings
+    UPROPERTY(BlueprintReadOnly, Category = "Memory Budget")
+    int64 StagingBytes = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Memory Budget")
+    int64 TotalBytes = 0;
+
+    // 0 = unlimited
+    UPROPERTY(BlueprintReadOnly, Category = "Memory Budget")
+    int64 BudgetBytes = 0;
+
+    // Scale applied to manager-created targets by the last plan
+    UPROPERTY(BlueprintReadOnly, Category = "Memory Budget")
+    float ResolutionScale = 1.0f;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Memory Budget")
+    TArray<EMLBufferType> DroppedBuffers;
+
+    // Cameras left without targets by the last plan
+    UPROPERTY(BlueprintReadOnly, Category = "Memory Budget")
+    int32 CamerasRefused = 0;
+
+    // Individual targets refused since BeginPlay because they would have crossed the budget
+    UPROPERTY(BlueprintReadOnly, Category = "Memory Budget")
+    int64 TargetsRefused = 0;
+};
+
+namespace RenderTargetBudget
+{
+    // Bytes the RHI allocates for one 2D texture, row pitch and alignment included; staging copies are CPU-readable
+    CAMERATESTER_API int64 ComputeTextureBytes(int32 Width, int32 Height, EPixelFormat Format, bool bStaging = false);
+    CAMERATESTER_API int64 ComputeTargetBytes(int32 Width, int32 Height, ETextureRenderTargetFormat Format, bool bStaging = false);
+
+    // BaseSize scaled to multiples of 4, at least 16 pixels
+    CAMERATESTER_API FIntPoint ScaleSize(const FIntPoint& BaseSize, float Scale);
+
+    // One render target a camera will need
+    struct FTargetDemand
+    {
+        EMLBufferType BufferType = EMLBufferType::RGB;
+        ETextureRenderTargetFormat Format = RTF_RGBA8;
+        FIntPoint Size = FIntPoint::ZeroValue;
+        // Created (and sized) by the manager; persistent targets only add staging copies
+        bool bOwned = true;
+    };
+
+    struct FSettings
+    {
+        int64 BudgetBytes = 0;
+        EMLMemoryBudgetPolicy Policy = EMLMemoryBudgetPolicy::DropThenReduce;
+        TArray<EMLBufferType> OptionalBuffers;
+        float MinResolutionScale = 0.25f;
+        // Staging copies per read-back target; 0 without readback
+        int32 StagingCopies = 0;
+    };
+
+    struct FPlan
+    {
+        float ResolutionScale = 1.0f;
+        TArray<EMLBufferType> DroppedBuffers;
+        // Cameras, in order, that get their targets; the rest are refused
+        int32 NumCameras = 0;
+        int64 PlannedBytes = 0;
+
+        bool IsDropped(EMLBufferType BufferType) const { return DroppedBuffers.Contains(BufferType); }
+    };
+
+    // Fits Cameras (each camera's target list, in camera order) into Settings.BudgetBytes following Settings.Policy
+    CAMERATESTER_API FPlan Plan(const TArray<TArray<FTargetDemand>>& Cameras, const FSettings& Settings);
+
+    // Bytes one camera needs under a plan
+    CAMERATESTER_API int64 ComputeCameraBytes(const TArray<FTargetDemand>& Targets, const FPlan& InPlan, int32 StagingCopies);
+}
@@ -1,186 +1,1736 @@
 #include "RenderTargetManager.h"
+#include "MLCaptureStats.h"
+#include "CameraTrajectorySubsystem.h"
+#include "CaptureSharding.h"
+#include "CameraSpawnerManager.h"
+#include "EngineUtils.h"
 #include "Engine/World.h"
+#include "HAL/FileManager.h"
+#include "Materials/MaterialInterface.h"
 #include "TimerManager.h"
+#include "Misc/App.h"
+#include "Misc/CommandLine.h"
+#include "Misc/Paths.h"
 
 #if WITH_EDITOR
 #include "AssetRegistry/AssetRegistryModule.h"
+#include "ObjectTools.h"
+#include "RenderingThread.h"
 #include "UObject/SavePackage.h"
 #endif
 
 ARenderTargetManager::ARenderTargetManager()
 {
-    PrimaryActorTick.bCanEverTick = false;
+    PrimaryActorTick.bCanEverTick = true;
+    PrimaryActorTick.bStartWithTickEnabled = false;
     RenderTargetWidth = 512;
     RenderTargetHeight = 512;
     bForceFrameUpdates = true;
     UpdateFrequency = 0.0f;
     MaxDepthDistance = 10000.0f;
+
+    RGBCaptureProfile = MLCaptureProfile::MakeDefault(EMLBufferType::RGB);
+    DepthCaptureProfile = MLCaptureProfile::MakeDefault(EMLBufferType::SceneDepth);
+    MLDepthCaptureProfile = MLCaptureProfile::MakeDefault(EMLBufferType::MLDepth);
+    NormalCaptureProfile = MLCaptureProfile::MakeDefault(EMLBufferType::Normal);
+    SegmentationCaptureProfile = MLCaptureProfile::MakeDefault(EMLBufferType::Segmentation);
+
+    OptionalBuffers.Add(EMLBufferType::Normal);
+}
+
+void ARenderTargetManager::BeginPlay()
+{
+    Super::BeginPlay();
+
+    RenderTargetPool.SetMaxPooledBytes(static_cast<int64>(MaxPooledRenderTargetMB) * 1024 * 1024);
+
+    // Start tracking cameras now so spawns before detection are already known
+    if (UCameraCaptureRegistry* Registry = GetCameraRegistry())
+    {
+        Registry->WatchClass(TargetActorClass);
+        CamerasChangedHandle = Registry->OnCamerasChanged().AddUObject(this, &ARenderTargetManager::HandleCamerasChanged);
+        SpawnsCompleteHandle = Registry->OnSpawnsComplete().AddUObject(this, &ARenderTargetManager::HandleSpawnsComplete);
+    }
+
+    if (FParse::Param(FCommandLine::Get(), TEXT("MLOffline")))
+    {
+        bOfflineCapture = true;
+    }
+    if (FParse::Param(FCommandLine::Get(), TEXT("MLWriteDataset")))
+    {
+        bWriteDataset = true;
+    }
+    if (FParse::Param(FCommandLine::Get(), TEXT("MLDedup")))
+    {
+        bDeduplicateCaptures = true;
+    }
+    FParse::Value(FCommandLine::Get(), TEXT("MLDatasetDir="), DatasetDirectory);
+    FParse::Value(FCommandLine::Get(), TEXT("MLRenderTargetBudgetMB="), RenderTargetBudgetMB);
+
+    if (bOfflineCapture)
+    {
+        BeginOfflineCapture();
+    }
+
+    if (bUseAtlasCapture && !UsesExplicitCaptures())
+    {
+        UE_LOG(LogMLCapture, Warning, TEXT("Atlas capture needs explicit captures; enabling the capture scheduler"));
+        bUseCaptureScheduler = true;
+    }
+
+    if (bAdaptiveResolution && bOfflineCapture)
+    {
+        UE_LOG(LogMLCapture, Warning, TEXT("Adaptive resolution follows GPU timings and would break offline determinism; disabled"));
+        bAdaptiveResolution = false;
+    }
+    if (bAdaptiveResolution)
+    {
+        ConfigureResolutionController();
+    }
+
+    if (bChangeDrivenCapture && !UsesExplicitCaptures())
+    {
+        UE_LOG(LogMLCapture, Warning, TEXT("Change-driven capture needs explicit captures; enabling the capture scheduler"));
+        bUseCaptureScheduler = true;
+    }
+
+    if (bDeduplicateCaptures && !bWriteDataset)
+    {
+        UE_LOG(LogMLCapture, Warning, TEXT("Capture deduplication indexes the dataset and needs the dataset writer; disabled"));
+        bDeduplicateCaptures = false;
+    }
+    if (bDeduplicateCaptures && !UsesExplicitCaptures())
+    {
+        UE_LOG(LogMLCapture, Warning, TEXT("Capture deduplication needs explicit captures; enabling the capture scheduler"));
+        bUseCaptureScheduler = true;
+    }
+
+    // Deduplication keys views by the tracker's scene hash too
+    if (bChangeDrivenCapture || bDeduplicateCaptures)
+    {
+        ConfigureChangeTracker();
+        ChangeTracker.Initialize(GetWorld());
+    }
+
+    if (bCreateSegmentationBuffer)
+    {
+        UE_CLOG(!SegmentationMaterial, LogMLCapture, Warning, TEXT("Segmentation buffer has no SegmentationMaterial; its captures render scene color"));
+
+        if (bLabelSegmentation)
+        {
+            FSegmentationLabelerSettings LabelerSettings;
+            LabelerSettings.bOcclusionFromDepth = bSegmentationOcclusionFromDepth;
+            LabelerSettings.MinPixels = SegmentationMinPixels;
+            LabelerSettings.bBlockWhenFull = bOfflineCapture;
+
+            SegmentationLabeler = MakeUnique<FSegmentationLabeler>(LabelerSettings);
+            SegmentationLabeler->OnLabelsReady().AddUObject(this, &ARenderTargetManager::HandleLabelsReady);
+        }
+        AssignSegmentationIds();
+    }
+
+    if (NeedsReadback())
+    {
+        InitializeReadback();
+    }
+
+    if (bWriteDataset)
+    {
+        StartDatasetWriter();
+    }
+
+    if (bStreamFrames)
+    {
+        StartFrameStream();
+    }
+
+    if (bExportPointClouds)
+    {
+        StartPointCloudExport();
+    }
+
+    if (GetWorld())
+    {
+        // Next tick every level actor has begun play, so a spawner placed after us has already opened its batch
+        RequestDetection();
+
+        if (bOfflineCapture)
+        {
+            SetActorTickEnabled(true);
+        }
+        else if (bUseCaptureScheduler)
+        {
+            ConfigureCaptureScheduler();
+            SetActorTickEnabled(true);
+        }
+        else if (bForceFrameUpdates && UpdateFrequency > 0.0f)
+        {
+            StartPeriodicUpdates();
+        }
+    }
+}
+
+void ARenderTargetManager::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+    StopPeriodicUpdates();
+
+    if (UCameraCaptureRegistry* Registry = GetCameraRegistry())
+    {
+        Registry->OnCamerasChanged().Remove(CamerasChangedHandle);
+        Registry->OnSpawnsComplete().Remove(SpawnsCompleteHandle);
+    }
+
+    if (Readback)
+    {
+        // Let in-flight frames reach the writers before they shut down
+        if (DatasetWriter || PointCloudExporter || SegmentationLabeler)
+        {
+            Readback->Flush();
+        }
+        Readback->Reset();
+        Readback.Reset();
+    }
+    DispatchQuantizedDepth(true);
+
+    if (SegmentationLabeler)
+    {
+        SegmentationLabeler->Flush();
+        SegmentationLabeler.Reset();
+    }
+
+    StopDatasetWriter();
+    StopFrameStream();
+    StopPointCloudExport();
+    ChangeTracker.Shutdown();
+
+    if (bOfflineCapture)
+    {
+        EndOfflineCapture();
+    }
+
+    Super::EndPlay(EndPlayReason);
+}
+
+void ARenderTargetManager::Tick(float DeltaSeconds)
+{
+    Super::Tick(DeltaSeconds);
+
+    // Every-frame captures render after the tick that issued them, so last frame's images are only complete now.
+    // Read them back before the index and the poses move on, so they keep last frame's labels.
+    if (Readback && CaptureFrameIndex > 0)
+    {
+        for (const FMLCaptureBinding& Binding : CaptureBindings)
+        {
+            if (IsValid(Binding.SceneCapture) && Binding.SceneCapture->bCaptureEveryFrame)
+            {
+                ++FrameCounters.CapturesIssued;
+                QueueReadback(Binding);
+            }
+        }
+    }
+
+    ++CaptureFrameIndex;
+
+    // Move the cameras before anything looks at their poses, so this frame's captures render and record them
+    if (UCameraTrajectorySubsystem* Trajectories = GetWorld()->GetSubsystem<UCameraTrajectorySubsystem>())
+    {
+        Trajectories->Advance(DeltaSeconds, CaptureFrameIndex);
+    }
+
+    if (bAdaptiveResolution)
+    {
+        UpdateCaptureResolutions();
+    }
+
+    if (bChangeDrivenCapture || CaptureIndex)
+    {
+        if (bChangeTrackerDirty)
+        {
+            ChangeTracker.Rebuild(CaptureBindings);
+            bChangeTrackerDirty = false;
+        }
+        ChangeTracker.BeginFrame();
+    }
+
+    if (CaptureIndex)
+    {
+        // Readbacks land a few frames later; anything older than this has long been dispatched
+        constexpr int64 SceneHashHistoryFrames = 64;
+        SceneHashByFrame.Add(CaptureFrameIndex, ChangeTracker.GetSceneHash());
+        SceneHashByFrame.Remove(CaptureFrameIndex - SceneHashHistoryFrames);
+    }
+
+    if (bOfflineCapture)
+    {
+        RunOfflineCapture();
+    }
+    else if (bUseCaptureScheduler)
+    {
+        RunCaptureScheduler(DeltaSeconds);
+    }
+
+    // Instance boxes as this frame's segmentation captures see them, for labeling once they are read back
+    if (SegmentationLabeler)
+    {
+        SegmentationLabeler->SnapshotInstances(CaptureFrameIndex);
+    }
+
+    // Explicit captures queued their readback right after CaptureScene
+    if (Readback)
+    {
+        Readback->Tick();
+    }
+    DispatchQuantizedDepth(false);
+
+    if (SegmentationLabeler)
+    {
+        SegmentationLabeler->Tick();
+    }
+
+    if (FrameEncoder)
+    {
+        FrameEncoder->Tick();
+    }
+
+    PublishFrameCounters();
+    ReportShardProgress(false);
+}
+
+void ARenderTargetManager::ReportShardProgress(bool bDone)
+{
+    UCaptureShardSubsystem* Shards = DatasetWriter ? UCaptureShardSubsystem::Get(this) : nullptr;
+    if (!Shards)
+        return;
+
+    Shards->ReportProgress(BoundCameras.Num(), bOfflineCapture ? OfflineFramesCaptured : CaptureFrameIndex,
+        DatasetWriter->GetFramesWritten(), DatasetWriter->GetBytesWritten());
+    if (bDone)
+    {
+        Shards->ReportDone(DatasetWriter->GetManifestPath());
+    }
+}
+
+void ARenderTargetManager::PublishFrameCounters()
+{
+    if (Readback)
+    {
+        const int64 NumDropped = Readback->GetNumDropped();
+        FrameCounters.ReadbacksDropped += static_cast<int32>(NumDropped - ReadbacksDroppedPublished);
+        ReadbacksDroppedPublished = NumDropped;
+        FrameCounters.ReadbacksPending = Readback->GetNumPending();
+    }
+    else
+    {
+        FrameCounters.ReadbacksPending = 0;
+    }
+
+    FrameCounters.EncodesInFlight = FrameEncoder ? FrameEncoder->GetNumInFlight() : 0;
+    FrameCounters.WriterQueuedBytes = DatasetWriter ? DatasetWriter->GetQueuedBytes() : 0;
+    FrameCounters.RenderTargetBytes = RenderTargetPool.GetStats().InUseBytes;
+    FrameCounters.PooledRenderTargetBytes = RenderTargetPool.GetStats().PooledBytes;
+    FrameCounters.StagingBytes = Readback ? Readback->GetStagingBytes() : 0;
+    FrameCounters.BudgetBytes = GetRenderTargetBudgetBytes();
+
+    MLCaptureStats::Publish(FrameCounters);
+}
+
+void ARenderTargetManager::DetectAndCreateRenderTargets()
+{
+    ML_CAPTURE_SCOPE(STAT_MLCapture_Detection);
+    UE_LOG(LogMLCapture, Log, TEXT("=== RenderTargetManager: Starting dynamic detection ==="));
+
+    bDetectionPending = false;
+    PendingCameras.Reset();
+
+    if (!IsValid(this) || !GetWorld() || !TargetActorClass)
+    {
+        UE_LOG(LogMLCapture, Error, TEXT("Invalid prerequisites for render target detection."));
+        return;
+    }
+
+    for (USceneCaptureComponent2D* SceneCap : RuntimeCaptures)
+    {
+        if (IsValid(SceneCap))
+        {
+            SceneCap->TextureTarget = nullptr;
+            SceneCap->DestroyComponent();
+        }
+    }
+    RuntimeCaptures.Reset();
+
+    // Hand the previous targets back so re-detection reuses them instead of allocating. Captures must not keep
+    // pointing at them: a camera refused by the budget would otherwise be bound to a target it no longer owns.
+    for (const FMLCaptureBinding& Binding : CaptureBindings)
+    {
+        if (IsValid(Binding.SceneCapture) && RenderTargetPool.Owns(Binding.SceneCapture->TextureTarget))
+        {
+            Binding.SceneCapture->TextureTarget = nullptr;
+        }
+    }
+    for (UTextureRenderTarget2D* OldRT : CreatedRenderTargets)
+    {
+        RenderTargetPool.Release(OldRT);
+    }
+    CreatedRenderTargets.Reset();
+    ResetCaptureBindings();
+
+    UCameraCaptureRegistry* Registry = GetCameraRegistry();
+    TArray<AActor*> FoundActors = GetAllInstancesOfTargetActor();
+    PlanRenderTargetBudget(FoundActors);
+    for (int32 i = 0; i < BudgetPlan.NumCameras; i++)
+    {
+        BindCamera(FoundActors[i], Registry ? Registry->GetCameraIndex(TargetActorClass, FoundActors[i]) : i);
+    }
+
+    if (bUseAtlasCapture)
+    {
+        BuildCaptureAtlas();
+    }
+
+    // The idle pool gets whatever the plan left over
+    const int64 BudgetBytes = GetRenderTargetBudgetBytes();
+    const int64 MaxPooledBytes = static_cast<int64>(MaxPooledRenderTargetMB) * 1024 * 1024;
+    RenderTargetPool.SetMaxPooledBytes(BudgetBytes > 0 ? FMath::Min(MaxPooledBytes, BudgetBytes - BudgetPlan.PlannedBytes) : MaxPooledBytes);
+
+    ConfigureCaptureSettings();
+    bInitialDetectionDone = true;
+    UE_LOG(LogMLCapture, Log, TEXT("=== Detection complete: %d render targets created/assigned ==="), CreatedRenderTargets.Num());
+}
+
+void ARenderTargetManager::BindCamera(AActor* Camera, int32 CameraIndex)
+{
+    if (!IsValid(Camera) || BoundCameras.Contains(Camera))
+        return;
+
+    BoundCameras.Add(Camera);
+
+    const bool bCreateRGB = !BudgetPlan.IsDropped(EMLBufferType::RGB);
+    if (bUseAtlasCapture && bCreateRGB)
+    {
+        // Targets are assigned when the atlas is built
+        USceneCaptureComponent2D* SceneCap = Camera->FindComponentByClass<USceneCaptureComponent2D>();
+        if (IsValid(SceneCap))
+        {
+            SetupSceneCaptureComponent(SceneCap, ESceneCaptureSource::SCS_FinalColorLDR);
+            AddCaptureBinding(Camera, CameraIndex, EMLBufferType::RGB, SceneCap, nullptr);
+        }
+    }
+
+    UTextureRenderTarget2D* RT = bUseAtlasCapture || !bCreateRGB ? nullptr : CreateRenderTargetForActor(Camera, CameraIndex + 1);
+    if (IsValid(RT))
+    {
+        CreatedRenderTargets.Add(RT);
+        USceneCaptureComponent2D* SceneCap = Camera->FindComponentByClass<USceneCaptureComponent2D>();
+        if (IsValid(SceneCap))
+        {
+            SceneCap->TextureTarget = RT;
+            SetupSceneCaptureComponent(SceneCap, ESceneCaptureSource::SCS_FinalColorLDR);
+            AddCaptureBinding(Camera, CameraIndex, EMLBufferType::RGB, SceneCap, RT);
+        }
+    }
+
+    // Keep any persistent depth/normal captures bound so they are read back too
+    TArray<USceneCaptureComponent2D*> SceneCaptures;
+    Camera->GetComponents<USceneCaptureComponent2D>(SceneCaptures);
+    bool bHasType[static_cast<int32>(EMLBufferType::Count)] = {};
+    for (USceneCaptureComponent2D* SceneCap : SceneCaptures)
+    {
+        if (IsValid(SceneCap) && IsValid(SceneCap->TextureTarget) && !BindingIndexByCapture.Contains(SceneCap))
+        {
+            const EMLBufferType BufferType = MLCapture::ClassifyCapture(SceneCap);
+            if (BudgetPlan.IsDropped(BufferType))
+                continue;
+
+            // CPU quantization derives MLDepth from SceneDepth under the same capture key; a GPU MLDepth
+            // capture left on the camera by an earlier setup would be a second, colliding stream
+            if (BufferType == EMLBufferType::MLDepth && !UsesGpuMLDepth())
+            {
+                SceneCap->bCaptureEveryFrame = false;
+                SceneCap->bCaptureOnMovement = false;
+                continue;
+            }
+
+            AddCaptureBinding(Camera, CameraIndex, BufferType, SceneCap, SceneCap->TextureTarget);
+            bHasType[static_cast<int32>(BufferType)] = true;
+        }
+    }
+
+    if (bCreateRuntimeBufferCaptures && !bUseAtlasCapture && SceneCaptures.Num() > 0)
+    {
+        const bool bNeedsDepth = bCreateDepthBuffer || UsesCpuMLDepth();
+        if (bNeedsDepth && !bHasType[static_cast<int32>(EMLBufferType::SceneDepth)] && !BudgetPlan.IsDropped(EMLBufferType::SceneDepth))
+        {
+            CreateRuntimeCapture(Camera, CameraIndex, EMLBufferType::SceneDepth, SceneCaptures[0]);
+        }
+        if (bCreateNormalBuffer && !bHasType[static_cast<int32>(EMLBufferType::Normal)] && !BudgetPlan.IsDropped(EMLBufferType::Normal))
+        {
+            CreateRuntimeCapture(Camera, CameraIndex, EMLBufferType::Normal, SceneCaptures[0]);
+        }
+        if (bCreateSegmentationBuffer && !bHasType[static_cast<int32>(EMLBufferType::Segmentation)] && !BudgetPlan.IsDropped(EMLBufferType::Segmentation))
+        {
+            CreateRuntimeCapture(Camera, CameraIndex, EMLBufferType::Segmentation, SceneCaptures[0]);
+        }
+    }
+}
+
+void ARenderTargetManager::RequestDetection()
+{
+    if (bDetectionPending || !GetWorld())
+        return;
+
+    bDetectionPending = true;
+    GetWorld()->GetTimerManager().SetTimerForNextTick(FTimerDelegate::CreateWeakLambda(this, [this]()
+    {
+        // A spawner still working will report completion; atlases and camera indices want the whole rig
+        UCameraCaptureRegistry* Registry = GetCameraRegistry();
+        if (Registry && Registry->IsSpawnInProgress() && (bUseAtlasCapture || bInitialDetectionDone))
+            return;
+
+        DetectAndCreateRenderTargets();
+    }));
+}
+
+void ARenderTargetManager::HandleCamerasChanged(UClass* CameraClass, AActor* Camera, bool bAdded)
+{
+    if (!TargetActorClass || !CameraClass->IsChildOf(TargetActorClass))
+        return;
+
+    // Removals shift camera indices and atlas layouts need every tile up front, so both rebuild everything
+    if (!bAdded || bUseAtlasCapture || !bInitialDetectionDone)
+    {
+        RequestDetection();
+        return;
+    }
+
+    // Bind next tick: the spawn event can fire before construction has added every capture component
+    if (PendingCameras.Num() == 0 && GetWorld())
+    {
+        GetWorld()->GetTimerManager().SetTimerForNextTick(this, &ARenderTargetManager::BindPendingCameras);
+    }
+    PendingCameras.AddUnique(Camera);
+}
+
+void ARenderTargetManager::HandleSpawnsComplete()
+{
+    if (bDetectionPending)
+    {
+        bDetectionPending = false;
+        DetectAndCreateRenderTargets();
+    }
+}
+
+void ARenderTargetManager::BindPendingCameras()
+{
+    UCameraCaptureRegistry* Registry = GetCameraRegistry();
+    if (!Registry || PendingCameras.Num() == 0 || bDetectionPending)
+    {
+        PendingCameras.Reset();
+        return;
+    }
+
+    const int32 FirstNewBinding = CaptureBindings.Num();
+    for (AActor* Camera : PendingCameras)
+    {
+        const int32 CameraIndex = Registry->GetCameraIndex(TargetActorClass, Camera);
+        if (CameraIndex != INDEX_NONE)
+        {
+            BindCamera(Camera, CameraIndex);
+        }
+    }
+    PendingCameras.Reset();
+
+    Registry->MarkCapturesDirty();
+    for (int32 BindingIndex = FirstNewBinding; BindingIndex < CaptureBindings.Num(); ++BindingIndex)
+    {
+        ConfigureCapture(CaptureBindings[BindingIndex].SceneCapture);
+    }
+
+    UE_LOG(LogMLCapture, Verbose, TEXT("Bound %d new capture(s); %d total"), CaptureBindings.Num() - FirstNewBinding, CaptureBindings.Num());
+}
+
+bool ARenderTargetManager::AreRenderTargetsReady() const
+{
+    const UCameraCaptureRegistry* Registry = GetCameraRegistry();
+    return bInitialDetectionDone && !bDetectionPending && PendingCameras.Num() == 0
+        && !(Registry && Registry->IsSpawnInProgress()) && CaptureBindings.Num() > 0;
+}
+
+void ARenderTargetManager::PlanRenderTargetBudget(const TArray<AActor*>& Cameras)
+{
+    BudgetPlan = RenderTargetBudget::FPlan();
+    BudgetPlan.NumCameras = Cameras.Num();
+    CamerasRefused = 0;
+
+    const int64 BudgetBytes = GetRenderTargetBudgetBytes();
+    if (BudgetBytes <= 0)
+        return;
+
+    TArray<TArray<RenderTargetBudget::FTargetDemand>> Demand;
+    Demand.SetNum(Cameras.Num());
+    for (int32 i = 0; i < Cameras.Num(); i++)
+    {
+        CollectTargetDemand(Cameras[i], Demand[i]);
+    }
+
+    RenderTargetBudget::FSettings Settings;
+    Settings.BudgetBytes = BudgetBytes;
+    Settings.Policy = MemoryBudgetPolicy;
+    Settings.OptionalBuffers = OptionalBuffers;
+    Settings.MinResolutionScale = MinBudgetResolutionScale;
+    Settings.StagingCopies = GetStagingCopies();
+
+    BudgetPlan = RenderTargetBudget::Plan(Demand, Settings);
+    CamerasRefused = Cameras.Num() - BudgetPlan.NumCameras;
+
+    FString Dropped;
+    for (const EMLBufferType BufferType : BudgetPlan.DroppedBuffers)
+    {
+        Dropped += Dropped.IsEmpty() ? TEXT(", dropped ") : TEXT("/");
+        Dropped += MLCapture::GetBufferTypeName(BufferType);
+    }
+    const bool bCompromised = CamerasRefused > 0 || BudgetPlan.ResolutionScale < 1.0f || BudgetPlan.DroppedBuffers.Num() > 0;
+    UE_LOG(LogMLCapture, Log, TEXT("Render target budget %.1f MB: %.1f MB planned for %d/%d cameras at %.0f%% resolution%s"),
+        BudgetBytes / (1024.0 * 1024.0), BudgetPlan.PlannedBytes / (1024.0 * 1024.0), BudgetPlan.NumCameras, Cameras.Num(),
+        BudgetPlan.ResolutionScale * 100.0f, *Dropped);
+    UE_CLOG(bCompromised, LogMLCapture, Warning, TEXT("Camera rig exceeds RenderTargetBudgetMB=%d (policy %s); %d camera(s) refused"),
+        RenderTargetBudgetMB, *UEnum::GetValueAsString(MemoryBudgetPolicy), CamerasRefused);
+}
+
+void ARenderTargetManager::CollectTargetDemand(AActor* Camera, TArray<RenderTargetBudget::FTargetDemand>& OutTargets) const
+{
+    // Mirrors BindCamera: the primary capture always gets a new RGB target, other captures that already render
+    // into a target only add staging copies, runtime captures fill in the missing buffer types
+    if (!IsValid(Camera))
+        return;
+
+    const FIntPoint Size(RenderTargetWidth, RenderTargetHeight);
+    auto AddTarget = [&OutTargets](EMLBufferType BufferType, ETextureRenderTargetFormat Format, const FIntPoint& TargetSize, bool bOwned)
+    {
+        RenderTargetBudget::FTargetDemand& Target = OutTargets.AddDefaulted_GetRef();
+        Target.BufferType = BufferType;
+        Target.Format = Format;
+        Target.Size = TargetSize;
+        Target.bOwned = bOwned;
+    };
+
+    USceneCaptureComponent2D* PrimaryCapture = Camera->FindComponentByClass<USceneCaptureComponent2D>();
+    if (IsValid(PrimaryCapture))
+    {
+        AddTarget(EMLBufferType::RGB, RTF_RGBA8, Size, true);
+    }
+
+    TArray<USceneCaptureComponent2D*> SceneCaptures;
+    Camera->GetComponents<USceneCaptureComponent2D>(SceneCaptures);
+    bool bHasType[static_cast<int32>(EMLBufferType::Count)] = {};
+    for (USceneCaptureComponent2D* SceneCap : SceneCaptures)
+    {
+        if (SceneCap != PrimaryCapture && IsValid(SceneCap) && IsValid(SceneCap->TextureTarget))
+        {
+            const EMLBufferType BufferType = MLCapture::ClassifyCapture(SceneCap);
+            if (BufferType == EMLBufferType::MLDepth && !UsesGpuMLDepth())
+                continue;
+
+            UTextureRenderTarget2D* Target = SceneCap->TextureTarget;
+            AddTarget(BufferType, Target->RenderTargetFormat, FIntPoint(Target->SizeX, Target->SizeY), false);
+            bHasType[static_cast<int32>(BufferType)] = true;
+        }
+    }
+
+    if (bCreateRuntimeBufferCaptures && !bUseAtlasCapture && SceneCaptures.Num() > 0)
+    {
+        auto AddRuntimeTarget = [&](EMLBufferType BufferType, bool bEnabled)
+        {
+            if (bEnabled && !bHasType[static_cast<int32>(BufferType)])
+            {
+                AddTarget(BufferType, MLCapture::GetDefaultFormat(BufferType), Size, true);
+            }
+        };
+        AddRuntimeTarget(EMLBufferType::SceneDepth, bCreateDepthBuffer || UsesCpuMLDepth());
+        AddRuntimeTarget(EMLBufferType::Normal, bCreateNormalBuffer);
+        AddRuntimeTarget(EMLBufferType::Segmentation, bCreateSegmentationBuffer);
+    }
+}
+
+int64 ARenderTargetManager::ComputeBudgetedBytes(int32 Width, int32 Height, ETextureRenderTargetFormat Format) const
+{
+    return RenderTargetBudget::ComputeTargetBytes(Width, Height, Format)
+        + GetStagingCopies() * RenderTargetBudget::ComputeTargetBytes(Width, Height, Format, true);
+}
+
+UTextureRenderTarget2D* ARenderTargetManager::AcquireBudgetedTarget(int32 Width, int32 Height, ETextureRenderTargetFormat Format, int64 FreedBytes)
+{
+    const int64 BudgetBytes = GetRenderTargetBudgetBytes();
+    if (BudgetBytes > 0)
+    {
+        // Staging copies of existing targets are allocated lazily, so count the new target's up front
+        const int64 UsedBytes = RenderTargetPool.GetStats().InUseBytes + (Readback ? Readback->GetStagingBytes() : 0);
+        const int64 NeededBytes = ComputeBudgetedBytes(Width, Height, Format) - FreedBytes;
+        if (NeededBytes > 0 && UsedBytes + NeededBytes > BudgetBytes)
+        {
+            ++TargetsRefused;
+            UE_LOG(LogMLCapture, Verbose, TEXT("Refused %dx%d render target: %.1f MB used, %.1f MB needed, budget %.1f MB"), Width, Height,
+                UsedBytes / (1024.0 * 1024.0), NeededBytes / (1024.0 * 1024.0), BudgetBytes / (1024.0 * 1024.0));
+            UE_CLOG(TargetsRefused == 1, LogMLCapture, Warning, TEXT("Render target budget exhausted; further targets are refused (see Verbose log)"));
+            return nullptr;
+        }
+    }
+    return RenderTargetPool.Acquire(this, Width, Height, Format);
+}
+
+FMLRenderTargetMemoryStats ARenderTargetManager::GetRenderTargetMemoryStats() const
+{
+    FMLRenderTargetMemoryStats Stats;
+    Stats.RenderTargetBytes = RenderTargetPool.GetStats().InUseBytes;
+    Stats.PooledBytes = RenderTargetPool.GetStats().PooledBytes;
+    Stats.StagingBytes = Readback ? Readback->GetStagingBytes() : 0;
+    Stats.TotalBytes = Stats.RenderTargetBytes + Stats.PooledBytes + Stats.StagingBytes;
+    Stats.BudgetBytes = GetRenderTargetBudgetBytes();
+    Stats.ResolutionScale = BudgetPlan.ResolutionScale;
+    Stats.DroppedBuffers = BudgetPlan.DroppedBuffers;
+    Stats.CamerasRefused = CamerasRefused;
+    Stats.TargetsRefused = TargetsRefused;
+    return Stats;
+}
+
+UTextureRenderTarget2D* ARenderTargetManager::CreateRenderTargetForActor(AActor* Actor, int32 Index, ETextureRenderTargetFormat Format)
+{
+    if (!IsValid(Actor) || !GetWorld())
+    {
+        UE_LOG(LogMLCapture, Error, TEXT("Invalid parameters for render target creation"));
+        return nullptr;
+    }
+
+    const FIntPoint Size = GetBudgetedSize();
+    return AcquireBudgetedTarget(Size.X, Size.Y, Format);
+}
+
+USceneCaptureComponent2D* ARenderTargetManager::CreateRuntimeCapture(AActor* Camera, int32 CameraIndex, EMLBufferType BufferType, USceneCaptureComponent2D* ViewSource)
+{
+    const FIntPoint Size = GetBudgetedSize();
+    UTextureRenderTarget2D* RT = AcquireBudgetedTarget(Size.X, Size.Y, MLCapture::GetDefaultFormat(BufferType));
+    if (!IsValid(RT))
+        return nullptr;
+
+    // Same view as the RGB capture
+    USceneCaptureComponent2D* SceneCap = NewObject<USceneCaptureComponent2D>(Camera);
+    SceneCap->SetupAttachment(ViewSource);
+    SceneCap->FOVAngle = ViewSource->FOVAngle;
+    SceneCap->TextureTarget = RT;
+    if (BufferType == EMLBufferType::Segmentation)
+    {
+        SceneCap->ComponentTags.AddUnique(MLCapture::SegmentationCaptureTag);
+    }
+    Camera->AddInstanceComponent(SceneCap);
+    SceneCap->RegisterComponent();
+
+    SetupSceneCaptureComponent(SceneCap, MLCapture::GetCaptureSource(BufferType));
+    RuntimeCaptures.Add(SceneCap);
+    CreatedRenderTargets.Add(RT);
+    AddCaptureBinding(Camera, CameraIndex, BufferType, SceneCap, RT);
+
+    if (UCameraCaptureRegistry* Registry = GetCameraRegistry())
+    {
+        Registry->MarkCapturesDirty();
+    }
+    return SceneCap;
+}
+
+TArray<AActor*> ARenderTargetManager::GetAllInstancesOfTargetActor()
+{
+    UCameraCaptureRegistry* Registry = GetCameraRegistry();
+    if (Registry && TargetActorClass)
+    {
+        return Registry->GetCameras(TargetActorClass);
+    }
+    return TArray<AActor*>();
+}
+
+UCameraCaptureRegistry* ARenderTargetManager::GetCameraRegistry() const
+{
+    return GetWorld() ? GetWorld()->GetSubsystem<UCameraCaptureRegistry>() : nullptr;
+}
+
+TArray<UTextureRenderTarget2D*> ARenderTargetManager::GetAllRenderTargets()
+{
+    return CreatedRenderTargets;
+}
+
+void ARenderTargetManager::ForceUpdateAllRenderTargets()
+{
+    UCameraCaptureRegistry* Registry = GetCameraRegistry();
+    if (!Registry)
+        return;
+
+    ML_CAPTURE_SCOPE(STAT_MLCapture_Dispatch);
+    int32 UpdateCount = 0;
+    for (USceneCaptureComponent2D* SceneCap : Registry->GetAllCaptures(TargetActorClass))
+    {
+        if (IsValid(SceneCap) && IsValid(SceneCap->TextureTarget))
+        {
+            if (!SceneCap->bCaptureEveryFrame)
+            {
+                SceneCap->CaptureScene();
+                QueueReadbackForCapture(SceneCap);
+                UpdateCount++;
+            }
+        }
+    }
+
+    FrameCounters.CapturesIssued += UpdateCount;
+    UE_LOG(LogMLCapture, Verbose, TEXT("Force updated %d scene capture components"), UpdateCount);
+
+    // Timer-driven updates run without the actor tick, which would otherwise publish the counters
+    if (!IsActorTickEnabled())
+    {
+        PublishFrameCounters();
+    }
+}
+
+void ARenderTargetManager::StartPeriodicUpdates()
+{
+    if (GetWorld() && UpdateFrequency > 0.0f)
+    {
+        GetWorld()->GetTimerManager().SetTimer(UpdateTimer, this, &ARenderTargetManager::UpdateRenderTargets, UpdateFrequency, true);
+        UE_LOG(LogMLCapture, Log, TEXT("Started periodic render target updates every %.2f seconds"), UpdateFrequency);
+    }
+}
+
+void ARenderTargetManager::StopPeriodicUpdates()
+{
+    if (GetWorld() && UpdateTimer.IsValid())
+    {
+        GetWorld()->GetTimerManager().ClearTimer(UpdateTimer);
+        UE_LOG(LogMLCapture, Log, TEXT("Stopped periodic render target updates"));
+    }
+}
+
+void ARenderTargetManager::ConfigureCaptureSettings()
+{
+    ML_CAPTURE_SCOPE(STAT_MLCapture_Configure);
+    UCameraCaptureRegistry* Registry = GetCameraRegistry();
+    if (!Registry)
+        return;
+
+    // Targets and sources may have just changed, so re-classify before walking the flat list
+    Registry->MarkCapturesDirty();
+
+    for (USceneCaptureComponent2D* SceneCap : Registry->GetAllCaptures(TargetActorClass))
+    {
+        ConfigureCapture(SceneCap);
+    }
+    
+    UE_LOG(LogMLCapture, Log, TEXT("Configured capture settings: CaptureEveryFrame=%s, Scheduler=%s"), 
+        ShouldCaptureEveryFrame() ? TEXT("True") : TEXT("False"), bUseCaptureScheduler ? TEXT("True") : TEXT("False"));
+    UE_CLOG(bOfflineCapture, LogMLCapture, Log, TEXT("Offline capture: fixed step %.4f s, every %d frame(s), seed %d"),
+        FApp::GetFixedDeltaTime(), OfflineCaptureInterval, OfflineSeed);
+}
+
+void ARenderTargetManager::ConfigureCapture(USceneCaptureComponent2D* SceneCap)
+{
+    if (IsValid(SceneCap))
+    {
+        SceneCap->bCaptureEveryFrame = ShouldCaptureEveryFrame();
+        SceneCap->bCaptureOnMovement = !UsesExplicitCaptures();
+        SceneCap->SetActive(true);
+        ApplyCaptureProfile(SceneCap);
+    }
+}
+
+const FMLCaptureProfile& ARenderTargetManager::GetCaptureProfile(EMLBufferType BufferType) const
+{
+    if (!bUseCaptureProfiles)
+        return RGBCaptureProfile;
+
+    switch (BufferType)
+    {
+    case EMLBufferType::SceneDepth:   return DepthCaptureProfile;
+    case EMLBufferType::MLDepth:      return MLDepthCaptureProfile;
+    case EMLBufferType::Normal:       return NormalCaptureProfile;
+    case EMLBufferType::Segmentation: return SegmentationCaptureProfile;
+    default:                          return RGBCaptureProfile;
+    }
+}
+
+void ARenderTargetManager::ApplyCaptureProfile(USceneCaptureComponent2D* SceneCap)
+{
+    // Bindings know their buffer type; captures configured before binding are classified from their source
+    const int32* BindingIndex = BindingIndexByCapture.Find(SceneCap);
+    const EMLBufferType BufferType = BindingIndex ? CaptureBindings[*BindingIndex].BufferType : MLCapture::ClassifyCapture(SceneCap);
+    MLCaptureProfile::Apply(GetCaptureProfile(BufferType), SceneCap, MaxDepthDistance);
+
+    // After the profile, whose post-process override would otherwise drop it
+    if (BufferType == EMLBufferType::Segmentation)
+    {
+        ApplySegmentationMaterial(SceneCap);
+    }
+}
+
+void ARenderTargetManager::ApplySegmentationMaterial(USceneCaptureComponent2D* SceneCap)
+{
+    if (!SegmentationMaterial)
+        return;
+
+    for (const FWeightedBlendable& Blendable : SceneCap->PostProcessSettings.WeightedBlendables.Array)
+    {
+        if (Blendable.Object == SegmentationMaterial)
+            return;
+    }
+    SceneCap->PostProcessSettings.AddBlendable(SegmentationMaterial, 1.0f);
+    SceneCap->PostProcessBlendWeight = 1.0f;
+}
+
+void ARenderTargetManager::UpdateRenderTargets()
+{
+    ForceUpdateAllRenderTargets();
+}
+
+void ARenderTargetManager::ConfigureCaptureScheduler()
+{
+    FCaptureScheduler::FSettings Settings;
+    Settings.BudgetMode = CaptureBudgetMode;
+    Settings.MaxCapturesPerFrame = MaxCapturesPerFrame;
+    Settings.GpuFrameBudgetMs = GpuFrameBudgetMs;
+    Settings.DefaultTargetRateHz = (DefaultCaptureRateHz <= 0.0f && UpdateFrequency > 0.0f) ? 1.0f / UpdateFrequency : DefaultCaptureRateHz;
+    Settings.Overrides = CaptureRateOverrides;
+
+    CaptureScheduler.Configure(Settings);
+    bSchedulerDirty = true;
+}
+
+void ARenderTargetManager::SetCaptureRate(int32 CameraIndex, EMLBufferType BufferType, float TargetRateHz, int32 Priority)
+{
+    CaptureScheduler.SetCaptureRate(CameraIndex, BufferType, TargetRateHz, Priority);
+}
+
+float ARenderTargetManager::GetAchievedCaptureRate(int32 CameraIndex, EMLBufferType BufferType) const
+{
+    return GetWorld() ? CaptureScheduler.GetAchievedRate(CameraIndex, BufferType, GetWorld()->GetTimeSeconds()) : 0.0f;
+}
+
+void ARenderTargetManager::RunCaptureScheduler(float DeltaSeconds)
+{
+    if (bSchedulerDirty)
+    {
+        CaptureScheduler.Rebuild(CaptureBindings);
+        bSchedulerDirty = false;
+    }
+
+    CaptureScheduler.SelectCaptures(GetWorld()->GetTimeSeconds(), DeltaSeconds, ScheduledBindingIndices);
+    FrameCounters.CapturesSkipped += CaptureScheduler.GetStats().CapturesDeferred;
+
+    IssueCaptures(ScheduledBindingIndices);
+}
+
+void ARenderTargetManager::IssueCaptures(const TArray<int32>& BindingIndices)
+{
+    ML_CAPTURE_SCOPE(STAT_MLCapture_Dispatch);
+    const double NowSeconds = GetWorld()->GetTimeSeconds();
+    for (const int32 BindingIndex : BindingIndices)
+    {
+        const FMLCaptureBinding& Binding = CaptureBindings[BindingIndex];
+        if (CaptureIndex && SkipIndexedCapture(Binding))
+            continue;
+
+        if (bChangeDrivenCapture && !ChangeTracker.NeedsCapture(BindingIndex, Binding, NowSeconds))
+        {
+            ++FrameCounters.CapturesSkipped;
+            ReportSkippedCapture(BindingIndex, Binding);
+            continue;
+        }
+
+        if (bUseAtlasCapture && CaptureAtlas.ContainsCapture(Binding))
+        {
+            CaptureAtlas.CaptureIntoAtlas(Binding);
+        }
+        else if (IsValid(Binding.SceneCapture) && IsValid(Binding.SceneCapture->TextureTarget))
+        {
+            Binding.SceneCapture->CaptureScene();
+            QueueReadback(Binding);
+        }
+        else
+        {
+            continue;
+        }
+
+        ++FrameCounters.CapturesIssued;
+        if (bChangeDrivenCapture)
+        {
+            ChangeTracker.MarkCaptured(BindingIndex, Binding, NowSeconds, CaptureFrameIndex);
+        }
+    }
+
+    if (Readback && !CaptureAtlas.IsEmpty())
+    {
+        CaptureAtlas.EndFrame(CaptureFrameIndex, *Readback);
+    }
+}
+
+void ARenderTargetManager::ConfigureResolutionController()
+{
+    FCaptureResolutionController::FSettings Settings;
+    Settings.TargetFrameMs = ResolutionTargetFrameMs;
+    Settings.AdjustIntervalFrames = ResolutionAdjustIntervalFrames;
+    Settings.TierScales = ResolutionTierScales;
+    Settings.DefaultMinScale = DefaultMinResolutionScale;
+    Settings.Overrides = ResolutionOverrides;
+
+    ResolutionController.Configure(Settings);
+    bResolutionControllerDirty = true;
+}
+
+FIntPoint ARenderTargetManager::GetCaptureResolution(int32 CameraIndex, EMLBufferType BufferType) const
+{
+    for (const FMLCaptureBinding& Binding : CaptureBindings)
+    {
+        if (Binding.CameraIndex == CameraIndex && Binding.BufferType == BufferType && IsValid(Binding.RenderTarget))
+        {
+            return FIntPoint(Binding.RenderTarget->SizeX, Binding.RenderTarget->SizeY);
+        }
+    }
+    return FIntPoint::ZeroValue;
+}
+
+FIntPoint ARenderTargetManager::GetTierSize(int32 Tier) const
+{
+    // Tiers scale whatever the memory budget left of the configured size
+    return RenderTargetBudget::ScaleSize(GetBudgetedSize(), ResolutionController.GetTierScale(Tier));
+}
+
+void ARenderTargetManager::UpdateCaptureResolutions()
+{
+    if (bResolutionControllerDirty)
+    {
+        ResolutionController.Rebuild(CaptureBindings);
+        bResolutionControllerDirty = false;
+
+        // Bring new bindings to their starting tier and preallocate the next tier down, where the controller goes first
+        TMap<FIntVector, int32> PrewarmCounts;
+        for (int32 BindingIndex = 0; BindingIndex < CaptureBindings.Num(); ++BindingIndex)
+        {
+            if (!ResizeCapture(BindingIndex, ResolutionController.GetTier(BindingIndex)))
+            {
+                ResolutionController.SetFixed(BindingIndex);
+                continue;
+            }
+
+            const int32 NextTier = ResolutionController.GetTier(BindingIndex) + 1;
+            if (NextTier <= ResolutionController.GetMinTier(BindingIndex))
+            {
+                const FIntPoint Size = GetTierSize(NextTier);
+                ++PrewarmCounts.FindOrAdd(FIntVector(Size.X, Size.Y, CaptureBindings[BindingIndex].RenderTarget->RenderTargetFormat));
+            }
+        }
+        for (const TPair<FIntVector, int32>& Pair : PrewarmCounts)
+        {
+            RenderTargetPool.Prewarm(this, Pair.Key.X, Pair.Key.Y, static_cast<ETextureRenderTargetFormat>(Pair.Key.Z), Pair.Value);
+        }
+    }
+
+    ResolutionController.Update(ResolutionChanges);
+    for (const FCaptureResolutionController::FTierChange& Change : ResolutionChanges)
+    {
+        ResizeCapture(Change.BindingIndex, Change.Tier);
+    }
+    UE_CLOG(ResolutionChanges.Num() > 0, LogMLCapture, Verbose, TEXT("Adaptive resolution: %d tier change(s), GPU %.2f ms, %.0f%% of full pixels"),
+        ResolutionChanges.Num(), ResolutionController.GetStats().GpuFrameMs, ResolutionController.GetStats().PixelFraction * 100.0f);
+}
+
+bool ARenderTargetManager::ResizeCapture(int32 BindingIndex, int32 Tier)
+{
+    // Only pooled targets can be swapped; atlas tiles and persistent assets keep their size
+    FMLCaptureBinding& Binding = CaptureBindings[BindingIndex];
+    UTextureRenderTarget2D* OldRT = Binding.RenderTarget;
+    if (!IsValid(Binding.SceneCapture) || !RenderTargetPool.Owns(OldRT) || Binding.SceneCapture->TextureTarget != OldRT)
+        return false;
+
+    const FIntPoint Size = GetTierSize(Tier);
+    if (OldRT->SizeX == Size.X && OldRT->SizeY == Size.Y)
+        return true;
+
+    // Growing back up must still fit the memory budget; the old target is returned once the new one is bound
+    UTextureRenderTarget2D* NewRT = AcquireBudgetedTarget(Size.X, Size.Y, OldRT->RenderTargetFormat,
+        ComputeBudgetedBytes(OldRT->SizeX, OldRT->SizeY, OldRT->RenderTargetFormat));
+    if (!IsValid(NewRT))
+        return false;
+
+    // Readbacks already queued copied from the old target on the render thread, so it can go straight back to the pool
+    Binding.SceneCapture->TextureTarget = NewRT;
+    Binding.RenderTarget = NewRT;
+    const int32 CreatedIndex = CreatedRenderTargets.Find(OldRT);
+    if (CreatedIndex != INDEX_NONE)
+    {
+        CreatedRenderTargets[CreatedIndex] = NewRT;
+    }
+    RenderTargetPool.Release(OldRT);
+
+    // A new target holds no history to reuse
+    bChangeTrackerDirty = true;
+    return true;
+}
+
+void ARenderTargetManager::ConfigureChangeTracker()
+{
+    FCaptureChangeTracker::FSettings Settings;
+    Settings.PositionTolerance = ChangePositionTolerance;
+    Settings.RotationToleranceDegrees = ChangeRotationToleranceDegrees;
+    Settings.FOVToleranceDegrees = ChangeFOVToleranceDegrees;
+    Settings.MaxStalenessSeconds = MaxCaptureStalenessSeconds;
+    Settings.MaxViewDistance = MaxDepthDistance;
+    Settings.bTrackSceneMotion = bTrackSceneMotion;
+
+    ChangeTracker.Configure(Settings);
+    bChangeTrackerDirty = true;
+}
+
+void ARenderTargetManager::ReportSkippedCapture(int32 BindingIndex, const FMLCaptureBinding& Binding)
+{
+    const int64 ReusedFrameIndex = ChangeTracker.GetLastCapturedFrame(BindingIndex);
+    OnCaptureSkipped.Broadcast(Binding.CameraIndex, Binding.BufferType, CaptureFrameIndex, ReusedFrameIndex);
+
+    // Atlas tiles are read back with the whole atlas, so a skipped tile still arrives as a frame with its old pixels
+    if (bUseAtlasCapture && CaptureAtlas.ContainsCapture(Binding))
+        return;
+
+    SubmitReusedFrame(Binding, ReusedFrameIndex);
+}
+
+void ARenderTargetManager::SubmitReusedFrame(const FMLCaptureBinding& Binding, int64 ReusedFrameIndex)
+{
+    if (!DatasetWriter || ReusedFrameIndex == INDEX_NONE)
+        return;
+
+    const UTextureRenderTarget2D* RenderTarget = IsValid(Binding.SceneCapture) ? Binding.SceneCapture->TextureTarget.Get() : nullptr;
+    if (!RenderTarget)
+        return;
+
+    FMLCapturedFramePtr Frame = MakeShared<FMLCapturedFrame, ESPMode::ThreadSafe>();
+    Frame->FrameIndex = CaptureFrameIndex;
+    Frame->CameraIndex = Binding.CameraIndex;
+    Frame->BufferType = Binding.BufferType;
+    Frame->Width = RenderTarget->SizeX;
+    Frame->Height = RenderTarget->SizeY;
+    Frame->PixelFormat = RenderTarget->GetFormat();
+    Frame->BytesPerPixel = GPixelFormats[Frame->PixelFormat].BlockBytes;
+    Frame->CameraPose = Binding.SceneCapture->GetComponentTransform();
+    Frame->FOVAngle = Binding.SceneCapture->FOVAngle;
+    Frame->ReusedFrameIndex = ReusedFrameIndex;
+    if (!IsInternalDepth(Binding.BufferType))
+    {
+        DatasetWriter->Submit(Frame);
+    }
+
+    // The derived ML depth of the reused depth frame still applies as well
+    if (UsesCpuMLDepth() && Binding.BufferType == EMLBufferType::SceneDepth)
+    {
+        FMLCapturedFramePtr MLDepthFrame = MakeShared<FMLCapturedFrame, ESPMode::ThreadSafe>(*Frame);
+        MLDepthFrame->BufferType = EMLBufferType::MLDepth;
+        MLDepthFrame->PixelFormat = bMLDepth16Bit ? PF_G16 : PF_G8;
+        MLDepthFrame->BytesPerPixel = bMLDepth16Bit ? 2 : 1;
+        DatasetWriter->Submit(MLDepthFrame);
+    }
+
+    // So do the reused segmentation frame's labels
+    if (SegmentationLabeler && Binding.BufferType == EMLBufferType::Segmentation)
+    {
+        FMLCapturedFramePtr LabelsFrame = MakeShared<FMLCapturedFrame, ESPMode::ThreadSafe>(*Frame);
+        LabelsFrame->BufferType = EMLBufferType::Labels;
+        LabelsFrame->PixelFormat = PF_Unknown;
+        LabelsFrame->BytesPerPixel = sizeof(FMLInstanceLabel);
+        LabelsFrame->Width = 0;
+        LabelsFrame->Height = 1;
+        DatasetWriter->Submit(LabelsFrame);
+    }
+}
+
+bool ARenderTargetManager::SkipIndexedCapture(const FMLCaptureBinding& Binding)
+{
+    // Atlas tiles render and read back with their whole atlas
+    if (!IsValid(Binding.SceneCapture) || (bUseAtlasCapture && CaptureAtlas.ContainsCapture(Binding)))
+        return false;
+
+    // A deterministic replay reaches the same frame numbers, so frames the interrupted run wrote are simply not redone
+    // Internal depth is never written; the MLDepth derived from it stands in for it
+    const EMLBufferType IndexedType = IsInternalDepth(Binding.BufferType) ? EMLBufferType::MLDepth : Binding.BufferType;
+    int64 ExistingFrame = INDEX_NONE;
+    bool bDuplicateView = false;
+    if (CaptureFrameIndex <= ResumeFrameIndex && CaptureIndex->IsCommitted(CaptureFrameIndex, Binding.CameraIndex, IndexedType))
+    {
+        ExistingFrame = CaptureFrameIndex;
+        CaptureIndex->CountResumed();
+    }
+    else if (bSkipDuplicateViews)
+    {
+        const uint64 PoseHash = CaptureIndex->HashPose(Binding.SceneCapture->GetComponentTransform(), Binding.SceneCapture->FOVAngle);
+        ExistingFrame = CaptureIndex->FindView(FCaptureIndex::MakeViewKey(Binding.CameraIndex, IndexedType, PoseHash, ChangeTracker.GetSceneHash()));
+        if (ExistingFrame == INDEX_NONE)
+            return false;
+        CaptureIndex->CountDeduplicated();
+        bDuplicateView = true;
+    }
+    else
+    {
+        return false;
+    }
+
+    ++FrameCounters.CapturesSkipped;
+    OnCaptureSkipped.Broadcast(Binding.CameraIndex, Binding.BufferType, CaptureFrameIndex, ExistingFrame);
+
+    // A resumed frame is already in the dataset; a duplicate view still needs its record at this frame
+    if (bDuplicateView)
+    {
+        SubmitReusedFrame(Binding, ExistingFrame);
+    }
+    return true;
+}
+
+void ARenderTargetManager::BeginOfflineCapture()
+{
+    FParse::Value(FCommandLine::Get(), TEXT("MLOfflineFrames="), OfflineFrameCount);
+    FParse::Value(FCommandLine::Get(), TEXT("MLOfflineSeed="), OfflineSeed);
+    if (FParse::Param(FCommandLine::Get(), TEXT("MLOfflineExit")))
+    {
+        bExitWhenOfflineComplete = true;
+    }
+
+    // Benchmarking mode keeps the engine from pacing fixed steps to real time
+    bPreviousUseFixedTimeStep = FApp::UseFixedTimeStep();
+    bPreviousBenchmarking = FApp::IsBenchmarking();
+    PreviousFixedDeltaTime = FApp::GetFixedDeltaTime();
+    FApp::SetUseFixedTimeStep(true);
+    FApp::SetBenchmarking(true);
+    FApp::SetFixedDeltaTime(1.0 / FMath::Max(OfflineFrameRate, 1.0f));
+
+    FMath::RandInit(OfflineSeed);
+    FMath::SRandInit(OfflineSeed);
+
+    OfflineFramesCaptured = 0;
+    OfflineFirstCaptureFrame = INDEX_NONE;
+    bOfflineComplete = false;
+}
+
+void ARenderTargetManager::EndOfflineCapture()
+{
+    FApp::SetUseFixedTimeStep(bPreviousUseFixedTimeStep);
+    FApp::SetBenchmarking(bPreviousBenchmarking);
+    FApp::SetFixedDeltaTime(PreviousFixedDeltaTime);
+}
+
+void ARenderTargetManager::RunOfflineCapture()
+{
+    // Time-sliced spawning is paced by wall-clock budgets, so wait for the complete rig
+    if (bOfflineComplete || !AreRenderTargetsReady())
+        return;
+
+    // The first capture frame is fixed relative to the rig becoming ready, which happens at a fixed simulated time
+    if (OfflineFirstCaptureFrame == INDEX_NONE)
+    {
+        OfflineFirstCaptureFrame = CaptureFrameIndex + OfflineWarmupFrames;
+    }
+
+    const int64 FramesSinceFirst = CaptureFrameIndex - OfflineFirstCaptureFrame;
+    if (FramesSinceFirst < 0 || FramesSinceFirst % FMath::Max(OfflineCaptureInterval, 1) != 0)
+        return;
+
+    ScheduledBindingIndices.Reset(CaptureBindings.Num());
+    for (int32 BindingIndex = 0; BindingIndex < CaptureBindings.Num(); ++BindingIndex)
+    {
+        ScheduledBindingIndices.Add(BindingIndex);
+    }
+    IssueCaptures(ScheduledBindingIndices);
+
+    ++OfflineFramesCaptured;
+    if (OfflineFrameCount > 0 && OfflineFramesCaptured >= OfflineFrameCount)
+    {
+        CompleteOfflineCapture();
+    }
+}
+
+void ARenderTargetManager::CompleteOfflineCapture()
+{
+    bOfflineComplete = true;
+
+    // Drain every stage so the dataset is complete before anyone reacts
+    if (Readback)
+    {
+        Readback->Flush();
+    }
+    DispatchQuantizedDepth(true);
+    if (SegmentationLabeler)
+    {
+        SegmentationLabeler->Flush();
+    }
+    if (FrameEncoder)
+    {
+        FrameEncoder->Flush();
+    }
+
+    UE_LOG(LogMLCapture, Log, TEXT("Offline capture complete: %d frames, %d buffers each"), OfflineFramesCaptured, CaptureBindings.Num());
+    OnOfflineCaptureComplete.Broadcast(OfflineFramesCaptured);
+
+    if (bExitWhenOfflineComplete)
+    {
+        StopDatasetWriter();
+        StopFrameStream();
+        StopPointCloudExport();
+        FPlatformMisc::RequestExit(false, TEXT("ARenderTargetManager::CompleteOfflineCapture"));
+    }
+}
+
+void ARenderTargetManager::BuildCaptureAtlas()
+{
+    const FIntPoint TileSize = GetBudgetedSize();
+    CaptureAtlas.Build(this, RenderTargetPool, CaptureBindings, TileSize.X, TileSize.Y);
+
+    TArray<UTextureRenderTarget2D*> AtlasTargets;
+    CaptureAtlas.GetRenderTargets(AtlasTargets);
+    CreatedRenderTargets.Append(AtlasTargets);
+
+    // Cameras past the atlas capacity were bound without a target; they capture on their own like a non-atlas rig
+    int32 NumFallbacks = 0;
+    for (FMLCaptureBinding& Binding : CaptureBindings)
+    {
+        if (IsValid(Binding.RenderTarget) || !IsValid(Binding.SceneCapture) || CaptureAtlas.ContainsCapture(Binding))
+            continue;
+
+        UTextureRenderTarget2D* RT = AcquireBudgetedTarget(TileSize.X, TileSize.Y, MLCapture::GetDefaultFormat(Binding.BufferType));
+        if (!IsValid(RT))
+            continue;
+
+        CreatedRenderTargets.Add(RT);
+        Binding.RenderTarget = RT;
+        Binding.SceneCapture->TextureTarget = RT;
+        ++NumFallbacks;
+    }
+    UE_CLOG(NumFallbacks > 0, LogMLCapture, Warning, TEXT("%d captures did not fit the atlas and use their own render targets"), NumFallbacks);
+}
+
+void ARenderTargetManager::RequestReadbackForAllBuffers()
+{
+    if (!Readback)
+    {
+        InitializeReadback();
+    }
+
+    for (const FMLCaptureBinding& Binding : CaptureBindings)
+    {
+        QueueReadback(Binding);
+    }
 }
 
-void ARenderTargetManager::BeginPlay()
+void ARenderTargetManager::AddCaptureBinding(AActor* Camera, int32 CameraIndex, EMLBufferType BufferType, USceneCaptureComponent2D* SceneCapture, UTextureRenderTarget2D* RenderTarget)
 {
-    Super::BeginPlay();
+    FMLCaptureBinding Binding;
+    Binding.Camera = Camera;
+    Binding.SceneCapture = SceneCapture;
+    Binding.RenderTarget = RenderTarget;
+    Binding.CameraIndex = CameraIndex;
+    Binding.BufferType = BufferType;
 
-    FTimerHandle InitTimer;
-    if (GetWorld())
+    const int32 BindingIndex = CaptureBindings.Add(Binding);
+    BindingIndexByCapture.Add(SceneCapture, BindingIndex);
+    bSchedulerDirty = true;
+    bChangeTrackerDirty = true;
+    bResolutionControllerDirty = true;
+}
+
+void ARenderTargetManager::ResetCaptureBindings()
+{
+    CaptureBindings.Reset();
+    BindingIndexByCapture.Reset();
+    BoundCameras.Reset();
+    bSchedulerDirty = true;
+    bChangeTrackerDirty = true;
+    bResolutionControllerDirty = true;
+    CaptureAtlas.Reset();
+
+    // Camera indices may change between detections
+    if (Readback)
     {
-        GetWorld()->GetTimerManager().SetTimer(InitTimer, this, &ARenderTargetManager::DetectAndCreateRenderTargets, 5.0f, false);
-        
-        if (bForceFrameUpdates && UpdateFrequency > 0.0f)
+        Readback->Reset();
+    }
+}
+
+void ARenderTargetManager::InitializeReadback()
+{
+    Readback = MakeUnique<FRenderTargetReadback>(ReadbackFramesInFlight);
+    Readback->SetBlockWhenFull(bOfflineCapture);
+    ReadbacksDroppedPublished = 0;
+    Readback->OnFrameReady().AddUObject(this, &ARenderTargetManager::HandleFrameReadback);
+    SetActorTickEnabled(true);
+
+    UE_LOG(LogMLCapture, Log, TEXT("GPU readback enabled with %d frames in flight per capture"), ReadbackFramesInFlight);
+}
+
+void ARenderTargetManager::QueueReadback(const FMLCaptureBinding& Binding)
+{
+    if (!Readback || !IsValid(Binding.SceneCapture) || !IsValid(Binding.RenderTarget))
+        return;
+
+    // Atlas tiles are read back together in RunCaptureScheduler
+    if (CaptureAtlas.ContainsCapture(Binding))
+        return;
+
+    Readback->EnqueueReadback(Binding.CameraIndex, Binding.BufferType, CaptureFrameIndex,
+        Binding.RenderTarget, Binding.SceneCapture->GetComponentTransform(), Binding.SceneCapture->FOVAngle);
+}
+
+void ARenderTargetManager::QueueReadbackForCapture(const USceneCaptureComponent2D* SceneCapture)
+{
+    if (!Readback)
+        return;
+
+    if (const int32* BindingIndex = BindingIndexByCapture.Find(SceneCapture))
+    {
+        QueueReadback(CaptureBindings[*BindingIndex]);
+    }
+}
+
+FMLShardAssignment ARenderTargetManager::ResolveShard() const
+{
+    // The spawner of our cameras decided which part of the layout exists in this process
+    for (TActorIterator<ACameraSpawnerManager> It(GetWorld()); It; ++It)
+    {
+        const TSubclassOf<AActor> CameraClass = It->GetCameraClass();
+        if (CameraClass && TargetActorClass && CameraClass->IsChildOf(TargetActorClass))
         {
-            StartPeriodicUpdates();
+            return It->ResolveShard();
         }
     }
+    return UCaptureShardSubsystem::Resolve(this, FMLShardAssignment());
 }
 
-void ARenderTargetManager::DetectAndCreateRenderTargets()
+bool ARenderTargetManager::StartDatasetWriter()
 {
-    UE_LOG(LogTemp, Warning, TEXT("=== RenderTargetManager: Starting dynamic detection ==="));
+    if (DatasetWriter && DatasetWriter->IsRunning())
+        return true;
 
-    if (!IsValid(this) || !GetWorld() || !TargetActorClass)
+    FDatasetShardWriterSettings Settings;
+    Settings.OutputDirectory = FPaths::IsRelative(DatasetDirectory)
+        ? FPaths::Combine(FPaths::ProjectSavedDir(), DatasetDirectory)
+        : DatasetDirectory;
+    Settings.MaxShardBytes = static_cast<int64>(DatasetShardSizeMB) * 1024 * 1024;
+    Settings.NumWorkers = DatasetWriterThreads;
+    Settings.MaxQueuedBytes = static_cast<int64>(DatasetMaxQueuedMB) * 1024 * 1024;
+    Settings.bBlockWhenFull = bOfflineCapture;
+    Settings.Shard = ResolveShard();
+    if (Settings.Shard.IsSharded())
     {
-        UE_LOG(LogTemp, Error, TEXT("Invalid prerequisites for render target detection."));
-        return;
+        Settings.OutputDirectory = FPaths::Combine(Settings.OutputDirectory, Settings.Shard.GetPartName());
     }
 
-    CreatedRenderTargets.Reset();
-
-    TArray<AActor*> FoundActors = GetAllInstancesOfTargetActor();
-    for (int32 i = 0; i < FoundActors.Num(); i++)
+    if (bDeduplicateCaptures)
     {
-        AActor* Camera = FoundActors[i];
-        if (!IsValid(Camera))
-            continue;
+        FCaptureIndex::FSettings IndexSettings;
+        IndexSettings.Path = FPaths::Combine(Settings.OutputDirectory, TEXT("capture_index.bin"));
+        IndexSettings.PositionQuantum = DedupPositionQuantum;
+        IndexSettings.RotationQuantumDegrees = DedupRotationQuantumDegrees;
+        IndexSettings.NearDuplicateBits = NearDuplicateBits;
 
-        UTextureRenderTarget2D* RT = CreateRenderTargetForActor(Camera, i + 1);
-        if (IsValid(RT))
+        IFileManager::Get().MakeDirectory(*Settings.OutputDirectory, true);
+        CaptureIndex = MakeShared<FCaptureIndex, ESPMode::ThreadSafe>(IndexSettings);
+        if (!CaptureIndex->Open())
         {
-            CreatedRenderTargets.Add(RT);
-            USceneCaptureComponent2D* SceneCap = Camera->FindComponentByClass<USceneCaptureComponent2D>();
-            if (IsValid(SceneCap))
-            {
-                SceneCap->TextureTarget = RT;
-                SetupSceneCaptureComponent(SceneCap, ESceneCaptureSource::SCS_FinalColorLDR);
-            }
+            // Writing on without the index would overwrite the shards it was meant to protect
+            CaptureIndex.Reset();
+            return false;
         }
+        Settings.CaptureIndex = CaptureIndex;
+        Settings.bResume = true;
     }
 
-    ConfigureCaptureSettings();
-    UE_LOG(LogTemp, Warning, TEXT("=== Detection complete: %d render targets created/assigned ==="), CreatedRenderTargets.Num());
+    DatasetWriter = MakeUnique<FDatasetShardWriter>(Settings);
+    if (!DatasetWriter->Start())
+    {
+        DatasetWriter.Reset();
+        CaptureIndex.Reset();
+        return false;
+    }
+
+    if (CaptureIndex)
+    {
+        ResumeFrameIndex = CaptureIndex->GetResumeFrame();
+        SceneHashByFrame.Reset();
+        bChangeTrackerDirty = true;
+        UE_CLOG(ResumeFrameIndex != INDEX_NONE, LogMLCapture, Log, TEXT("Resuming capture: frames up to %lld already in %s are skipped"),
+            ResumeFrameIndex, *Settings.OutputDirectory);
+    }
+
+    if (bEncodeFrames)
+    {
+        FFrameEncoderSettings EncoderSettings;
+        EncoderSettings.Codecs[static_cast<int32>(EMLBufferType::RGB)] = RGBCodec;
+        EncoderSettings.Codecs[static_cast<int32>(EMLBufferType::SceneDepth)] = DepthCodec;
+        EncoderSettings.Codecs[static_cast<int32>(EMLBufferType::MLDepth)] = MLDepthCodec;
+        EncoderSettings.Codecs[static_cast<int32>(EMLBufferType::Normal)] = NormalCodec;
+        EncoderSettings.Codecs[static_cast<int32>(EMLBufferType::Segmentation)] = SegmentationCodec;
+        EncoderSettings.PNGDroppedBits = PNGDroppedBits;
+        EncoderSettings.KeyframeInterval = TemporalKeyframeInterval;
+        EncoderSettings.bComputePerceptualHash = CaptureIndex.IsValid();
+        EncoderSettings.MaxFramesInFlight = MaxEncodesInFlight;
+        EncoderSettings.bBlockWhenFull = bOfflineCapture;
+
+        FrameEncoder = MakeUnique<FFrameEncoder>(EncoderSettings);
+        FrameEncoder->OnFrameEncoded().AddUObject(this, &ARenderTargetManager::HandleFrameEncoded);
+    }
+
+    if (!Readback)
+    {
+        InitializeReadback();
+    }
+    return true;
 }
 
-UTextureRenderTarget2D* ARenderTargetManager::CreateRenderTargetForActor(AActor* Actor, int32 Index, ETextureRenderTargetFormat Format)
+void ARenderTargetManager::StopDatasetWriter()
 {
-    if (!IsValid(Actor) || !GetWorld())
+    if (FrameEncoder)
     {
-        UE_LOG(LogTemp, Error, TEXT("Invalid parameters for render target creation"));
-        return nullptr;
+        // Encoded frames still go to the writer before it closes its shards
+        FrameEncoder->Flush();
+        FrameEncoder.Reset();
     }
 
-    UTextureRenderTarget2D* NewRenderTarget = NewObject<UTextureRenderTarget2D>(this);
-    if (IsValid(NewRenderTarget))
+    if (DatasetWriter)
     {
-        NewRenderTarget->RenderTargetFormat = Format;
-        NewRenderTarget->InitAutoFormat(RenderTargetWidth, RenderTargetHeight);
+        DatasetWriter->Stop();
+        ReportShardProgress(true);
+        DatasetWriter.Reset();
     }
 
-    return NewRenderTarget;
+    if (CaptureIndex)
+    {
+        CaptureIndex->Close();
+        CaptureIndex.Reset();
+        SceneHashByFrame.Reset();
+    }
 }
 
-TArray<AActor*> ARenderTargetManager::GetAllInstancesOfTargetActor()
+void ARenderTargetManager::HandleFrameReadback(const FMLCapturedFramePtr& Frame)
 {
-    TArray<AActor*> FoundActors;
-    if (GetWorld() && TargetActorClass)
+    ++FrameCounters.FramesReadBack;
+    FrameCounters.BytesReadBack += Frame->Pixels.Num();
+
+    // Atlas frames carry no camera; fan them out into per-camera frames
+    if (Frame->CameraIndex == INDEX_NONE)
     {
-        UGameplayStatics::GetAllActorsOfClass(GetWorld(), TargetActorClass, FoundActors);
+        TArray<FMLCapturedFramePtr> TileFrames;
+        CaptureAtlas.SplitFrame(Frame, TileFrames);
+        for (const FMLCapturedFramePtr& TileFrame : TileFrames)
+        {
+            DispatchFrame(TileFrame);
+        }
+        return;
     }
-    return FoundActors;
+
+    DispatchFrame(Frame);
 }
 
-TArray<UTextureRenderTarget2D*> ARenderTargetManager::GetAllRenderTargets()
+void ARenderTargetManager::DispatchFrame(const FMLCapturedFramePtr& Frame)
 {
-    return CreatedRenderTargets;
+    ML_CAPTURE_SCOPE(STAT_MLCapture_Export);
+
+    if (CaptureIndex)
+    {
+        if (const uint64* SceneHash = SceneHashByFrame.Find(Frame->FrameIndex))
+        {
+            Frame->SceneStateHash = *SceneHash;
+        }
+    }
+
+    // Depth captured only to derive MLDepth feeds the labeler and point clouds but is not an output itself
+    const bool bOutput = !IsInternalDepth(Frame->BufferType);
+    if (bOutput)
+    {
+        if (FrameStream)
+        {
+            FrameStream->Publish(*Frame);
+        }
+
+        if (FrameEncoder)
+        {
+            FrameEncoder->Submit(Frame);
+        }
+        else if (DatasetWriter)
+        {
+            DatasetWriter->Submit(Frame);
+        }
+    }
+
+    if (PointCloudExporter)
+    {
+        PointCloudExporter->Submit(Frame);
+    }
+
+    if (SegmentationLabeler)
+    {
+        SegmentationLabeler->Submit(Frame);
+    }
+
+    if (bOutput)
+    {
+        FrameDataReady.Broadcast(Frame);
+        OnFrameReadback.Broadcast(Frame->CameraIndex, Frame->BufferType, Frame->FrameIndex);
+    }
+
+    if (UsesCpuMLDepth() && Frame->BufferType == EMLBufferType::SceneDepth)
+    {
+        QuantizeDepthFrame(Frame);
+    }
 }
 
-void ARenderTargetManager::ForceUpdateAllRenderTargets()
+void ARenderTargetManager::QuantizeDepthFrame(const FMLCapturedFramePtr& DepthFrame)
 {
-    TArray<AActor*> Cameras = GetAllInstancesOfTargetActor();
-    int32 UpdateCount = 0;
-    
-    for (AActor* Camera : Cameras)
-    {
-        if (!IsValid(Camera))
-            continue;
-            
-        TArray<USceneCaptureComponent2D*> SceneCaptures;
-        Camera->GetComponents<USceneCaptureComponent2D>(SceneCaptures);
-        
-        for (USceneCaptureComponent2D* SceneCap : SceneCaptures)
+    DepthQuantization::FParams Params;
+    Params.Encoding = MLDepthEncoding;
+    Params.MinDepth = MLDepthMinDistance;
+    Params.MaxDepth = MaxDepthDistance;
+
+    // Quantized on the task graph like encodes; the results are dispatched from Tick()
+    QuantizeTasks.RemoveAllSwap([](const UE::Tasks::FTask& Task) { return Task.IsCompleted(); }, EAllowShrinking::No);
+    QuantizeTasks.Add(UE::Tasks::Launch(UE_SOURCE_LOCATION,
+        [Quantized = QuantizedDepthFrames, DepthFrame, b16Bit = bMLDepth16Bit, Params]()
         {
-            if (IsValid(SceneCap) && IsValid(SceneCap->TextureTarget))
+            if (FMLCapturedFramePtr MLDepthFrame = DepthQuantization::MakeMLDepthFrame(*DepthFrame, b16Bit, Params))
             {
-                if (!SceneCap->bCaptureEveryFrame)
-                {
-                    SceneCap->CaptureScene();
-                    UpdateCount++;
-                }
+                Quantized->Enqueue(MLDepthFrame);
             }
-        }
+        }));
+}
+
+void ARenderTargetManager::DispatchQuantizedDepth(bool bWait)
+{
+    if (bWait)
+    {
+        UE::Tasks::Wait(QuantizeTasks);
+        QuantizeTasks.Reset();
+    }
+
+    FMLCapturedFramePtr MLDepthFrame;
+    while (QuantizedDepthFrames->Dequeue(MLDepthFrame))
+    {
+        DispatchFrame(MLDepthFrame);
     }
-    
-    UE_LOG(LogTemp, Log, TEXT("Force updated %d scene capture components"), UpdateCount);
 }
 
-void ARenderTargetManager::StartPeriodicUpdates()
+bool ARenderTargetManager::StartFrameStream()
 {
-    if (GetWorld() && UpdateFrequency > 0.0f)
+    if (FrameStream && FrameStream->IsOpen())
+        return true;
+
+    FSharedFrameStreamSettings Settings;
+    Settings.Name = StreamName;
+    Settings.SlotCount = StreamSlotCount;
+    Settings.MaxReaders = StreamMaxReaders;
+    Settings.Policy = StreamBackpressure;
+    Settings.BlockTimeoutMs = StreamBlockTimeoutMs;
+    // Room for up to 8 bytes per pixel (half-float RGBA) at the largest capture size
+    const float MaxScale = bAdaptiveResolution ? FMath::Max(ResolutionController.GetLargestScale(), 1.0f) : 1.0f;
+    Settings.MaxFrameBytes = static_cast<int64>(FMath::CeilToInt(RenderTargetWidth * MaxScale)) * FMath::CeilToInt(RenderTargetHeight * MaxScale) * 8;
+
+    FrameStream = MakeUnique<FSharedFrameStream>(Settings);
+    if (!FrameStream->Open())
     {
-        GetWorld()->GetTimerManager().SetTimer(UpdateTimer, this, &ARenderTargetManager::UpdateRenderTargets, UpdateFrequency, true);
-        UE_LOG(LogTemp, Log, TEXT("Started periodic render target updates every %.2f seconds"), UpdateFrequency);
+        FrameStream.Reset();
+        return false;
+    }
+
+    if (!Readback)
+    {
+        InitializeReadback();
     }
+    return true;
 }
 
-void ARenderTargetManager::StopPeriodicUpdates()
+void ARenderTargetManager::StopFrameStream()
 {
-    if (GetWorld() && UpdateTimer.IsValid())
+    if (FrameStream)
     {
-        GetWorld()->GetTimerManager().ClearTimer(UpdateTimer);
-        UE_LOG(LogTemp, Log, TEXT("Stopped periodic render target updates"));
+        FrameStream->Close();
+        FrameStream.Reset();
     }
 }
 
-void ARenderTargetManager::ConfigureCaptureSettings()
+bool ARenderTargetManager::StartPointCloudExport()
 {
-    TArray<AActor*> Cameras = GetAllInstancesOfTargetActor();
-    
-    for (AActor* Camera : Cameras)
+    if (PointCloudExporter && PointCloudExporter->IsRunning())
+        return true;
+
+    FPointCloudExporterSettings Settings;
+    Settings.OutputDirectory = FPaths::IsRelative(PointCloudDirectory)
+        ? FPaths::Combine(FPaths::ProjectSavedDir(), PointCloudDirectory)
+        : PointCloudDirectory;
+    Settings.Format = PointCloudFormat;
+    Settings.Fusion = PointCloudFusion;
+    Settings.bColor = bPointCloudColor;
+    Settings.bHalfPrecision = bPointCloudHalfPrecision;
+    Settings.VoxelSize = PointCloudVoxelSize;
+    Settings.Projection.MaxDepth = MaxDepthDistance;
+    Settings.Projection.PixelStride = PointCloudPixelStride;
+    Settings.MaxPointsPerFile = PointCloudMaxPointsPerFile;
+    Settings.bBlockWhenFull = bOfflineCapture;
+    if (UWorld* World = GetWorld())
     {
-        if (!IsValid(Camera))
-            continue;
-            
-        TArray<USceneCaptureComponent2D*> SceneCaptures;
-        Camera->GetComponents<USceneCaptureComponent2D>(SceneCaptures);
-        
-        for (USceneCaptureComponent2D* SceneCap : SceneCaptures)
-        {
-            if (IsValid(SceneCap))
-            {
-                SceneCap->bCaptureEveryFrame = bForceFrameUpdates;
-                SceneCap->bCaptureOnMovement = true;
-                SceneCap->SetActive(true);
-                SceneCap->MaxViewDistanceOverride = 100000.0f;
-                SceneCap->LODDistanceFactor = 1.0f;
-            }
-        }
+        Settings.WorldOrigin = FVector(World->OriginLocation);
     }
-    
-    UE_LOG(LogTemp, Log, TEXT("Configured capture settings: CaptureEveryFrame=%s"), 
-        bForceFrameUpdates ? TEXT("True") : TEXT("False"));
+
+    PointCloudExporter = MakeUnique<FPointCloudExporter>(Settings);
+    if (!PointCloudExporter->Start())
+    {
+        PointCloudExporter.Reset();
+        return false;
+    }
+
+    if (!Readback)
+    {
+        InitializeReadback();
+    }
+    return true;
 }
 
-void ARenderTargetManager::UpdateRenderTargets()
+void ARenderTargetManager::StopPointCloudExport()
 {
-    ForceUpdateAllRenderTargets();
+    if (PointCloudExporter)
+    {
+        PointCloudExporter->StopExport();
+        PointCloudExporter.Reset();
+    }
+}
+
+FMLPointCloudStats ARenderTargetManager::GetPointCloudStats() const
+{
+    return PointCloudExporter ? PointCloudExporter->GetStats() : FMLPointCloudStats();
+}
+
+int32 ARenderTargetManager::AssignSegmentationIds()
+{
+    SegmentationLabeling::AssignInstanceIds(GetWorld(), SegmentationActorTag, SegmentationInstances);
+    if (SegmentationLabeler)
+    {
+        SegmentationLabeler->SetInstances(SegmentationInstances);
+    }
+    return SegmentationInstances.Num();
+}
+
+FMLSegmentationStats ARenderTargetManager::GetSegmentationStats() const
+{
+    return SegmentationLabeler ? SegmentationLabeler->GetStats() : FMLSegmentationStats();
+}
+
+void ARenderTargetManager::HandleLabelsReady(const FMLCapturedFramePtr& Frame)
+{
+    DispatchFrame(Frame);
+}
+
+void ARenderTargetManager::HandleFrameEncoded(const FMLCapturedFramePtr& Frame)
+{
+    if (DatasetWriter)
+    {
+        DatasetWriter->Submit(Frame);
+    }
+}
+
+TArray<FMLCodecStats> ARenderTargetManager::GetCodecStats() const
+{
+    return FrameEncoder ? FrameEncoder->GetStats() : TArray<FMLCodecStats>();
 }
 
 void ARenderTargetManager::SetupSceneCaptureComponent(USceneCaptureComponent2D* SceneCapture, ESceneCaptureSource CaptureSource)
@@ -189,24 +1739,27 @@ void ARenderTargetManager::SetupSceneCaptureComponent(USceneCaptureComponent2D*
         return;
         
     SceneCapture->CaptureSource = CaptureSource;
-    SceneCapture->bCaptureEveryFrame = bForceFrameUpdates;
-    SceneCapture->bCaptureOnMovement = true;
+    SceneCapture->bCaptureEveryFrame = ShouldCaptureEveryFrame();
+    SceneCapture->bCaptureOnMovement = !UsesExplicitCaptures();
     SceneCapture->SetActive(true);
-    SceneCapture->MaxViewDistanceOverride = 100000.0f;
-    SceneCapture->LODDistanceFactor = 1.0f;
+    ApplyCaptureProfile(SceneCapture);
 }
 
 #if WITH_EDITOR
 void ARenderTargetManager::CreatePersistentCameraRenderTargets()
 {
-    FString OutputFolder = TEXT("/Game/RenderTargets");
     IFileManager::Get().MakeDirectory(*(FPaths::ProjectContentDir() + "RenderTargets"), true);
 
+    // Assets are created or updated in memory first and saved together at the end
+    AssetBatch = FRenderTargetAssetBatch();
+
     // Clear existing arrays
     RGBRenderTargets.Empty();
     DepthRenderTargets.Empty();
     MLDepthRenderTargets.Empty(); // NEW
     NormalRenderTargets.Empty();
+    SegmentationRenderTargets.Empty();
+    ResetCaptureBindings();
 
     TArray<AActor*> Cameras = GetAllInstancesOfTargetActor();
 
@@ -230,11 +1783,12 @@ void ARenderTargetManager::CreatePersistentCameraRenderTargets()
             SceneCaptures[0]->TextureTarget = RGBRT;
             SetupSceneCaptureComponent(SceneCaptures[0], ESceneCaptureSource::SCS_FinalColorLDR);
             RGBRenderTargets.Add(RGBRT);
-            UE_LOG(LogTemp, Log, TEXT("✓ Created RGB render target for camera %d"), i + 1);
+            AddCaptureBinding(Camera, i, EMLBufferType::RGB, SceneCaptures[0], RGBRT);
+            UE_LOG(LogMLCapture, Verbose, TEXT("✓ Created RGB render target for camera %d"), i + 1);
         }
 
-        // Raw Depth Buffer
-        if (bCreateDepthBuffer && SceneCaptures.Num() > 1)
+        // Raw Depth Buffer; CPU-quantized MLDepth is derived from it
+        if ((bCreateDepthBuffer || UsesCpuMLDepth()) && SceneCaptures.Num() > 1)
         {
             UTextureRenderTarget2D* DepthRT = CreateRenderTargetAsset(
                 FString::Printf(TEXT("RT_Depth_Camera_%d"), i + 1),
@@ -243,12 +1797,16 @@ void ARenderTargetManager::CreatePersistentCameraRenderTargets()
             SceneCaptures[1]->CaptureSource = ESceneCaptureSource::SCS_SceneDepth;
             SceneCaptures[1]->TextureTarget = DepthRT;
             SetupSceneCaptureComponent(SceneCaptures[1], ESceneCaptureSource::SCS_SceneDepth);
-            DepthRenderTargets.Add(DepthRT);
-            UE_LOG(LogTemp, Log, TEXT("✓ Created Raw Depth render target for camera %d (red debug view)"), i + 1);
+            if (bCreateDepthBuffer)
+            {
+                DepthRenderTargets.Add(DepthRT);
+            }
+            AddCaptureBinding(Camera, i, EMLBufferType::SceneDepth, SceneCaptures[1], DepthRT);
+            UE_LOG(LogMLCapture, Verbose, TEXT("✓ Created Raw Depth render target for camera %d (red debug view)"), i + 1);
         }
 
-        // NEW: ML Depth Buffer (Normalized for Machine Learning)
-        if (bCreateMLDepthBuffer)
+        // ML Depth Buffer rendered on the GPU; with CPU quantization it comes from the depth buffer instead
+        if (UsesGpuMLDepth())
         {
             CreateMLDepthCaptureForCamera(Camera, i);
         }
@@ -264,15 +1822,70 @@ void ARenderTargetManager::CreatePersistentCameraRenderTargets()
             SceneCaptures[2]->TextureTarget = NormalRT;
             SetupSceneCaptureComponent(SceneCaptures[2], ESceneCaptureSource::SCS_Normal);
             NormalRenderTargets.Add(NormalRT);
-            UE_LOG(LogTemp, Log, TEXT("✓ Created Normal render target for camera %d"), i + 1);
+            AddCaptureBinding(Camera, i, EMLBufferType::Normal, SceneCaptures[2], NormalRT);
+            UE_LOG(LogMLCapture, Verbose, TEXT("✓ Created Normal render target for camera %d"), i + 1);
+        }
+
+        // Segmentation Buffer
+        if (bCreateSegmentationBuffer)
+        {
+            CreateSegmentationCaptureForCamera(Camera, i);
         }
     }
 
+    SaveRenderTargetAssetBatch();
     ConfigureAllSceneCaptureSettings();
 
-    UE_LOG(LogTemp, Warning, TEXT("=== ML Render Target Creation Complete ==="));
-    UE_LOG(LogTemp, Warning, TEXT("Created %d RGB, %d Raw Depth, %d ML Depth, %d Normal render targets"), 
-        RGBRenderTargets.Num(), DepthRenderTargets.Num(), MLDepthRenderTargets.Num(), NormalRenderTargets.Num());
+    UE_LOG(LogMLCapture, Log, TEXT("=== ML Render Target Creation Complete ==="));
+    UE_LOG(LogMLCapture, Log, TEXT("Created %d RGB, %d Raw Depth, %d ML Depth, %d Normal, %d Segmentation render targets"), 
+        RGBRenderTargets.Num(), DepthRenderTargets.Num(), MLDepthRenderTargets.Num(), NormalRenderTargets.Num(), SegmentationRenderTargets.Num());
+    UE_LOG(LogMLCapture, Log, TEXT("Render target assets: %d created, %d updated, %d unchanged"),
+        AssetBatch.NumCreated, AssetBatch.NumUpdated, AssetBatch.NumUnchanged);
+}
+
+void ARenderTargetManager::DeletePersistentCameraRenderTargets()
+{
+    TArray<FAssetData> Assets;
+    IAssetRegistry::GetChecked().GetAssetsByPath(FName(RenderTargetAssetFolder), Assets, false);
+
+    TArray<UObject*> ObjectsToDelete;
+    for (const FAssetData& Asset : Assets)
+    {
+        // Only what CreatePersistentCameraRenderTargets names RT_<Buffer>_Camera_<N>
+        const FString AssetName = Asset.AssetName.ToString();
+        if (Asset.AssetClassPath == UTextureRenderTarget2D::StaticClass()->GetClassPathName()
+            && AssetName.StartsWith(TEXT("RT_")) && AssetName.Contains(TEXT("_Camera_")))
+        {
+            if (UObject* Object = Asset.GetAsset())
+            {
+                ObjectsToDelete.Add(Object);
+            }
+        }
+    }
+
+    // Drop every reference we hold so the delete does not have to null them out behind our back
+    for (const FMLCaptureBinding& Binding : CaptureBindings)
+    {
+        if (IsValid(Binding.SceneCapture) && ObjectsToDelete.Contains(Binding.SceneCapture->TextureTarget))
+        {
+            Binding.SceneCapture->TextureTarget = nullptr;
+        }
+    }
+    RGBRenderTargets.Empty();
+    DepthRenderTargets.Empty();
+    MLDepthRenderTargets.Empty();
+    NormalRenderTargets.Empty();
+    SegmentationRenderTargets.Empty();
+    ResetCaptureBindings();
+
+    const int32 NumDeleted = ObjectsToDelete.Num() > 0 ? ObjectTools::ForceDeleteObjects(ObjectsToDelete, false) : 0;
+    UE_LOG(LogMLCapture, Log, TEXT("Deleted %d of %d persistent camera render targets"), NumDeleted, ObjectsToDelete.Num());
+}
+
+void ARenderTargetManager::RegeneratePersistentCameraRenderTargets()
+{
+    DeletePersistentCameraRenderTargets();
+    CreatePersistentCameraRenderTargets();
 }
 
 void ARenderTargetManager::CreateMLDepthCaptureForCamera(AActor* Camera, int32 CameraIndex)
@@ -283,19 +1896,29 @@ void ARenderTargetManager::CreateMLDepthCaptureForCamera(AActor* Camera, int32 C
         RTF_R8  // 8-bit grayscale for ML
     );
 
+    // A previous run already added the capture; reuse it rather than stacking another one
+    TArray<USceneCaptureComponent2D*> SceneCaptures;
+    Camera->GetComponents<USceneCaptureComponent2D>(SceneCaptures);
+    for (USceneCaptureComponent2D* SceneCap : SceneCaptures)
+    {
+        if (IsValid(SceneCap) && SceneCap->TextureTarget == MLDepthRT)
+        {
+            SetupSceneCaptureComponent(SceneCap, ESceneCaptureSource::SCS_FinalColorLDR);
+            MLDepthRenderTargets.Add(MLDepthRT);
+            AddCaptureBinding(Camera, CameraIndex, EMLBufferType::MLDepth, SceneCap, MLDepthRT);
+            return;
+        }
+    }
+
     // Create additional Scene Capture Component for normalized depth
     USceneCaptureComponent2D* MLDepthCapture = NewObject<USceneCaptureComponent2D>(Camera);
     MLDepthCapture->AttachToComponent(Camera->GetRootComponent(), 
         FAttachmentTransformRules::KeepRelativeTransform);
 
-    // Configure ML depth capture
+    // Configure ML depth capture; normalization comes from MLDepthCaptureProfile's post-process settings
     MLDepthCapture->CaptureSource = ESceneCaptureSource::SCS_FinalColorLDR;
     MLDepthCapture->TextureTarget = MLDepthRT;
-    
-    // TODO: Apply depth normalization post-process material here
-    // This would contain a material that samples SceneDepth, divides by MaxDepthDistance, 
-    // and outputs as grayscale
-    
+
     SetupSceneCaptureComponent(MLDepthCapture, ESceneCaptureSource::SCS_FinalColorLDR);
     
     // Register the new component
@@ -303,7 +1926,51 @@ void ARenderTargetManager::CreateMLDepthCaptureForCamera(AActor* Camera, int32 C
     MLDepthCapture->RegisterComponent();
 
     MLDepthRenderTargets.Add(MLDepthRT);
-    UE_LOG(LogTemp, Log, TEXT("✓ Created ML Depth render target for camera %d (grayscale, ML-ready)"), CameraIndex + 1);
+    AddCaptureBinding(Camera, CameraIndex, EMLBufferType::MLDepth, MLDepthCapture, MLDepthRT);
+    UE_LOG(LogMLCapture, Verbose, TEXT("✓ Created ML Depth render target for camera %d (grayscale, ML-ready)"), CameraIndex + 1);
+}
+
+void ARenderTargetManager::CreateSegmentationCaptureForCamera(AActor* Camera, int32 CameraIndex)
+{
+    // 8-bit stencil IDs; no filtering or gamma may touch them
+    UTextureRenderTarget2D* SegmentationRT = CreateRenderTargetAsset(
+        FString::Printf(TEXT("RT_Segmentation_Camera_%d"), CameraIndex + 1),
+        MLCapture::GetDefaultFormat(EMLBufferType::Segmentation)
+    );
+
+    // Reuse the capture a previous run added
+    TArray<USceneCaptureComponent2D*> SceneCaptures;
+    Camera->GetComponents<USceneCaptureComponent2D>(SceneCaptures);
+    USceneCaptureComponent2D* SegmentationCapture = nullptr;
+    for (USceneCaptureComponent2D* SceneCap : SceneCaptures)
+    {
+        if (IsValid(SceneCap) && (SceneCap->TextureTarget == SegmentationRT || SceneCap->ComponentHasTag(MLCapture::SegmentationCaptureTag)))
+        {
+            SegmentationCapture = SceneCap;
+            break;
+        }
+    }
+
+    if (!SegmentationCapture)
+    {
+        SegmentationCapture = NewObject<USceneCaptureComponent2D>(Camera);
+        SegmentationCapture->AttachToComponent(Camera->GetRootComponent(), FAttachmentTransformRules::KeepRelativeTransform);
+        if (SceneCaptures.Num() > 0)
+        {
+            SegmentationCapture->FOVAngle = SceneCaptures[0]->FOVAngle;
+        }
+        Camera->AddInstanceComponent(SegmentationCapture);
+        SegmentationCapture->RegisterComponent();
+    }
+
+    // Tagged before setup so the segmentation profile and material are applied
+    SegmentationCapture->ComponentTags.AddUnique(MLCapture::SegmentationCaptureTag);
+    SegmentationCapture->TextureTarget = SegmentationRT;
+    SetupSceneCaptureComponent(SegmentationCapture, ESceneCaptureSource::SCS_FinalColorLDR);
+
+    SegmentationRenderTargets.Add(SegmentationRT);
+    AddCaptureBinding(Camera, CameraIndex, EMLBufferType::Segmentation, SegmentationCapture, SegmentationRT);
+    UE_LOG(LogMLCapture, Verbose, TEXT("✓ Created Segmentation render target for camera %d"), CameraIndex + 1);
 }
 
 void ARenderTargetManager::ConfigureAllSceneCaptureSettings()
@@ -313,31 +1980,85 @@ void ARenderTargetManager::ConfigureAllSceneCaptureSettings()
     FTimerHandle ForceUpdateTimer;
     GetWorld()->GetTimerManager().SetTimer(ForceUpdateTimer, this, &ARenderTargetManager::ForceUpdateAllRenderTargets, 1.0f, false);
     
-    UE_LOG(LogTemp, Log, TEXT("Configured all Scene Capture settings for live updates"));
+    UE_LOG(LogMLCapture, Log, TEXT("Configured all Scene Capture settings for live updates"));
 }
 
 UTextureRenderTarget2D* ARenderTargetManager::CreateRenderTargetAsset(const FString& AssetName, ETextureRenderTargetFormat Format)
 {
-    FString PackageName = TEXT("/Game/RenderTargets/") + AssetName;
-    UPackage* Package = CreatePackage(*PackageName);
-    Package->FullyLoad();
+    const FString PackageName = FString::Printf(TEXT("%s/%s"), RenderTargetAssetFolder, *AssetName);
+
+    // Leave assets from a previous run untouched (and unsaved) when their size and format still match
+    if (UTextureRenderTarget2D* Existing = LoadObject<UTextureRenderTarget2D>(nullptr, *(PackageName + TEXT(".") + AssetName), nullptr, LOAD_NoWarn | LOAD_Quiet))
+    {
+        if (Existing->SizeX == RenderTargetWidth && Existing->SizeY == RenderTargetHeight && Existing->RenderTargetFormat == Format)
+        {
+            ++AssetBatch.NumUnchanged;
+            return Existing;
+        }
+
+        Existing->RenderTargetFormat = Format;
+        Existing->InitAutoFormat(RenderTargetWidth, RenderTargetHeight);
+        Existing->MarkPackageDirty();
+        AssetBatch.PackagesToSave.Add({ Existing->GetPackage(), Existing });
+        ++AssetBatch.NumUpdated;
+        return Existing;
+    }
 
+    UPackage* Package = CreatePackage(*PackageName);
     UTextureRenderTarget2D* RT = NewObject<UTextureRenderTarget2D>(
         Package, *AssetName, RF_Public | RF_Standalone
     );
     RT->RenderTargetFormat = Format;
+    // Queues the resource update; nothing waits for it here
     RT->InitAutoFormat(RenderTargetWidth, RenderTargetHeight);
-    RT->UpdateResourceImmediate(true);
 
     FAssetRegistryModule::AssetCreated(RT);
     Package->MarkPackageDirty();
+    AssetBatch.PackagesToSave.Add({ Package, RT });
+    ++AssetBatch.NumCreated;
+
+    return RT;
+}
+
+void ARenderTargetManager::SaveRenderTargetAssetBatch()
+{
+    if (AssetBatch.PackagesToSave.Num() == 0)
+        return;
+
+    const double StartTime = FPlatformTime::Seconds();
+
+    // Render target resources must exist before their packages are serialized
+    FlushRenderingCommands();
+
+    TArray<FPackageSaveInfo> SaveInfos;
+    SaveInfos.Reserve(AssetBatch.PackagesToSave.Num());
+    for (const TPair<UPackage*, UObject*>& Entry : AssetBatch.PackagesToSave)
+    {
+        FPackageSaveInfo& Info = SaveInfos.AddDefaulted_GetRef();
+        Info.Package = Entry.Key;
+        Info.Asset = Entry.Value;
+        Info.Filename = FPackageName::LongPackageNameToFilename(Entry.Key->GetName(), FPackageName::GetAssetPackageExtension());
+    }
 
-    FString PackageFileName = FPackageName::LongPackageNameToFilename(PackageName, FPackageName::GetAssetPackageExtension());
     FSavePackageArgs SaveArgs;
     SaveArgs.TopLevelFlags = RF_Public | RF_Standalone;
-    SaveArgs.SaveFlags = SAVE_None;
-    UPackage::SavePackage(Package, RT, *PackageFileName, SaveArgs);
+    SaveArgs.SaveFlags = SAVE_NoError;
 
-    return RT;
+    TArray<FSavePackageResultStruct> Results;
+    UPackage::SaveConcurrent(SaveInfos, SaveArgs, Results);
+
+    int32 NumFailed = 0;
+    for (int32 i = 0; i < Results.Num(); ++i)
+    {
+        if (Results[i].Result != ESavePackageResult::Success)
+        {
+            UE_LOG(LogMLCapture, Error, TEXT("Failed to save %s"), *SaveInfos[i].Filename);
+            ++NumFailed;
+        }
+    }
+
+    UE_LOG(LogMLCapture, Log, TEXT("Saved %d render target packages in %.2f s (%d failed)"),
+        SaveInfos.Num() - NumFailed, FPlatformTime::Seconds() - StartTime, NumFailed);
+    AssetBatch.PackagesToSave.Reset();
 }
 #endif
@@ -7,19 +7,48 @@
 #include "Kismet/GameplayStatics.h"
 #include "Engine/World.h"
 #include "TimerManager.h"
+#include "MLCaptureTypes.h"
+#include "RenderTargetReadback.h"
+#include "DatasetShardWriter.h"
+#include "CaptureIndex.h"
+#include "CaptureScheduler.h"
+#include "CaptureChangeTracker.h"
+#include "CaptureProfile.h"
+#include "CaptureResolutionController.h"
+#include "RenderTargetAtlas.h"
+#include "RenderTargetPool.h"
+#include "RenderTargetBudget.h"
+#include "CameraCaptureRegistry.h"
+#include "DepthQuantization.h"
+#include "FrameEncoder.h"
+#include "SharedFrameStream.h"
+#include "PointCloudExporter.h"
+#include "SegmentationLabeler.h"
+#include "MLCaptureStats.h"
 #include "RenderTargetManager.generated.h"
 
+class UMaterialInterface;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnMLOfflineCaptureComplete, int32, FramesCaptured);
+
 UCLASS(BlueprintType, Blueprintable)
 class CAMERATESTER_API ARenderTargetManager : public AActor
 {
     GENERATED_BODY()
 
+    friend class UCaptureBenchmarkSubsystem;
+
 public:
     ARenderTargetManager();
 
 protected:
     virtual void BeginPlay() override;
+    virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+public:
+    virtual void Tick(float DeltaSeconds) override;
 
+protected:
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Detection")
     TSubclassOf<AActor> TargetActorClass;
 
@@ -29,6 +58,26 @@ protected:
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Render Targets")
     int32 RenderTargetHeight = 512;
 
+    // Idle render targets kept for reuse across re-detection; least recently released are evicted beyond this
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Render Targets", meta = (ClampMin = "0"))
+    int32 MaxPooledRenderTargetMB = 256;
+
+    // Memory Budget
+    // Cap on render targets plus readback staging copies; 0 = unlimited. Overridden by -MLRenderTargetBudgetMB=
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Memory Budget", meta = (ClampMin = "0"))
+    int32 RenderTargetBudgetMB = 0;
+
+    // How detection fits the camera rig into the budget. Targets allocated later are refused once the budget is full.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Memory Budget", meta = (EditCondition = "RenderTargetBudgetMB > 0"))
+    EMLMemoryBudgetPolicy MemoryBudgetPolicy = EMLMemoryBudgetPolicy::DropThenReduce;
+
+    // Given up first, in order, by DropOptionalBuffers and DropThenReduce
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Memory Budget", meta = (EditCondition = "RenderTargetBudgetMB > 0"))
+    TArray<EMLBufferType> OptionalBuffers;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Memory Budget", meta = (ClampMin = "0.05", ClampMax = "1", EditCondition = "RenderTargetBudgetMB > 0"))
+    float MinBudgetResolutionScale = 0.25f;
+
     // ML Buffer Options
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ML Buffers")
     bool bCreateRGBBuffer = true;
@@ -42,17 +91,183 @@ protected:
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ML Buffers")
     bool bCreateNormalBuffer = false;
 
+    // Custom stencil instance IDs of actors tagged SegmentationActorTag; needs SegmentationMaterial
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ML Buffers")
+    bool bCreateSegmentationBuffer = false;
+
+    // At runtime, add pooled depth/normal/segmentation captures to cameras that lack them (honours the bCreate*Buffer flags).
+    // ML depth is then derived on the CPU from scene depth.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ML Buffers")
+    bool bCreateRuntimeBufferCaptures = false;
+
+    // Capture Profiles
+    // Per-buffer show flags, post-process, view distance and LOD; off = every buffer renders with the RGB profile
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Capture Profiles")
+    bool bUseCaptureProfiles = true;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Capture Profiles")
+    FMLCaptureProfile RGBCaptureProfile;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Capture Profiles", meta = (EditCondition = "bUseCaptureProfiles"))
+    FMLCaptureProfile DepthCaptureProfile;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Capture Profiles", meta = (EditCondition = "bUseCaptureProfiles"))
+    FMLCaptureProfile MLDepthCaptureProfile;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Capture Profiles", meta = (EditCondition = "bUseCaptureProfiles"))
+    FMLCaptureProfile NormalCaptureProfile;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Capture Profiles", meta = (EditCondition = "bUseCaptureProfiles"))
+    FMLCaptureProfile SegmentationCaptureProfile;
+
     // Force Update Options
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Update Settings")
     bool bForceFrameUpdates = true;
 
+    // Legacy periodic timer; with the scheduler enabled it becomes the default per-capture period
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Update Settings")
     float UpdateFrequency = 0.0f;
 
+    // Capture Scheduler
+    // Drive CaptureScene from a budgeted round-robin instead of bCaptureEveryFrame on every component
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Scheduler")
+    bool bUseCaptureScheduler = true;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Scheduler")
+    EMLCaptureBudgetMode CaptureBudgetMode = EMLCaptureBudgetMode::CaptureCount;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Scheduler", meta = (ClampMin = "1"))
+    int32 MaxCapturesPerFrame = 16;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Scheduler", meta = (ClampMin = "1", EditCondition = "CaptureBudgetMode == EMLCaptureBudgetMode::GpuTime"))
+    float GpuFrameBudgetMs = 16.0f;
+
+    // 0 = as often as the budget allows
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Scheduler", meta = (ClampMin = "0"))
+    float DefaultCaptureRateHz = 0.0f;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Scheduler")
+    TArray<FMLCaptureRateOverride> CaptureRateOverrides;
+
+    // Adaptive Resolution
+    // Resize pooled capture targets between preallocated size tiers to hold GPU frame time at a target.
+    // Low-priority captures degrade first; exported frames carry the size they were captured at.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Adaptive Resolution")
+    bool bAdaptiveResolution = false;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Adaptive Resolution", meta = (ClampMin = "1", EditCondition = "bAdaptiveResolution"))
+    float ResolutionTargetFrameMs = 16.6f;
+
+    // Scales of RenderTargetWidth/Height a capture may use
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Adaptive Resolution", meta = (EditCondition = "bAdaptiveResolution"))
+    TArray<float> ResolutionTierScales = { 1.0f, 0.75f, 0.5f, 0.375f, 0.25f };
+
+    // Frames between adjustments, so a resize shows up in GPU time before the next one
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Adaptive Resolution", meta = (ClampMin = "1", EditCondition = "bAdaptiveResolution"))
+    int32 ResolutionAdjustIntervalFrames = 15;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Adaptive Resolution", meta = (ClampMin = "0.05", ClampMax = "1", EditCondition = "bAdaptiveResolution"))
+    float DefaultMinResolutionScale = 0.25f;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Adaptive Resolution", meta = (EditCondition = "bAdaptiveResolution"))
+    TArray<FMLCaptureResolutionOverride> ResolutionOverrides;
+
+    // Offline Capture
+    // Advance the world by a fixed step as fast as the hardware allows and capture every binding in lockstep with
+    // the frame index. Nothing is dropped (stages wait instead), so a given seed yields identical frames and poses.
+    // Also enabled with -MLOffline.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Offline")
+    bool bOfflineCapture = false;
+
+    // Simulated frames per second; each tick advances the world by exactly 1 / OfflineFrameRate
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Offline", meta = (ClampMin = "1", EditCondition = "bOfflineCapture"))
+    float OfflineFrameRate = 30.0f;
+
+    // Capture on every Nth simulated frame
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Offline", meta = (ClampMin = "1", EditCondition = "bOfflineCapture"))
+    int32 OfflineCaptureInterval = 1;
+
+    // Frames simulated after detection before the first capture, so exposure and temporal effects settle
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Offline", meta = (ClampMin = "0", EditCondition = "bOfflineCapture"))
+    int32 OfflineWarmupFrames = 8;
+
+    // Capture frames to produce; 0 = until stopped. Overridden by -MLOfflineFrames=
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Offline", meta = (ClampMin = "0", EditCondition = "bOfflineCapture"))
+    int32 OfflineFrameCount = 0;
+
+    // Seeds the engine's global random streams. Overridden by -MLOfflineSeed=
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Offline", meta = (EditCondition = "bOfflineCapture"))
+    int32 OfflineSeed = 0;
+
+    // Also enabled with -MLOfflineExit
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Offline", meta = (EditCondition = "bOfflineCapture"))
+    bool bExitWhenOfflineComplete = false;
+
+    // Change Detection
+    // Re-render a capture only when its camera moved, a movable actor moved inside its view or it went stale.
+    // Skipped captures are reported through OnCaptureSkipped and written to the dataset as reused records.
+    // Requires explicit captures (scheduler or offline mode).
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Change Detection")
+    bool bChangeDrivenCapture = false;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Change Detection", meta = (ClampMin = "0", EditCondition = "bChangeDrivenCapture"))
+    float ChangePositionTolerance = 0.5f;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Change Detection", meta = (ClampMin = "0", EditCondition = "bChangeDrivenCapture"))
+    float ChangeRotationToleranceDegrees = 0.05f;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Change Detection", meta = (ClampMin = "0", EditCondition = "bChangeDrivenCapture"))
+    float ChangeFOVToleranceDegrees = 0.01f;
+
+    // Watch movable actors and re-capture every view whose frustum they move through
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Change Detection", meta = (EditCondition = "bChangeDrivenCapture"))
+    bool bTrackSceneMotion = true;
+
+    // Re-capture an unchanged view after this long anyway (lighting, materials, particles); 0 = never
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Change Detection", meta = (ClampMin = "0", EditCondition = "bChangeDrivenCapture"))
+    float MaxCaptureStalenessSeconds = 5.0f;
+
     // Depth Normalization Settings
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ML Settings", meta = (ClampMin = "100", ClampMax = "100000"))
     float MaxDepthDistance = 10000.0f; // 100 meters in cm
 
+    // Derive an MLDepth frame from every read-back SceneDepth frame with the SIMD quantization kernels.
+    // Replaces the GPU MLDepth capture whenever frames are read back (readback, dataset, stream, point clouds or labels).
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ML Settings")
+    bool bQuantizeDepthOnCPU = true;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ML Settings", meta = (EditCondition = "bQuantizeDepthOnCPU"))
+    EMLDepthEncoding MLDepthEncoding = EMLDepthEncoding::Linear;
+
+    // G16 instead of G8
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ML Settings", meta = (EditCondition = "bQuantizeDepthOnCPU"))
+    bool bMLDepth16Bit = false;
+
+    // Near clamp and zero point for the Inverse and Log encodings
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ML Settings", meta = (ClampMin = "0.1", EditCondition = "bQuantizeDepthOnCPU"))
+    float MLDepthMinDistance = 10.0f;
+
+    // Segmentation
+    // Actors with this tag get a stencil ID (1-255) on BeginPlay; IDs follow actor name order
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Segmentation", meta = (EditCondition = "bCreateSegmentationBuffer"))
+    FName SegmentationActorTag = TEXT("MLSegment");
+
+    // Post-process material (replacing the tonemapper) that writes SceneTexture:CustomStencil / 255 to red
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Segmentation", meta = (EditCondition = "bCreateSegmentationBuffer"))
+    UMaterialInterface* SegmentationMaterial = nullptr;
+
+    // Derive a Labels frame from every read-back Segmentation frame: pixel counts, 2D/3D boxes, components, occlusion
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Segmentation", meta = (EditCondition = "bCreateSegmentationBuffer"))
+    bool bLabelSegmentation = true;
+
+    // Measure occlusion against the SceneDepth frame of the same camera; labels wait a few frames for it
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Segmentation", meta = (EditCondition = "bCreateSegmentationBuffer && bLabelSegmentation"))
+    bool bSegmentationOcclusionFromDepth = true;
+
+    // Instances with fewer visible pixels get no label
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Segmentation", meta = (ClampMin = "1", EditCondition = "bCreateSegmentationBuffer && bLabelSegmentation"))
+    int32 SegmentationMinPixels = 1;
+
     // Store render targets by type
     UPROPERTY(BlueprintReadOnly, Category = "Render Targets")
     TArray<UTextureRenderTarget2D*> CreatedRenderTargets;
@@ -69,19 +284,249 @@ protected:
     UPROPERTY(BlueprintReadOnly, Category = "ML Buffers")
     TArray<UTextureRenderTarget2D*> NormalRenderTargets;
 
+    UPROPERTY(BlueprintReadOnly, Category = "ML Buffers")
+    TArray<UTextureRenderTarget2D*> SegmentationRenderTargets;
+
+    // GPU Readback
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Readback")
+    bool bEnableReadback = false;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Readback", meta = (ClampMin = "1", ClampMax = "16"))
+    int32 ReadbackFramesInFlight = 3;
+
+    // Atlas Capture
+    // Pack all cameras of a buffer type into one tiled target: one resolve and one readback per buffer type per frame.
+    // Requires the capture scheduler.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Atlas")
+    bool bUseAtlasCapture = false;
+
+    // Dataset Export
+    // Also enabled with -MLWriteDataset. A sharded process (see UCaptureShardSubsystem) writes into a part_<k>
+    // subdirectory and reports its manifest to the shard coordinator when the writer stops.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Dataset")
+    bool bWriteDataset = false;
+
+    // Relative paths are resolved against the project's Saved directory. Overridden by -MLDatasetDir=
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Dataset")
+    FString DatasetDirectory = TEXT("Dataset");
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Dataset", meta = (ClampMin = "16"))
+    int32 DatasetShardSizeMB = 1024;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Dataset", meta = (ClampMin = "1", ClampMax = "32"))
+    int32 DatasetWriterThreads = 2;
+
+    // Frames are dropped (never blocking the game thread) once this much data is waiting for disk
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Dataset", meta = (ClampMin = "16"))
+    int32 DatasetMaxQueuedMB = 256;
+
+    // Deduplication
+    // Keep capture_index.bin next to the shards. A restarted run keeps the shards already written and skips, before
+    // rendering, every capture the dataset already holds: the same frame of a deterministic replay, or the same view
+    // (camera, buffer, quantized pose and scene state) at any frame. Written frames whose pixels barely differ from
+    // the previous frame of their capture are flagged NearDuplicate. Needs the dataset writer and explicit captures.
+    // Also enabled with -MLDedup.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Deduplication")
+    bool bDeduplicateCaptures = false;
+
+    // Skip views already in the index, not only frames already written; off keeps every frame of the run
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Deduplication", meta = (EditCondition = "bDeduplicateCaptures"))
+    bool bSkipDuplicateViews = true;
+
+    // Camera positions closer than this count as the same view. An existing index keeps the quanta it was made with.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Deduplication", meta = (ClampMin = "0.01", EditCondition = "bDeduplicateCaptures"))
+    float DedupPositionQuantum = 1.0f;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Deduplication", meta = (ClampMin = "0.001", EditCondition = "bDeduplicateCaptures"))
+    float DedupRotationQuantumDegrees = 0.1f;
+
+    // Perceptual hash bits (of 64) two frames may differ in and still be near-duplicates; -1 disables flagging
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Deduplication", meta = (ClampMin = "-1", ClampMax = "32", EditCondition = "bDeduplicateCaptures"))
+    int32 NearDuplicateBits = 3;
+
+    // Encoding
+    // Compress frames on the task graph before they reach the dataset writer
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Encoding")
+    bool bEncodeFrames = true;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Encoding", meta = (EditCondition = "bEncodeFrames"))
+    EMLFrameCodec RGBCodec = EMLFrameCodec::PNG;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Encoding", meta = (EditCondition = "bEncodeFrames"))
+    EMLFrameCodec DepthCodec = EMLFrameCodec::TemporalDelta;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Encoding", meta = (EditCondition = "bEncodeFrames"))
+    EMLFrameCodec MLDepthCodec = EMLFrameCodec::PNG;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Encoding", meta = (EditCondition = "bEncodeFrames"))
+    EMLFrameCodec NormalCodec = EMLFrameCodec::TemporalDelta;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Encoding", meta = (EditCondition = "bEncodeFrames"))
+    EMLFrameCodec SegmentationCodec = EMLFrameCodec::PNG;
+
+    // Low bits cleared per 8-bit channel before PNG encoding; 0 = lossless
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Encoding", meta = (ClampMin = "0", ClampMax = "7", EditCondition = "bEncodeFrames"))
+    int32 PNGDroppedBits = 0;
+
+    // TemporalDelta frames per capture between keyframes: longer saves more space, shorter makes random access cheaper
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Encoding", meta = (ClampMin = "1", EditCondition = "bEncodeFrames"))
+    int32 TemporalKeyframeInterval = 30;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Encoding", meta = (ClampMin = "1", EditCondition = "bEncodeFrames"))
+    int32 MaxEncodesInFlight = 128;
+
+    // Frame Stream
+    // Publish every read-back buffer into a shared-memory ring for local consumers (Tools/FrameStream)
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Stream")
+    bool bStreamFrames = false;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Stream", meta = (EditCondition = "bStreamFrames"))
+    FString StreamName = TEXT("cameratester_frames");
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Stream", meta = (ClampMin = "2", EditCondition = "bStreamFrames"))
+    int32 StreamSlotCount = 32;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Stream", meta = (ClampMin = "1", ClampMax = "64", EditCondition = "bStreamFrames"))
+    int32 StreamMaxReaders = 8;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Stream", meta = (EditCondition = "bStreamFrames"))
+    EMLStreamBackpressure StreamBackpressure = EMLStreamBackpressure::DropFrame;
+
+    // Longest the game thread waits for slow readers under the Block policy
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Stream", meta = (ClampMin = "0", EditCondition = "bStreamFrames && StreamBackpressure == EMLStreamBackpressure::Block"))
+    float StreamBlockTimeoutMs = 100.0f;
+
+    // Point Cloud
+    // Back-project read-back SceneDepth into world-space point clouds, colored from the RGB buffer when captured
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Point Cloud")
+    bool bExportPointClouds = false;
+
+    // Relative paths are under the project's Saved directory
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Point Cloud", meta = (EditCondition = "bExportPointClouds"))
+    FString PointCloudDirectory = TEXT("PointClouds");
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Point Cloud", meta = (EditCondition = "bExportPointClouds"))
+    EMLPointCloudFormat PointCloudFormat = EMLPointCloudFormat::PLY;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Point Cloud", meta = (EditCondition = "bExportPointClouds"))
+    EMLPointCloudFusion PointCloudFusion = EMLPointCloudFusion::PerCamera;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Point Cloud", meta = (EditCondition = "bExportPointClouds"))
+    bool bPointCloudColor = true;
+
+    // Voxel edge in cm; 0 keeps every pixel for PerCamera clouds, the fused modes use at least 1
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Point Cloud", meta = (ClampMin = "0", EditCondition = "bExportPointClouds"))
+    float PointCloudVoxelSize = 0.0f;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Point Cloud", meta = (ClampMin = "1", ClampMax = "16", EditCondition = "bExportPointClouds"))
+    int32 PointCloudPixelStride = 1;
+
+    // Compact format only
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Point Cloud", meta = (EditCondition = "bExportPointClouds && PointCloudFormat == EMLPointCloudFormat::Compact"))
+    bool bPointCloudHalfPrecision = false;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Point Cloud", meta = (ClampMin = "65536", EditCondition = "bExportPointClouds"))
+    int64 PointCloudMaxPointsPerFile = 16 * 1024 * 1024;
+
+    // Captures added by bCreateRuntimeBufferCaptures; destroyed on re-detection
+    UPROPERTY(Transient)
+    TArray<USceneCaptureComponent2D*> RuntimeCaptures;
+
+    // Actor rendered with stencil ID Index + 1
+    UPROPERTY(Transient)
+    TArray<AActor*> SegmentationInstances;
+
+    // Every capture component we fill, with its camera index and buffer type
+    UPROPERTY(Transient, BlueprintReadOnly, Category = "Capture")
+    TArray<FMLCaptureBinding> CaptureBindings;
+
     // Timer for updates
     FTimerHandle UpdateTimer;
 
+    // Detection state driven by UCameraCaptureRegistry events
+    TSet<const AActor*> BoundCameras;
+    TArray<AActor*> PendingCameras;
+    FDelegateHandle CamerasChangedHandle;
+    FDelegateHandle SpawnsCompleteHandle;
+    bool bDetectionPending = false;
+    bool bInitialDetectionDone = false;
+
+    // Incremented once per capture tick; tags every readback
+    int64 CaptureFrameIndex = 0;
+
+    // Offline state; timing is restored on EndPlay
+    int32 OfflineFramesCaptured = 0;
+    int64 OfflineFirstCaptureFrame = INDEX_NONE;
+    bool bOfflineComplete = false;
+    bool bPreviousUseFixedTimeStep = false;
+    bool bPreviousBenchmarking = false;
+    double PreviousFixedDeltaTime = 0.0;
+
+    TUniquePtr<FRenderTargetReadback> Readback;
+    TUniquePtr<FDatasetShardWriter> DatasetWriter;
+    TSharedPtr<FCaptureIndex, ESPMode::ThreadSafe> CaptureIndex;
+    // Last frame the dataset held when the writer started
+    int64 ResumeFrameIndex = INDEX_NONE;
+    // Scene state of recent capture frames, stamped onto their frames once read back
+    TMap<int64, uint64> SceneHashByFrame;
+    TUniquePtr<FFrameEncoder> FrameEncoder;
+    // CPU depth quantization in flight, and its finished MLDepth frames waiting for the game thread
+    TArray<UE::Tasks::FTask> QuantizeTasks;
+    TSharedRef<TQueue<FMLCapturedFramePtr, EQueueMode::Mpsc>, ESPMode::ThreadSafe> QuantizedDepthFrames = MakeShared<TQueue<FMLCapturedFramePtr, EQueueMode::Mpsc>, ESPMode::ThreadSafe>();
+    TUniquePtr<FSharedFrameStream> FrameStream;
+    TUniquePtr<FPointCloudExporter> PointCloudExporter;
+    TUniquePtr<FSegmentationLabeler> SegmentationLabeler;
+    TMap<const USceneCaptureComponent2D*, int32> BindingIndexByCapture;
+
+    FRenderTargetPool RenderTargetPool;
+    // Sizes and buffers of manager-created targets follow the last plan until the next detection
+    RenderTargetBudget::FPlan BudgetPlan;
+    int32 CamerasRefused = 0;
+    int64 TargetsRefused = 0;
+    FRenderTargetAtlas CaptureAtlas;
+    FCaptureScheduler CaptureScheduler;
+    TArray<int32> ScheduledBindingIndices;
+    bool bSchedulerDirty = true;
+    FCaptureChangeTracker ChangeTracker;
+    bool bChangeTrackerDirty = true;
+    FCaptureResolutionController ResolutionController;
+    TArray<FCaptureResolutionController::FTierChange> ResolutionChanges;
+    bool bResolutionControllerDirty = true;
+    FOnMLFrameDataReady FrameDataReady;
+
+    // Published to "stat MLCapture" and Insights once per tick
+    FMLCaptureFrameCounters FrameCounters;
+    int64 ReadbacksDroppedPublished = 0;
+
 public:
+    // Called automatically on the first tick after BeginPlay (or once the camera spawners finish), then again
+    // whenever cameras are removed; cameras spawned later are bound incrementally
     UFUNCTION(BlueprintCallable, Category = "Detection")
     void DetectAndCreateRenderTargets();
 
+    // Every spawner has finished and every registered camera is bound
+    UFUNCTION(BlueprintCallable, Category = "Detection")
+    bool AreRenderTargetsReady() const;
+
+    // Served from UCameraCaptureRegistry; no world iteration
     UFUNCTION(BlueprintCallable, Category = "Detection")
     TArray<AActor*> GetAllInstancesOfTargetActor();
 
+    UCameraCaptureRegistry* GetCameraRegistry() const;
+
     UFUNCTION(BlueprintCallable, Category = "Render Targets")
     TArray<UTextureRenderTarget2D*> GetAllRenderTargets();
 
+    UFUNCTION(BlueprintCallable, Category = "Render Targets")
+    FMLRenderTargetPoolStats GetRenderTargetPoolStats() const { return RenderTargetPool.GetStats(); }
+
+    UFUNCTION(BlueprintCallable, Category = "Render Targets")
+    void TrimRenderTargetPool() { RenderTargetPool.Trim(); }
+
+    // Exact RHI footprint of manager-owned targets, the idle pool and readback staging, and what the budget gave up
+    UFUNCTION(BlueprintCallable, Category = "Memory Budget")
+    FMLRenderTargetMemoryStats GetRenderTargetMemoryStats() const;
+
     UFUNCTION(BlueprintCallable, Category = "Render Targets")
     UTextureRenderTarget2D* CreateRenderTargetForActor(AActor* Actor, int32 Index, ETextureRenderTargetFormat Format = RTF_RGBA8);
 
@@ -98,19 +543,205 @@ public:
     UFUNCTION(BlueprintCallable, Category = "Updates")
     void ConfigureCaptureSettings();
 
+    UFUNCTION(BlueprintCallable, Category = "Capture Profiles")
+    const FMLCaptureProfile& GetCaptureProfile(EMLBufferType BufferType) const;
+
+    // Readback
+    UFUNCTION(BlueprintCallable, Category = "Readback")
+    void RequestReadbackForAllBuffers();
+
+    UFUNCTION(BlueprintCallable, Category = "Capture")
+    TArray<FMLCaptureBinding> GetCaptureBindings() const { return CaptureBindings; }
+
+    UFUNCTION(BlueprintCallable, Category = "Readback")
+    int64 GetCaptureFrameIndex() const { return CaptureFrameIndex; }
+
+    // Scheduler
+    UFUNCTION(BlueprintCallable, Category = "Scheduler")
+    void ConfigureCaptureScheduler();
+
+    UFUNCTION(BlueprintCallable, Category = "Scheduler")
+    void SetCaptureRate(int32 CameraIndex, EMLBufferType BufferType, float TargetRateHz, int32 Priority = 0);
+
+    UFUNCTION(BlueprintCallable, Category = "Scheduler")
+    float GetAchievedCaptureRate(int32 CameraIndex, EMLBufferType BufferType) const;
+
+    UFUNCTION(BlueprintCallable, Category = "Scheduler")
+    FMLCaptureSchedulerStats GetCaptureSchedulerStats() const { return CaptureScheduler.GetStats(); }
+
+    // Adaptive resolution
+    UFUNCTION(BlueprintCallable, Category = "Adaptive Resolution")
+    void ConfigureResolutionController();
+
+    UFUNCTION(BlueprintCallable, Category = "Adaptive Resolution")
+    FMLResolutionControllerStats GetResolutionControllerStats() const { return ResolutionController.GetStats(); }
+
+    // Current render target size of a capture; (0, 0) if it is not bound
+    UFUNCTION(BlueprintCallable, Category = "Adaptive Resolution")
+    FIntPoint GetCaptureResolution(int32 CameraIndex, EMLBufferType BufferType) const;
+
+    // Change detection
+    UFUNCTION(BlueprintCallable, Category = "Change Detection")
+    void ConfigureChangeTracker();
+
+    UFUNCTION(BlueprintCallable, Category = "Change Detection")
+    FMLChangeTrackerStats GetChangeTrackerStats() const { return ChangeTracker.GetStats(); }
+
+    // Atlas
+    UFUNCTION(BlueprintCallable, Category = "Atlas")
+    TArray<FMLAtlasTile> GetAtlasTiles(EMLBufferType BufferType) const { return CaptureAtlas.GetTiles(BufferType); }
+
+    UFUNCTION(BlueprintCallable, Category = "Atlas")
+    UTextureRenderTarget2D* GetAtlasRenderTarget(EMLBufferType BufferType) const { return CaptureAtlas.GetAtlasTarget(BufferType); }
+
+    UFUNCTION(BlueprintCallable, Category = "Dataset")
+    bool StartDatasetWriter();
+
+    UFUNCTION(BlueprintCallable, Category = "Dataset")
+    void StopDatasetWriter();
+
+    UFUNCTION(BlueprintCallable, Category = "Deduplication")
+    FMLCaptureIndexStats GetCaptureIndexStats() const { return CaptureIndex ? CaptureIndex->GetStats() : FMLCaptureIndexStats(); }
+
+    UFUNCTION(BlueprintCallable, Category = "Encoding")
+    TArray<FMLCodecStats> GetCodecStats() const;
+
+    UFUNCTION(BlueprintCallable, Category = "Stream")
+    bool StartFrameStream();
+
+    UFUNCTION(BlueprintCallable, Category = "Stream")
+    void StopFrameStream();
+
+    UFUNCTION(BlueprintCallable, Category = "Point Cloud")
+    bool StartPointCloudExport();
+
+    UFUNCTION(BlueprintCallable, Category = "Point Cloud")
+    void StopPointCloudExport();
+
+    UFUNCTION(BlueprintCallable, Category = "Point Cloud")
+    FMLPointCloudStats GetPointCloudStats() const;
+
+    // Re-tags the world, e.g. after spawning actors; returns the number of instances with an ID
+    UFUNCTION(BlueprintCallable, Category = "Segmentation")
+    int32 AssignSegmentationIds();
+
+    // Element Index has stencil ID Index + 1
+    UFUNCTION(BlueprintCallable, Category = "Segmentation")
+    TArray<AActor*> GetSegmentationInstances() const { return SegmentationInstances; }
+
+    UFUNCTION(BlueprintCallable, Category = "Segmentation")
+    FMLSegmentationStats GetSegmentationStats() const;
+
+    // Fired on the game thread when a buffer's pixels have reached the CPU
+    UPROPERTY(BlueprintAssignable, Category = "Readback")
+    FOnMLFrameReadback OnFrameReadback;
+
+    // Fired on the game thread for every capture skipped as unchanged; ReusedFrameIndex is the frame whose pixels still apply
+    UPROPERTY(BlueprintAssignable, Category = "Change Detection")
+    FOnMLCaptureSkipped OnCaptureSkipped;
+
+    // Fired once OfflineFrameCount frames are captured and every stage has been flushed
+    UPROPERTY(BlueprintAssignable, Category = "Offline")
+    FOnMLOfflineCaptureComplete OnOfflineCaptureComplete;
+
+    UFUNCTION(BlueprintCallable, Category = "Offline")
+    int32 GetOfflineFramesCaptured() const { return OfflineFramesCaptured; }
+
+    // Native variant carrying the pixel data
+    FOnMLFrameDataReady& OnFrameDataReady() { return FrameDataReady; }
+
 #if WITH_EDITOR
+    // Creates missing assets, updates ones whose size or format changed and saves them all in one concurrent save
     UFUNCTION(CallInEditor, Category = "Editor Tools")
     void CreatePersistentCameraRenderTargets();
 
     UFUNCTION(CallInEditor, Category = "Editor Tools")
     void ConfigureAllSceneCaptureSettings();
 
+    // Deletes every RT_*_Camera_* asset under /Game/RenderTargets
+    UFUNCTION(CallInEditor, Category = "Editor Tools")
+    void DeletePersistentCameraRenderTargets();
+
+    UFUNCTION(CallInEditor, Category = "Editor Tools")
+    void RegeneratePersistentCameraRenderTargets();
+
 private:
+    static constexpr const TCHAR* RenderTargetAssetFolder = TEXT("/Game/RenderTargets");
+
+    struct FRenderTargetAssetBatch
+    {
+        TArray<TPair<UPackage*, UObject*>> PackagesToSave;
+        int32 NumCreated = 0;
+        int32 NumUpdated = 0;
+        int32 NumUnchanged = 0;
+    };
+
     UTextureRenderTarget2D* CreateRenderTargetAsset(const FString& AssetName, ETextureRenderTargetFormat Format);
+    void SaveRenderTargetAssetBatch();
     void CreateMLDepthCaptureForCamera(AActor* Camera, int32 CameraIndex); // NEW
+    void CreateSegmentationCaptureForCamera(AActor* Camera, int32 CameraIndex);
+
+    FRenderTargetAssetBatch AssetBatch;
 #endif
 
 private:
     void UpdateRenderTargets();
+    void RunCaptureScheduler(float DeltaSeconds);
+    void IssueCaptures(const TArray<int32>& BindingIndices);
+    void ReportSkippedCapture(int32 BindingIndex, const FMLCaptureBinding& Binding);
+    void SubmitReusedFrame(const FMLCaptureBinding& Binding, int64 ReusedFrameIndex);
+    bool SkipIndexedCapture(const FMLCaptureBinding& Binding);
+    void UpdateCaptureResolutions();
+    bool ResizeCapture(int32 BindingIndex, int32 Tier);
+    FIntPoint GetTierSize(int32 Tier) const;
+    FIntPoint GetBudgetedSize() const { return RenderTargetBudget::ScaleSize(FIntPoint(RenderTargetWidth, RenderTargetHeight), BudgetPlan.ResolutionScale); }
+    int64 GetRenderTargetBudgetBytes() const { return static_cast<int64>(RenderTargetBudgetMB) * 1024 * 1024; }
+    int32 GetStagingCopies() const { return Readback ? Readback->GetFramesInFlight() : 0; }
+    void PlanRenderTargetBudget(const TArray<AActor*>& Cameras);
+    void CollectTargetDemand(AActor* Camera, TArray<RenderTargetBudget::FTargetDemand>& OutTargets) const;
+    // Target plus its staging copies
+    int64 ComputeBudgetedBytes(int32 Width, int32 Height, ETextureRenderTargetFormat Format) const;
+    UTextureRenderTarget2D* AcquireBudgetedTarget(int32 Width, int32 Height, ETextureRenderTargetFormat Format, int64 FreedBytes = 0);
+    void BeginOfflineCapture();
+    void EndOfflineCapture();
+    void RunOfflineCapture();
+    void CompleteOfflineCapture();
+    bool UsesExplicitCaptures() const { return bUseCaptureScheduler || bOfflineCapture; }
+    bool NeedsReadback() const { return bEnableReadback || bWriteDataset || bStreamFrames || bExportPointClouds || (bCreateSegmentationBuffer && bLabelSegmentation); }
+    // CPU quantization needs read-back depth; without readback MLDepth stays on the GPU capture
+    bool UsesCpuMLDepth() const { return bCreateMLDepthBuffer && bQuantizeDepthOnCPU && NeedsReadback(); }
+    bool UsesGpuMLDepth() const { return bCreateMLDepthBuffer && !UsesCpuMLDepth(); }
+    // SceneDepth captured only as the source of CPU-quantized MLDepth
+    bool IsInternalDepth(EMLBufferType BufferType) const { return BufferType == EMLBufferType::SceneDepth && !bCreateDepthBuffer; }
+
+    // Shard of the spawner that owns our cameras, else the process assignment
+    FMLShardAssignment ResolveShard() const;
+
+    bool ShouldCaptureEveryFrame() const { return bForceFrameUpdates && !UsesExplicitCaptures() && !bUseAtlasCapture; }
     void SetupSceneCaptureComponent(USceneCaptureComponent2D* SceneCapture, ESceneCaptureSource CaptureSource);
+    void ConfigureCapture(USceneCaptureComponent2D* SceneCap);
+    void ApplyCaptureProfile(USceneCaptureComponent2D* SceneCap);
+    void ApplySegmentationMaterial(USceneCaptureComponent2D* SceneCap);
+
+    void BindCamera(AActor* Camera, int32 CameraIndex);
+    void RequestDetection();
+    void HandleCamerasChanged(UClass* CameraClass, AActor* Camera, bool bAdded);
+    void HandleSpawnsComplete();
+    void BindPendingCameras();
+
+    USceneCaptureComponent2D* CreateRuntimeCapture(AActor* Camera, int32 CameraIndex, EMLBufferType BufferType, USceneCaptureComponent2D* ViewSource);
+    void AddCaptureBinding(AActor* Camera, int32 CameraIndex, EMLBufferType BufferType, USceneCaptureComponent2D* SceneCapture, UTextureRenderTarget2D* RenderTarget);
+    void ResetCaptureBindings();
+    void InitializeReadback();
+    void QueueReadback(const FMLCaptureBinding& Binding);
+    void QueueReadbackForCapture(const USceneCaptureComponent2D* SceneCapture);
+    void HandleFrameReadback(const FMLCapturedFramePtr& Frame);
+    void DispatchFrame(const FMLCapturedFramePtr& Frame);
+    void QuantizeDepthFrame(const FMLCapturedFramePtr& DepthFrame);
+    void DispatchQuantizedDepth(bool bWait);
+    void HandleFrameEncoded(const FMLCapturedFramePtr& Frame);
+    void HandleLabelsReady(const FMLCapturedFramePtr& Frame);
+    void BuildCaptureAtlas();
+    void PublishFrameCounters();
+    void ReportShardProgress(bool bDone);
 };
@@ -0,0 +1,158 @@
+#include "RenderTargetPool.h"
+#include "RenderTargetBudget.h"
+#include "TextureResource.h"
+
+int64 FRenderTargetPool::ComputeTargetBytes(int32 Width, int32 Height, ETextureRenderTargetFormat Format)
+{
+    return RenderTargetBudget::ComputeTargetBytes(Width, Height, Format);
+}
+
+UTextureRenderTarget2D* FRenderTargetPool::Acquire(UObject* Outer, int32 Width, int32 Height, ETextureRenderTargetFormat Format)
+{
+    const FIntVector Key = MakeKey(Width, Height, Format);
+
+    if (TArray<FPooledTarget>* Bucket = FreeTargets.Find(Key))
+    {
+        while (Bucket->Num() > 0)
+        {
+            FPooledTarget Pooled = Bucket->Pop(EAllowShrinking::No);
+            Stats.PooledBytes -= Pooled.Bytes;
+            --Stats.NumPooled;
+
+            if (!IsValid(Pooled.RenderTarget))
+                continue;
+
+            ++Stats.Hits;
+            ++Stats.NumInUse;
+            Stats.InUseBytes += Pooled.Bytes;
+            UTextureRenderTarget2D* RenderTarget = Pooled.RenderTarget;
+            InUse.Add(RenderTarget, Pooled);
+            return RenderTarget;
+        }
+    }
+
+    UTextureRenderTarget2D* RenderTarget = NewObject<UTextureRenderTarget2D>(Outer);
+    if (!IsValid(RenderTarget))
+        return nullptr;
+
+    RenderTarget->RenderTargetFormat = Format;
+    RenderTarget->ClearColor = FLinearColor::Black;
+    RenderTarget->InitAutoFormat(Width, Height);
+
+    FPooledTarget Pooled;
+    Pooled.RenderTarget = RenderTarget;
+    Pooled.Key = Key;
+    Pooled.Bytes = ComputeTargetBytes(Width, Height, Format);
+
+    ++Stats.Misses;
+    ++Stats.NumInUse;
+    Stats.InUseBytes += Pooled.Bytes;
+    InUse.Add(RenderTarget, Pooled);
+    return RenderTarget;
+}
+
+void FRenderTargetPool::Release(UTextureRenderTarget2D* RenderTarget)
+{
+    FPooledTarget Pooled;
+    if (!RenderTarget || !InUse.RemoveAndCopyValue(RenderTarget, Pooled))
+        return;
+
+    --Stats.NumInUse;
+    Stats.InUseBytes -= Pooled.Bytes;
+
+    Pooled.ReleaseSerial = NextReleaseSerial++;
+    FreeTargets.FindOrAdd(Pooled.Key).Add(Pooled);
+    ++Stats.NumPooled;
+    Stats.PooledBytes += Pooled.Bytes;
+
+    EvictToBudget();
+}
+
+void FRenderTargetPool::Prewarm(UObject* Outer, int32 Width, int32 Height, ETextureRenderTargetFormat Format, int32 Count)
+{
+    const FIntVector Key = MakeKey(Width, Height, Format);
+    const int64 Bytes = ComputeTargetBytes(Width, Height, Format);
+    TArray<FPooledTarget>& Bucket = FreeTargets.FindOrAdd(Key);
+
+    while (Bucket.Num() < Count && Stats.PooledBytes + Bytes <= MaxPooledBytes)
+    {
+        UTextureRenderTarget2D* RenderTarget = NewObject<UTextureRenderTarget2D>(Outer);
+        if (!IsValid(RenderTarget))
+            return;
+
+        RenderTarget->RenderTargetFormat = Format;
+        RenderTarget->ClearColor = FLinearColor::Black;
+        RenderTarget->InitAutoFormat(Width, Height);
+
+        FPooledTarget Pooled;
+        Pooled.RenderTarget = RenderTarget;
+        Pooled.Key = Key;
+        Pooled.Bytes = Bytes;
+        Pooled.ReleaseSerial = NextReleaseSerial++;
+        Bucket.Add(Pooled);
+
+        ++Stats.NumPooled;
+        Stats.PooledBytes += Bytes;
+    }
+}
+
+void FRenderTargetPool::Trim()
+{
+    Stats.Evictions += Stats.NumPooled;
+    FreeTargets.Empty();
+    Stats.NumPooled = 0;
+    Stats.PooledBytes = 0;
+}
+
+void FRenderTargetPool::SetMaxPooledBytes(int64 InMaxPooledBytes)
+{
+    MaxPooledBytes = FMath::Max<int64>(0, InMaxPooledBytes);
+    EvictToBudget();
+}
+
+void FRenderTargetPool::EvictToBudget()
+{
+    while (Stats.PooledBytes > MaxPooledBytes)
+    {
+        // Least recently released first; the pool is small so a linear scan is fine
+        TArray<FPooledTarget>* OldestBucket = nullptr;
+        int32 OldestIndex = INDEX_NONE;
+        uint64 OldestSerial = MAX_uint64;
+        for (TPair<FIntVector, TArray<FPooledTarget>>& Pair : FreeTargets)
+        {
+            for (int32 i = 0; i < Pair.Value.Num(); ++i)
+            {
+                if (Pair.Value[i].ReleaseSerial < OldestSerial)
+                {
+                    OldestSerial = Pair.Value[i].ReleaseSerial;
+                    OldestBucket = &Pair.Value;
+                    OldestIndex = i;
+                }
+            }
+        }
+
+        if (!OldestBucket)
+            break;
+
+        // Dropping our reference hands the target to GC
+        Stats.PooledBytes -= (*OldestBucket)[OldestIndex].Bytes;
+        --Stats.NumPooled;
+        ++Stats.Evictions;
+        OldestBucket->RemoveAtSwap(OldestIndex, EAllowShrinking::No);
+    }
+}
+
+void FRenderTargetPool::AddReferencedObjects(FReferenceCollector& Collector)
+{
+    for (TPair<FIntVector, TArray<FPooledTarget>>& Pair : FreeTargets)
+    {
+        for (FPooledTarget& Pooled : Pair.Value)
+        {
+            Collector.AddReferencedObject(Pooled.RenderTarget);
+        }
+    }
+    for (TPair<UTextureRenderTarget2D*, FPooledTarget>& Pair : InUse)
+    {
+        Collector.AddReferencedObject(Pair.Value.RenderTarget);
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/GCObject.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "RenderTargetPool.generated.h"
+
+USTRUCT(BlueprintType)
+struct CAMERATESTER_API FMLRenderTargetPoolStats
+{
+    GENERATED_BODY()
+
+    UPROPERTY(BlueprintReadOnly, Category = "Pool")
+    int64 Hits = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Pool")
+    int64 Misses = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Pool")
+    int64 Evictions = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Pool")
+    int32 NumInUse = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Pool")
+    int32 NumPooled = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Pool")
+    int64 InUseBytes = 0;
+
+    // Bytes held by released targets waiting to be reused
+    UPROPERTY(BlueprintReadOnly, Category = "Pool")
+    int64 PooledBytes = 0;
+};
+
+// Render targets keyed by width, height and format. Released targets are kept for reuse until the idle
+// pool exceeds MaxPooledBytes, at which point the least recently released ones are evicted.
+class CAMERATESTER_API FRenderTargetPool : public FGCObject
+{
+public:
+    UTextureRenderTarget2D* Acquire(UObject* Outer, int32 Width, int32 Height, ETextureRenderTargetFormat Format);
+
+    // Safe to call with targets the pool doesn't own; those are ignored
+    void Release(UTextureRenderTarget2D* RenderTarget);
+
+    // Make sure at least Count idle targets of this size wait in the pool; still bounded by MaxPooledBytes
+    void Prewarm(UObject* Outer, int32 Width, int32 Height, ETextureRenderTargetFormat Format, int32 Count);
+
+    // Drop every idle target
+    void Trim();
+
+    void SetMaxPooledBytes(int64 InMaxPooledBytes);
+    int64 GetMaxPooledBytes() const { return MaxPooledBytes; }
+
+    bool Owns(const UTextureRenderTarget2D* RenderTarget) const { return InUse.Contains(const_cast<UTextureRenderTarget2D*>(RenderTarget)); }
+
+    const FMLRenderTargetPoolStats& GetStats() const { return Stats; }
+
+    static int64 ComputeTargetBytes(int32 Width, int32 Height, ETextureRenderTargetFormat Format);
+
+    // FGCObject
+    virtual void AddReferencedObjects(FReferenceCollector& Collector) override;
+    virtual FString GetReferencerName() const override { return TEXT("FRenderTargetPool"); }
+
+private:
+    struct FPooledTarget
+    {
+        TObjectPtr<UTextureRenderTarget2D> RenderTarget = nullptr;
+        FIntVector Key = FIntVector::ZeroValue;
+        int64 Bytes = 0;
+        uint64 ReleaseSerial = 0;
+    };
+
+    static FIntVector MakeKey(int32 Width, int32 Height, ETextureRenderTargetFormat Format)
+    {
+        return FIntVector(Width, Height, static_cast<int32>(Format));
+    }
+
+    void EvictToBudget();
+
+    TMap<FIntVector, TArray<FPooledTarget>> FreeTargets;
+    TMap<UTextureRenderTarget2D*, FPooledTarget> InUse;
+
+    int64 MaxPooledBytes = 256ll * 1024 * 1024;
+    uint64 NextReleaseSerial = 0;
+    FMLRenderTargetPoolStats Stats;
+};
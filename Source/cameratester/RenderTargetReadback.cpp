@@ -0,0 +1,249 @@
+#include "RenderTargetReadback.h"
+#include "MLCaptureStats.h"
+#include "RenderTargetBudget.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "RHIGPUReadback.h"
+#include "RenderingThread.h"
+#include "TextureResource.h"
+
+FRenderTargetReadback::FRenderTargetReadback(int32 InFramesInFlight)
+    : FramesInFlight(FMath::Clamp(InFramesInFlight, 1, 16))
+    , Shared(MakeShared<FSharedState, ESPMode::ThreadSafe>())
+{
+}
+
+FRenderTargetReadback::~FRenderTargetReadback()
+{
+    Reset();
+}
+
+bool FRenderTargetReadback::EnqueueReadback(int32 CameraIndex, EMLBufferType BufferType, int64 FrameIndex, UTextureRenderTarget2D* RenderTarget, const FTransform& CameraPose,
+    float FOVAngle, const FIntRect& SourceRect)
+{
+    ML_CAPTURE_SCOPE(STAT_MLCapture_ReadbackEnqueue);
+
+    if (!IsValid(RenderTarget))
+        return false;
+
+    FTextureRenderTargetResource* Resource = RenderTarget->GameThread_GetRenderTargetResource();
+    if (!Resource)
+        return false;
+
+    const uint32 Key = MLCapture::MakeCaptureKey(CameraIndex, BufferType);
+    FCaptureRingRef* FoundRing = Rings.Find(Key);
+    if (!FoundRing)
+    {
+        FCaptureRingRef NewRing = MakeShared<FCaptureRing, ESPMode::ThreadSafe>();
+        for (int32 i = 0; i < FramesInFlight; ++i)
+        {
+            TUniquePtr<FSlot> Slot = MakeUnique<FSlot>();
+            Slot->Readback = MakeUnique<FRHIGPUTextureReadback>(
+                *FString::Printf(TEXT("MLReadback_Cam%d_%s_%d"), CameraIndex, MLCapture::GetBufferTypeName(BufferType), i));
+            NewRing->Slots.Add(MoveTemp(Slot));
+        }
+        FoundRing = &Rings.Add(Key, NewRing);
+    }
+
+    FSlot* Slot = AcquireFreeSlot(FoundRing->Get());
+    if (!Slot && bBlockWhenFull)
+    {
+        Slot = WaitForFreeSlot(*FoundRing);
+    }
+
+    if (!Slot)
+    {
+        // Every frame of this capture is still in flight; skip rather than stall
+        ++NumDropped;
+        return false;
+    }
+
+    FMLCapturedFramePtr Frame = MakeShared<FMLCapturedFrame, ESPMode::ThreadSafe>();
+    Frame->FrameIndex = FrameIndex;
+    Frame->CameraIndex = CameraIndex;
+    Frame->BufferType = BufferType;
+    const FIntRect CopyRect = SourceRect.IsEmpty() ? FIntRect(0, 0, RenderTarget->SizeX, RenderTarget->SizeY) : SourceRect;
+    Frame->Width = CopyRect.Width();
+    Frame->Height = CopyRect.Height();
+    Frame->PixelFormat = RenderTarget->GetFormat();
+    Frame->BytesPerPixel = GPixelFormats[Frame->PixelFormat].BlockBytes;
+    Frame->CameraPose = CameraPose;
+    Frame->FOVAngle = FOVAngle;
+
+    // The readback (re)allocates its staging texture to match the copied rectangle
+    const int64 SlotStagingBytes = RenderTargetBudget::ComputeTextureBytes(Frame->Width, Frame->Height, Frame->PixelFormat, true);
+    StagingBytes += SlotStagingBytes - Slot->StagingBytes;
+    Slot->StagingBytes = SlotStagingBytes;
+
+    Slot->Frame = Frame;
+    Slot->State.store(ESlotState::Pending);
+    Shared->NumPending.fetch_add(1);
+
+    FCaptureRingRef RingRef = *FoundRing;
+    FSharedStateRef SharedRef = Shared;
+    ENQUEUE_RENDER_COMMAND(MLEnqueueReadback)(
+        [RingRef, SharedRef, Slot, Resource, CopyRect](FRHICommandListImmediate& RHICmdList)
+        {
+            FRHITexture* Texture = Resource->GetRenderTargetTexture();
+            if (Texture)
+            {
+                RHICmdList.Transition(FRHITransitionInfo(Texture, ERHIAccess::Unknown, ERHIAccess::CopySrc));
+                Slot->Readback->EnqueueCopy(RHICmdList, Texture, FIntVector(CopyRect.Min.X, CopyRect.Min.Y, 0), 0, FIntVector(CopyRect.Width(), CopyRect.Height(), 1));
+                RHICmdList.Transition(FRHITransitionInfo(Texture, ERHIAccess::CopySrc, ERHIAccess::SRVMask));
+            }
+            else
+            {
+                Slot->Frame.Reset();
+                Slot->State.store(ESlotState::Free);
+                SharedRef->NumPending.fetch_sub(1);
+            }
+        });
+
+    return true;
+}
+
+FRenderTargetReadback::FSlot* FRenderTargetReadback::AcquireFreeSlot(FCaptureRing& Ring)
+{
+    for (int32 Attempt = 0; Attempt < Ring.Slots.Num(); ++Attempt)
+    {
+        const int32 SlotIndex = (Ring.NextSlot + Attempt) % Ring.Slots.Num();
+        if (Ring.Slots[SlotIndex]->State.load() == ESlotState::Free)
+        {
+            Ring.NextSlot = (SlotIndex + 1) % Ring.Slots.Num();
+            return Ring.Slots[SlotIndex].Get();
+        }
+    }
+    return nullptr;
+}
+
+FRenderTargetReadback::FSlot* FRenderTargetReadback::WaitForFreeSlot(const FCaptureRingRef& Ring)
+{
+    // Completed frames land in the shared queue and are broadcast from the next Tick(), as usual
+    const double Deadline = FPlatformTime::Seconds() + 5.0;
+    while (FPlatformTime::Seconds() < Deadline)
+    {
+        FSharedStateRef SharedRef = Shared;
+        ENQUEUE_RENDER_COMMAND(MLPollFullRing)(
+            [Ring, SharedRef](FRHICommandListImmediate& RHICmdList)
+            {
+                PollRings_RenderThread({ Ring }, SharedRef);
+            });
+        FlushRenderingCommands();
+
+        if (FSlot* Slot = AcquireFreeSlot(Ring.Get()))
+            return Slot;
+
+        FPlatformProcess::SleepNoStats(0.0005f);
+    }
+    return nullptr;
+}
+
+void FRenderTargetReadback::PollRings_RenderThread(const TArray<FCaptureRingRef>& InRings, const FSharedStateRef& InShared)
+{
+    ML_CAPTURE_SCOPE(STAT_MLCapture_ReadbackPoll);
+
+    for (const FCaptureRingRef& Ring : InRings)
+    {
+        for (const TUniquePtr<FSlot>& Slot : Ring->Slots)
+        {
+            if (Slot->State.load() != ESlotState::Pending || !Slot->Readback->IsReady())
+                continue;
+
+            FMLCapturedFramePtr Frame = MoveTemp(Slot->Frame);
+
+            int32 RowPitchInPixels = 0;
+            int32 BufferHeight = 0;
+            const uint8* Src = static_cast<const uint8*>(Slot->Readback->Lock(RowPitchInPixels, &BufferHeight));
+            if (Src && Frame.IsValid())
+            {
+                const int32 RowBytes = Frame->Width * Frame->BytesPerPixel;
+                const int32 SrcPitch = RowPitchInPixels * Frame->BytesPerPixel;
+                const int32 Rows = FMath::Min(Frame->Height, BufferHeight > 0 ? BufferHeight : Frame->Height);
+
+                Frame->Pixels.SetNumUninitialized(RowBytes * Frame->Height);
+                if (SrcPitch == RowBytes)
+                {
+                    FMemory::Memcpy(Frame->Pixels.GetData(), Src, RowBytes * Rows);
+                }
+                else
+                {
+                    for (int32 Y = 0; Y < Rows; ++Y)
+                    {
+                        FMemory::Memcpy(Frame->Pixels.GetData() + Y * RowBytes, Src + Y * SrcPitch, RowBytes);
+                    }
+                }
+            }
+            Slot->Readback->Unlock();
+
+            Slot->State.store(ESlotState::Free);
+            InShared->NumPending.fetch_sub(1);
+
+            if (Src && Frame.IsValid())
+            {
+                InShared->Completed.Enqueue(Frame);
+            }
+        }
+    }
+}
+
+void FRenderTargetReadback::Tick()
+{
+    BroadcastCompleted();
+
+    if (Shared->NumPending.load() == 0)
+        return;
+
+    TArray<FCaptureRingRef> RingSnapshot;
+    Rings.GenerateValueArray(RingSnapshot);
+
+    FSharedStateRef SharedRef = Shared;
+    ENQUEUE_RENDER_COMMAND(MLPollReadbacks)(
+        [RingSnapshot = MoveTemp(RingSnapshot), SharedRef](FRHICommandListImmediate& RHICmdList)
+        {
+            PollRings_RenderThread(RingSnapshot, SharedRef);
+        });
+}
+
+void FRenderTargetReadback::Flush()
+{
+    // Bounded so a lost device can't hang the game thread forever
+    const double Deadline = FPlatformTime::Seconds() + 5.0;
+    while (Shared->NumPending.load() > 0 && FPlatformTime::Seconds() < Deadline)
+    {
+        Tick();
+        FlushRenderingCommands();
+        FPlatformProcess::SleepNoStats(0.001f);
+    }
+
+    BroadcastCompleted();
+}
+
+void FRenderTargetReadback::Reset()
+{
+    if (Rings.Num() > 0)
+    {
+        // Release the readback objects on the render thread, after any command still using them
+        TArray<FCaptureRingRef> RingsToRelease;
+        Rings.GenerateValueArray(RingsToRelease);
+        Rings.Empty();
+
+        ENQUEUE_RENDER_COMMAND(MLReleaseReadbacks)(
+            [RingsToRelease = MoveTemp(RingsToRelease)](FRHICommandListImmediate& RHICmdList) mutable
+            {
+                RingsToRelease.Empty();
+            });
+    }
+
+    Shared = MakeShared<FSharedState, ESPMode::ThreadSafe>();
+    StagingBytes = 0;
+}
+
+void FRenderTargetReadback::BroadcastCompleted()
+{
+    ML_CAPTURE_SCOPE(STAT_MLCapture_ReadbackBroadcast);
+
+    FMLCapturedFramePtr Frame;
+    while (Shared->Completed.Dequeue(Frame))
+    {
+        FrameReadyDelegate.Broadcast(Frame);
+    }
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+#include "MLCaptureTypes.h"
+#include <atomic>
+
+class FRHIGPUTextureReadback;
+class UTextureRenderTarget2D;
+
+// Asynchronous GPU -> CPU readback with a fixed number of frames in flight per capture.
+// Copies are queued on the render thread and polled without ever blocking on the GPU;
+// finished frames are broadcast on the game thread from Tick().
+class CAMERATESTER_API FRenderTargetReadback
+{
+public:
+    explicit FRenderTargetReadback(int32 InFramesInFlight = 3);
+    ~FRenderTargetReadback();
+
+    // Queue a copy of the target's current contents, or of SourceRect within it when that is not empty; the frame
+    // is SourceRect's size. Returns false if all slots of this capture are still in flight.
+    bool EnqueueReadback(int32 CameraIndex, EMLBufferType BufferType, int64 FrameIndex, UTextureRenderTarget2D* RenderTarget, const FTransform& CameraPose,
+        float FOVAngle = 90.0f, const FIntRect& SourceRect = FIntRect());
+
+    // Poll in-flight copies on the render thread and broadcast frames that landed since the last call
+    void Tick();
+
+    // Block until every queued readback has completed and been broadcast
+    void Flush();
+
+    // Drop all rings; in-flight copies are discarded
+    void Reset();
+
+    FOnMLFrameDataReady& OnFrameReady() { return FrameReadyDelegate; }
+
+    int32 GetFramesInFlight() const { return FramesInFlight; }
+    int32 GetNumPending() const { return Shared->NumPending.load(); }
+    int64 GetNumDropped() const { return NumDropped; }
+
+    // CPU-readable staging memory allocated by the rings so far
+    int64 GetStagingBytes() const { return StagingBytes; }
+
+    // Wait for the GPU instead of dropping when a capture's ring is full; used for deterministic offline runs
+    void SetBlockWhenFull(bool bInBlockWhenFull) { bBlockWhenFull = bInBlockWhenFull; }
+
+private:
+    enum class ESlotState : uint8
+    {
+        Free,
+        Pending
+    };
+
+    struct FSlot
+    {
+        TUniquePtr<FRHIGPUTextureReadback> Readback;
+        std::atomic<ESlotState> State { ESlotState::Free };
+        FMLCapturedFramePtr Frame;
+        // Game thread only; size of the staging copy the last enqueue needed
+        int64 StagingBytes = 0;
+    };
+
+    struct FCaptureRing
+    {
+        TArray<TUniquePtr<FSlot>> Slots;
+        int32 NextSlot = 0;
+    };
+
+    // State touched by render commands; shared so queued commands never outlive it
+    struct FSharedState
+    {
+        TQueue<FMLCapturedFramePtr, EQueueMode::Mpsc> Completed;
+        std::atomic<int32> NumPending { 0 };
+    };
+
+    using FCaptureRingRef = TSharedRef<FCaptureRing, ESPMode::ThreadSafe>;
+    using FSharedStateRef = TSharedRef<FSharedState, ESPMode::ThreadSafe>;
+
+    // Render thread: lock ready slots, copy rows out and hand frames to the game thread
+    static void PollRings_RenderThread(const TArray<FCaptureRingRef>& InRings, const FSharedStateRef& InShared);
+
+    static FSlot* AcquireFreeSlot(FCaptureRing& Ring);
+    FSlot* WaitForFreeSlot(const FCaptureRingRef& Ring);
+    void BroadcastCompleted();
+
+    int32 FramesInFlight;
+    bool bBlockWhenFull = false;
+    TMap<uint32, FCaptureRingRef> Rings;
+    FSharedStateRef Shared;
+
+    int64 NumDropped = 0;
+    int64 StagingBytes = 0;
+    FOnMLFrameDataReady FrameReadyDelegate;
+};
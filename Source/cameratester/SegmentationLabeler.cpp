@@ -0,0 +1,669 @@
+#include "SegmentationLabeler.h"
+#include "MLCaptureStats.h"
+#include "Async/ParallelFor.h"
+#include "Components/PrimitiveComponent.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+
+namespace SegmentationLabeling
+{
+namespace
+{
+    constexpr int32 NumIds = MaxInstanceId + 1;
+
+    // Closer box corners count as behind the camera
+    constexpr float MinCornerDepth = 1.0f;
+
+    // Rows per band at 16 KB of stencil, matching the other kernels' task size
+    int32 GetRowsPerBand(int32 Width)
+    {
+        return FMath::Max(1, 16384 / FMath::Max(Width, 1));
+    }
+
+    struct FIdStats
+    {
+        uint32 Count = 0;
+        int32 MinX = MAX_int32;
+        int32 MinY = MAX_int32;
+        int32 MaxX = -1;
+        int32 MaxY = -1;
+    };
+
+    // Horizontal span of one ID on one row, [X0, X1)
+    struct FRun
+    {
+        int32 X0;
+        int32 X1;
+        int32 Id;
+    };
+
+    // A band of rows scanned by one task. Runs are stored row by row; RowStart[i] is the first run of row FirstRow + i.
+    struct FBand
+    {
+        int32 FirstRow = 0;
+        int32 EndRow = 0;
+        FIdStats Stats[NumIds];
+        TArray<FRun> Runs;
+        TArray<int32> RowStart;
+    };
+
+    int32 FindRoot(TArray<int32>& Parent, int32 Index)
+    {
+        while (Parent[Index] != Index)
+        {
+            Parent[Index] = Parent[Parent[Index]];
+            Index = Parent[Index];
+        }
+        return Index;
+    }
+
+    void Union(TArray<int32>& Parent, int32 A, int32 B)
+    {
+        A = FindRoot(Parent, A);
+        B = FindRoot(Parent, B);
+        if (A != B)
+        {
+            Parent[FMath::Max(A, B)] = FMath::Min(A, B);
+        }
+    }
+
+    // Joins runs of the same ID on adjacent rows whose spans overlap (4-connectivity). Both rows are sorted by X.
+    void LinkRows(const FRun* Upper, int32 NumUpper, int32 UpperBase, const FRun* Lower, int32 NumLower, int32 LowerBase, TArray<int32>& Parent)
+    {
+        int32 i = 0;
+        int32 j = 0;
+        while (i < NumUpper && j < NumLower)
+        {
+            const FRun& A = Upper[i];
+            const FRun& B = Lower[j];
+            if (A.Id == B.Id && A.X1 > B.X0 && B.X1 > A.X0)
+            {
+                Union(Parent, UpperBase + i, LowerBase + j);
+            }
+            if (A.X1 < B.X1)
+            {
+                ++i;
+            }
+            else
+            {
+                ++j;
+            }
+        }
+    }
+
+    // Run-length encodes the band's rows and folds each run into its ID's stats, so the per-pixel work is one compare
+    void ScanBand(const uint8* Ids, int32 Width, FBand& Band)
+    {
+        Band.RowStart.Reset(Band.EndRow - Band.FirstRow + 1);
+        for (int32 Y = Band.FirstRow; Y < Band.EndRow; ++Y)
+        {
+            Band.RowStart.Add(Band.Runs.Num());
+            const uint8* Row = Ids + static_cast<int64>(Y) * Width;
+
+            int32 X = 0;
+            while (X < Width)
+            {
+                const uint8 Id = Row[X];
+                int32 End = X + 1;
+
+                // Skip eight equal IDs at a time; background and large instances are long runs
+                const uint64 Pattern = static_cast<uint64>(Id) * 0x0101010101010101ull;
+                while (End + 8 <= Width && FPlatformMemory::ReadUnaligned<uint64>(Row + End) == Pattern)
+                {
+                    End += 8;
+                }
+                while (End < Width && Row[End] == Id)
+                {
+                    ++End;
+                }
+
+                if (Id != 0)
+                {
+                    Band.Runs.Add({ X, End, Id });
+                    FIdStats& Stats = Band.Stats[Id];
+                    Stats.Count += End - X;
+                    Stats.MinX = FMath::Min(Stats.MinX, X);
+                    Stats.MaxX = FMath::Max(Stats.MaxX, End - 1);
+                    Stats.MinY = FMath::Min(Stats.MinY, Y);
+                    Stats.MaxY = Y;
+                }
+                X = End;
+            }
+        }
+        Band.RowStart.Add(Band.Runs.Num());
+    }
+
+    int32 GetStencilChannel(EPixelFormat PixelFormat)
+    {
+        // BGRA keeps red in the third byte
+        return PixelFormat == PF_B8G8R8A8 ? 2 : 0;
+    }
+
+    struct FProjection
+    {
+        FTransform Pose;
+        float HalfWidth = 0.0f;
+        float HalfHeight = 0.0f;
+        float Focal = 0.0f;
+
+        FProjection(const FMLCapturedFrame& Frame)
+            : Pose(Frame.CameraPose)
+            , HalfWidth(Frame.Width * 0.5f)
+            , HalfHeight(Frame.Height * 0.5f)
+            , Focal(HalfWidth / FMath::Tan(FMath::DegreesToRadians(FMath::Clamp(Frame.FOVAngle, 1.0f, 179.0f)) * 0.5f))
+        {
+        }
+
+        // View space is X forward, Y right, Z up; returns planar depth
+        float Project(const FVector& World, float& OutX, float& OutY) const
+        {
+            const FVector View = Pose.InverseTransformPositionNoScale(World);
+            const float Depth = FMath::Max(static_cast<float>(View.X), MinCornerDepth);
+            OutX = HalfWidth + static_cast<float>(View.Y) * Focal / Depth;
+            OutY = HalfHeight - static_cast<float>(View.Z) * Focal / Depth;
+            return static_cast<float>(View.X);
+        }
+    };
+
+    // Fills the 3D box fields; returns the nearest corner's depth and the box's on-screen rect for the occlusion test
+    float ProjectBox(const FInstanceBox& Box, const FProjection& Projection, int32 Width, int32 Height, FMLInstanceLabel& Label, FIntRect& OutRect)
+    {
+        Label.Flags |= EMLInstanceLabelFlags::Box3D;
+        Label.Center[0] = static_cast<float>(Box.Center.X);
+        Label.Center[1] = static_cast<float>(Box.Center.Y);
+        Label.Center[2] = static_cast<float>(Box.Center.Z);
+        Label.Extent[0] = Box.Extent.X;
+        Label.Extent[1] = Box.Extent.Y;
+        Label.Extent[2] = Box.Extent.Z;
+        Label.Rotation[0] = Box.Rotation.X;
+        Label.Rotation[1] = Box.Rotation.Y;
+        Label.Rotation[2] = Box.Rotation.Z;
+        Label.Rotation[3] = Box.Rotation.W;
+
+        const FQuat Rotation(Box.Rotation);
+        float NearestDepth = MAX_flt;
+        float MinX = MAX_flt, MinY = MAX_flt, MaxX = -MAX_flt, MaxY = -MAX_flt;
+        for (int32 Corner = 0; Corner < 8; ++Corner)
+        {
+            const FVector Local(
+                (Corner & 1) ? Box.Extent.X : -Box.Extent.X,
+                (Corner & 2) ? Box.Extent.Y : -Box.Extent.Y,
+                (Corner & 4) ? Box.Extent.Z : -Box.Extent.Z);
+
+            float X, Y;
+            const float Depth = Projection.Project(Box.Center + Rotation.RotateVector(Local), X, Y);
+            Label.Corners[Corner * 2] = X;
+            Label.Corners[Corner * 2 + 1] = Y;
+
+            if (Depth < MinCornerDepth)
+            {
+                Label.Flags |= EMLInstanceLabelFlags::BehindCamera;
+                continue;
+            }
+            NearestDepth = FMath::Min(NearestDepth, Depth);
+            MinX = FMath::Min(MinX, X);
+            MinY = FMath::Min(MinY, Y);
+            MaxX = FMath::Max(MaxX, X);
+            MaxY = FMath::Max(MaxY, Y);
+        }
+
+        if (NearestDepth == MAX_flt)
+        {
+            OutRect = FIntRect();
+            return 0.0f;
+        }
+
+        // Share of the projected box's rect that falls outside the image
+        const float Area = FMath::Max((MaxX - MinX) * (MaxY - MinY), 1.0f);
+        const float VisibleWidth = FMath::Max(FMath::Min(MaxX, static_cast<float>(Width)) - FMath::Max(MinX, 0.0f), 0.0f);
+        const float VisibleHeight = FMath::Max(FMath::Min(MaxY, static_cast<float>(Height)) - FMath::Max(MinY, 0.0f), 0.0f);
+        Label.Truncation = FMath::Clamp(1.0f - VisibleWidth * VisibleHeight / Area, 0.0f, 1.0f);
+
+        OutRect = FIntRect(
+            FMath::Clamp(FMath::FloorToInt(MinX), 0, Width), FMath::Clamp(FMath::FloorToInt(MinY), 0, Height),
+            FMath::Clamp(FMath::CeilToInt(MaxX), 0, Width), FMath::Clamp(FMath::CeilToInt(MaxY), 0, Height));
+        return NearestDepth;
+    }
+
+    // Pixels inside the box's rect that belong to something else and lie in front of the whole box hide part of it.
+    // Counted against the visible pixels this estimates the hidden share without rendering the instance on its own.
+    float MeasureOcclusion(const uint8* Ids, int32 Width, int32 Height, const FMLCapturedFrame& Depth, uint8 Id,
+        const FIntRect& Rect, float NearestDepth, uint32 VisiblePixels)
+    {
+        const float* DepthPixels = reinterpret_cast<const float*>(Depth.Pixels.GetData());
+        uint32 Occluders = 0;
+        for (int32 Y = Rect.Min.Y; Y < Rect.Max.Y; ++Y)
+        {
+            const uint8* Row = Ids + static_cast<int64>(Y) * Width;
+            const float* DepthRow = DepthPixels + static_cast<int64>(Y) * Depth.Height / Height * Depth.Width;
+            for (int32 X = Rect.Min.X; X < Rect.Max.X; ++X)
+            {
+                if (Row[X] == Id)
+                    continue;
+
+                const float PixelDepth = DepthRow[static_cast<int64>(X) * Depth.Width / Width];
+                Occluders += (PixelDepth > 0.0f && PixelDepth < NearestDepth) ? 1 : 0;
+            }
+        }
+        return static_cast<float>(Occluders) / static_cast<float>(Occluders + VisiblePixels);
+    }
+}
+
+    int32 AssignInstanceIds(UWorld* World, FName ActorTag, TArray<AActor*>& OutInstances)
+    {
+        OutInstances.Reset();
+        if (!World || ActorTag.IsNone())
+            return 0;
+
+        for (TActorIterator<AActor> It(World); It; ++It)
+        {
+            if (It->ActorHasTag(ActorTag))
+            {
+                OutInstances.Add(*It);
+            }
+        }
+        OutInstances.Sort([](const AActor& A, const AActor& B) { return A.GetFName().LexicalLess(B.GetFName()); });
+
+        if (OutInstances.Num() > MaxInstanceId)
+        {
+            UE_LOG(LogMLCapture, Warning, TEXT("Segmentation: %d actors tagged '%s'; only the first %d get a stencil ID"),
+                OutInstances.Num(), *ActorTag.ToString(), MaxInstanceId);
+            OutInstances.SetNum(MaxInstanceId);
+        }
+
+        for (int32 Index = 0; Index < OutInstances.Num(); ++Index)
+        {
+            const int32 Id = Index + 1;
+            OutInstances[Index]->ForEachComponent<UPrimitiveComponent>(false, [Id](UPrimitiveComponent* Primitive)
+            {
+                Primitive->SetRenderCustomDepth(true);
+                Primitive->SetCustomDepthStencilValue(Id);
+            });
+        }
+
+        // Custom depth without stencil leaves the IDs unwritten
+        if (OutInstances.Num() > 0)
+        {
+            IConsoleVariable* CustomDepth = IConsoleManager::Get().FindConsoleVariable(TEXT("r.CustomDepth"));
+            if (CustomDepth && CustomDepth->GetInt() != 3)
+            {
+                CustomDepth->Set(3, ECVF_SetByCode);
+                UE_LOG(LogMLCapture, Log, TEXT("Segmentation: set r.CustomDepth=3 (enabled with stencil)"));
+            }
+        }
+
+        UE_LOG(LogMLCapture, Log, TEXT("Segmentation: assigned stencil IDs to %d actors tagged '%s'"), OutInstances.Num(), *ActorTag.ToString());
+        return OutInstances.Num();
+    }
+
+    bool CanLabel(const FMLCapturedFrame& Segmentation)
+    {
+        const bool bFormat = Segmentation.PixelFormat == PF_G8 || Segmentation.PixelFormat == PF_R8
+            || Segmentation.PixelFormat == PF_B8G8R8A8 || Segmentation.PixelFormat == PF_R8G8B8A8;
+        return bFormat && Segmentation.Codec == EMLFrameCodec::Raw && Segmentation.Width > 0 && Segmentation.Height > 0
+            && Segmentation.Pixels.Num() == static_cast<int64>(Segmentation.Width) * Segmentation.Height * Segmentation.BytesPerPixel;
+    }
+
+    void LabelFrame(const FMLCapturedFrame& Segmentation, const FMLCapturedFrame* Depth, const FSnapshot* Boxes,
+        int32 MinPixels, TArray<FMLInstanceLabel>& OutLabels)
+    {
+        ML_CAPTURE_SCOPE(STAT_MLCapture_Label);
+
+        OutLabels.Reset();
+        if (!CanLabel(Segmentation))
+            return;
+
+        const int32 Width = Segmentation.Width;
+        const int32 Height = Segmentation.Height;
+        const int32 RowsPerBand = GetRowsPerBand(Width);
+        const int32 NumBands = FMath::DivideAndRoundUp(Height, RowsPerBand);
+
+        // Color targets carry the ID in red; pull it into a dense plane first so every later pass reads one byte per pixel
+        TArray<uint8> IdPlane;
+        const uint8* Ids = Segmentation.Pixels.GetData();
+        if (Segmentation.BytesPerPixel != 1)
+        {
+            IdPlane.SetNumUninitialized(Width * Height);
+            const int32 Stride = Segmentation.BytesPerPixel;
+            const int32 Channel = GetStencilChannel(Segmentation.PixelFormat);
+            ParallelFor(NumBands, [&](int32 BandIndex)
+            {
+                const int64 Begin = static_cast<int64>(BandIndex) * RowsPerBand * Width;
+                const int64 End = FMath::Min<int64>(Begin + static_cast<int64>(RowsPerBand) * Width, IdPlane.Num());
+                for (int64 Pixel = Begin; Pixel < End; ++Pixel)
+                {
+                    IdPlane[Pixel] = Segmentation.Pixels[Pixel * Stride + Channel];
+                }
+            });
+            Ids = IdPlane.GetData();
+        }
+
+        // Per band: runs, per-ID stats and the band-local union of vertically touching runs
+        TArray<FBand> Bands;
+        Bands.SetNum(NumBands);
+        TArray<TArray<int32>> BandParents;
+        BandParents.SetNum(NumBands);
+        ParallelFor(NumBands, [&](int32 BandIndex)
+        {
+            FBand& Band = Bands[BandIndex];
+            Band.FirstRow = BandIndex * RowsPerBand;
+            Band.EndRow = FMath::Min(Band.FirstRow + RowsPerBand, Height);
+            ScanBand(Ids, Width, Band);
+
+            TArray<int32>& Parent = BandParents[BandIndex];
+            Parent.SetNumUninitialized(Band.Runs.Num());
+            for (int32 Run = 0; Run < Parent.Num(); ++Run)
+            {
+                Parent[Run] = Run;
+            }
+            for (int32 Row = 1; Row < Band.EndRow - Band.FirstRow; ++Row)
+            {
+                const int32 Upper = Band.RowStart[Row - 1];
+                const int32 Lower = Band.RowStart[Row];
+                LinkRows(Band.Runs.GetData() + Upper, Lower - Upper, Upper, Band.Runs.GetData() + Lower, Band.RowStart[Row + 1] - Lower, Lower, Parent);
+            }
+        });
+
+        // Stitch the bands: one forest over every run, joined across each band boundary
+        TArray<int32> BandBase;
+        BandBase.SetNumUninitialized(NumBands);
+        int32 NumRuns = 0;
+        for (int32 BandIndex = 0; BandIndex < NumBands; ++BandIndex)
+        {
+            BandBase[BandIndex] = NumRuns;
+            NumRuns += Bands[BandIndex].Runs.Num();
+        }
+
+        TArray<int32> Parent;
+        Parent.SetNumUninitialized(NumRuns);
+        for (int32 BandIndex = 0; BandIndex < NumBands; ++BandIndex)
+        {
+            const TArray<int32>& Local = BandParents[BandIndex];
+            for (int32 Run = 0; Run < Local.Num(); ++Run)
+            {
+                Parent[BandBase[BandIndex] + Run] = BandBase[BandIndex] + Local[Run];
+            }
+        }
+        for (int32 BandIndex = 1; BandIndex < NumBands; ++BandIndex)
+        {
+            const FBand& Above = Bands[BandIndex - 1];
+            const FBand& Below = Bands[BandIndex];
+            const int32 LastRow = Above.EndRow - Above.FirstRow - 1;
+            const int32 NumUpper = Above.RowStart[LastRow + 1] - Above.RowStart[LastRow];
+            const int32 NumLower = Below.RowStart[1] - Below.RowStart[0];
+            if (NumUpper > 0 && NumLower > 0)
+            {
+                LinkRows(Above.Runs.GetData() + Above.RowStart[LastRow], NumUpper, BandBase[BandIndex - 1] + Above.RowStart[LastRow],
+                    Below.Runs.GetData(), NumLower, BandBase[BandIndex], Parent);
+            }
+        }
+
+        FIdStats Stats[NumIds];
+        uint16 Components[NumIds] = {};
+        for (int32 BandIndex = 0; BandIndex < NumBands; ++BandIndex)
+        {
+            const FBand& Band = Bands[BandIndex];
+            for (int32 Id = 1; Id < NumIds; ++Id)
+            {
+                const FIdStats& Local = Band.Stats[Id];
+                if (Local.Count == 0)
+                    continue;
+
+                FIdStats& Total = Stats[Id];
+                Total.Count += Local.Count;
+                Total.MinX = FMath::Min(Total.MinX, Local.MinX);
+                Total.MinY = FMath::Min(Total.MinY, Local.MinY);
+                Total.MaxX = FMath::Max(Total.MaxX, Local.MaxX);
+                Total.MaxY = FMath::Max(Total.MaxY, Local.MaxY);
+            }
+            for (int32 Run = 0; Run < Band.Runs.Num(); ++Run)
+            {
+                const int32 Index = BandBase[BandIndex] + Run;
+                if (FindRoot(Parent, Index) == Index)
+                {
+                    ++Components[Band.Runs[Run].Id];
+                }
+            }
+        }
+
+        for (int32 Id = 1; Id < NumIds; ++Id)
+        {
+            const FIdStats& IdStats = Stats[Id];
+            if (IdStats.Count == 0 || IdStats.Count < static_cast<uint32>(MinPixels))
+                continue;
+
+            FMLInstanceLabel& Label = OutLabels.AddDefaulted_GetRef();
+            Label.InstanceId = static_cast<uint16>(Id);
+            Label.PixelCount = IdStats.Count;
+            Label.Box2D[0] = static_cast<uint16>(IdStats.MinX);
+            Label.Box2D[1] = static_cast<uint16>(IdStats.MinY);
+            Label.Box2D[2] = static_cast<uint16>(IdStats.MaxX);
+            Label.Box2D[3] = static_cast<uint16>(IdStats.MaxY);
+            Label.NumComponents = Components[Id];
+        }
+
+        if (!Boxes)
+            return;
+
+        // 3D boxes and occlusion per instance; the occlusion scan is bounded by each box's rect
+        const bool bDepth = Depth && Depth->PixelFormat == PF_R32_FLOAT && Depth->Codec == EMLFrameCodec::Raw
+            && Depth->Pixels.Num() == static_cast<int64>(Depth->Width) * Depth->Height * sizeof(float);
+        const FProjection Projection(Segmentation);
+        ParallelFor(OutLabels.Num(), [&](int32 LabelIndex)
+        {
+            FMLInstanceLabel& Label = OutLabels[LabelIndex];
+            if (!Boxes->Boxes.IsValidIndex(Label.InstanceId) || !Boxes->Boxes[Label.InstanceId].bValid)
+                return;
+
+            FIntRect Rect;
+            const float NearestDepth = ProjectBox(Boxes->Boxes[Label.InstanceId], Projection, Width, Height, Label, Rect);
+            if (bDepth && NearestDepth > 0.0f)
+            {
+                Label.Occlusion = MeasureOcclusion(Ids, Width, Height, *Depth, static_cast<uint8>(Label.InstanceId), Rect, NearestDepth, Label.PixelCount);
+                Label.Flags |= EMLInstanceLabelFlags::Occlusion;
+            }
+        });
+    }
+}
+
+namespace
+{
+    FORCEINLINE uint64 MakePendingKey(int64 FrameIndex, int32 CameraIndex)
+    {
+        return (static_cast<uint64>(FrameIndex) << 24) | (static_cast<uint32>(CameraIndex) & 0xFFFFFF);
+    }
+}
+
+FSegmentationLabeler::FSegmentationLabeler(const FSegmentationLabelerSettings& InSettings)
+    : Settings(InSettings)
+{
+    Settings.MaxFramesInFlight = FMath::Max(Settings.MaxFramesInFlight, 1);
+    Settings.MaxSnapshotAgeFrames = FMath::Max(Settings.MaxSnapshotAgeFrames, 1);
+}
+
+FSegmentationLabeler::~FSegmentationLabeler()
+{
+    UE::Tasks::Wait(Tasks);
+}
+
+void FSegmentationLabeler::SetInstances(const TArray<AActor*>& InInstances)
+{
+    Instances.Reset(InInstances.Num());
+    for (AActor* Actor : InInstances)
+    {
+        FInstance& Instance = Instances.AddDefaulted_GetRef();
+        Instance.Actor = Actor;
+        Instance.LocalBounds = IsValid(Actor) ? Actor->CalculateComponentsBoundingBoxInLocalSpace(true) : FBox(ForceInit);
+    }
+    Snapshots.Reset();
+}
+
+void FSegmentationLabeler::SnapshotInstances(int64 FrameIndex)
+{
+    if (Instances.Num() == 0 || Snapshots.Contains(FrameIndex))
+        return;
+
+    ML_CAPTURE_SCOPE(STAT_MLCapture_Label);
+
+    for (auto It = Snapshots.CreateIterator(); It; ++It)
+    {
+        if (It.Key() < FrameIndex - Settings.MaxSnapshotAgeFrames)
+        {
+            It.RemoveCurrent();
+        }
+    }
+
+    TSharedPtr<SegmentationLabeling::FSnapshot, ESPMode::ThreadSafe> Snapshot = MakeShared<SegmentationLabeling::FSnapshot, ESPMode::ThreadSafe>();
+    Snapshot->FrameIndex = FrameIndex;
+    Snapshot->Boxes.SetNum(Instances.Num() + 1);
+    for (int32 Index = 0; Index < Instances.Num(); ++Index)
+    {
+        const AActor* Actor = Instances[Index].Actor.Get();
+        const FBox& Local = Instances[Index].LocalBounds;
+        if (!Actor || !Local.IsValid)
+            continue;
+
+        const FTransform& Transform = Actor->GetActorTransform();
+        SegmentationLabeling::FInstanceBox& Box = Snapshot->Boxes[Index + 1];
+        Box.Center = Transform.TransformPosition(Local.GetCenter());
+        Box.Extent = FVector3f(Local.GetExtent() * Transform.GetScale3D().GetAbs());
+        Box.Rotation = FQuat4f(Transform.GetRotation());
+        Box.bValid = true;
+    }
+    Snapshots.Add(FrameIndex, MoveTemp(Snapshot));
+}
+
+void FSegmentationLabeler::Submit(const FMLCapturedFramePtr& Frame)
+{
+    if (!Frame.IsValid() || Frame->ReusedFrameIndex != INDEX_NONE || Frame->Codec != EMLFrameCodec::Raw)
+        return;
+
+    const bool bSegmentation = Frame->BufferType == EMLBufferType::Segmentation && SegmentationLabeling::CanLabel(*Frame);
+    const bool bDepth = Settings.bOcclusionFromDepth && Frame->BufferType == EMLBufferType::SceneDepth && Frame->PixelFormat == PF_R32_FLOAT;
+    if (!bSegmentation && !bDepth)
+        return;
+
+    if (Frame->FrameIndex > NewestFrameIndex)
+    {
+        NewestFrameIndex = Frame->FrameIndex;
+        FlushStalePending(NewestFrameIndex);
+    }
+
+    if (!Settings.bOcclusionFromDepth)
+    {
+        Launch(Frame, nullptr);
+        return;
+    }
+
+    const uint64 Key = MakePendingKey(Frame->FrameIndex, Frame->CameraIndex);
+    FPendingFrame& Entry = Pending.FindOrAdd(Key);
+    (bSegmentation ? Entry.Segmentation : Entry.Depth) = Frame;
+    if (Entry.Segmentation && Entry.Depth)
+    {
+        Launch(Entry.Segmentation, Entry.Depth);
+        Pending.Remove(Key);
+    }
+}
+
+void FSegmentationLabeler::FlushStalePending(int64 InNewestFrameIndex)
+{
+    for (auto It = Pending.CreateIterator(); It; ++It)
+    {
+        if (static_cast<int64>(It.Key() >> 24) > InNewestFrameIndex - Settings.DepthWaitFrames)
+            continue;
+
+        // No depth for this camera or it was dropped; depth without segmentation is simply discarded
+        if (It.Value().Segmentation)
+        {
+            Launch(It.Value().Segmentation, nullptr);
+        }
+        It.RemoveCurrent();
+    }
+}
+
+void FSegmentationLabeler::Launch(const FMLCapturedFramePtr& Segmentation, const FMLCapturedFramePtr& Depth)
+{
+    Tasks.RemoveAllSwap([](const UE::Tasks::FTask& Task) { return Task.IsCompleted(); }, EAllowShrinking::No);
+
+    if (NumInFlight.load() >= Settings.MaxFramesInFlight)
+    {
+        if (!Settings.bBlockWhenFull)
+        {
+            FramesDropped.fetch_add(1);
+            return;
+        }
+        while (NumInFlight.load() >= Settings.MaxFramesInFlight && Tasks.Num() > 0)
+        {
+            Tasks[0].Wait();
+            Tasks.RemoveAllSwap([](const UE::Tasks::FTask& Task) { return Task.IsCompleted(); }, EAllowShrinking::No);
+        }
+    }
+
+    const FSnapshotPtr* Snapshot = Snapshots.Find(Segmentation->FrameIndex);
+    NumInFlight.fetch_add(1);
+    Tasks.Add(UE::Tasks::Launch(UE_SOURCE_LOCATION,
+        [this, Segmentation, Depth, Boxes = Snapshot ? *Snapshot : FSnapshotPtr()]()
+        {
+            const uint64 StartCycles = FPlatformTime::Cycles64();
+
+            TArray<FMLInstanceLabel> Labels;
+            SegmentationLabeling::LabelFrame(*Segmentation, Depth.Get(), Boxes.Get(), Settings.MinPixels, Labels);
+
+            FMLCapturedFramePtr LabelFrame = MakeShared<FMLCapturedFrame, ESPMode::ThreadSafe>();
+            LabelFrame->FrameIndex = Segmentation->FrameIndex;
+            LabelFrame->CameraIndex = Segmentation->CameraIndex;
+            LabelFrame->BufferType = EMLBufferType::Labels;
+            LabelFrame->Width = Labels.Num();
+            LabelFrame->Height = 1;
+            LabelFrame->PixelFormat = PF_Unknown;
+            LabelFrame->BytesPerPixel = sizeof(FMLInstanceLabel);
+            LabelFrame->CameraPose = Segmentation->CameraPose;
+            LabelFrame->FOVAngle = Segmentation->FOVAngle;
+            LabelFrame->Pixels.SetNumUninitialized(Labels.Num() * sizeof(FMLInstanceLabel));
+            FMemory::Memcpy(LabelFrame->Pixels.GetData(), Labels.GetData(), LabelFrame->Pixels.Num());
+
+            LabelCycles.fetch_add(FPlatformTime::Cycles64() - StartCycles);
+            InstancesLabeled.fetch_add(Labels.Num());
+            FramesLabeled.fetch_add(1);
+
+            Completed.Enqueue(MoveTemp(LabelFrame));
+            NumInFlight.fetch_sub(1);
+        }));
+}
+
+void FSegmentationLabeler::Tick()
+{
+    FMLCapturedFramePtr Frame;
+    while (Completed.Dequeue(Frame))
+    {
+        LabelsReadyDelegate.Broadcast(Frame);
+    }
+}
+
+void FSegmentationLabeler::Flush()
+{
+    for (const TPair<uint64, FPendingFrame>& Entry : Pending)
+    {
+        if (Entry.Value.Segmentation)
+        {
+            Launch(Entry.Value.Segmentation, Entry.Value.Depth);
+        }
+    }
+    Pending.Reset();
+
+    UE::Tasks::Wait(Tasks);
+    Tasks.Reset();
+    Tick();
+}
+
+FMLSegmentationStats FSegmentationLabeler::GetStats() const
+{
+    FMLSegmentationStats Stats;
+    Stats.FramesLabeled = FramesLabeled.load();
+    Stats.FramesDropped = FramesDropped.load();
+    Stats.InstancesLabeled = InstancesLabeled.load();
+    Stats.AverageLabelMs = Stats.FramesLabeled > 0
+        ? static_cast<float>(FPlatformTime::ToMilliseconds64(LabelCycles.load()) / Stats.FramesLabeled)
+        : 0.0f;
+    return Stats;
+}
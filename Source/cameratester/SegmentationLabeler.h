@@ -0,0 +1,180 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+#include "Tasks/Task.h"
+#include "MLCaptureTypes.h"
+#include <atomic>
+#include "SegmentationLabeler.generated.h"
+
+// One record per visible instance; a Labels frame's Pixels hold Width of them (Height 1).
+// Pixel coordinates are in the segmentation frame, boxes are world space at capture time.
+#pragma pack(push, 1)
+struct FMLInstanceLabel
+{
+    uint16 InstanceId = 0;     // Custom stencil value, 1-255
+    uint16 Flags = 0;          // EMLInstanceLabelFlags
+    uint32 PixelCount = 0;
+    uint16 Box2D[4] = { 0, 0, 0, 0 }; // Visible pixels: MinX, MinY, MaxX, MaxY, inclusive
+    uint16 NumComponents = 0;  // 4-connected visible regions
+    uint16 Reserved = 0;
+    float Occlusion = -1.0f;   // Share of the instance hidden by nearer surfaces; -1 when not measured
+    float Truncation = 0.0f;   // Share of the projected 3D box outside the image
+    float Center[3] = { 0.f, 0.f, 0.f };
+    float Extent[3] = { 0.f, 0.f, 0.f };
+    float Rotation[4] = { 0.f, 0.f, 0.f, 1.f };
+    float Corners[16] = {};    // 3D box corners in pixels as x/y pairs; corner i is at -/+Extent per bit 0/1/2 of i (x/y/z)
+};
+#pragma pack(pop)
+
+namespace EMLInstanceLabelFlags
+{
+    enum : uint16
+    {
+        None = 0,
+        // Center, Extent, Rotation, Corners and Truncation are set
+        Box3D = 1 << 0,
+        // Occlusion is set
+        Occlusion = 1 << 1,
+        // Some corners are behind the camera; their pixel positions and Truncation are only approximate
+        BehindCamera = 1 << 2,
+    };
+}
+
+static_assert(sizeof(FMLInstanceLabel) == 132, "Instance label layout is part of the file format");
+
+USTRUCT(BlueprintType)
+struct CAMERATESTER_API FMLSegmentationStats
+{
+    GENERATED_BODY()
+
+    UPROPERTY(BlueprintReadOnly, Category = "Segmentation")
+    int64 FramesLabeled = 0;
+
+    // Segmentation frames rejected while too many were in flight
+    UPROPERTY(BlueprintReadOnly, Category = "Segmentation")
+    int64 FramesDropped = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Segmentation")
+    int64 InstancesLabeled = 0;
+
+    // Task time per frame
+    UPROPERTY(BlueprintReadOnly, Category = "Segmentation")
+    float AverageLabelMs = 0.0f;
+};
+
+namespace SegmentationLabeling
+{
+    // Stencil values are 8-bit and 0 is background
+    constexpr int32 MaxInstanceId = 255;
+
+    struct FInstanceBox
+    {
+        FVector Center = FVector::ZeroVector;
+        FVector3f Extent = FVector3f::ZeroVector;
+        FQuat4f Rotation = FQuat4f::Identity;
+        bool bValid = false;
+    };
+
+    // Every instance's oriented box at one capture frame, indexed by instance ID
+    struct FSnapshot
+    {
+        int64 FrameIndex = 0;
+        TArray<FInstanceBox> Boxes;
+    };
+
+    // Gives each actor tagged ActorTag a stencil ID (1-255, in name order so reruns of a level agree) and renders its
+    // primitives into custom depth. OutInstances[Id - 1] is the actor with that ID. Returns the number assigned.
+    CAMERATESTER_API int32 AssignInstanceIds(UWorld* World, FName ActorTag, TArray<AActor*>& OutInstances);
+
+    // Raw 8-bit stencil IDs: G8/R8, or the red channel of BGRA/RGBA
+    CAMERATESTER_API bool CanLabel(const FMLCapturedFrame& Segmentation);
+
+    // One record per instance with at least MinPixels visible pixels. Depth (same camera and frame, any size) enables
+    // occlusion; Boxes enables the 3D box and its projection.
+    CAMERATESTER_API void LabelFrame(const FMLCapturedFrame& Segmentation, const FMLCapturedFrame* Depth, const FSnapshot* Boxes,
+        int32 MinPixels, TArray<FMLInstanceLabel>& OutLabels);
+}
+
+struct FSegmentationLabelerSettings
+{
+    // Pair each segmentation frame with the SceneDepth frame of the same camera and frame index to measure occlusion
+    bool bOcclusionFromDepth = true;
+
+    // Segmentation frames wait this many capture frames for their depth before being labeled without it
+    int32 DepthWaitFrames = 4;
+
+    // Instances with fewer visible pixels get no record
+    int32 MinPixels = 1;
+
+    int32 MaxFramesInFlight = 64;
+
+    // Wait instead of dropping once MaxFramesInFlight is reached
+    bool bBlockWhenFull = false;
+
+    // Box snapshots older than this many frames are discarded; readbacks land well within it
+    int32 MaxSnapshotAgeFrames = 64;
+};
+
+// Turns read-back Segmentation frames into Labels frames on the task graph: per-instance pixel counts, 2D boxes,
+// connected components, occlusion against depth and the instance's 3D box as it was when the frame was captured.
+class CAMERATESTER_API FSegmentationLabeler
+{
+public:
+    explicit FSegmentationLabeler(const FSegmentationLabelerSettings& InSettings);
+    ~FSegmentationLabeler();
+
+    // Game thread. Instances[Id - 1] is the actor rendered with stencil Id; their local bounds are cached here.
+    void SetInstances(const TArray<AActor*>& Instances);
+
+    // Game thread, once per capture frame: records every instance's box for frames read back later
+    void SnapshotInstances(int64 FrameIndex);
+
+    // Game thread. Takes raw Segmentation frames and, for occlusion, raw SceneDepth frames; everything else is ignored.
+    void Submit(const FMLCapturedFramePtr& Frame);
+
+    // Game thread: delivers finished Labels frames through OnLabelsReady()
+    void Tick();
+
+    // Labels everything still pending, waits for the tasks and delivers their results
+    void Flush();
+
+    FMLSegmentationStats GetStats() const;
+    FOnMLFrameDataReady& OnLabelsReady() { return LabelsReadyDelegate; }
+
+private:
+    struct FInstance
+    {
+        TWeakObjectPtr<AActor> Actor;
+        FBox LocalBounds;
+    };
+
+    struct FPendingFrame
+    {
+        FMLCapturedFramePtr Segmentation;
+        FMLCapturedFramePtr Depth;
+    };
+
+    using FSnapshotPtr = TSharedPtr<const SegmentationLabeling::FSnapshot, ESPMode::ThreadSafe>;
+
+    void Launch(const FMLCapturedFramePtr& Segmentation, const FMLCapturedFramePtr& Depth);
+    void FlushStalePending(int64 NewestFrameIndex);
+
+    FSegmentationLabelerSettings Settings;
+    FOnMLFrameDataReady LabelsReadyDelegate;
+
+    // Game thread
+    TArray<FInstance> Instances;
+    TMap<int64, FSnapshotPtr> Snapshots;
+    TMap<uint64, FPendingFrame> Pending;
+    TArray<UE::Tasks::FTask> Tasks;
+    int64 NewestFrameIndex = INDEX_NONE;
+
+    // Shared with the labeling tasks
+    TQueue<FMLCapturedFramePtr, EQueueMode::Mpsc> Completed;
+    std::atomic<int32> NumInFlight { 0 };
+    std::atomic<int64> FramesLabeled { 0 };
+    std::atomic<int64> FramesDropped { 0 };
+    std::atomic<int64> InstancesLabeled { 0 };
+    std::atomic<uint64> LabelCycles { 0 };
+};
@@ -0,0 +1,439 @@
+#include "ShardCoordinator.h"
+#include "MLCaptureStats.h"
+#include "Common/TcpSocketBuilder.h"
+#include "Interfaces/IPv4/IPv4Endpoint.h"
+#include "JsonObjectConverter.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "Sockets.h"
+#include "SocketSubsystem.h"
+
+namespace
+{
+    // A peer sending more than this without a newline is not speaking the protocol
+    constexpr int32 MaxLineBytes = 64 * 1024;
+
+    TSharedRef<FJsonObject> MakeMessage(const TCHAR* Type)
+    {
+        TSharedRef<FJsonObject> Message = MakeShared<FJsonObject>();
+        Message->SetStringField(TEXT("type"), Type);
+        return Message;
+    }
+
+    void DestroySocket(FSocket* Socket)
+    {
+        if (Socket)
+        {
+            Socket->Close();
+            ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(Socket);
+        }
+    }
+}
+
+FShardMessageSocket::FShardMessageSocket(FSocket* InSocket)
+    : Socket(InSocket)
+{
+}
+
+FShardMessageSocket::~FShardMessageSocket()
+{
+    Close();
+}
+
+void FShardMessageSocket::Close()
+{
+    DestroySocket(Socket);
+    Socket = nullptr;
+}
+
+bool FShardMessageSocket::Send(const TSharedRef<FJsonObject>& Message)
+{
+    if (!Socket)
+        return false;
+
+    FString Text;
+    const TSharedRef<TJsonWriter<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>> Writer = TJsonWriterFactory<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>::Create(&Text);
+    FJsonSerializer::Serialize(Message, Writer);
+    Text.AppendChar(TEXT('\n'));
+
+    const FTCHARToUTF8 Utf8(*Text);
+    const uint8* Data = reinterpret_cast<const uint8*>(Utf8.Get());
+    int32 Remaining = Utf8.Length();
+    while (Remaining > 0)
+    {
+        int32 BytesSent = 0;
+        if (!Socket->Send(Data, Remaining, BytesSent) || BytesSent <= 0)
+        {
+            Close();
+            return false;
+        }
+        Data += BytesSent;
+        Remaining -= BytesSent;
+    }
+    return true;
+}
+
+bool FShardMessageSocket::Receive(TArray<TSharedPtr<FJsonObject>>& OutMessages)
+{
+    OutMessages.Append(MoveTemp(Backlog));
+    Backlog.Reset();
+
+    if (!Socket)
+        return false;
+
+    uint8 Chunk[4096];
+    while (Socket->Wait(ESocketWaitConditions::WaitForRead, FTimespan::Zero()))
+    {
+        // Readable with nothing to read is an orderly close
+        int32 BytesRead = 0;
+        if (!Socket->Recv(Chunk, sizeof(Chunk), BytesRead) || BytesRead <= 0)
+        {
+            Close();
+            break;
+        }
+        Buffer.Append(Chunk, BytesRead);
+    }
+
+    int32 LineStart = 0;
+    for (int32 Index = 0; Index < Buffer.Num(); ++Index)
+    {
+        if (Buffer[Index] != '\n')
+            continue;
+
+        const FUTF8ToTCHAR Line(reinterpret_cast<const ANSICHAR*>(Buffer.GetData() + LineStart), Index - LineStart);
+        TSharedPtr<FJsonObject> Message;
+        if (FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(FString(Line.Length(), Line.Get())), Message) && Message.IsValid())
+        {
+            OutMessages.Add(Message);
+        }
+        else
+        {
+            UE_LOG(LogMLCapture, Warning, TEXT("Shard coordinator: ignoring malformed message"));
+        }
+        LineStart = Index + 1;
+    }
+    Buffer.RemoveAt(0, LineStart, EAllowShrinking::No);
+
+    if (Buffer.Num() > MaxLineBytes)
+    {
+        UE_LOG(LogMLCapture, Warning, TEXT("Shard coordinator: peer sent %d bytes without a newline; closing"), Buffer.Num());
+        Close();
+    }
+    return Socket != nullptr;
+}
+
+TSharedPtr<FJsonObject> FShardMessageSocket::ReceiveOne(double TimeoutSeconds)
+{
+    const double Deadline = FPlatformTime::Seconds() + TimeoutSeconds;
+    TArray<TSharedPtr<FJsonObject>> Messages;
+    while (true)
+    {
+        const bool bOpen = Receive(Messages);
+        if (Messages.Num() > 0)
+        {
+            TSharedPtr<FJsonObject> First = Messages[0];
+            Messages.RemoveAt(0);
+            Backlog = MoveTemp(Messages);
+            return First;
+        }
+
+        const double Remaining = Deadline - FPlatformTime::Seconds();
+        if (!bOpen || Remaining <= 0.0)
+            return nullptr;
+
+        Socket->Wait(ESocketWaitConditions::WaitForRead, FTimespan::FromSeconds(FMath::Min(Remaining, 0.5)));
+    }
+}
+
+FShardCoordinatorClient::~FShardCoordinatorClient()
+{
+    Connection.Reset();
+}
+
+bool FShardCoordinatorClient::Connect(const FString& Address, int32 PreferredShard, double TimeoutSeconds, FMLShardAssignment& OutAssignment)
+{
+    FIPv4Endpoint Endpoint;
+    if (!FIPv4Endpoint::Parse(Address, Endpoint))
+    {
+        UE_LOG(LogMLCapture, Error, TEXT("Invalid coordinator address '%s' (expected ip:port)"), *Address);
+        return false;
+    }
+
+    // The coordinator may still be starting up; keep trying until the timeout
+    const double Deadline = FPlatformTime::Seconds() + TimeoutSeconds;
+    FSocket* Socket = nullptr;
+    while (!Socket)
+    {
+        Socket = FTcpSocketBuilder(TEXT("MLShardClient")).AsBlocking().Build();
+        if (Socket && Socket->Connect(*Endpoint.ToInternetAddr()))
+            break;
+
+        DestroySocket(Socket);
+        Socket = nullptr;
+        if (FPlatformTime::Seconds() > Deadline)
+        {
+            UE_LOG(LogMLCapture, Error, TEXT("Could not reach shard coordinator at %s"), *Address);
+            return false;
+        }
+        FPlatformProcess::Sleep(0.25f);
+    }
+    Connection = MakeUnique<FShardMessageSocket>(Socket);
+
+    TSharedRef<FJsonObject> Hello = MakeMessage(TEXT("hello"));
+    Hello->SetNumberField(TEXT("pid"), FPlatformProcess::GetCurrentProcessId());
+    Hello->SetNumberField(TEXT("shard"), PreferredShard);
+    if (!Connection->Send(Hello))
+        return false;
+
+    const TSharedPtr<FJsonObject> Reply = Connection->ReceiveOne(FMath::Max(Deadline - FPlatformTime::Seconds(), 1.0));
+    FString Type;
+    if (!Reply.IsValid() || !Reply->TryGetStringField(TEXT("type"), Type) || Type != TEXT("assign"))
+    {
+        FString Reason = TEXT("no reply");
+        if (Reply.IsValid())
+        {
+            Reply->TryGetStringField(TEXT("reason"), Reason);
+        }
+        UE_LOG(LogMLCapture, Error, TEXT("Shard coordinator refused this process: %s"), *Reason);
+        Connection.Reset();
+        return false;
+    }
+
+    FMLShardAssignment Assignment;
+    Assignment.ShardIndex = Reply->GetIntegerField(TEXT("shard"));
+    Assignment.ShardCount = Reply->GetIntegerField(TEXT("count"));
+    Assignment.Seed = Reply->GetIntegerField(TEXT("seed"));
+    const int64 ModeValue = StaticEnum<EMLShardMode>()->GetValueByNameString(Reply->GetStringField(TEXT("mode")));
+    Assignment.Mode = ModeValue != INDEX_NONE ? static_cast<EMLShardMode>(ModeValue) : EMLShardMode::IndexRange;
+    if (!Assignment.IsValid())
+    {
+        UE_LOG(LogMLCapture, Error, TEXT("Shard coordinator sent an invalid assignment"));
+        Connection.Reset();
+        return false;
+    }
+
+    OutAssignment = Assignment;
+    return true;
+}
+
+void FShardCoordinatorClient::SendProgress(const FMLShardProgress& Progress, bool bDone)
+{
+    if (!IsConnected())
+        return;
+
+    TSharedRef<FJsonObject> Message = MakeMessage(bDone ? TEXT("done") : TEXT("progress"));
+    FJsonObjectConverter::UStructToJsonObject(FMLShardProgress::StaticStruct(), &Progress, Message);
+    if (!Connection->Send(Message))
+    {
+        UE_LOG(LogMLCapture, Warning, TEXT("Lost the connection to the shard coordinator"));
+    }
+}
+
+FShardCoordinator::FShardCoordinator(int32 InShardCount, EMLShardMode InMode, int32 InSeed)
+    : Mode(InMode)
+    , Seed(InSeed)
+{
+    Shards.SetNum(FMath::Max(InShardCount, 1));
+    ShardClaimed.SetNumZeroed(Shards.Num());
+    for (int32 ShardIndex = 0; ShardIndex < Shards.Num(); ++ShardIndex)
+    {
+        Shards[ShardIndex].ShardIndex = ShardIndex;
+    }
+}
+
+FShardCoordinator::~FShardCoordinator()
+{
+    Stop();
+}
+
+bool FShardCoordinator::Start(int32 Port)
+{
+    if (ListenSocket)
+        return true;
+
+    // Loopback only: the coordinator hands out work to processes on this machine
+    ListenSocket = FTcpSocketBuilder(TEXT("MLShardCoordinator"))
+        .AsNonBlocking()
+        .AsReusable()
+        .BoundToEndpoint(FIPv4Endpoint(FIPv4Address(127, 0, 0, 1), static_cast<uint16>(Port)))
+        .Listening(64)
+        .Build();
+    if (!ListenSocket)
+    {
+        UE_LOG(LogMLCapture, Error, TEXT("Shard coordinator could not listen on port %d"), Port);
+        return false;
+    }
+
+    ListenPort = ListenSocket->GetPortNo();
+    UE_LOG(LogMLCapture, Display, TEXT("Shard coordinator listening on 127.0.0.1:%d for %d shards (%s)"), ListenPort, Shards.Num(),
+        *StaticEnum<EMLShardMode>()->GetNameStringByValue(static_cast<int64>(Mode)));
+    return true;
+}
+
+void FShardCoordinator::Stop()
+{
+    Connections.Empty();
+    DestroySocket(ListenSocket);
+    ListenSocket = nullptr;
+}
+
+void FShardCoordinator::Poll()
+{
+    if (!ListenSocket)
+        return;
+
+    bool bPending = false;
+    while (ListenSocket->HasPendingConnection(bPending) && bPending)
+    {
+        FSocket* Accepted = ListenSocket->Accept(TEXT("MLShardProcess"));
+        if (!Accepted)
+            break;
+
+        FConnection& Connection = Connections.AddDefaulted_GetRef();
+        Connection.Socket = MakeUnique<FShardMessageSocket>(Accepted);
+    }
+
+    TArray<TSharedPtr<FJsonObject>> Messages;
+    for (int32 Index = Connections.Num() - 1; Index >= 0; --Index)
+    {
+        FConnection& Connection = Connections[Index];
+        Messages.Reset();
+        const bool bOpen = Connection.Socket->Receive(Messages);
+        for (const TSharedPtr<FJsonObject>& Message : Messages)
+        {
+            HandleMessage(Connection, Message.ToSharedRef());
+        }
+
+        if (!bOpen || !Connection.Socket->IsOpen())
+        {
+            ReleaseShard(Connection);
+            Connections.RemoveAtSwap(Index);
+        }
+    }
+}
+
+void FShardCoordinator::HandleMessage(FConnection& Connection, const TSharedRef<FJsonObject>& Message)
+{
+    FString Type;
+    Message->TryGetStringField(TEXT("type"), Type);
+
+    if (Type == TEXT("hello"))
+    {
+        if (Connection.ShardIndex != INDEX_NONE)
+            return;
+
+        Connection.ProcessId = static_cast<uint32>(Message->GetIntegerField(TEXT("pid")));
+        int32 PreferredShard = INDEX_NONE;
+        Message->TryGetNumberField(TEXT("shard"), PreferredShard);
+
+        Connection.ShardIndex = ClaimShard(PreferredShard);
+        if (Connection.ShardIndex == INDEX_NONE)
+        {
+            TSharedRef<FJsonObject> Reject = MakeMessage(TEXT("reject"));
+            Reject->SetStringField(TEXT("reason"), TEXT("every shard is taken or done"));
+            Connection.Socket->Send(Reject);
+            UE_LOG(LogMLCapture, Warning, TEXT("Shard coordinator: process %u asked for a shard but none is free"), Connection.ProcessId);
+            return;
+        }
+
+        TSharedRef<FJsonObject> Assign = MakeMessage(TEXT("assign"));
+        Assign->SetNumberField(TEXT("shard"), Connection.ShardIndex);
+        Assign->SetNumberField(TEXT("count"), Shards.Num());
+        Assign->SetStringField(TEXT("mode"), StaticEnum<EMLShardMode>()->GetNameStringByValue(static_cast<int64>(Mode)));
+        Assign->SetNumberField(TEXT("seed"), Seed);
+        Connection.Socket->Send(Assign);
+        UE_LOG(LogMLCapture, Display, TEXT("Shard coordinator: shard %d -> process %u"), Connection.ShardIndex, Connection.ProcessId);
+        return;
+    }
+
+    if (Type != TEXT("progress") && Type != TEXT("done"))
+    {
+        UE_LOG(LogMLCapture, Warning, TEXT("Shard coordinator: unknown message '%s'"), *Type);
+        return;
+    }
+
+    FMLShardProgress Progress;
+    if (Connection.ShardIndex == INDEX_NONE || !FJsonObjectConverter::JsonObjectToUStruct(Message, &Progress)
+        || Progress.ShardIndex != Connection.ShardIndex)
+    {
+        UE_LOG(LogMLCapture, Warning, TEXT("Shard coordinator: process %u reported on a shard it does not own"), Connection.ProcessId);
+        return;
+    }
+
+    Progress.bDone = Type == TEXT("done");
+    Shards[Connection.ShardIndex] = Progress;
+    UE_CLOG(Progress.bDone, LogMLCapture, Display, TEXT("Shard coordinator: shard %d done, %lld records in %s"),
+        Progress.ShardIndex, Progress.RecordsWritten, *Progress.Manifest);
+}
+
+int32 FShardCoordinator::ClaimShard(int32 PreferredShard)
+{
+    auto IsFree = [this](int32 ShardIndex) { return !ShardClaimed[ShardIndex] && !Shards[ShardIndex].bDone; };
+
+    int32 ShardIndex = Shards.IsValidIndex(PreferredShard) && IsFree(PreferredShard) ? PreferredShard : INDEX_NONE;
+    for (int32 Candidate = 0; ShardIndex == INDEX_NONE && Candidate < Shards.Num(); ++Candidate)
+    {
+        if (IsFree(Candidate))
+        {
+            ShardIndex = Candidate;
+        }
+    }
+
+    if (ShardIndex != INDEX_NONE)
+    {
+        ShardClaimed[ShardIndex] = true;
+    }
+    return ShardIndex;
+}
+
+void FShardCoordinator::ReleaseShard(FConnection& Connection)
+{
+    if (Connection.ShardIndex == INDEX_NONE)
+        return;
+
+    ShardClaimed[Connection.ShardIndex] = false;
+    if (!Shards[Connection.ShardIndex].bDone)
+    {
+        // Nothing is deleted: the next claimant's dataset writer recovers the shards the lost process left in the part
+        // directory and numbers its own after them; files it cannot recover stay behind until the part is cleaned
+        UE_LOG(LogMLCapture, Warning, TEXT("Shard coordinator: process %u left before finishing shard %d; shard is free again"),
+            Connection.ProcessId, Connection.ShardIndex);
+        const int32 ShardIndex = Connection.ShardIndex;
+        Shards[ShardIndex] = FMLShardProgress();
+        Shards[ShardIndex].ShardIndex = ShardIndex;
+    }
+    Connection.ShardIndex = INDEX_NONE;
+}
+
+int32 FShardCoordinator::GetNumDone() const
+{
+    int32 NumDone = 0;
+    for (const FMLShardProgress& Shard : Shards)
+    {
+        NumDone += Shard.bDone ? 1 : 0;
+    }
+    return NumDone;
+}
+
+int32 FShardCoordinator::GetNumUnassigned() const
+{
+    int32 NumUnassigned = 0;
+    for (int32 ShardIndex = 0; ShardIndex < Shards.Num(); ++ShardIndex)
+    {
+        NumUnassigned += !ShardClaimed[ShardIndex] && !Shards[ShardIndex].bDone ? 1 : 0;
+    }
+    return NumUnassigned;
+}
+
+TArray<FString> FShardCoordinator::GetManifests() const
+{
+    TArray<FString> Manifests;
+    for (const FMLShardProgress& Shard : Shards)
+    {
+        if (Shard.bDone && !Shard.Manifest.IsEmpty())
+        {
+            Manifests.Add(Shard.Manifest);
+        }
+    }
+    return Manifests;
+}
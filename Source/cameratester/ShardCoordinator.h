@@ -0,0 +1,99 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Dom/JsonObject.h"
+#include "CaptureSharding.h"
+
+class FSocket;
+
+// Capture processes talk to the coordinator over a loopback TCP connection, one JSON object per line:
+//   client -> {"type":"hello","pid":<pid>,"shard":<preferred or -1>}
+//   server -> {"type":"assign","shard":k,"count":N,"mode":"IndexRange","seed":s}  or  {"type":"reject","reason":...}
+//   client -> {"type":"progress", FMLShardProgress fields}   (repeated)
+//   client -> {"type":"done", FMLShardProgress fields with Manifest set}
+// A connection that closes before "done" returns its shard to the pool so a relaunched process can take it over.
+class CAMERATESTER_API FShardMessageSocket
+{
+public:
+    explicit FShardMessageSocket(FSocket* InSocket);
+    ~FShardMessageSocket();
+
+    bool Send(const TSharedRef<FJsonObject>& Message);
+
+    // Appends every complete line received so far; false once the peer has gone
+    bool Receive(TArray<TSharedPtr<FJsonObject>>& OutMessages);
+
+    // Blocks until one message arrives, the peer goes or TimeoutSeconds pass
+    TSharedPtr<FJsonObject> ReceiveOne(double TimeoutSeconds);
+
+    bool IsOpen() const { return Socket != nullptr; }
+    void Close();
+
+private:
+    FSocket* Socket = nullptr;
+    TArray<uint8> Buffer;
+    TArray<TSharedPtr<FJsonObject>> Backlog;
+};
+
+// Game-process side: one request for a shard, then progress until the dataset is closed
+class CAMERATESTER_API FShardCoordinatorClient
+{
+public:
+    ~FShardCoordinatorClient();
+
+    // Address is "host:port"; PreferredShard is honoured while that shard is free
+    bool Connect(const FString& Address, int32 PreferredShard, double TimeoutSeconds, FMLShardAssignment& OutAssignment);
+
+    void SendProgress(const FMLShardProgress& Progress, bool bDone);
+
+    bool IsConnected() const { return Connection.IsValid() && Connection->IsOpen(); }
+
+private:
+    TUniquePtr<FShardMessageSocket> Connection;
+};
+
+// Coordinator side. Single-threaded: Poll() accepts connections, hands out shards and collects progress.
+class CAMERATESTER_API FShardCoordinator
+{
+public:
+    FShardCoordinator(int32 InShardCount, EMLShardMode InMode, int32 InSeed);
+    ~FShardCoordinator();
+
+    // Listens on 127.0.0.1:Port; Port 0 picks a free one
+    bool Start(int32 Port);
+    void Stop();
+
+    void Poll();
+
+    int32 GetPort() const { return ListenPort; }
+    int32 GetShardCount() const { return Shards.Num(); }
+    int32 GetNumDone() const;
+    int32 GetNumUnassigned() const;
+    bool IsComplete() const { return GetNumDone() == Shards.Num(); }
+
+    const TArray<FMLShardProgress>& GetProgress() const { return Shards; }
+
+    // Manifests of finished shards, in shard order
+    TArray<FString> GetManifests() const;
+
+private:
+    struct FConnection
+    {
+        TUniquePtr<FShardMessageSocket> Socket;
+        int32 ShardIndex = INDEX_NONE;
+        uint32 ProcessId = 0;
+    };
+
+    void HandleMessage(FConnection& Connection, const TSharedRef<FJsonObject>& Message);
+    void ReleaseShard(FConnection& Connection);
+    int32 ClaimShard(int32 PreferredShard);
+
+    FSocket* ListenSocket = nullptr;
+    int32 ListenPort = 0;
+    EMLShardMode Mode;
+    int32 Seed;
+
+    TArray<FMLShardProgress> Shards;
+    TArray<bool> ShardClaimed;
+    TArray<FConnection> Connections;
+};
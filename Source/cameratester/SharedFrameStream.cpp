@@ -0,0 +1,250 @@
+#include "SharedFrameStream.h"
+#include "MLCaptureStats.h"
+#include "HAL/PlatformMemory.h"
+#include "HAL/PlatformProcess.h"
+
+using namespace MLFrameStream;
+
+namespace
+{
+    constexpr uint64 StreamAlignment = 64;
+
+    uint64 AlignUp(uint64 Value, uint64 Alignment)
+    {
+        return (Value + Alignment - 1) / Alignment * Alignment;
+    }
+}
+
+FSharedFrameStream::FSharedFrameStream(const FSharedFrameStreamSettings& InSettings)
+    : Settings(InSettings)
+{
+    Settings.SlotCount = FMath::Max(Settings.SlotCount, 2);
+    Settings.MaxReaders = FMath::Clamp(Settings.MaxReaders, 1, 64);
+    Settings.MaxFrameBytes = FMath::Max<int64>(Settings.MaxFrameBytes, 1);
+}
+
+FSharedFrameStream::~FSharedFrameStream()
+{
+    Close();
+}
+
+bool FSharedFrameStream::Open()
+{
+    if (Region)
+        return true;
+
+    const uint64 SlotSize = AlignUp(sizeof(FSlotHeader) + Settings.MaxFrameBytes, StreamAlignment);
+    const uint64 SlotsOffset = AlignUp(sizeof(FHeader) + sizeof(FReader) * Settings.MaxReaders, 4096);
+    const uint64 RegionSize = SlotsOffset + SlotSize * Settings.SlotCount;
+
+    Region = FPlatformMemory::MapNamedSharedMemoryRegion(Settings.Name, true,
+        FPlatformMemory::ESharedMemoryAccess::Read | FPlatformMemory::ESharedMemoryAccess::Write, RegionSize);
+    if (!Region)
+    {
+        UE_LOG(LogMLCapture, Error, TEXT("Frame stream: could not create shared memory region '%s' (%llu MB); a stale region from a previous run may still exist"),
+            *Settings.Name, RegionSize / (1024 * 1024));
+        return false;
+    }
+
+    Base = static_cast<uint8*>(Region->GetAddress());
+    FMemory::Memzero(Base, SlotsOffset);
+
+    FHeader* Header = GetHeader();
+    Header->Magic = MLFrameStream::Magic;
+    Header->Version = MLFrameStream::Version;
+    Header->SlotCount = Settings.SlotCount;
+    Header->MaxReaders = Settings.MaxReaders;
+    Header->SlotSize = SlotSize;
+    Header->SlotsOffset = SlotsOffset;
+    Header->Policy = static_cast<uint32>(Settings.Policy);
+
+    for (int32 SlotIndex = 0; SlotIndex < Settings.SlotCount; ++SlotIndex)
+    {
+        GetSlot(SlotIndex)->Seq = 0;
+    }
+
+    // Readers validate the header only after seeing the producer alive
+    FPlatformMisc::MemoryBarrier();
+    FPlatformAtomics::InterlockedExchange(reinterpret_cast<volatile int32*>(&Header->bProducerAlive), 1);
+
+    UE_LOG(LogMLCapture, Log, TEXT("Frame stream '%s' open: %d slots of %llu KB, policy %s"),
+        *Settings.Name, Settings.SlotCount, SlotSize / 1024, *UEnum::GetValueAsString(Settings.Policy));
+    return true;
+}
+
+void FSharedFrameStream::Close()
+{
+    if (!Region)
+        return;
+
+    FPlatformAtomics::InterlockedExchange(reinterpret_cast<volatile int32*>(&GetHeader()->bProducerAlive), 0);
+    FPlatformMemory::UnmapNamedSharedMemoryRegion(Region);
+    Region = nullptr;
+    Base = nullptr;
+
+    UE_LOG(LogMLCapture, Log, TEXT("Frame stream '%s' closed: %lld published, %lld dropped"), *Settings.Name, FramesPublished, FramesDropped);
+}
+
+FHeader* FSharedFrameStream::GetHeader() const
+{
+    return reinterpret_cast<FHeader*>(Base);
+}
+
+FReader* FSharedFrameStream::GetReader(int32 Index) const
+{
+    return reinterpret_cast<FReader*>(Base + sizeof(FHeader)) + Index;
+}
+
+FSlotHeader* FSharedFrameStream::GetSlot(int64 Seq) const
+{
+    const FHeader* Header = GetHeader();
+    return reinterpret_cast<FSlotHeader*>(Base + Header->SlotsOffset + (Seq % Header->SlotCount) * Header->SlotSize);
+}
+
+int32 FSharedFrameStream::GetNumActiveReaders() const
+{
+    if (!Region)
+        return 0;
+
+    int32 NumActive = 0;
+    for (int32 ReaderIndex = 0; ReaderIndex < Settings.MaxReaders; ++ReaderIndex)
+    {
+        NumActive += FPlatformAtomics::AtomicRead(&GetReader(ReaderIndex)->bActive) != 0 ? 1 : 0;
+    }
+    return NumActive;
+}
+
+int64 FSharedFrameStream::GetSlowestReadSeq() const
+{
+    int64 Slowest = -1;
+    for (int32 ReaderIndex = 0; ReaderIndex < Settings.MaxReaders; ++ReaderIndex)
+    {
+        const FReader* Reader = GetReader(ReaderIndex);
+        if (FPlatformAtomics::AtomicRead(&Reader->bActive) == 0)
+            continue;
+
+        const int64 ReadSeq = FPlatformAtomics::AtomicRead(&Reader->ReadSeq);
+        Slowest = Slowest < 0 ? ReadSeq : FMath::Min(Slowest, ReadSeq);
+    }
+    return Slowest;
+}
+
+bool FSharedFrameStream::ReleaseDeadReaders()
+{
+    bool bReleased = false;
+    for (int32 ReaderIndex = 0; ReaderIndex < Settings.MaxReaders; ++ReaderIndex)
+    {
+        FReader* Reader = GetReader(ReaderIndex);
+        // A zero pid is a reader between claiming the entry and recording itself
+        const uint32 ProcessId = Reader->ProcessId;
+        if (FPlatformAtomics::AtomicRead(&Reader->bActive) == 0 || ProcessId == 0 || FPlatformProcess::IsApplicationRunning(ProcessId))
+            continue;
+
+        // Clear the pid first so the entry is never seen free with a dead pid that a new reader could inherit
+        Reader->ProcessId = 0;
+        if (FPlatformAtomics::InterlockedCompareExchange(&Reader->bActive, 0, 1) == 1)
+        {
+            UE_LOG(LogMLCapture, Warning, TEXT("Frame stream '%s': reader %d (pid %u) exited without closing; released its entry"),
+                *Settings.Name, ReaderIndex, ProcessId);
+            bReleased = true;
+        }
+    }
+    return bReleased;
+}
+
+bool FSharedFrameStream::WaitForSpace(int64 Seq)
+{
+    if (Settings.Policy == EMLStreamBackpressure::OverwriteOldest)
+        return true;
+
+    auto HasSpace = [this, Seq]()
+    {
+        const int64 Slowest = GetSlowestReadSeq();
+        return Slowest < 0 || Seq - Slowest < Settings.SlotCount;
+    };
+
+    if (HasSpace())
+        return true;
+
+    // Only a reader holding the ring back is worth a liveness check; a crashed one would stall the stream for good
+    if (ReleaseDeadReaders() && HasSpace())
+        return true;
+    if (Settings.Policy == EMLStreamBackpressure::DropFrame)
+        return false;
+
+    const double Deadline = FPlatformTime::Seconds() + Settings.BlockTimeoutMs / 1000.0;
+    while (FPlatformTime::Seconds() < Deadline)
+    {
+        FPlatformProcess::YieldThread();
+        if (HasSpace())
+            return true;
+    }
+    return false;
+}
+
+bool FSharedFrameStream::Publish(const FMLCapturedFrame& Frame)
+{
+    ML_CAPTURE_SCOPE(STAT_MLCapture_StreamPublish);
+
+    if (!Region)
+        return false;
+
+    FHeader* Header = GetHeader();
+    const int64 PayloadSize = Frame.Pixels.Num();
+    if (PayloadSize > Settings.MaxFrameBytes)
+    {
+        if (!bWarnedOversized)
+        {
+            UE_LOG(LogMLCapture, Warning, TEXT("Frame stream: %lld byte frame exceeds the %lld byte slot payload; such frames are dropped"),
+                PayloadSize, Settings.MaxFrameBytes);
+            bWarnedOversized = true;
+        }
+        ++FramesDropped;
+        FPlatformAtomics::InterlockedIncrement(&Header->Dropped);
+        return false;
+    }
+
+    // Single producer: WriteSeq only changes here
+    const int64 Seq = Header->WriteSeq;
+    if (!WaitForSpace(Seq))
+    {
+        ++FramesDropped;
+        FPlatformAtomics::InterlockedIncrement(&Header->Dropped);
+        return false;
+    }
+
+    FSlotHeader* Slot = GetSlot(Seq);
+
+    // Odd sequence marks the slot as being written; it must be visible before any payload byte changes
+    FPlatformAtomics::InterlockedExchange(&Slot->Seq, 2 * Seq + 1);
+    FPlatformMisc::MemoryBarrier();
+
+    Slot->FrameIndex = Frame.FrameIndex;
+    Slot->CameraIndex = Frame.CameraIndex;
+    Slot->BufferType = static_cast<uint8>(Frame.BufferType);
+    Slot->PixelFormat = static_cast<uint8>(Frame.PixelFormat);
+    Slot->Codec = static_cast<uint8>(Frame.Codec);
+    Slot->Width = static_cast<uint32>(Frame.Width);
+    Slot->Height = static_cast<uint32>(Frame.Height);
+    Slot->BytesPerPixel = static_cast<uint32>(Frame.BytesPerPixel);
+    Slot->PayloadSize = static_cast<uint32>(PayloadSize);
+
+    const FVector Location = Frame.CameraPose.GetLocation();
+    const FQuat Rotation = Frame.CameraPose.GetRotation();
+    Slot->Position[0] = Location.X;
+    Slot->Position[1] = Location.Y;
+    Slot->Position[2] = Location.Z;
+    Slot->Rotation[0] = Rotation.X;
+    Slot->Rotation[1] = Rotation.Y;
+    Slot->Rotation[2] = Rotation.Z;
+    Slot->Rotation[3] = Rotation.W;
+
+    FMemory::Memcpy(reinterpret_cast<uint8*>(Slot) + sizeof(FSlotHeader), Frame.Pixels.GetData(), PayloadSize);
+
+    // Interlocked operations are full barriers: payload first, then the even sequence, then WriteSeq
+    FPlatformAtomics::InterlockedExchange(&Slot->Seq, 2 * Seq + 2);
+    FPlatformAtomics::InterlockedExchange(&Header->WriteSeq, Seq + 1);
+
+    ++FramesPublished;
+    return true;
+}
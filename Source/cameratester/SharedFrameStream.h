@@ -0,0 +1,133 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MLCaptureTypes.h"
+#include "SharedFrameStream.generated.h"
+
+struct FSharedMemoryRegion;
+
+// What the producer does when the slowest reader is a full ring behind
+UENUM(BlueprintType)
+enum class EMLStreamBackpressure : uint8
+{
+    // Skip publishing the new frame
+    DropFrame,
+    // Wait for readers up to a timeout, then drop
+    Block,
+    // Ignore readers; they detect overwritten slots and skip ahead
+    OverwriteOldest
+};
+
+// Shared-memory layout. Mirrored by Tools/FrameStream/ml_frame_stream.h and ml_frame_stream.py; bump
+// MLFS_VERSION in all three when it changes. Everything is little-endian and 64-byte aligned.
+//
+// Message N is written to slot N % SlotCount using a per-slot sequence:
+//   Seq = 2N+1 while the producer writes, 2N+2 once published; Header.WriteSeq = N+1 afterwards.
+// A reader consuming message N checks Seq == 2N+2 before and after touching the payload, then stores
+// N+1 in its ReadSeq. Unless the policy is OverwriteOldest the producer never reuses a slot that an
+// active reader has not released, so payloads can be used in place. Readers record their ProcessId after
+// claiming an entry and zero it before releasing it; the producer releases entries of exited processes.
+namespace MLFrameStream
+{
+    constexpr uint32 Magic = 0x53464C4D; // "MLFS"
+    constexpr uint32 Version = 1;
+
+    struct FHeader
+    {
+        uint32 Magic;
+        uint32 Version;
+        uint32 SlotCount;
+        uint32 MaxReaders;
+        uint64 SlotSize;        // Bytes per slot including FSlotHeader
+        uint64 SlotsOffset;     // Byte offset of slot 0 from the start of the region
+        uint32 Policy;          // EMLStreamBackpressure
+        uint32 bProducerAlive;  // Cleared when the engine closes the stream
+        volatile int64 WriteSeq;
+        volatile int64 Dropped;
+        uint8 Pad[8];
+    };
+
+    struct FReader
+    {
+        volatile int64 ReadSeq;
+        volatile int32 bActive;
+        uint32 ProcessId;
+        uint8 Pad[48];
+    };
+
+    struct FSlotHeader
+    {
+        volatile int64 Seq;
+        int64 FrameIndex;
+        int32 CameraIndex;
+        uint8 BufferType;       // EMLBufferType
+        uint8 PixelFormat;      // EPixelFormat
+        uint8 Codec;            // EMLFrameCodec
+        uint8 Reserved0;
+        uint32 Width;
+        uint32 Height;
+        uint32 BytesPerPixel;
+        uint32 PayloadSize;
+        double Position[3];
+        double Rotation[4];     // Quaternion x, y, z, w
+        uint8 Pad[32];
+    };
+
+    static_assert(sizeof(FHeader) == 64, "Stream header layout is shared with external readers");
+    static_assert(sizeof(FReader) == 64, "Stream reader layout is shared with external readers");
+    static_assert(sizeof(FSlotHeader) == 128, "Stream slot layout is shared with external readers");
+}
+
+struct FSharedFrameStreamSettings
+{
+    // Region name; Python opens it with shared_memory.SharedMemory(Name)
+    FString Name = TEXT("cameratester_frames");
+
+    int32 SlotCount = 32;
+    int64 MaxFrameBytes = 512 * 512 * 8;
+    int32 MaxReaders = 8;
+
+    EMLStreamBackpressure Policy = EMLStreamBackpressure::DropFrame;
+    float BlockTimeoutMs = 100.0f;
+};
+
+// Single-producer / multi-consumer ring of fixed-size frame slots in named shared memory.
+// The game thread publishes; any number of local processes read the pixels in place without serialization.
+class CAMERATESTER_API FSharedFrameStream
+{
+public:
+    explicit FSharedFrameStream(const FSharedFrameStreamSettings& InSettings);
+    ~FSharedFrameStream();
+
+    bool Open();
+    void Close();
+    bool IsOpen() const { return Region != nullptr; }
+
+    // Copies one buffer into the next slot. Returns false if it was dropped (too large or readers behind).
+    bool Publish(const FMLCapturedFrame& Frame);
+
+    int64 GetFramesPublished() const { return FramesPublished; }
+    int64 GetFramesDropped() const { return FramesDropped; }
+    int32 GetNumActiveReaders() const;
+
+    const FSharedFrameStreamSettings& GetSettings() const { return Settings; }
+
+private:
+    // Lowest ReadSeq of the attached readers, or -1 if none are attached
+    int64 GetSlowestReadSeq() const;
+    // Deactivates entries whose reader process has exited; true if any were released
+    bool ReleaseDeadReaders();
+    bool WaitForSpace(int64 Seq);
+
+    MLFrameStream::FHeader* GetHeader() const;
+    MLFrameStream::FReader* GetReader(int32 Index) const;
+    MLFrameStream::FSlotHeader* GetSlot(int64 Seq) const;
+
+    FSharedFrameStreamSettings Settings;
+    FSharedMemoryRegion* Region = nullptr;
+    uint8* Base = nullptr;
+
+    int64 FramesPublished = 0;
+    int64 FramesDropped = 0;
+    bool bWarnedOversized = false;
+};
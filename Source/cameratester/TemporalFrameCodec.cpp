@@ -0,0 +1,249 @@
+#include "TemporalFrameCodec.h"
+#include "MLCaptureStats.h"
+#include "Misc/Compression.h"
+#include <type_traits>
+
+namespace
+{
+    // Longest residual chain followed back to a keyframe; longer chains mean a corrupt or foreign stream
+    constexpr int32 MaxChainLength = 1 << 16;
+
+    template<typename WordType>
+    FORCEINLINE WordType LoadWord(const uint8* Data, int64 Index)
+    {
+        WordType Value;
+        FMemory::Memcpy(&Value, Data + Index * sizeof(WordType), sizeof(WordType));
+        return Value;
+    }
+
+    // Small negative residuals become small positive ones instead of all-ones high bytes
+    template<typename WordType>
+    FORCEINLINE WordType ZigZag(WordType Delta)
+    {
+        using FSignedWord = std::make_signed_t<WordType>;
+        const FSignedWord Signed = static_cast<FSignedWord>(Delta);
+        return static_cast<WordType>(static_cast<WordType>(Delta << 1) ^ static_cast<WordType>(Signed >> (sizeof(WordType) * 8 - 1)));
+    }
+
+    template<typename WordType>
+    FORCEINLINE WordType UnZigZag(WordType Value)
+    {
+        return static_cast<WordType>((Value >> 1) ^ static_cast<WordType>(0 - (Value & 1)));
+    }
+
+    // Each word minus the same word of Reference, or minus the same channel of the previous pixel in its row when
+    // Reference is null; written straight into byte planes
+    template<typename WordType>
+    void EncodeResiduals(const uint8* Src, const uint8* Reference, uint8* Planes, int32 Width, int32 Height, int32 Channels)
+    {
+        const int64 RowWords = static_cast<int64>(Width) * Channels;
+        const int64 NumWords = RowWords * Height;
+        for (int64 Y = 0; Y < Height; ++Y)
+        {
+            for (int64 i = 0; i < RowWords; ++i)
+            {
+                const int64 Index = Y * RowWords + i;
+                WordType Predicted = 0;
+                if (Reference)
+                {
+                    Predicted = LoadWord<WordType>(Reference, Index);
+                }
+                else if (i >= Channels)
+                {
+                    Predicted = LoadWord<WordType>(Src, Index - Channels);
+                }
+
+                const WordType Residual = ZigZag<WordType>(static_cast<WordType>(LoadWord<WordType>(Src, Index) - Predicted));
+                for (int32 Byte = 0; Byte < static_cast<int32>(sizeof(WordType)); ++Byte)
+                {
+                    Planes[Byte * NumWords + Index] = static_cast<uint8>(Residual >> (Byte * 8));
+                }
+            }
+        }
+    }
+
+    template<typename WordType>
+    void DecodeResiduals(const uint8* Planes, const uint8* Reference, uint8* Dst, int32 Width, int32 Height, int32 Channels)
+    {
+        const int64 RowWords = static_cast<int64>(Width) * Channels;
+        const int64 NumWords = RowWords * Height;
+        for (int64 Y = 0; Y < Height; ++Y)
+        {
+            for (int64 i = 0; i < RowWords; ++i)
+            {
+                const int64 Index = Y * RowWords + i;
+                WordType Residual = 0;
+                for (int32 Byte = 0; Byte < static_cast<int32>(sizeof(WordType)); ++Byte)
+                {
+                    Residual |= static_cast<WordType>(static_cast<WordType>(Planes[Byte * NumWords + Index]) << (Byte * 8));
+                }
+
+                WordType Predicted = 0;
+                if (Reference)
+                {
+                    Predicted = LoadWord<WordType>(Reference, Index);
+                }
+                else if (i >= Channels)
+                {
+                    Predicted = LoadWord<WordType>(Dst, Index - Channels);
+                }
+
+                const WordType Value = static_cast<WordType>(UnZigZag<WordType>(Residual) + Predicted);
+                FMemory::Memcpy(Dst + Index * sizeof(WordType), &Value, sizeof(WordType));
+            }
+        }
+    }
+}
+
+void TemporalFrameCodec::GetWordLayout(EPixelFormat PixelFormat, int32 BytesPerPixel, int32& OutWordBytes, int32& OutChannels)
+{
+    switch (PixelFormat)
+    {
+    case PF_R32_FLOAT:       OutWordBytes = 4; OutChannels = 1; break;
+    case PF_A32B32G32R32F:   OutWordBytes = 4; OutChannels = 4; break;
+    case PF_G16:
+    case PF_R16F:            OutWordBytes = 2; OutChannels = 1; break;
+    case PF_FloatRGBA:       OutWordBytes = 2; OutChannels = 4; break;
+    default:                 OutWordBytes = 1; OutChannels = FMath::Max(BytesPerPixel, 1); break;
+    }
+}
+
+bool TemporalFrameCodec::Encode(const FMLCapturedFrame& Source, const FMLCapturedFrame* Reference, int64 KeyframeIndex,
+    FName CompressionFormat, TArray<uint8>& Scratch, TArray<uint8>& Out)
+{
+    int32 WordBytes = 1;
+    int32 Channels = 1;
+    GetWordLayout(Source.PixelFormat, Source.BytesPerPixel, WordBytes, Channels);
+
+    const int32 SrcBytes = Source.Pixels.Num();
+    if (SrcBytes == 0 || Source.Width > MAX_uint16 || Source.Height > MAX_uint16
+        || static_cast<int64>(Source.Width) * Source.Height * Channels * WordBytes != SrcBytes)
+        return false;
+
+    if (Reference && (Reference->Pixels.Num() != SrcBytes || Reference->Width != Source.Width || Reference->Height != Source.Height || Reference->PixelFormat != Source.PixelFormat))
+        return false;
+
+    Scratch.SetNumUninitialized(SrcBytes, EAllowShrinking::No);
+    const uint8* ReferencePixels = Reference ? Reference->Pixels.GetData() : nullptr;
+    switch (WordBytes)
+    {
+    case 4:  EncodeResiduals<uint32>(Source.Pixels.GetData(), ReferencePixels, Scratch.GetData(), Source.Width, Source.Height, Channels); break;
+    case 2:  EncodeResiduals<uint16>(Source.Pixels.GetData(), ReferencePixels, Scratch.GetData(), Source.Width, Source.Height, Channels); break;
+    default: EncodeResiduals<uint8>(Source.Pixels.GetData(), ReferencePixels, Scratch.GetData(), Source.Width, Source.Height, Channels); break;
+    }
+
+    FMLTemporalFrameHeader Header;
+    Header.WordBytes = static_cast<uint8>(WordBytes);
+    Header.Channels = static_cast<uint8>(Channels);
+    Header.ReferenceFrameIndex = Reference ? Reference->FrameIndex : INDEX_NONE;
+    Header.KeyframeIndex = KeyframeIndex;
+    Header.Width = static_cast<uint16>(Source.Width);
+    Header.Height = static_cast<uint16>(Source.Height);
+    Header.RawSize = static_cast<uint32>(SrcBytes);
+
+    int32 CompressedBytes = FCompression::CompressMemoryBound(CompressionFormat, SrcBytes);
+    Out.SetNumUninitialized(sizeof(Header) + CompressedBytes, EAllowShrinking::No);
+    FMemory::Memcpy(Out.GetData(), &Header, sizeof(Header));
+    if (!FCompression::CompressMemory(CompressionFormat, Out.GetData() + sizeof(Header), CompressedBytes, Scratch.GetData(), SrcBytes, COMPRESS_BiasSpeed))
+        return false;
+
+    Out.SetNum(sizeof(Header) + CompressedBytes, EAllowShrinking::No);
+    return true;
+}
+
+bool TemporalFrameCodec::ReadHeader(const uint8* Data, int64 NumBytes, FMLTemporalFrameHeader& OutHeader)
+{
+    if (!Data || NumBytes < static_cast<int64>(sizeof(FMLTemporalFrameHeader)))
+        return false;
+
+    FMemory::Memcpy(&OutHeader, Data, sizeof(OutHeader));
+    const FMLTemporalFrameHeader Expected;
+    return OutHeader.Magic == Expected.Magic && OutHeader.Version <= Expected.Version
+        && (OutHeader.WordBytes == 1 || OutHeader.WordBytes == 2 || OutHeader.WordBytes == 4) && OutHeader.Channels > 0
+        && static_cast<int64>(OutHeader.Width) * OutHeader.Height * OutHeader.Channels * OutHeader.WordBytes == OutHeader.RawSize;
+}
+
+bool TemporalFrameCodec::Decode(const uint8* Data, int64 NumBytes, const uint8* ReferencePixels, int64 ReferenceBytes,
+    FName CompressionFormat, TArray<uint8>& Scratch, TArray<uint8>& OutPixels)
+{
+    FMLTemporalFrameHeader Header;
+    if (!ReadHeader(Data, NumBytes, Header))
+        return false;
+
+    const uint8* Reference = Header.IsKeyframe() ? nullptr : ReferencePixels;
+    if (!Header.IsKeyframe() && (!Reference || ReferenceBytes != Header.RawSize))
+        return false;
+
+    Scratch.SetNumUninitialized(Header.RawSize, EAllowShrinking::No);
+    if (!FCompression::UncompressMemory(CompressionFormat, Scratch.GetData(), Header.RawSize, Data + sizeof(Header), NumBytes - sizeof(Header)))
+        return false;
+
+    OutPixels.SetNumUninitialized(Header.RawSize, EAllowShrinking::No);
+    switch (Header.WordBytes)
+    {
+    case 4:  DecodeResiduals<uint32>(Scratch.GetData(), Reference, OutPixels.GetData(), Header.Width, Header.Height, Header.Channels); break;
+    case 2:  DecodeResiduals<uint16>(Scratch.GetData(), Reference, OutPixels.GetData(), Header.Width, Header.Height, Header.Channels); break;
+    default: DecodeResiduals<uint8>(Scratch.GetData(), Reference, OutPixels.GetData(), Header.Width, Header.Height, Header.Channels); break;
+    }
+    return true;
+}
+
+FTemporalStreamDecoder::FTemporalStreamDecoder(FReadPayload InReadPayload, FName InCompressionFormat)
+    : ReadPayload(MoveTemp(InReadPayload))
+    , CompressionFormat(InCompressionFormat)
+{
+}
+
+bool FTemporalStreamDecoder::DecodeFrame(int64 FrameIndex, TArray<uint8>& OutPixels)
+{
+    if (FrameIndex == CachedFrameIndex)
+    {
+        OutPixels = CachedPixels;
+        return true;
+    }
+
+    // Walk back through the references until a keyframe or the frame decoded last
+    int32 NumPayloads = 0;
+    int64 Current = FrameIndex;
+    for (;;)
+    {
+        if (NumPayloads == Payloads.Num())
+        {
+            Payloads.AddDefaulted();
+        }
+        TArray<uint8>& Payload = Payloads[NumPayloads++];
+
+        FMLTemporalFrameHeader Header;
+        if (!ReadPayload(Current, Payload) || !TemporalFrameCodec::ReadHeader(Payload.GetData(), Payload.Num(), Header))
+        {
+            UE_LOG(LogMLCapture, Warning, TEXT("Cannot decode frame %lld: frame %lld of its temporal chain is missing or not a temporal frame"), FrameIndex, Current);
+            return false;
+        }
+        if (Header.IsKeyframe() || Header.ReferenceFrameIndex == CachedFrameIndex)
+            break;
+
+        if (NumPayloads >= MaxChainLength)
+        {
+            UE_LOG(LogMLCapture, Warning, TEXT("Cannot decode frame %lld: no keyframe within %d frames"), FrameIndex, MaxChainLength);
+            return false;
+        }
+        Current = Header.ReferenceFrameIndex;
+    }
+
+    // Decode forward, each frame becoming the reference of the next
+    for (int32 Index = NumPayloads - 1; Index >= 0; --Index)
+    {
+        const TArray<uint8>& Payload = Payloads[Index];
+        if (!TemporalFrameCodec::Decode(Payload.GetData(), Payload.Num(), CachedPixels.GetData(), CachedPixels.Num(), CompressionFormat, Scratch, DecodedPixels))
+        {
+            CachedFrameIndex = INDEX_NONE;
+            UE_LOG(LogMLCapture, Warning, TEXT("Cannot decode frame %lld: corrupt temporal payload"), FrameIndex);
+            return false;
+        }
+        Swap(CachedPixels, DecodedPixels);
+    }
+
+    CachedFrameIndex = FrameIndex;
+    OutPixels = CachedPixels;
+    return true;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MLCaptureTypes.h"
+
+// Payload prefix of every EMLFrameCodec::TemporalDelta frame. The rest of the payload is the compressed residual
+// words split into byte planes (all first bytes, then all second bytes, ...).
+#pragma pack(push, 1)
+struct FMLTemporalFrameHeader
+{
+    uint32 Magic = 0x44544C4D; // "MLTD"
+    uint16 Version = 1;
+    uint8 WordBytes = 1;
+    uint8 Channels = 1;
+    // Frame this residual was taken against: the previous encoded frame of the same capture. INDEX_NONE for keyframes.
+    int64 ReferenceFrameIndex = INDEX_NONE;
+    // Keyframe the chain through ReferenceFrameIndex ends at
+    int64 KeyframeIndex = 0;
+    uint16 Width = 0;
+    uint16 Height = 0;
+    // Decoded pixel bytes: Width * Height * Channels * WordBytes
+    uint32 RawSize = 0;
+
+    bool IsKeyframe() const { return ReferenceFrameIndex == INDEX_NONE; }
+};
+#pragma pack(pop)
+
+static_assert(sizeof(FMLTemporalFrameHeader) == 32, "Temporal frame header layout is part of the file format");
+
+// Lossless per-capture stream codec for slowly changing buffers such as depth and normals. Keyframes store
+// zigzagged row deltas; every other frame stores zigzagged word differences against the previous frame of the
+// same capture. Both go through byte-plane splitting, which turns the near-zero high bytes into long runs, and
+// then the generic compressor.
+namespace TemporalFrameCodec
+{
+    // Word size and interleaved channel count residuals are taken over; unknown formats use single bytes
+    CAMERATESTER_API void GetWordLayout(EPixelFormat PixelFormat, int32 BytesPerPixel, int32& OutWordBytes, int32& OutChannels);
+
+    // Reference null encodes a keyframe. Reference must match Source in size and format. Scratch is reused between calls.
+    CAMERATESTER_API bool Encode(const FMLCapturedFrame& Source, const FMLCapturedFrame* Reference, int64 KeyframeIndex,
+        FName CompressionFormat, TArray<uint8>& Scratch, TArray<uint8>& Out);
+
+    CAMERATESTER_API bool ReadHeader(const uint8* Data, int64 NumBytes, FMLTemporalFrameHeader& OutHeader);
+
+    // ReferencePixels are the decoded pixels of the header's ReferenceFrameIndex; ignored for keyframes
+    CAMERATESTER_API bool Decode(const uint8* Data, int64 NumBytes, const uint8* ReferencePixels, int64 ReferenceBytes,
+        FName CompressionFormat, TArray<uint8>& Scratch, TArray<uint8>& OutPixels);
+}
+
+// Random access into one capture's TemporalDelta stream. A frame is rebuilt from the nearest keyframe before it,
+// or from the last frame this decoder produced when that is closer, so sequential reads decode one residual each.
+class CAMERATESTER_API FTemporalStreamDecoder
+{
+public:
+    // Fills OutPayload with the stored bytes of FrameIndex in this stream; false if the frame is missing
+    using FReadPayload = TFunction<bool(int64 FrameIndex, TArray<uint8>& OutPayload)>;
+
+    explicit FTemporalStreamDecoder(FReadPayload InReadPayload, FName InCompressionFormat = NAME_Oodle);
+
+    bool DecodeFrame(int64 FrameIndex, TArray<uint8>& OutPixels);
+
+    // Drop the cached frame, e.g. after the stream was rewritten
+    void Reset() { CachedFrameIndex = INDEX_NONE; }
+
+private:
+    FReadPayload ReadPayload;
+    FName CompressionFormat;
+
+    int64 CachedFrameIndex = INDEX_NONE;
+    TArray<uint8> CachedPixels;
+    TArray<uint8> DecodedPixels;
+    TArray<uint8> Scratch;
+    TArray<TArray<uint8>> Payloads;
+};
@@ -0,0 +1,213 @@
+/*
+ * Reader for the shared-memory frame stream published by ARenderTargetManager (bStreamFrames).
+ * Header-only, C11, POSIX (shm_open/mmap). Layout and protocol: Source/cameratester/SharedFrameStream.h.
+ *
+ *     mlfs_reader reader;
+ *     if (mlfs_open(&reader, "cameratester_frames") == 0) {
+ *         mlfs_frame frame;
+ *         for (;;) {
+ *             if (!mlfs_acquire(&reader, &frame)) { if (!mlfs_producer_alive(&reader)) break; continue; }
+ *             consume(frame.slot, frame.pixels);
+ *             if (!mlfs_release(&reader, &frame)) { discard: the producer overwrote it meanwhile }
+ *         }
+ *         mlfs_close(&reader);
+ *     }
+ */
+#ifndef ML_FRAME_STREAM_H
+#define ML_FRAME_STREAM_H
+
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MLFS_MAGIC 0x53464C4Du
+#define MLFS_VERSION 1u
+
+enum mlfs_policy { MLFS_DROP_FRAME = 0, MLFS_BLOCK = 1, MLFS_OVERWRITE_OLDEST = 2 };
+enum mlfs_buffer_type {
+    MLFS_RGB = 0, MLFS_SCENE_DEPTH = 1, MLFS_ML_DEPTH = 2, MLFS_NORMAL = 3, MLFS_SEGMENTATION = 4, MLFS_LABELS = 5
+};
+
+typedef struct mlfs_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slot_count;
+    uint32_t max_readers;
+    uint64_t slot_size;
+    uint64_t slots_offset;
+    uint32_t policy;
+    _Atomic uint32_t producer_alive;
+    _Atomic int64_t write_seq;
+    _Atomic int64_t dropped;
+    uint8_t pad[8];
+} mlfs_header;
+
+typedef struct mlfs_reader_slot {
+    _Atomic int64_t read_seq;
+    _Atomic int32_t active;
+    uint32_t pid;
+    uint8_t pad[48];
+} mlfs_reader_slot;
+
+typedef struct mlfs_slot {
+    _Atomic int64_t seq;
+    int64_t frame_index;
+    int32_t camera_index;
+    uint8_t buffer_type;
+    uint8_t pixel_format;
+    uint8_t codec;
+    uint8_t reserved0;
+    uint32_t width;
+    uint32_t height;
+    uint32_t bytes_per_pixel;
+    uint32_t payload_size;
+    double position[3];
+    double rotation[4]; /* quaternion x, y, z, w */
+    uint8_t pad[32];
+} mlfs_slot;
+
+_Static_assert(sizeof(mlfs_header) == 64, "mlfs_header layout");
+_Static_assert(sizeof(mlfs_reader_slot) == 64, "mlfs_reader_slot layout");
+_Static_assert(sizeof(mlfs_slot) == 128, "mlfs_slot layout");
+
+typedef struct mlfs_reader {
+    uint8_t* base;
+    size_t size;
+    mlfs_header* header;
+    mlfs_reader_slot* self;
+    int64_t next_seq;
+    int64_t lost;       /* messages skipped because the producer lapped this reader */
+} mlfs_reader;
+
+typedef struct mlfs_frame {
+    const mlfs_slot* slot;
+    const uint8_t* pixels;  /* slot->payload_size bytes, valid until mlfs_release */
+    int64_t seq;
+} mlfs_frame;
+
+static inline mlfs_slot* mlfs__slot(const mlfs_reader* r, int64_t seq)
+{
+    return (mlfs_slot*)(r->base + r->header->slots_offset + (uint64_t)(seq % r->header->slot_count) * r->header->slot_size);
+}
+
+/* Map the region and claim a reader slot. Starts at the newest message. Returns 0 on success. */
+static inline int mlfs_open(mlfs_reader* r, const char* name)
+{
+    char path[256];
+    memset(r, 0, sizeof(*r));
+    if (snprintf(path, sizeof(path), "%s%s", name[0] == '/' ? "" : "/", name) >= (int)sizeof(path))
+        return -1;
+
+    int fd = shm_open(path, O_RDWR, 0);
+    if (fd < 0)
+        return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(mlfs_header)) {
+        close(fd);
+        return -1;
+    }
+
+    void* base = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return -1;
+
+    r->base = (uint8_t*)base;
+    r->size = (size_t)st.st_size;
+    r->header = (mlfs_header*)base;
+
+    if (!atomic_load_explicit(&r->header->producer_alive, memory_order_acquire) ||
+        r->header->magic != MLFS_MAGIC || r->header->version != MLFS_VERSION) {
+        munmap(base, r->size);
+        memset(r, 0, sizeof(*r));
+        return -2;
+    }
+
+    mlfs_reader_slot* readers = (mlfs_reader_slot*)(r->base + sizeof(mlfs_header));
+    for (uint32_t i = 0; i < r->header->max_readers; ++i) {
+        int32_t expected = 0;
+        /* Publish read_seq before becoming visible as active so the producer never sees a stale position */
+        if (atomic_load(&readers[i].active) == 0) {
+            const int64_t start = atomic_load_explicit(&r->header->write_seq, memory_order_acquire);
+            atomic_store(&readers[i].read_seq, start);
+            if (atomic_compare_exchange_strong(&readers[i].active, &expected, 1)) {
+                atomic_store(&readers[i].read_seq, start); /* a losing racer may have written its own start */
+                readers[i].pid = (uint32_t)getpid();
+                r->self = &readers[i];
+                r->next_seq = start;
+                return 0;
+            }
+        }
+    }
+
+    munmap(base, r->size);
+    memset(r, 0, sizeof(*r));
+    return -3; /* all reader slots taken */
+}
+
+static inline void mlfs_close(mlfs_reader* r)
+{
+    /* Zero the pid before releasing, so the producer never mistakes the next claimant for this (exited) process */
+    if (r->self) {
+        r->self->pid = 0;
+        atomic_store(&r->self->active, 0);
+    }
+    if (r->base)
+        munmap(r->base, r->size);
+    memset(r, 0, sizeof(*r));
+}
+
+static inline int mlfs_producer_alive(const mlfs_reader* r)
+{
+    return atomic_load_explicit(&r->header->producer_alive, memory_order_acquire) != 0;
+}
+
+/* Next published message, in place. Returns 1 if a frame is available, 0 otherwise. */
+static inline int mlfs_acquire(mlfs_reader* r, mlfs_frame* out)
+{
+    for (;;) {
+        const int64_t written = atomic_load_explicit(&r->header->write_seq, memory_order_acquire);
+        if (r->next_seq >= written)
+            return 0;
+
+        /* Lapped: everything older than one ring is gone */
+        if (written - r->next_seq > (int64_t)r->header->slot_count) {
+            r->lost += written - (int64_t)r->header->slot_count - r->next_seq;
+            r->next_seq = written - (int64_t)r->header->slot_count;
+        }
+
+        mlfs_slot* slot = mlfs__slot(r, r->next_seq);
+        const int64_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (seq == 2 * r->next_seq + 2) {
+            out->slot = slot;
+            out->pixels = (const uint8_t*)slot + sizeof(mlfs_slot);
+            out->seq = r->next_seq;
+            return 1;
+        }
+        if (seq < 2 * r->next_seq + 2)
+            return 0;
+
+        /* Overwritten between the two loads */
+        ++r->lost;
+        ++r->next_seq;
+    }
+}
+
+/* Done with the frame; lets the producer reuse its slot. Returns 0 if the slot was overwritten while in use. */
+static inline int mlfs_release(mlfs_reader* r, const mlfs_frame* frame)
+{
+    atomic_thread_fence(memory_order_acquire);
+    const int valid = atomic_load_explicit(&frame->slot->seq, memory_order_relaxed) == 2 * frame->seq + 2;
+    r->next_seq = frame->seq + 1;
+    atomic_store_explicit(&r->self->read_seq, r->next_seq, memory_order_release);
+    return valid;
+}
+
+#endif /* ML_FRAME_STREAM_H */
@@ -0,0 +1,272 @@
+"""Reader for the shared-memory frame stream published by ARenderTargetManager (bStreamFrames).
+
+Layout and protocol: Source/cameratester/SharedFrameStream.h (mirrored by ml_frame_stream.h).
+Pixels are exposed in place as memoryviews / numpy views over the shared region; copy them (or hand
+them to torch.from_numpy(...).clone()) before calling release() if they must outlive the slot.
+
+    with FrameStreamReader("cameratester_frames") as stream:
+        for frame in stream.frames():
+            depth = frame.as_numpy()
+            ...
+            frame.release()
+
+Multiple readers in different processes are supported; each claims one reader entry with the same
+compare-and-swap as ml_frame_stream.h (through libatomic), or under a lock file where libatomic is missing.
+"""
+
+import ctypes
+import ctypes.util
+import os
+import struct
+import tempfile
+import time
+from multiprocessing import shared_memory
+
+MLFS_MAGIC = 0x53464C4D
+MLFS_VERSION = 1
+
+HEADER_SIZE = 64
+READER_SIZE = 64
+SLOT_HEADER_SIZE = 128
+
+# magic, version, slot_count, max_readers, slot_size, slots_offset, policy, producer_alive, write_seq, dropped
+_HEADER = struct.Struct("<IIIIQQIIqq")
+# seq, frame_index, camera_index, buffer_type, pixel_format, codec, reserved, width, height, bpp, payload_size, pos[3], rot[4]
+_SLOT = struct.Struct("<qqiBBBBIIII3d4d")
+
+# Header field offsets, in 8-byte words where atomics live
+_WRITE_SEQ_WORD = 40 // 8
+_DROPPED_WORD = 48 // 8
+_PRODUCER_ALIVE_OFFSET = 36
+
+BUFFER_TYPES = {0: "rgb", 1: "scene_depth", 2: "ml_depth", 3: "normal", 4: "segmentation", 5: "labels"}
+POLICIES = {0: "drop_frame", 1: "block", 2: "overwrite_oldest"}
+
+# EPixelFormat values the capture pipeline produces -> (numpy dtype, channels)
+PIXEL_FORMATS = {
+    1: ("float32", 4),   # PF_A32B32G32R32F
+    2: ("uint8", 4),     # PF_B8G8R8A8
+    3: ("uint8", 1),     # PF_G8
+    4: ("uint16", 1),    # PF_G16
+    10: ("float16", 4),  # PF_FloatRGBA
+    13: ("float32", 1),  # PF_R32_FLOAT
+    21: ("float16", 1),  # PF_R16F
+}
+
+
+class Frame:
+    """One published buffer. Valid until release(); release() returns False if it was overwritten meanwhile."""
+
+    def __init__(self, reader, seq, fields, pixels):
+        self._reader = reader
+        self.seq = seq
+        (_, self.frame_index, self.camera_index, buffer_type, self.pixel_format, self.codec, _,
+         self.width, self.height, self.bytes_per_pixel, payload_size, *pose) = fields
+        self.buffer_type = BUFFER_TYPES.get(buffer_type, buffer_type)
+        self.position = tuple(pose[0:3])
+        self.rotation = tuple(pose[3:7])  # quaternion x, y, z, w
+        self.pixels = pixels[:payload_size]
+        self._released = False
+
+    def as_numpy(self):
+        """Zero-copy view shaped (height, width[, channels]); raw bytes for unknown formats or encoded frames."""
+        import numpy as np
+
+        if self.codec != 0 or self.pixel_format not in PIXEL_FORMATS:
+            return np.frombuffer(self.pixels, dtype=np.uint8)
+        dtype, channels = PIXEL_FORMATS[self.pixel_format]
+        array = np.frombuffer(self.pixels, dtype=dtype)
+        shape = (self.height, self.width) if channels == 1 else (self.height, self.width, channels)
+        return array.reshape(shape)
+
+    def release(self):
+        if self._released:
+            return True
+        self._released = True
+        self.pixels.release()
+        return self._reader._release(self.seq)
+
+
+class FrameStreamReader:
+    def __init__(self, name="cameratester_frames", reader_index=None):
+        self._name = name
+        self._shm = _open_shared_memory(name)
+        self._buf = self._shm.buf
+        self._words = self._buf[:HEADER_SIZE].cast("q")
+
+        (magic, version, self.slot_count, self.max_readers, self.slot_size, self.slots_offset,
+         policy, alive, _, _) = _HEADER.unpack_from(self._buf, 0)
+        if magic != MLFS_MAGIC or version != MLFS_VERSION or not alive:
+            self._close_views()
+            raise RuntimeError(f"'{name}' is not a live frame stream (magic {magic:#x}, version {version})")
+        self.policy = POLICIES.get(policy, policy)
+
+        try:
+            self._reader_offset = self._claim_reader(reader_index)
+        except RuntimeError:
+            self._close_views()
+            raise
+        self._reader_words = self._buf[self._reader_offset:self._reader_offset + READER_SIZE].cast("q")
+        self.next_seq = self._reader_words[0]
+        self.lost = 0
+
+    # Reader registration mirrors mlfs_open: publish read_seq first, then mark active
+    def _claim_reader(self, reader_index):
+        candidates = [reader_index] if reader_index is not None else range(self.max_readers)
+        for index in candidates:
+            offset = HEADER_SIZE + index * READER_SIZE
+            active, = struct.unpack_from("<i", self._buf, offset + 8)
+            if active:
+                continue
+            start = self._words[_WRITE_SEQ_WORD]
+            struct.pack_into("<q", self._buf, offset, start)
+            if not self._try_activate(offset + 8):
+                continue
+            struct.pack_into("<q", self._buf, offset, start)  # a losing racer may have written its own start
+            struct.pack_into("<I", self._buf, offset + 12, os.getpid())
+            return offset
+        raise RuntimeError("no free reader slot in the frame stream")
+
+    def _try_activate(self, active_offset):
+        """Flips a reader entry's active flag from 0 to 1; False if another reader got there first."""
+        if _ATOMIC_CAS is not None:
+            flag = ctypes.c_int32.from_buffer(self._buf, active_offset)
+            expected = ctypes.c_int32(0)
+            try:
+                return _ATOMIC_CAS(ctypes.addressof(flag), ctypes.byref(expected), 1, _SEQ_CST, _SEQ_CST)
+            finally:
+                del flag  # the shared memory cannot be closed while ctypes holds a view of it
+
+        # Without libatomic only other Python readers are kept out, by serialising claims on a lock file
+        import fcntl
+
+        with open(os.path.join(tempfile.gettempdir(), f"{self._name.lstrip('/')}.readers.lock"), "a") as lock:
+            fcntl.flock(lock, fcntl.LOCK_EX)
+            if struct.unpack_from("<i", self._buf, active_offset)[0]:
+                return False
+            struct.pack_into("<i", self._buf, active_offset, 1)
+            return True
+
+    @property
+    def producer_alive(self):
+        return struct.unpack_from("<I", self._buf, _PRODUCER_ALIVE_OFFSET)[0] != 0
+
+    @property
+    def producer_dropped(self):
+        return self._words[_DROPPED_WORD]
+
+    def _slot_offset(self, seq):
+        return self.slots_offset + (seq % self.slot_count) * self.slot_size
+
+    def try_acquire(self):
+        """Next frame, or None if nothing new has been published."""
+        while True:
+            written = self._words[_WRITE_SEQ_WORD]
+            if self.next_seq >= written:
+                return None
+            if written - self.next_seq > self.slot_count:
+                self.lost += written - self.slot_count - self.next_seq
+                self.next_seq = written - self.slot_count
+
+            offset = self._slot_offset(self.next_seq)
+            fields = _SLOT.unpack_from(self._buf, offset)
+            expected = 2 * self.next_seq + 2
+            if fields[0] == expected:
+                start = offset + SLOT_HEADER_SIZE
+                return Frame(self, self.next_seq, fields, self._buf[start:start + self.slot_size - SLOT_HEADER_SIZE])
+            if fields[0] < expected:
+                return None
+            self.lost += 1
+            self.next_seq += 1
+
+    def _release(self, seq):
+        valid = struct.unpack_from("<q", self._buf, self._slot_offset(seq))[0] == 2 * seq + 2
+        self.next_seq = seq + 1
+        self._reader_words[0] = self.next_seq
+        return valid
+
+    def frames(self, poll_interval=0.0005):
+        """Yields frames until the producer closes the stream."""
+        while True:
+            frame = self.try_acquire()
+            if frame is not None:
+                yield frame
+                frame.release()
+                continue
+            if not self.producer_alive:
+                return
+            time.sleep(poll_interval)
+
+    def close(self):
+        if self._shm is None:
+            return
+        # Zero the pid before releasing, as mlfs_close does
+        struct.pack_into("<I", self._buf, self._reader_offset + 12, 0)
+        struct.pack_into("<i", self._buf, self._reader_offset + 8, 0)
+        self._close_views()
+
+    def _close_views(self):
+        for view in ("_reader_words", "_words"):
+            if getattr(self, view, None) is not None:
+                getattr(self, view).release()
+                setattr(self, view, None)
+        self._buf = None
+        self._shm.close()
+        self._shm = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+
+_SEQ_CST = 5  # __ATOMIC_SEQ_CST
+
+
+def _load_atomic_cas():
+    """bool __atomic_compare_exchange_4(int32 *ptr, int32 *expected, int32 desired, int success, int failure)"""
+    library = ctypes.util.find_library("atomic")
+    if not library:
+        return None
+    try:
+        cas = getattr(ctypes.CDLL(library), "__atomic_compare_exchange_4")
+    except (OSError, AttributeError):
+        return None
+    cas.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int32, ctypes.c_int, ctypes.c_int]
+    cas.restype = ctypes.c_bool
+    return cas
+
+
+_ATOMIC_CAS = _load_atomic_cas()
+
+
+def _open_shared_memory(name):
+    try:
+        return shared_memory.SharedMemory(name=name, create=False, track=False)
+    except TypeError:
+        # Python < 3.13: keep the resource tracker from unlinking the engine's region when we exit
+        from multiprocessing import resource_tracker
+        shm = shared_memory.SharedMemory(name=name, create=False)
+        try:
+            resource_tracker.unregister(shm._name, "shared_memory")
+        except Exception:
+            pass
+        return shm
+
+
+if __name__ == "__main__":
+    import sys
+
+    stream_name = sys.argv[1] if len(sys.argv) > 1 else "cameratester_frames"
+    with FrameStreamReader(stream_name) as stream:
+        print(f"attached to '{stream_name}': {stream.slot_count} slots, policy {stream.policy}")
+        count = 0
+        started = time.perf_counter()
+        for frame in stream.frames():
+            count += 1
+            if count % 100 == 0:
+                rate = count / (time.perf_counter() - started)
+                print(f"{count} frames ({rate:.1f}/s), last cam {frame.camera_index} {frame.buffer_type} "
+                      f"#{frame.frame_index} {frame.width}x{frame.height}, lost {stream.lost}")
+        print(f"producer closed the stream after {count} frames, lost {stream.lost}")